@@ -0,0 +1,325 @@
+#include "BatchForecast.h"
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../FleetService/ThreadPool.h"
+#include "../../lib/SolarCalc/SolarCalc.h"
+#include "../../lib/EpochTime/EpochTime.h"
+#include "../../lib/EpochTime/TimeZone.h"
+
+static void appendRaw(std::string& out, const void* data, size_t bytes) {
+    out.append((const char*)data, bytes);
+}
+
+static bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        written += n;
+    }
+    return true;
+}
+
+static bool sameSite(const BatchRow& a, const BatchRow& b) {
+    return a.latitude == b.latitude && a.longitude == b.longitude && a.elevation == b.elevation &&
+           strcmp(a.timezone, b.timezone) == 0;
+}
+
+BatchForecast::BatchForecast(const BatchOptions& options) : options(options) {
+    memset(&stats, 0, sizeof(stats));
+    days = EpochTime::daysInYear(options.year);
+}
+
+BatchOptions BatchForecast::defaults() {
+    BatchOptions options;
+    options.year = TimeZone::buildYear();
+    options.mode = BATCH_ANNUAL;
+    options.format = BATCH_CSV;
+    options.threads = 0;
+    options.chunkBytes = 0;
+    options.blocksInFlight = 0;
+    options.allowMap = true;
+    return options;
+}
+
+bool BatchForecast::parseRow(const char* line, size_t length, BatchRow& row) {
+    // Copy so the number parsers stop at the line end, even at the end of a mapping
+    char text[BATCH_MAX_LINE];
+    while (length && (line[length - 1] == '\r' || line[length - 1] == ' ')) length--;
+    if (length >= sizeof(text)) return false;
+    memcpy(text, line, length);
+    text[length] = '\0';
+
+    char* p = text;
+    char* comma = strchr(p, ',');
+    if (!comma || comma == p || (size_t)(comma - p) >= sizeof(row.id)) return false;
+    memcpy(row.id, p, comma - p);
+    row.id[comma - p] = '\0';
+    p = comma + 1;
+
+    float* numbers[] = {&row.latitude, &row.longitude, &row.elevation, &row.tilt, &row.azimuth};
+    for (uint8_t i = 0; i < 5; i++) {
+        char* end;
+        *numbers[i] = strtof(p, &end);
+        if (end == p || (*end != ',' && *end != '\0') || (*end == '\0' && i < 4)) return false;
+        p = *end ? end + 1 : end;
+    }
+
+    while (*p == ' ') p++;
+    if (strlen(p) >= sizeof(row.timezone)) return false;
+    strcpy(row.timezone, p);
+
+    // A zone that does not compile would put every hour in the wrong place
+    if (row.timezone[0]) {
+        TimeZone zone;
+        if (!zone.begin(row.timezone)) return false;
+    }
+
+    return row.latitude >= -90 && row.latitude <= 90 && row.longitude >= -180 && row.longitude <= 180 &&
+           row.tilt >= 0 && row.tilt <= 90 && row.azimuth >= 0 && row.azimuth < 360;
+}
+
+void BatchForecast::writeHeader(std::string& out) {
+    if (options.format == BATCH_CSV) {
+        out = options.mode == BATCH_ANNUAL ? "id,latitude,longitude,tilt,azimuth,annual_kwh_m2\n"
+                                           : "id,date,kwh_m2\n";
+        return;
+    }
+
+    uint16_t version = 1;
+    uint8_t mode = options.mode;
+    uint8_t reserved8 = 0;
+    int16_t year = (int16_t)options.year;
+    uint16_t columns = options.mode == BATCH_DAILY ? days : 0;
+    uint32_t reserved32 = 0;
+    out.assign("SGFB", 4);
+    appendRaw(out, &version, 2);
+    appendRaw(out, &mode, 1);
+    appendRaw(out, &reserved8, 1);
+    appendRaw(out, &year, 2);
+    appendRaw(out, &columns, 2);
+    appendRaw(out, &reserved32, 4);
+}
+
+void BatchForecast::process(Block& block) {
+    // Parse the block's lines
+    std::vector<BatchRow> rows;
+    rows.reserve(block.size / 40 + 1);
+    const char* p = block.data;
+    const char* end = block.data + block.size;
+    while (p < end) {
+        const char* newline = (const char*)memchr(p, '\n', end - p);
+        const char* lineEnd = newline ? newline : end;
+        const char* first = p;
+        while (first < lineEnd && (*first == ' ' || *first == '\t')) first++;
+        bool skip = first == lineEnd || *first == '\r' || *first == '#' ||
+                    (lineEnd - first >= 3 && strncmp(first, "id,", 3) == 0);
+        if (!skip) {
+            rows.emplace_back();
+            if (!parseRow(first, lineEnd - first, rows.back())) {
+                rows.pop_back();
+                block.rejected++;
+            }
+        }
+        p = lineEnd + 1;
+    }
+
+    size_t count = rows.size();
+    std::vector<double> totals(count, 0.0);
+    std::vector<float> daily(options.mode == BATCH_DAILY ? (size_t)days * count : 0);
+    int64_t firstDay = EpochTime::daysFromCivil(options.year, 1, 1);
+
+    // One SolarCalc per block, moved from site to site
+    SolarCalc solar(0, 0, 0, 0, 0);
+    TimeZone zone;
+    std::string zoneText = "\x01";  // nothing compiled yet
+
+    for (size_t first = 0; first < count;) {
+        size_t last = first + 1;
+        while (last < count && sameSite(rows[first], rows[last])) last++;
+
+        const BatchRow& site = rows[first];
+        if (zoneText != site.timezone) {
+            zoneText = site.timezone;
+            // parseRow() has checked that it compiles
+            zone.begin(site.timezone[0] ? site.timezone : "UTC0", options.year);
+            solar.setTimeZone(&zone);
+        }
+        solar.setSite(site.latitude, site.longitude, site.elevation);
+
+        // Day outside, rows inside: each day's sun is computed once for the run
+        for (uint16_t dayIndex = 0; dayIndex < days; dayIndex++) {
+            int year, month, day;
+            EpochTime::civilFromDays(firstDay + dayIndex, year, month, day);
+            for (size_t i = first; i < last; i++) {
+                solar.setPanel(rows[i].tilt, rows[i].azimuth);
+                float total = solar.calculateDailyForecast(year, month, day).totalIrradiance;
+                totals[i] += total;
+                if (!daily.empty()) daily[(size_t)dayIndex * count + i] = total;
+            }
+        }
+        first = last;
+    }
+
+    SolarCalcStats solarStats = solar.getStats();
+    block.rows = count;
+    block.skyRuns = solarStats.ephemerisRuns;
+    block.transpositions = solarStats.transpositions;
+
+    // Encode
+    std::string& out = block.output;
+    out.clear();
+    if (options.format == BATCH_CSV) {
+        char line[160];
+        for (size_t i = 0; i < count; i++) {
+            const BatchRow& row = rows[i];
+            if (options.mode == BATCH_ANNUAL) {
+                int length = snprintf(line, sizeof(line), "%s,%.4f,%.4f,%.1f,%.1f,%.3f\n", row.id, row.latitude,
+                                      row.longitude, row.tilt, row.azimuth, totals[i]);
+                out.append(line, length);
+                continue;
+            }
+            for (uint16_t dayIndex = 0; dayIndex < days; dayIndex++) {
+                int length = snprintf(line, sizeof(line), "%s,%s,%.4f\n", row.id, dateLabels[dayIndex],
+                                      daily[(size_t)dayIndex * count + i]);
+                out.append(line, length);
+            }
+        }
+    } else {
+        uint32_t rowCount = (uint32_t)count;
+        uint32_t idBytes = 0;
+        std::vector<uint16_t> idLengths(count);
+        for (size_t i = 0; i < count; i++) {
+            idLengths[i] = (uint16_t)strlen(rows[i].id);
+            idBytes += idLengths[i];
+        }
+        appendRaw(out, &rowCount, 4);
+        appendRaw(out, &idBytes, 4);
+        appendRaw(out, idLengths.data(), count * sizeof(uint16_t));
+        for (size_t i = 0; i < count; i++) {
+            appendRaw(out, rows[i].id, idLengths[i]);
+        }
+
+        std::vector<float> column(count);
+        float BatchRow::* fields[] = {&BatchRow::latitude, &BatchRow::longitude, &BatchRow::tilt, &BatchRow::azimuth};
+        for (float BatchRow::* field : fields) {
+            for (size_t i = 0; i < count; i++) {
+                column[i] = rows[i].*field;
+            }
+            appendRaw(out, column.data(), count * sizeof(float));
+        }
+        for (size_t i = 0; i < count; i++) {
+            column[i] = (float)totals[i];
+        }
+        appendRaw(out, column.data(), count * sizeof(float));
+        appendRaw(out, daily.data(), daily.size() * sizeof(float));
+    }
+}
+
+bool BatchForecast::run(const char* inputPath, int outFd) {
+    memset(&stats, 0, sizeof(stats));
+    size_t chunkBytes = options.chunkBytes ? options.chunkBytes :
+                        options.mode == BATCH_DAILY ? BATCH_DAILY_CHUNK_BYTES : BATCH_ANNUAL_CHUNK_BYTES;
+    CsvChunkReader reader(chunkBytes);
+    if (!reader.open(inputPath, options.allowMap)) return false;
+
+    for (uint16_t dayIndex = 0; dayIndex < days; dayIndex++) {
+        int year, month, day;
+        EpochTime::civilFromDays(EpochTime::daysFromCivil(options.year, 1, 1) + dayIndex, year, month, day);
+        snprintf(dateLabels[dayIndex], sizeof(dateLabels[dayIndex]), "%04d-%02d-%02d", year, month, day);
+    }
+
+    unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    unsigned inFlight = options.blocksInFlight ? options.blocksInFlight : threads * 2;
+    std::vector<std::unique_ptr<Block>> slots(inFlight);
+    for (auto& slot : slots) {
+        slot.reset(new Block());
+        slot->done = true;
+    }
+
+    std::string header;
+    writeHeader(header);
+    bool ok = writeAll(outFd, header);
+    stats.bytesOut = header.size();
+
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(threads);
+    std::mutex lock;
+    std::condition_variable finished;
+    uint64_t nextBlock = 0;
+    uint64_t writeBlock = 0;
+    bool endOfInput = false;
+
+    while (ok) {
+        // Write finished blocks in input order
+        while (writeBlock < nextBlock && slots[writeBlock % inFlight]->done) {
+            Block& block = *slots[writeBlock % inFlight];
+
+            // Memory held right now: every block in flight, this one's output included
+            size_t buffered = 0;
+            for (uint64_t i = writeBlock; i < nextBlock; i++) {
+                Block& held = *slots[i % inFlight];
+                buffered += reader.isMapped() ? held.size : held.input.capacity();
+                if (held.done) buffered += held.output.capacity();
+            }
+            if (buffered > stats.peakBuffered) stats.peakBuffered = buffered;
+
+            if (!writeAll(outFd, block.output)) ok = false;
+            stats.bytesOut += block.output.size();
+            stats.rows += block.rows;
+            stats.rejected += block.rejected;
+            stats.skyRuns += block.skyRuns;
+            stats.transpositions += block.transpositions;
+            stats.blocks++;
+            reader.release(block.data, block.size);
+            writeBlock++;
+        }
+        if (!ok) break;
+
+        if (!endOfInput && nextBlock - writeBlock < inFlight) {
+            Block& block = *slots[nextBlock % inFlight];
+            if (!reader.next(block.input, block.data, block.size)) {
+                stats.readError = reader.getError();
+                if (stats.readError) ok = false;
+                endOfInput = true;
+                continue;
+            }
+            block.rows = block.rejected = block.skyRuns = block.transpositions = 0;
+            block.done = false;
+            stats.bytesIn += block.size;
+            nextBlock++;
+            pool.submit([this, &block, &lock, &finished] {
+                process(block);
+                std::lock_guard<std::mutex> guard(lock);
+                block.done = true;
+                finished.notify_one();
+            });
+            continue;
+        }
+        if (endOfInput && writeBlock == nextBlock) break;
+
+        std::unique_lock<std::mutex> guard(lock);
+        Block& oldest = *slots[writeBlock % inFlight];
+        finished.wait(guard, [&oldest] { return oldest.done.load(); });
+    }
+
+    // On a read or write error, let submitted blocks finish before their slots go
+    pool.stop();
+    reader.close();
+
+    stats.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    stats.rowsPerSecond = stats.seconds > 0 ? stats.rows / stats.seconds : 0;
+    stats.threads = threads;
+    return ok;
+}
@@ -0,0 +1,126 @@
+#ifndef BATCH_FORECAST_H
+#define BATCH_FORECAST_H
+
+// Clear-sky yield for many candidate sites and panels, streamed from CSV to
+// CSV or a binary columnar file. Input rows are
+//
+//   id,latitude,longitude,elevation,tilt,azimuth[,timezone]
+//
+// with the POSIX TZ string optional (UTC) and taking the rest of the line.
+// The reader hands out blocks of lines, the thread pool computes them and
+// the calling thread writes them back in input order. At most
+// blocksInFlight blocks exist at once, so memory does not grow with the file.
+//
+// Consecutive rows at the same site (a tilt sweep, say) share SolarCalc's
+// sun positions for each day; only the transposition runs per row.
+//
+// Binary output, little-endian. A 16-byte file header:
+//   char magic[4] "SGFB", uint16 version (1), uint8 mode (0 annual, 1 daily),
+//   uint8 reserved, int16 year, uint16 days (daily columns, 0 for annual), uint32 reserved
+// then one record batch per block:
+//   uint32 rows, uint32 idBytes, uint16 idLength[rows], char ids[idBytes],
+//   float latitude[rows], longitude[rows], tilt[rows], azimuth[rows], total[rows],
+//   and in daily mode float day[days][rows], one column per day of the year.
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include "CsvChunkReader.h"
+
+// Line-aligned input per block; daily mode writes about 365 values per row,
+// so its blocks are smaller
+#ifndef BATCH_ANNUAL_CHUNK_BYTES
+#define BATCH_ANNUAL_CHUNK_BYTES (256 * 1024)
+#endif
+
+#ifndef BATCH_DAILY_CHUNK_BYTES
+#define BATCH_DAILY_CHUNK_BYTES (16 * 1024)
+#endif
+
+#define BATCH_MAX_LINE 256
+
+enum BatchMode : uint8_t {
+    BATCH_ANNUAL,       // one total per row
+    BATCH_DAILY         // one total per row and day
+};
+
+enum BatchFormat : uint8_t {
+    BATCH_CSV,
+    BATCH_BINARY
+};
+
+struct BatchOptions {
+    int year;
+    BatchMode mode;
+    BatchFormat format;
+    unsigned threads;           // 0: one per core
+    size_t chunkBytes;          // 0: by mode, see above
+    unsigned blocksInFlight;    // 0: twice the threads
+    bool allowMap;              // false reads in chunks even from a regular file
+};
+
+struct BatchStats {
+    uint64_t rows;
+    uint64_t rejected;          // lines that are not a valid site row
+    uint64_t blocks;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t skyRuns;           // SolarCalc sun-position passes
+    uint64_t transpositions;
+    size_t peakBuffered;        // most bytes held by blocks at once
+    float seconds;
+    float rowsPerSecond;
+    unsigned threads;
+    int readError;              // errno when reading the input failed, else 0
+};
+
+struct BatchRow {
+    char id[48];
+    float latitude;
+    float longitude;
+    float elevation;
+    float tilt;
+    float azimuth;
+    char timezone[64];
+};
+
+class BatchForecast {
+private:
+    struct Block {
+        std::string input;          // read path only
+        const char* data;
+        size_t size;
+        std::string output;
+        uint64_t rows;
+        uint64_t rejected;
+        uint64_t skyRuns;
+        uint64_t transpositions;
+        std::atomic<bool> done;
+    };
+
+    BatchOptions options;
+    BatchStats stats;
+    uint16_t days;
+    char dateLabels[366][11];   // YYYY-MM-DD for each day of the year
+
+    void process(Block& block);
+    void writeHeader(std::string& out);
+
+public:
+    explicit BatchForecast(const BatchOptions& options);
+
+    static BatchOptions defaults();
+
+    // One line without its newline. False for a malformed row, a value out
+    // of range, a time zone that does not compile or a field too long for
+    // BatchRow.
+    static bool parseRow(const char* line, size_t length, BatchRow& row);
+
+    // Stream inputPath ("-" for stdin) to outFd. False when the input cannot
+    // be opened or read, or a write fails.
+    bool run(const char* inputPath, int outFd);
+
+    BatchStats getStats() const { return stats; }
+};
+
+#endif // BATCH_FORECAST_H
@@ -0,0 +1,112 @@
+#include "CsvChunkReader.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+CsvChunkReader::CsvChunkReader(size_t chunkBytes)
+    : fd(-1), map(nullptr), mapSize(0), offset(0), chunkBytes(chunkBytes ? chunkBytes : 1), finished(false),
+      error(0) {
+}
+
+CsvChunkReader::~CsvChunkReader() {
+    close();
+}
+
+bool CsvChunkReader::open(const char* path, bool allowMap) {
+    close();
+    fd = strcmp(path, "-") == 0 ? dup(STDIN_FILENO) : ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (allowMap && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            map = (const char*)mapped;
+            mapSize = info.st_size;
+            madvise(mapped, mapSize, MADV_SEQUENTIAL);
+        }
+    }
+    return true;
+}
+
+void CsvChunkReader::close() {
+    if (map) munmap((void*)map, mapSize);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    map = nullptr;
+    mapSize = 0;
+    offset = 0;
+    carry.clear();
+    finished = false;
+    error = 0;
+}
+
+bool CsvChunkReader::next(std::string& buffer, const char*& data, size_t& size) {
+    if (fd < 0 || finished) return false;
+
+    if (map) {
+        if (offset >= mapSize) {
+            finished = true;
+            return false;
+        }
+        // Run on to the end of the line the chunk boundary falls in
+        size_t end = offset + chunkBytes < mapSize ? offset + chunkBytes : mapSize;
+        if (end < mapSize) {
+            const char* newline = (const char*)memchr(map + end - 1, '\n', mapSize - end + 1);
+            end = newline ? newline - map + 1 : mapSize;
+        }
+        data = map + offset;
+        size = end - offset;
+        offset = end;
+        return true;
+    }
+
+    // Fill to a chunk, then hold back everything after the last newline
+    buffer.swap(carry);
+    carry.clear();
+    size_t lastNewline = std::string::npos;
+    for (;;) {
+        size_t have = buffer.size();
+        if (have >= chunkBytes && (lastNewline = buffer.rfind('\n')) != std::string::npos) break;
+        buffer.resize(have + chunkBytes);
+        ssize_t n = read(fd, &buffer[have], chunkBytes);
+        if (n < 0 && errno == EINTR) {
+            // A signal, such as fleetd's SIGHUP, is not the end of the input
+            buffer.resize(have);
+            continue;
+        }
+        if (n < 0) {
+            // The rest of the input is lost; a partial block would be wrong output
+            error = errno;
+            finished = true;
+            buffer.clear();
+            return false;
+        }
+        if (n == 0) {
+            buffer.resize(have);
+            finished = true;
+            break;
+        }
+        buffer.resize(have + n);
+    }
+
+    if (!finished) carry.assign(buffer, lastNewline + 1, std::string::npos);
+    if (!finished) buffer.resize(lastNewline + 1);
+    data = buffer.data();
+    size = buffer.size();
+    return size > 0;
+}
+
+void CsvChunkReader::release(const char* data, size_t size) {
+    if (!map || data < map || data + size > map + mapSize) return;
+
+    // Only whole pages inside the block; its neighbours may still be in use
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)data + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t)data + size) & ~(page - 1);
+    if (end > start) madvise((void*)start, end - start, MADV_DONTNEED);
+}
@@ -0,0 +1,48 @@
+#ifndef CSV_CHUNK_READER_H
+#define CSV_CHUNK_READER_H
+
+// Reads a CSV file as blocks of whole lines, about chunkBytes each. Regular
+// files are mapped and handed out in place; pipes and stdin ("-") are read
+// in chunks into a caller-owned buffer. Either way only the blocks being
+// worked on are resident, however large the file.
+
+#include <stddef.h>
+#include <string>
+
+#ifndef CSV_CHUNK_BYTES
+#define CSV_CHUNK_BYTES (1024 * 1024)
+#endif
+
+class CsvChunkReader {
+private:
+    int fd;
+    const char* map;        // whole file when mapped, else nullptr
+    size_t mapSize;
+    size_t offset;          // next byte of the mapping to hand out
+    size_t chunkBytes;
+    std::string carry;      // read path: partial last line of the previous chunk
+    bool finished;
+    int error;              // errno of a failed read; 0 at a clean end
+
+public:
+    explicit CsvChunkReader(size_t chunkBytes = CSV_CHUNK_BYTES);
+    ~CsvChunkReader();
+
+    // "-" reads stdin. allowMap false forces the read() path, as for a pipe.
+    bool open(const char* path, bool allowMap = true);
+    void close();
+
+    // Next block of whole lines; the last line may lack its newline. A
+    // mapped block points into the file and stays valid until close(); a
+    // read block lives in buffer. False at end of input, or when a read
+    // fails; getError() tells them apart.
+    bool next(std::string& buffer, const char*& data, size_t& size);
+    int getError() const { return error; }
+
+    // Let the kernel drop the pages of a finished mapped block
+    void release(const char* data, size_t size);
+
+    bool isMapped() const { return map != nullptr; }
+};
+
+#endif // CSV_CHUNK_READER_H
@@ -0,0 +1,83 @@
+// batchforecast: clear-sky yield for a CSV of candidate sites (pio run -e batchforecast).
+//
+//   batchforecast --in sites.csv [--out results.csv] [--year 2025] [--daily] [--binary]
+//                 [--threads N] [--chunk KiB] [--no-mmap]
+//
+// Input and output default to stdin and stdout; progress goes to stderr.
+
+#ifdef BATCH_FORECAST_MAIN
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <thread>
+#include "BatchForecast.h"
+
+static void usage() {
+    fprintf(stderr,
+            "usage: batchforecast [--in FILE|-] [--out FILE|-] [--year YYYY] [--daily] [--binary]\n"
+            "                     [--threads N] [--chunk KiB] [--no-mmap]\n");
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options = BatchForecast::defaults();
+    const char* inputPath = "-";
+    const char* outputPath = "-";
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(argv[i], "--daily") == 0) options.mode = BATCH_DAILY;
+        else if (strcmp(argv[i], "--binary") == 0) options.format = BATCH_BINARY;
+        else if (strcmp(argv[i], "--no-mmap") == 0) options.allowMap = false;
+        else if (value && strcmp(argv[i], "--in") == 0) inputPath = argv[++i];
+        else if (value && strcmp(argv[i], "--out") == 0) outputPath = argv[++i];
+        else if (value && strcmp(argv[i], "--year") == 0) options.year = atoi(argv[++i]);
+        else if (value && strcmp(argv[i], "--threads") == 0) options.threads = atoi(argv[++i]);
+        else if (value && strcmp(argv[i], "--chunk") == 0) options.chunkBytes = strtoul(argv[++i], nullptr, 10) * 1024;
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (options.year < 1900 || options.year > 2199) {
+        fprintf(stderr, "batchforecast: year out of range\n");
+        return 2;
+    }
+
+    int outFd = STDOUT_FILENO;
+    if (strcmp(outputPath, "-") != 0) {
+        outFd = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (outFd < 0) {
+            fprintf(stderr, "batchforecast: cannot write %s\n", outputPath);
+            return 1;
+        }
+    }
+
+    BatchForecast batch(options);
+    bool ok = batch.run(inputPath, outFd);
+    if (outFd != STDOUT_FILENO) close(outFd);
+    BatchStats stats = batch.getStats();
+    if (!ok && stats.readError) {
+        fprintf(stderr, "batchforecast: reading %s failed: %s\n", inputPath, strerror(stats.readError));
+        return 1;
+    }
+    if (!ok && stats.blocks == 0) {
+        fprintf(stderr, "batchforecast: cannot read %s\n", inputPath);
+        return 1;
+    }
+
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores == 0 || cores > stats.threads) cores = stats.threads;
+    fprintf(stderr,
+            "batchforecast: %llu rows (%llu rejected) in %.2f s on %u threads: %.0f rows/s, %.0f rows/s per core\n",
+            (unsigned long long)stats.rows, (unsigned long long)stats.rejected, stats.seconds, stats.threads,
+            stats.rowsPerSecond, stats.rowsPerSecond / cores);
+    fprintf(stderr, "batchforecast: %llu sun-position passes, %llu transpositions, peak %zu KiB buffered\n",
+            (unsigned long long)stats.skyRuns, (unsigned long long)stats.transpositions, stats.peakBuffered / 1024);
+    if (!ok) fprintf(stderr, "batchforecast: write failed\n");
+    return ok ? 0 : 1;
+}
+
+#endif // BATCH_FORECAST_MAIN
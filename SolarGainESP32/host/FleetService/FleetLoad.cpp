@@ -0,0 +1,172 @@
+#include "FleetLoad.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../../lib/EpochTime/EpochTime.h"
+
+FleetLoad::FleetLoad(const FleetLoadOptions& options, const std::vector<std::string>& siteIds)
+    : options(options), siteIds(siteIds) {
+}
+
+FleetLoadOptions FleetLoad::defaults() {
+    FleetLoadOptions options;
+    options.socketPath = nullptr;
+    options.port = 0;
+    options.clients = 4;
+    options.requests = 20000;
+    options.days = 365;
+    options.startDate = "2024-01-01";
+    options.seed = 1;
+    return options;
+}
+
+int FleetLoad::connectToService() {
+    int fd;
+    if (options.socketPath) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, options.socketPath, sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(options.port);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) {
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+    }
+    return fd;
+}
+
+void FleetLoad::runClient(unsigned client, uint32_t requests, std::vector<float>& latencies, uint64_t& errors) {
+    std::mt19937 rng(options.seed * 7919 + client);
+    int startYear = atoi(options.startDate);
+    int startMonth = atoi(options.startDate + 5);
+    int startDay = atoi(options.startDate + 8);
+    int64_t firstDay = EpochTime::daysFromCivil(startYear, startMonth, startDay);
+
+    int fd = connectToService();
+    std::string buffer;
+    char chunk[4096];
+    latencies.reserve(requests);
+
+    for (uint32_t i = 0; i < requests; i++) {
+        if (fd < 0) {
+            // Reconnect once per request; a refused connection is an error
+            fd = connectToService();
+            if (fd < 0) {
+                errors++;
+                continue;
+            }
+            buffer.clear();
+        }
+
+        const std::string& site = siteIds[rng() % siteIds.size()];
+        int year, month, day;
+        EpochTime::civilFromDays(firstDay + rng() % (options.days ? options.days : 1), year, month, day);
+        char request[256];
+        int length = snprintf(request, sizeof(request),
+                              "GET /forecast?site=%s&date=%04d-%02d-%02d HTTP/1.1\r\nHost: fleetd\r\n\r\n",
+                              site.c_str(), year, month, day);
+
+        auto start = std::chrono::steady_clock::now();
+        bool failed = send(fd, request, length, MSG_NOSIGNAL) != length;
+
+        // Status line, headers, then Content-Length bytes of body
+        size_t headEnd = std::string::npos;
+        while (!failed && (headEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) failed = true;
+            else buffer.append(chunk, n);
+        }
+        size_t total = 0;
+        int status = 0;
+        if (!failed) {
+            status = atoi(buffer.c_str() + 9);
+            size_t field = buffer.find("Content-Length:");
+            size_t contentLength = field < headEnd ? strtoul(buffer.c_str() + field + 15, nullptr, 10) : 0;
+            total = headEnd + 4 + contentLength;
+            while (!failed && buffer.size() < total) {
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) failed = true;
+                else buffer.append(chunk, n);
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        if (failed) {
+            close(fd);
+            fd = -1;
+            errors++;
+            continue;
+        }
+        buffer.erase(0, total);
+        if (status != 200) errors++;
+        latencies.push_back(std::chrono::duration<float, std::micro>(end - start).count());
+    }
+
+    if (fd >= 0) close(fd);
+}
+
+FleetLoadReport FleetLoad::run() {
+    FleetLoadReport report;
+    memset(&report, 0, sizeof(report));
+    if (siteIds.empty() || options.clients == 0) return report;
+
+    std::vector<std::vector<float>> latencies(options.clients);
+    std::vector<uint64_t> errors(options.clients, 0);
+    std::vector<std::thread> clients;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < options.clients; i++) {
+        uint32_t share = options.requests / options.clients + (i < options.requests % options.clients ? 1 : 0);
+        clients.emplace_back(&FleetLoad::runClient, this, i, share, std::ref(latencies[i]), std::ref(errors[i]));
+    }
+    for (std::thread& client : clients) {
+        client.join();
+    }
+    report.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<float> all;
+    for (unsigned i = 0; i < options.clients; i++) {
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+        report.errors += errors[i];
+    }
+    report.requests = all.size();
+    if (!all.empty()) {
+        // Nearest-rank percentiles
+        size_t p50 = (all.size() - 1) / 2;
+        size_t p99 = (all.size() - 1) * 99 / 100;
+        std::nth_element(all.begin(), all.begin() + p50, all.end());
+        report.p50Us = all[p50];
+        std::nth_element(all.begin() + p50, all.begin() + p99, all.end());
+        report.p99Us = all[p99];
+        report.maxUs = *std::max_element(all.begin() + p99, all.end());
+    }
+    if (report.seconds > 0) report.requestsPerSecond = report.requests / report.seconds;
+    return report;
+}
@@ -0,0 +1,50 @@
+#ifndef FLEET_LOAD_H
+#define FLEET_LOAD_H
+
+// Load generator for the fleet service. Each client thread holds one
+// keep-alive connection and sends forecast requests back to back for random
+// sites and dates, timing every round trip.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct FleetLoadOptions {
+    const char* socketPath;     // Unix socket, or nullptr to use port
+    uint16_t port;              // 127.0.0.1
+    unsigned clients;           // concurrent connections
+    uint32_t requests;          // in total, split over the clients
+    uint16_t days;              // dates drawn from this many days after startDate
+    const char* startDate;      // YYYY-MM-DD
+    uint32_t seed;
+};
+
+struct FleetLoadReport {
+    uint64_t requests;
+    uint64_t errors;            // non-200 responses and failed connections
+    float seconds;
+    float p50Us;
+    float p99Us;
+    float maxUs;
+    float requestsPerSecond;
+};
+
+class FleetLoad {
+private:
+    FleetLoadOptions options;
+    std::vector<std::string> siteIds;
+
+    int connectToService();
+
+    // One client; latencies in microseconds
+    void runClient(unsigned client, uint32_t requests, std::vector<float>& latencies, uint64_t& errors);
+
+public:
+    FleetLoad(const FleetLoadOptions& options, const std::vector<std::string>& siteIds);
+
+    static FleetLoadOptions defaults();
+
+    FleetLoadReport run();
+};
+
+#endif // FLEET_LOAD_H
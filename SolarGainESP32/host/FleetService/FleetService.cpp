@@ -0,0 +1,459 @@
+#include "FleetService.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../../lib/SolarCalc/SolarCalc.h"
+#include "../../lib/EpochTime/EpochTime.h"
+
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Quote a string for JSON; ids and names come from the site file
+static void appendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Write everything, waiting for a slow reader up to a second at a time
+static bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd writable = {fd, POLLOUT, 0};
+            if (poll(&writable, 1, 1000) <= 0) return false;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+FleetService::FleetService(SiteRegistry& registry, unsigned threads, size_t cacheEntries, unsigned cacheShards)
+    : registry(registry), cache(cacheEntries, cacheShards), threads(threads), listenFd(-1), epollFd(-1),
+      wakeFd(-1), port(0), running(false), connectionCount(0), requestCount(0), errorCount(0), computeCount(0) {
+}
+
+FleetService::~FleetService() {
+    stop();
+}
+
+bool FleetService::beginTcp(uint16_t listenPort) {
+    if (running) return false;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(listenPort);
+    socklen_t length = sizeof(addr);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &length) < 0) {
+        close(fd);
+        return false;
+    }
+    port = ntohs(addr.sin_port);
+    return start(fd);
+}
+
+bool FleetService::beginUnix(const char* path) {
+    if (running) return false;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+
+    // A socket file left by a daemon that did not stop cleanly
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return false;
+    }
+    socketPath = path;
+    return start(fd);
+}
+
+bool FleetService::start(int fd) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (listen(fd, 512) < 0 || epollFd < 0 || wakeFd < 0) {
+        close(fd);
+        if (epollFd >= 0) close(epollFd);
+        if (wakeFd >= 0) close(wakeFd);
+        epollFd = wakeFd = -1;
+        if (!socketPath.empty()) unlink(socketPath.c_str());
+        socketPath.clear();
+        return false;
+    }
+    listenFd = fd;
+
+    // The listener carries a null pointer, the wake-up event its own fd's address
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.ptr = &wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    pool.reset(new ThreadPool(threads));
+    running = true;
+    ioThread = std::thread(&FleetService::ioLoop, this);
+    return true;
+}
+
+void FleetService::stop() {
+    if (!running) return;
+    running = false;
+
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The I/O thread still wakes on its next event
+    }
+    ioThread.join();
+
+    // Let queued requests finish before their connections go
+    pool->stop();
+    pool.reset();
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& open : connections) {
+            close(open.first);
+        }
+        connections.clear();
+    }
+    close(listenFd);
+    close(epollFd);
+    close(wakeFd);
+    listenFd = epollFd = wakeFd = -1;
+    if (!socketPath.empty()) unlink(socketPath.c_str());
+    socketPath.clear();
+    port = 0;
+}
+
+void FleetService::ioLoop() {
+    struct epoll_event events[64];
+    while (running) {
+        int ready = epoll_wait(epollFd, events, 64, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == nullptr) {
+                acceptAll();
+            } else if (tag != &wakeFd) {
+                // One-shot: nothing else sees this connection until serve() re-arms it
+                Connection* connection = (Connection*)tag;
+                pool->submit([this, connection] { serve(connection); });
+            }
+        }
+    }
+}
+
+void FleetService::acceptAll() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (socketPath.empty()) {
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+
+        Connection* connection = new Connection();
+        connection->fd = fd;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            connections[fd].reset(connection);
+        }
+        connectionCount++;
+
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        event.data.ptr = connection;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void FleetService::drop(Connection* connection) {
+    // Close and forget under the lock, so an accept() reusing the fd number
+    // cannot register before the old entry is gone
+    std::lock_guard<std::mutex> guard(lock);
+    int fd = connection->fd;
+    close(fd);
+    connections.erase(fd);
+}
+
+void FleetService::serve(Connection* connection) {
+    int fd = connection->fd;
+    std::string& input = connection->input;
+    char chunk[4096];
+    bool closed = false;
+
+    for (;;) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            input.append(chunk, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        closed = true;
+        break;
+    }
+
+    // Answer every complete request, pipelined ones included
+    std::string output;
+    bool keepAlive = true;
+    size_t headEnd;
+    while (keepAlive && (headEnd = input.find("\r\n\r\n")) != std::string::npos) {
+        size_t lineEnd = input.find("\r\n");
+        size_t space1 = input.find(' ');
+        size_t space2 = input.find(' ', space1 + 1);
+        if (space1 >= lineEnd || space2 >= lineEnd) {
+            drop(connection);
+            return;
+        }
+        std::string method = input.substr(0, space1);
+        std::string target = input.substr(space1 + 1, space2 - space1 - 1);
+
+        size_t contentLength = 0;
+        size_t lineStart = lineEnd + 2;
+        while (lineStart < headEnd + 2) {
+            size_t next = input.find("\r\n", lineStart);
+            const char* line = input.c_str() + lineStart;
+            if (strncasecmp(line, "Content-Length:", 15) == 0) {
+                contentLength = strtoul(line + 15, nullptr, 10);
+            } else if (strncasecmp(line, "Connection:", 11) == 0) {
+                const char* value = line + 11;
+                while (*value == ' ') value++;
+                keepAlive = strncasecmp(value, "close", 5) != 0;
+            }
+            lineStart = next + 2;
+        }
+
+        // Bodies are not used, but must be skipped to find the next request
+        size_t total = headEnd + 4 + contentLength;
+        if (input.size() < total) break;
+        input.erase(0, total);
+
+        std::string body;
+        int status = handle(method, target, body);
+        const char* reason = status == 200 ? "OK" : status == 404 ? "Not Found" :
+                             status == 405 ? "Method Not Allowed" : "Bad Request";
+        char head[160];
+        snprintf(head, sizeof(head),
+                 "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %u\r\nConnection: %s\r\n\r\n",
+                 status, reason, (unsigned)body.size(), keepAlive ? "keep-alive" : "close");
+        output += head;
+        output += body;
+    }
+
+    if (input.size() > FLEET_MAX_REQUEST || (!output.empty() && !sendAll(fd, output)) || !keepAlive || closed) {
+        drop(connection);
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    event.data.ptr = connection;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+int FleetService::handle(const std::string& method, const std::string& target, std::string& body) {
+    requestCount++;
+    size_t mark = target.find('?');
+    std::string path = target.substr(0, mark);
+    std::string query = mark == std::string::npos ? "" : target.substr(mark + 1);
+    char number[48];
+    int status = 200;
+
+    if (method != "GET") {
+        status = 405;
+        body = "{\"error\":\"only GET is supported\"}";
+    } else if (path == "/forecast") {
+        std::string siteId = queryValue(query, "site");
+        std::string tiltText = queryValue(query, "tilt");
+        std::string azimuthText = queryValue(query, "azimuth");
+        float tilt = tiltText.empty() ? NAN : strtof(tiltText.c_str(), nullptr);
+        float azimuth = azimuthText.empty() ? NAN : strtof(azimuthText.c_str(), nullptr);
+        int year, month, day;
+        CachedForecast result;
+
+        FleetStatus outcome = FLEET_BAD_DATE;
+        if (parseDate(queryValue(query, "date"), year, month, day)) {
+            outcome = forecast(siteId, year, month, day, result, tilt, azimuth);
+        }
+
+        if (outcome == FLEET_UNKNOWN_SITE) {
+            status = 404;
+            body = "{\"error\":\"unknown site\"}";
+        } else if (outcome == FLEET_BAD_DATE) {
+            status = 400;
+            body = "{\"error\":\"date must be YYYY-MM-DD\"}";
+        } else if (outcome == FLEET_BAD_PANEL) {
+            status = 400;
+            body = "{\"error\":\"tilt must be 0-90 and azimuth 0-359\"}";
+        } else {
+            body = "{\"site\":";
+            appendJsonString(body, siteId);
+            snprintf(number, sizeof(number), ",\"date\":\"%04d-%02d-%02d\",\"total\":%.4f,\"hourly\":[",
+                     year, month, day, result.total);
+            body += number;
+            for (int hour = 0; hour < 24; hour++) {
+                snprintf(number, sizeof(number), hour ? ",%.4f" : "%.4f", result.hourly[hour]);
+                body += number;
+            }
+            body += "]}";
+        }
+    } else if (path == "/sites") {
+        body = "[";
+        for (const FleetSite& site : registry.list()) {
+            if (body.size() > 1) body += ',';
+            body += "{\"id\":";
+            appendJsonString(body, site.id);
+            body += ",\"name\":";
+            appendJsonString(body, site.name);
+            snprintf(number, sizeof(number), ",\"latitude\":%.4f,\"longitude\":%.4f", site.latitude, site.longitude);
+            body += number;
+            snprintf(number, sizeof(number), ",\"tilt\":%.1f,\"azimuth\":%.1f,\"timezone\":", site.tilt, site.azimuth);
+            body += number;
+            appendJsonString(body, site.timezone);
+            body += '}';
+        }
+        body += ']';
+    } else if (path == "/stats") {
+        FleetServiceStats stats = getStats();
+        char json[320];
+        snprintf(json, sizeof(json),
+                 "{\"connections\":%llu,\"requests\":%llu,\"errors\":%llu,\"computed\":%llu,"
+                 "\"cache\":{\"hits\":%llu,\"misses\":%llu,\"evictions\":%llu,\"entries\":%llu},"
+                 "\"sites\":%u,\"threads\":%u}",
+                 (unsigned long long)stats.connections, (unsigned long long)stats.requests,
+                 (unsigned long long)stats.errors, (unsigned long long)stats.computed,
+                 (unsigned long long)stats.cache.hits, (unsigned long long)stats.cache.misses,
+                 (unsigned long long)stats.cache.evictions, (unsigned long long)stats.cache.entries,
+                 stats.sites, stats.threads);
+        body = json;
+    } else {
+        status = 404;
+        body = "{\"error\":\"not found\"}";
+    }
+
+    if (status != 200) errorCount++;
+    return status;
+}
+
+FleetStatus FleetService::forecast(const std::string& siteId, int year, int month, int day,
+                                   CachedForecast& result, float tilt, float azimuth) {
+    FleetSite site;
+    if (!registry.find(siteId, site)) return FLEET_UNKNOWN_SITE;
+
+    // Reject dates that do not survive a round trip, e.g. 2023-02-29
+    if (year < 1900 || year > 2199 || month < 1 || month > 12 || day < 1 || day > 31) return FLEET_BAD_DATE;
+    int64_t dayNumber = EpochTime::daysFromCivil(year, month, day);
+    int checkYear, checkMonth, checkDay;
+    EpochTime::civilFromDays(dayNumber, checkYear, checkMonth, checkDay);
+    if (checkMonth != month || checkDay != day) return FLEET_BAD_DATE;
+
+    if (isnan(tilt)) tilt = site.tilt;
+    if (isnan(azimuth)) azimuth = site.azimuth;
+    if (!(tilt >= 0 && tilt <= 90 && azimuth >= 0 && azimuth < 360)) return FLEET_BAD_PANEL;
+
+    ForecastKey key = {site.index, site.revision, (int32_t)dayNumber, floatBits(tilt), floatBits(azimuth)};
+    if (cache.get(key, result)) return FLEET_OK;
+
+    // Two workers may miss on the same key at once; both compute the same answer
+    SolarCalc solar(site.latitude, site.longitude, site.elevation, tilt, azimuth);
+    solar.setTimeZone(&site.zone);
+    DailyForecast daily = solar.calculateDailyForecast(year, month, day);
+
+    result.total = daily.totalIrradiance;
+    memset(result.hourly, 0, sizeof(result.hourly));
+    for (const HourlyIrradiance& hour : daily.hourlyData) {
+        if (hour.hour >= 0 && hour.hour < 24) result.hourly[hour.hour] = hour.irradiance;
+    }
+    computeCount++;
+    cache.put(key, result);
+    return FLEET_OK;
+}
+
+FleetServiceStats FleetService::getStats() {
+    FleetServiceStats stats;
+    stats.connections = connectionCount;
+    stats.requests = requestCount;
+    stats.errors = errorCount;
+    stats.computed = computeCount;
+    stats.cache = cache.getStats();
+    stats.sites = (uint32_t)registry.size();
+    stats.threads = pool ? pool->size() : 0;
+    return stats;
+}
+
+bool FleetService::parseDate(const std::string& text, int& year, int& month, int& day) {
+    if (text.size() != 10 || text[4] != '-' || text[7] != '-') return false;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (i != 4 && i != 7 && (text[i] < '0' || text[i] > '9')) return false;
+    }
+    year = atoi(text.c_str());
+    month = atoi(text.c_str() + 5);
+    day = atoi(text.c_str() + 8);
+    return true;
+}
+
+std::string FleetService::queryValue(const std::string& query, const char* name) {
+    size_t length = strlen(name);
+    size_t start = 0;
+    while (start < query.size()) {
+        size_t end = query.find('&', start);
+        if (end == std::string::npos) end = query.size();
+        if (end - start > length && query.compare(start, length, name) == 0 && query[start + length] == '=') {
+            return query.substr(start + length + 1, end - start - length - 1);
+        }
+        start = end + 1;
+    }
+    return "";
+}
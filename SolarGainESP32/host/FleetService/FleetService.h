@@ -0,0 +1,121 @@
+#ifndef FLEET_SERVICE_H
+#define FLEET_SERVICE_H
+
+// Forecasts for many sites from one Linux process (fleetd). Requests arrive
+// over HTTP/1.1 with keep-alive, on a Unix socket or 127.0.0.1:
+//
+//   GET /forecast?site=<id>&date=YYYY-MM-DD[&tilt=<deg>&azimuth=<deg>]
+//   GET /sites
+//   GET /stats
+//
+// One I/O thread waits on every connection with epoll and hands a
+// connection to the thread pool when a request is ready; the worker answers
+// it from the sharded cache or runs SolarCalc, then re-arms the connection.
+
+#include <math.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "ForecastLru.h"
+#include "SiteRegistry.h"
+#include "ThreadPool.h"
+
+#ifndef FLEET_CACHE_ENTRIES
+#define FLEET_CACHE_ENTRIES 65536
+#endif
+
+#ifndef FLEET_CACHE_SHARDS
+#define FLEET_CACHE_SHARDS 16
+#endif
+
+// Largest request head accepted before the connection is dropped
+#define FLEET_MAX_REQUEST 8192
+
+enum FleetStatus {
+    FLEET_OK,
+    FLEET_UNKNOWN_SITE,
+    FLEET_BAD_DATE,
+    FLEET_BAD_PANEL
+};
+
+struct FleetServiceStats {
+    uint64_t connections;
+    uint64_t requests;
+    uint64_t errors;            // 4xx responses
+    uint64_t computed;          // SolarCalc runs, one per cache miss
+    ForecastLruStats cache;
+    uint32_t sites;
+    uint32_t threads;
+};
+
+class FleetService {
+private:
+    struct Connection {
+        int fd;
+        std::string input;
+    };
+
+    SiteRegistry& registry;
+    ForecastLru cache;
+    unsigned threads;
+    std::unique_ptr<ThreadPool> pool;
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    uint16_t port;
+    std::string socketPath;
+    std::atomic<bool> running;
+    std::thread ioThread;
+
+    std::mutex lock;            // connections
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
+    std::atomic<uint64_t> connectionCount;
+    std::atomic<uint64_t> requestCount;
+    std::atomic<uint64_t> errorCount;
+    std::atomic<uint64_t> computeCount;
+
+    bool start(int fd);
+    void ioLoop();
+    void acceptAll();
+    void serve(Connection* connection);
+    void drop(Connection* connection);
+
+    // Status and JSON body for one request line
+    int handle(const std::string& method, const std::string& target, std::string& body);
+
+    static bool parseDate(const std::string& text, int& year, int& month, int& day);
+    static std::string queryValue(const std::string& query, const char* name);
+
+public:
+    // 0 threads: one per core
+    FleetService(SiteRegistry& registry, unsigned threads = 0,
+                 size_t cacheEntries = FLEET_CACHE_ENTRIES, unsigned cacheShards = FLEET_CACHE_SHARDS);
+    ~FleetService();
+
+    // Listen on 127.0.0.1 (port 0 picks a free one, see getPort())
+    bool beginTcp(uint16_t port = 0);
+
+    // Listen on a Unix socket, replacing a stale one at the same path
+    bool beginUnix(const char* path);
+
+    void stop();
+    uint16_t getPort() { return port; }
+
+    // The forecast the API serves, without HTTP. NAN tilt or azimuth takes
+    // the site's panel.
+    FleetStatus forecast(const std::string& siteId, int year, int month, int day,
+                         CachedForecast& result, float tilt = NAN, float azimuth = NAN);
+
+    // Forget cached forecasts. Not needed after a reload: a moved site gets a
+    // new revision and its old entries age out.
+    void clearCache() { cache.clear(); }
+
+    FleetServiceStats getStats();
+};
+
+#endif // FLEET_SERVICE_H
@@ -0,0 +1,72 @@
+#include "ForecastLru.h"
+
+ForecastLru::ForecastLru(size_t capacity, unsigned shardCount)
+    : shards(shardCount ? shardCount : 1) {
+    shardCapacity = capacity / shards.size();
+    if (shardCapacity == 0) shardCapacity = 1;
+    for (Shard& shard : shards) {
+        shard.hits = shard.misses = shard.evictions = 0;
+        shard.index.reserve(shardCapacity);
+    }
+}
+
+bool ForecastLru::get(const ForecastKey& key, CachedForecast& out) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto found = shard.index.find(key);
+    if (found == shard.index.end()) {
+        shard.misses++;
+        return false;
+    }
+
+    // Move to the front without reallocating
+    shard.order.splice(shard.order.begin(), shard.order, found->second);
+    out = found->second->second;
+    shard.hits++;
+    return true;
+}
+
+void ForecastLru::put(const ForecastKey& key, const CachedForecast& value) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        // Two workers missed on the same key; keep one
+        found->second->second = value;
+        shard.order.splice(shard.order.begin(), shard.order, found->second);
+        return;
+    }
+
+    if (shard.index.size() >= shardCapacity) {
+        // Reuse the least recently used node for the new entry
+        auto last = std::prev(shard.order.end());
+        shard.index.erase(last->first);
+        last->first = key;
+        last->second = value;
+        shard.order.splice(shard.order.begin(), shard.order, last);
+        shard.evictions++;
+    } else {
+        shard.order.emplace_front(key, value);
+    }
+    shard.index[key] = shard.order.begin();
+}
+
+void ForecastLru::clear() {
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.order.clear();
+        shard.index.clear();
+    }
+}
+
+ForecastLruStats ForecastLru::getStats() {
+    ForecastLruStats stats = {0, 0, 0, 0};
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.entries += shard.index.size();
+    }
+    return stats;
+}
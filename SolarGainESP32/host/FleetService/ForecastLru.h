@@ -0,0 +1,86 @@
+#ifndef FORECAST_LRU_H
+#define FORECAST_LRU_H
+
+// Forecast cache for the fleet service, keyed by (site, date, panel). The
+// key space is split over shards by hash, each with its own lock and LRU
+// list, so workers computing different sites rarely contend.
+
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct ForecastKey {
+    uint32_t site;          // SiteRegistry index
+    uint32_t revision;      // bumped when the site's location or zone changes
+    int32_t day;            // days since 1970-01-01
+    uint32_t tiltBits;      // panel tilt and azimuth, bit for bit
+    uint32_t azimuthBits;
+
+    bool operator==(const ForecastKey& other) const {
+        return site == other.site && revision == other.revision && day == other.day &&
+               tiltBits == other.tiltBits && azimuthBits == other.azimuthBits;
+    }
+};
+
+struct ForecastKeyHash {
+    size_t operator()(const ForecastKey& key) const {
+        // 64-bit mix of the fields (splitmix64 finaliser)
+        uint64_t h = ((uint64_t)key.site << 32 | key.revision) ^ ((uint64_t)(uint32_t)key.day << 20);
+        h ^= (uint64_t)key.tiltBits * 0x9e3779b97f4a7c15ULL ^ (uint64_t)key.azimuthBits << 7;
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return (size_t)h;
+    }
+};
+
+// What the API returns: the day's total and each hour, kWh/m²
+struct CachedForecast {
+    float total;
+    float hourly[24];
+};
+
+struct ForecastLruStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+};
+
+class ForecastLru {
+private:
+    typedef std::pair<ForecastKey, CachedForecast> Entry;
+
+    struct Shard {
+        std::mutex lock;
+        std::list<Entry> order;     // most recently used first
+        std::unordered_map<ForecastKey, std::list<Entry>::iterator, ForecastKeyHash> index;
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+    };
+
+    std::vector<Shard> shards;
+    size_t shardCapacity;
+
+    Shard& shardFor(const ForecastKey& key) {
+        return shards[ForecastKeyHash()(key) % shards.size()];
+    }
+
+public:
+    // capacity is split evenly; shards is rounded up to at least 1
+    ForecastLru(size_t capacity, unsigned shardCount = 16);
+
+    bool get(const ForecastKey& key, CachedForecast& out);
+    void put(const ForecastKey& key, const CachedForecast& value);
+    void clear();
+
+    ForecastLruStats getStats();
+    unsigned getShardCount() const { return (unsigned)shards.size(); }
+};
+
+#endif // FORECAST_LRU_H
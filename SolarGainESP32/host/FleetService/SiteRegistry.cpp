@@ -0,0 +1,129 @@
+#include "SiteRegistry.h"
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SiteRegistry::SiteRegistry() : nextRevision(1) {
+}
+
+bool SiteRegistry::parseLine(const char* line, FleetSite& site) {
+    // id and name are plain fields; five numbers follow, then the zone
+    const char* p = line;
+    std::string fields[2];
+    for (std::string& field : fields) {
+        const char* comma = strchr(p, ',');
+        if (!comma) return false;
+        field.assign(p, comma - p);
+        p = comma + 1;
+    }
+
+    float numbers[5];
+    for (float& number : numbers) {
+        char* end;
+        number = strtof(p, &end);
+        if (end == p || *end != ',') return false;
+        p = end + 1;
+    }
+
+    // Trim the zone; CSV files written on Windows end in \r\n
+    const char* last = p + strlen(p);
+    while (last > p && (last[-1] == '\n' || last[-1] == '\r' || last[-1] == ' ')) last--;
+    while (p < last && *p == ' ') p++;
+
+    site.id = fields[0];
+    site.name = fields[1];
+    site.latitude = numbers[0];
+    site.longitude = numbers[1];
+    site.elevation = numbers[2];
+    site.tilt = numbers[3];
+    site.azimuth = numbers[4];
+    site.timezone.assign(p, last - p);
+    return !site.id.empty();
+}
+
+bool SiteRegistry::upsert(const FleetSite& site) {
+    if (site.id.empty()) return false;
+    if (site.latitude < -90 || site.latitude > 90 || site.longitude < -180 || site.longitude > 180) return false;
+    if (site.tilt < 0 || site.tilt > 90 || site.azimuth < 0 || site.azimuth >= 360) return false;
+
+    // Compile outside the lock
+    FleetSite entry = site;
+    if (entry.timezone.empty()) entry.timezone = "UTC0";
+    if (!entry.zone.begin(entry.timezone.c_str())) return false;
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    auto found = byId.find(entry.id);
+    if (found == byId.end()) {
+        entry.index = (uint32_t)sites.size();
+        entry.revision = nextRevision++;
+        byId[entry.id] = entry.index;
+        sites.push_back(entry);
+        return true;
+    }
+
+    // A new panel or name is not a new revision: the panel is part of the cache key
+    FleetSite& current = sites[found->second];
+    entry.index = current.index;
+    entry.revision = current.revision;
+    if (entry.latitude != current.latitude || entry.longitude != current.longitude ||
+        entry.elevation != current.elevation || entry.timezone != current.timezone) {
+        entry.revision = nextRevision++;
+    }
+    current = entry;
+    return true;
+}
+
+int SiteRegistry::loadCsv(const char* path, int* rejected) {
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+
+    int loaded = 0;
+    int bad = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        const char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') continue;
+        if (strncmp(p, "id,", 3) == 0) continue;
+
+        FleetSite site;
+        if (parseLine(p, site) && upsert(site)) {
+            loaded++;
+        } else {
+            bad++;
+        }
+    }
+    fclose(file);
+
+    if (rejected) *rejected = bad;
+    return loaded;
+}
+
+bool SiteRegistry::find(const std::string& id, FleetSite& site) {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    auto found = byId.find(id);
+    if (found == byId.end()) return false;
+    site = sites[found->second];
+    return true;
+}
+
+std::vector<std::string> SiteRegistry::ids() {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    std::vector<std::string> result;
+    result.reserve(sites.size());
+    for (const FleetSite& site : sites) {
+        result.push_back(site.id);
+    }
+    return result;
+}
+
+std::vector<FleetSite> SiteRegistry::list() {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return sites;
+}
+
+size_t SiteRegistry::size() {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return sites.size();
+}
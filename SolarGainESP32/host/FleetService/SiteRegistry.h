@@ -0,0 +1,60 @@
+#ifndef SITE_REGISTRY_H
+#define SITE_REGISTRY_H
+
+// The sites a fleet service forecasts for. Each site keeps its registry
+// index for life and carries a revision that moves whenever its location or
+// time zone changes, so cached forecasts for the old values stop matching.
+
+#include <stdint.h>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../../lib/EpochTime/TimeZone.h"
+
+struct FleetSite {
+    std::string id;
+    std::string name;
+    float latitude;
+    float longitude;
+    float elevation;        // meters
+    float tilt;             // default panel, degrees
+    float azimuth;          // degrees clockwise from north
+    std::string timezone;   // POSIX TZ string
+    TimeZone zone;          // timezone, compiled
+    uint32_t index;         // set by the registry
+    uint32_t revision;      // set by the registry
+};
+
+class SiteRegistry {
+private:
+    std::shared_mutex lock;     // readers copy sites out; loads take it exclusively
+    std::vector<FleetSite> sites;
+    std::unordered_map<std::string, uint32_t> byId;
+    uint32_t nextRevision;
+
+public:
+    SiteRegistry();
+
+    // Parse one CSV line: id,name,latitude,longitude,elevation,tilt,azimuth,timezone.
+    // The timezone is the rest of the line, commas and all; empty means UTC.
+    static bool parseLine(const char* line, FleetSite& site);
+
+    // Add a site, or update the one with the same id. Returns false for an
+    // empty id, coordinates out of range or a timezone that does not compile.
+    bool upsert(const FleetSite& site);
+
+    // Upsert every site in a CSV file; blank lines, "#" comments and a header
+    // line are skipped. Sites missing from the file are kept. Returns the
+    // number of sites read, or -1 when the file cannot be opened.
+    int loadCsv(const char* path, int* rejected = nullptr);
+
+    // Copy of a site, safe to use while the registry changes
+    bool find(const std::string& id, FleetSite& site);
+
+    std::vector<std::string> ids();
+    std::vector<FleetSite> list();
+    size_t size();
+};
+
+#endif // SITE_REGISTRY_H
@@ -0,0 +1,54 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threads) : stopping(false) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping) return;
+        tasks.push(std::move(task));
+    }
+    ready.notify_one();
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping) return;
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+size_t ThreadPool::pending() {
+    std::lock_guard<std::mutex> guard(lock);
+    return tasks.size();
+}
+
+void ThreadPool::work() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Fixed set of worker threads draining one FIFO of tasks. The fleet service
+// hands it a connection each time a request is ready, so a worker never
+// waits on a slow client.
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex lock;
+    std::condition_variable ready;
+    bool stopping;
+
+    void work();
+
+public:
+    // 0 threads: one per core
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+
+    // Finish queued tasks, then join the workers
+    void stop();
+
+    unsigned size() const { return (unsigned)workers.size(); }
+    size_t pending();
+};
+
+#endif // THREAD_POOL_H
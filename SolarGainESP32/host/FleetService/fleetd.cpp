@@ -0,0 +1,135 @@
+// fleetd: the fleet forecast service as a daemon (pio run -e fleetd).
+//
+//   fleetd --sites sites.csv [--socket /run/fleetd.sock | --port 8080] [--threads N]
+//   fleetd --sites sites.csv --load 100000 [--clients 8]
+//
+// SIGHUP reloads the site file; SIGINT or SIGTERM stops. --load serves on a
+// private socket, runs the load generator against it and prints the report.
+
+#ifdef FLEETD_MAIN
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "FleetLoad.h"
+#include "FleetService.h"
+
+static volatile sig_atomic_t reloadRequested = 0;
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int signal) {
+    if (signal == SIGHUP) reloadRequested = 1;
+    else stopRequested = 1;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: fleetd --sites FILE [--socket PATH | --port N] [--threads N] [--cache N]\n"
+            "              [--load REQUESTS [--clients N]]\n");
+}
+
+int main(int argc, char** argv) {
+    const char* sitesPath = nullptr;
+    const char* socketPath = nullptr;
+    int port = -1;
+    unsigned threads = 0;
+    size_t cacheEntries = FLEET_CACHE_ENTRIES;
+    uint32_t loadRequests = 0;
+    unsigned clients = 4;
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--sites") == 0) sitesPath = value;
+        else if (strcmp(argv[i], "--socket") == 0) socketPath = value;
+        else if (strcmp(argv[i], "--port") == 0) port = atoi(value);
+        else if (strcmp(argv[i], "--threads") == 0) threads = atoi(value);
+        else if (strcmp(argv[i], "--cache") == 0) cacheEntries = strtoul(value, nullptr, 10);
+        else if (strcmp(argv[i], "--load") == 0) loadRequests = strtoul(value, nullptr, 10);
+        else if (strcmp(argv[i], "--clients") == 0) clients = atoi(value);
+        else {
+            usage();
+            return 2;
+        }
+        i++;
+    }
+    if (!sitesPath) {
+        usage();
+        return 2;
+    }
+
+    SiteRegistry registry;
+    int rejected = 0;
+    int loaded = registry.loadCsv(sitesPath, &rejected);
+    if (loaded < 0) {
+        fprintf(stderr, "fleetd: cannot read %s\n", sitesPath);
+        return 1;
+    }
+    printf("fleetd: %d sites loaded, %d lines rejected\n", loaded, rejected);
+
+    FleetService service(registry, threads, cacheEntries);
+
+    if (loadRequests) {
+        char privateSocket[64];
+        snprintf(privateSocket, sizeof(privateSocket), "/tmp/fleetd-load-%d.sock", (int)getpid());
+        if (!service.beginUnix(privateSocket)) {
+            fprintf(stderr, "fleetd: cannot listen on %s\n", privateSocket);
+            return 1;
+        }
+
+        FleetLoadOptions options = FleetLoad::defaults();
+        options.socketPath = privateSocket;
+        options.clients = clients;
+        options.requests = loadRequests;
+        FleetLoad load(options, registry.ids());
+        FleetLoadReport report = load.run();
+        FleetServiceStats stats = service.getStats();
+        service.stop();
+
+        printf("fleetd: %llu requests, %llu errors in %.2f s: %.0f req/s, p50 %.1f us, p99 %.1f us, max %.1f us\n",
+               (unsigned long long)report.requests, (unsigned long long)report.errors, report.seconds,
+               report.requestsPerSecond, report.p50Us, report.p99Us, report.maxUs);
+        printf("fleetd: %u workers, cache hits %llu, misses %llu, evictions %llu\n", stats.threads,
+               (unsigned long long)stats.cache.hits, (unsigned long long)stats.cache.misses,
+               (unsigned long long)stats.cache.evictions);
+        return report.errors ? 1 : 0;
+    }
+
+    bool listening = socketPath ? service.beginUnix(socketPath) : service.beginTcp(port < 0 ? 8080 : port);
+    if (!listening) {
+        fprintf(stderr, "fleetd: cannot listen on %s\n", socketPath ? socketPath : "127.0.0.1");
+        return 1;
+    }
+    if (socketPath) printf("fleetd: listening on %s\n", socketPath);
+    else printf("fleetd: listening on 127.0.0.1:%u\n", service.getPort());
+    fflush(stdout);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigaction(SIGHUP, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    while (!stopRequested) {
+        usleep(200000);
+        if (reloadRequested) {
+            reloadRequested = 0;
+            loaded = registry.loadCsv(sitesPath, &rejected);
+            printf("fleetd: reloaded %d sites, %d lines rejected\n", loaded, rejected);
+            fflush(stdout);
+        }
+    }
+
+    service.stop();
+    printf("fleetd: stopped\n");
+    return 0;
+}
+
+#endif // FLEETD_MAIN
@@ -0,0 +1,340 @@
+#include "GraphStandIn.h"
+#include <chrono>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+GraphStandIn::GraphStandIn(const char* phoneNumberId, const char* accessToken)
+    : phoneNumberId(phoneNumberId), accessToken(accessToken), listenFd(-1), port(0),
+      running(false), rng(0x6a7e), nextMessageId(1) {
+    memset(&profile, 0, sizeof(profile));
+    memset(&stats, 0, sizeof(stats));
+}
+
+GraphStandIn::~GraphStandIn() {
+    stop();
+}
+
+bool GraphStandIn::begin(uint16_t listenPort) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) return false;
+
+    int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(listenPort);
+    socklen_t length = sizeof(addr);
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 16) < 0 ||
+        getsockname(listenFd, (struct sockaddr*)&addr, &length) < 0) {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    port = ntohs(addr.sin_port);
+
+    running = true;
+    acceptThread = std::thread(&GraphStandIn::acceptLoop, this);
+    return true;
+}
+
+void GraphStandIn::stop() {
+    if (!running) return;
+    running = false;
+
+    // Unblock accept() and every recv()
+    shutdown(listenFd, SHUT_RDWR);
+    acceptThread.join();
+    close(listenFd);
+    listenFd = -1;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (int fd : connectionFds) {
+            if (fd >= 0) shutdown(fd, SHUT_RDWR);
+        }
+    }
+    for (std::thread& thread : connectionThreads) {
+        thread.join();
+    }
+    connectionThreads.clear();
+    connectionFds.clear();
+}
+
+void GraphStandIn::setFaults(const GraphFaultProfile& faults) {
+    std::lock_guard<std::mutex> guard(lock);
+    profile = faults;
+}
+
+void GraphStandIn::setSeed(uint32_t seed) {
+    std::lock_guard<std::mutex> guard(lock);
+    rng.seed(seed);
+}
+
+void GraphStandIn::injectNext(GraphFault fault, int count) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (int i = 0; i < count; i++) {
+        script.push_back(fault);
+    }
+}
+
+GraphStandInStats GraphStandIn::getStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+std::vector<GraphMessage> GraphStandIn::getMessages() {
+    std::lock_guard<std::mutex> guard(lock);
+    return messages;
+}
+
+void GraphStandIn::reset() {
+    std::lock_guard<std::mutex> guard(lock);
+    memset(&stats, 0, sizeof(stats));
+    memset(&profile, 0, sizeof(profile));
+    script.clear();
+    messages.clear();
+    acceptedKeys.clear();
+}
+
+void GraphStandIn::acceptLoop() {
+    while (running) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (!running) break;
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        std::lock_guard<std::mutex> guard(lock);
+        stats.connections++;
+        connectionFds.push_back(fd);
+        connectionThreads.emplace_back(&GraphStandIn::serve, this, fd);
+    }
+}
+
+GraphFault GraphStandIn::nextFault(uint32_t& latencyMs) {
+    std::lock_guard<std::mutex> guard(lock);
+    latencyMs = profile.latencyMs;
+    if (profile.jitterMs) latencyMs += rng() % (profile.jitterMs + 1);
+
+    if (!script.empty()) {
+        GraphFault fault = script.front();
+        script.pop_front();
+        return fault;
+    }
+
+    uint32_t roll = rng() % 100;
+    if (roll < profile.rateLimitPct) return GRAPH_FAULT_RATE_LIMIT;
+    roll -= profile.rateLimitPct;
+    if (roll < profile.serverErrorPct) return roll % 2 ? GRAPH_FAULT_SERVER_ERROR : GRAPH_FAULT_UNAVAILABLE;
+    roll -= profile.serverErrorPct;
+    if (roll < profile.tlsFailurePct) return GRAPH_FAULT_TLS;
+    return GRAPH_FAULT_NONE;
+}
+
+void GraphStandIn::serve(int fd) {
+    std::string buffer;
+    char chunk[4096];
+    bool handshake = true;
+
+    while (running) {
+        size_t headEnd;
+        bool closed = false;
+        while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                closed = true;
+                break;
+            }
+            buffer.append(chunk, n);
+        }
+        if (closed) break;
+
+        // Request line and the headers we care about
+        std::string head = buffer.substr(0, headEnd + 2);
+        size_t space1 = head.find(' ');
+        size_t space2 = head.find(' ', space1 + 1);
+        std::string method = head.substr(0, space1);
+        std::string path = head.substr(space1 + 1, space2 - space1 - 1);
+        std::string authorization;
+        size_t contentLength = 0;
+        bool keepAlive = true;
+
+        size_t lineStart = head.find("\r\n") + 2;
+        while (lineStart < head.size()) {
+            size_t lineEnd = head.find("\r\n", lineStart);
+            std::string line = head.substr(lineStart, lineEnd - lineStart);
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                std::string name = line.substr(0, colon);
+                std::string value = line.substr(line.find_first_not_of(' ', colon + 1));
+                if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+                    contentLength = strtoul(value.c_str(), nullptr, 10);
+                } else if (strcasecmp(name.c_str(), "Authorization") == 0) {
+                    authorization = value;
+                } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+                    keepAlive = strcasecmp(value.c_str(), "close") != 0;
+                }
+            }
+            lineStart = lineEnd + 2;
+        }
+
+        size_t total = headEnd + 4 + contentLength;
+        while (buffer.size() < total) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                closed = true;
+                break;
+            }
+            buffer.append(chunk, n);
+        }
+        if (closed) break;
+        std::string body = buffer.substr(headEnd + 4, contentLength);
+        buffer.erase(0, total);
+
+        uint32_t latencyMs;
+        GraphFault fault = nextFault(latencyMs);
+        if (handshake) {
+            std::lock_guard<std::mutex> guard(lock);
+            latencyMs += profile.handshakeMs;
+            handshake = false;
+        }
+        if (latencyMs) std::this_thread::sleep_for(std::chrono::milliseconds(latencyMs));
+
+        int status;
+        std::string json;
+        if (!handle(method, path, authorization, body, fault, status, json)) {
+            // Reset rather than close, like an aborted TLS session
+            struct linger abort = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+            break;
+        }
+
+        const char* reason = status == 200 ? "OK" : status == 429 ? "Too Many Requests" :
+                             status == 401 ? "Unauthorized" : status == 503 ? "Service Unavailable" :
+                             status == 500 ? "Internal Server Error" : "Bad Request";
+        std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+                               "\r\nContent-Type: application/json\r\nContent-Length: " +
+                               std::to_string(json.size()) + "\r\nConnection: " +
+                               (keepAlive ? "keep-alive" : "close") + "\r\n\r\n" + json;
+        if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) != (ssize_t)response.size()) break;
+        if (!keepAlive) break;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (int& open : connectionFds) {
+        if (open == fd) open = -1;
+    }
+    close(fd);
+}
+
+bool GraphStandIn::handle(const std::string& method, const std::string& path, const std::string& authorization,
+                          const std::string& body, GraphFault fault, int& status, std::string& response) {
+    std::lock_guard<std::mutex> guard(lock);
+    stats.requests++;
+
+    if (authorization != "Bearer " + accessToken) fault = GRAPH_FAULT_AUTH;
+
+    switch (fault) {
+        case GRAPH_FAULT_TLS:
+            stats.tlsFailures++;
+            return false;
+        case GRAPH_FAULT_RATE_LIMIT:
+            stats.rateLimited++;
+            status = 429;
+            response = errorBody(130429, "Rate limit hit");
+            return true;
+        case GRAPH_FAULT_UNAVAILABLE:
+            stats.serverErrors++;
+            status = 503;
+            response = errorBody(131016, "Service unavailable");
+            return true;
+        case GRAPH_FAULT_SERVER_ERROR:
+            stats.serverErrors++;
+            status = 500;
+            response = errorBody(2, "Service temporarily unavailable");
+            return true;
+        case GRAPH_FAULT_AUTH:
+            stats.authFailures++;
+            status = 401;
+            response = errorBody(190, "Invalid OAuth access token");
+            return true;
+        case GRAPH_FAULT_NONE:
+        case GRAPH_FAULT_LOST_ACK:
+            break;
+    }
+
+    // /<version>/<phone id>[/messages]
+    size_t idStart = path.find('/', 1);
+    std::string rest = idStart == std::string::npos ? "" : path.substr(idStart + 1);
+    status = 400;
+
+    if (method == "GET" && rest == phoneNumberId) {
+        status = 200;
+        response = "{\"verified_name\":\"SolarGain Stand-in\",\"display_phone_number\":\"+1 555-0100\","
+                   "\"quality_rating\":\"GREEN\",\"id\":\"" + phoneNumberId + "\"}";
+        return true;
+    }
+
+    if (method == "POST" && rest == phoneNumberId + "/messages") {
+        GraphMessage message;
+        message.to = jsonField(body, "to");
+        message.body = jsonField(body, "body");
+        message.callbackData = jsonField(body, "biz_opaque_callback_data");
+        if (message.to.empty() || body.find("\"messaging_product\":\"whatsapp\"") == std::string::npos) {
+            response = errorBody(100, "Invalid parameter");
+            return true;
+        }
+
+        // Graph only echoes the callback key in webhooks; a resend is a second message
+        if (!message.callbackData.empty() && !acceptedKeys.insert(message.callbackData).second) {
+            stats.duplicates++;
+        }
+        stats.accepted++;
+        messages.push_back(message);
+
+        if (fault == GRAPH_FAULT_LOST_ACK) {
+            stats.tlsFailures++;
+            return false;
+        }
+
+        status = 200;
+        std::string waId = message.to[0] == '+' ? message.to.substr(1) : message.to;
+        response = "{\"messaging_product\":\"whatsapp\",\"contacts\":[{\"input\":\"" + message.to +
+                   "\",\"wa_id\":\"" + waId + "\"}],\"messages\":[{\"id\":\"wamid.STANDIN" +
+                   std::to_string(nextMessageId++) + "\"}]}";
+        return true;
+    }
+
+    response = errorBody(100, "Unsupported request");
+    return true;
+}
+
+std::string GraphStandIn::jsonField(const std::string& json, const char* name) {
+    std::string key = std::string("\"") + name + "\":\"";
+    size_t start = json.find(key);
+    if (start == std::string::npos) return "";
+    start += key.size();
+
+    // Up to the closing quote, skipping escaped ones
+    size_t end = start;
+    while (end < json.size() && json[end] != '"') {
+        end += json[end] == '\\' ? 2 : 1;
+    }
+    return json.substr(start, end - start);
+}
+
+std::string GraphStandIn::errorBody(long code, const char* message) {
+    return std::string("{\"error\":{\"message\":\"(#") + std::to_string(code) + ") " + message +
+           "\",\"type\":\"OAuthException\",\"code\":" + std::to_string(code) +
+           ",\"fbtrace_id\":\"StandIn\"}}";
+}
@@ -0,0 +1,110 @@
+#ifndef GRAPH_STAND_IN_H
+#define GRAPH_STAND_IN_H
+
+// Local stand-in for the WhatsApp Cloud API, for host tests and benchmarks.
+// Serves POST /<version>/<phone id>/messages and GET /<version>/<phone id> over
+// plain HTTP/1.1 with keep-alive, and injects latency, 429s, 5xx responses and
+// dropped connections on demand. Point WhatsAppClient at it with setEndpoint().
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum GraphFault {
+    GRAPH_FAULT_NONE,
+    GRAPH_FAULT_RATE_LIMIT,     // 429, error 130429
+    GRAPH_FAULT_UNAVAILABLE,    // 503, error 131016
+    GRAPH_FAULT_SERVER_ERROR,   // 500, error 2
+    GRAPH_FAULT_TLS,            // connection dropped without a response, as a failed
+                                // handshake or a corrupted TLS record looks to the client
+    GRAPH_FAULT_AUTH,           // 401, error 190
+    GRAPH_FAULT_LOST_ACK        // message accepted, then the connection dropped
+};
+
+// Random faults, applied to every request not covered by injectNext()
+struct GraphFaultProfile {
+    uint32_t latencyMs;         // added before every response
+    uint32_t jitterMs;          // plus a uniform 0..jitterMs
+    uint8_t rateLimitPct;
+    uint8_t serverErrorPct;     // split evenly between 503 and 500
+    uint8_t tlsFailurePct;
+    uint32_t handshakeMs;       // added to the first response on each connection, as a TLS handshake
+};
+
+struct GraphStandInStats {
+    uint32_t connections;
+    uint32_t requests;
+    uint32_t accepted;          // messages accepted, copies included
+    uint32_t duplicates;        // of those, copies of an already accepted callback key
+    uint32_t rateLimited;
+    uint32_t serverErrors;
+    uint32_t tlsFailures;
+    uint32_t authFailures;
+};
+
+struct GraphMessage {
+    std::string to;
+    std::string body;           // JSON-escaped, as sent
+    std::string callbackData;   // biz_opaque_callback_data, empty when absent
+};
+
+class GraphStandIn {
+private:
+    std::string phoneNumberId;
+    std::string accessToken;
+    int listenFd;
+    uint16_t port;
+    std::atomic<bool> running;
+    std::thread acceptThread;
+    std::vector<std::thread> connectionThreads;
+    std::vector<int> connectionFds;
+
+    std::mutex lock;            // everything below
+    GraphFaultProfile profile;
+    std::deque<GraphFault> script;
+    std::mt19937 rng;
+    GraphStandInStats stats;
+    std::vector<GraphMessage> messages;
+    std::set<std::string> acceptedKeys;   // only to count copies; like Graph, nothing is dropped
+    uint32_t nextMessageId;
+
+    void acceptLoop();
+    void serve(int fd);
+
+    // Fault and latency for the next request
+    GraphFault nextFault(uint32_t& latencyMs);
+
+    // Build the response to one request; false drops the connection instead
+    bool handle(const std::string& method, const std::string& path, const std::string& authorization,
+                const std::string& body, GraphFault fault, int& status, std::string& response);
+
+    static std::string jsonField(const std::string& json, const char* name);
+    static std::string errorBody(long code, const char* message);
+
+public:
+    GraphStandIn(const char* phoneNumberId, const char* accessToken);
+    ~GraphStandIn();
+
+    // Listen on 127.0.0.1 (port 0 picks a free one, see getPort())
+    bool begin(uint16_t port = 0);
+    void stop();
+    uint16_t getPort() { return port; }
+
+    void setFaults(const GraphFaultProfile& faults);
+    void setSeed(uint32_t seed);
+
+    // Queue faults for the next requests, ahead of the random profile
+    void injectNext(GraphFault fault, int count = 1);
+
+    GraphStandInStats getStats();
+    std::vector<GraphMessage> getMessages();
+    void reset();
+};
+
+#endif // GRAPH_STAND_IN_H
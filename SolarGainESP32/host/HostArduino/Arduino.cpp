@@ -0,0 +1,61 @@
+#include "Arduino.h"
+#include "esp_timer.h"
+#include <chrono>
+#include <random>
+#include <thread>
+
+static const auto bootTime = std::chrono::steady_clock::now();
+static std::mt19937 rng(0x5eed);
+static uint32_t cpuMhz = 240;
+
+HostSerial Serial;
+EspClass ESP;
+
+unsigned long millis() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - bootTime).count();
+}
+
+unsigned long micros() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - bootTime).count();
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - bootTime).count();
+}
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+    if (mhz != 240 && mhz != 160 && mhz != 80 && mhz != 40 && mhz != 20 && mhz != 10) return false;
+    cpuMhz = mhz;
+    return true;
+}
+
+uint32_t getCpuFrequencyMhz() { return cpuMhz; }
+
+void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+void yield() { std::this_thread::yield(); }
+
+long random(long howbig) {
+    if (howbig <= 0) return 0;
+    return (long)(rng() % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig) {
+    if (howsmall >= howbig) return howsmall;
+    return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) { rng.seed((uint32_t)seed); }
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return LOW; }
+uint16_t analogRead(uint8_t) { return 0; }
+uint32_t analogReadMilliVolts(uint8_t) { return 0; }
+
+size_t HostSerial::write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+size_t HostSerial::write(const uint8_t* buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+void HostSerial::flush() { fflush(stdout); }
@@ -0,0 +1,90 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host (env:native) stand-in for the Arduino core: enough of the API for the
+// platform-independent libraries and their tests to build and run on Linux/macOS.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+
+#define HOST_BUILD 1
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#define IRAM_ATTR
+
+using std::min;
+using std::max;
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+uint32_t analogReadMilliVolts(uint8_t pin);
+
+// Serial writes to stdout
+class HostSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override;
+    operator bool() const { return true; }
+    using Print::write;
+};
+
+extern HostSerial Serial;
+
+// CPU clock; recorded only, the host runs at its own speed
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+
+// ESP object: heap figures come from the host, so they are placeholders
+class EspClass {
+public:
+    uint32_t getFreeHeap() { return 320 * 1024; }
+    uint32_t getMinFreeHeap() { return 320 * 1024; }
+    uint32_t getMaxAllocHeap() { return 112 * 1024; }
+    uint32_t getHeapSize() { return 384 * 1024; }
+    uint32_t getCpuFreqMHz() { return getCpuFrequencyMhz(); }
+};
+
+extern EspClass ESP;
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,188 @@
+#include "SPIFFS.h"
+#include <Arduino.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct HostFileImpl {
+    FILE* fp = nullptr;
+    DIR* dir = nullptr;
+    std::string hostPath;
+    std::string path;
+    std::string name;
+};
+
+SPIFFSFS SPIFFS;
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!impl || !impl->fp) return 0;
+    return fwrite(buffer, 1, size, impl->fp);
+}
+
+int File::available() {
+    if (!impl || !impl->fp) return 0;
+    long here = ftell(impl->fp);
+    return (int)(size() - (size_t)here);
+}
+
+int File::read() {
+    if (!impl || !impl->fp) return -1;
+    int c = fgetc(impl->fp);
+    return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+    if (!impl || !impl->fp) return -1;
+    int c = fgetc(impl->fp);
+    if (c == EOF) return -1;
+    ungetc(c, impl->fp);
+    return c;
+}
+
+void File::flush() {
+    if (impl && impl->fp) fflush(impl->fp);
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!impl || !impl->fp) return 0;
+    return fread(buffer, 1, size, impl->fp);
+}
+
+bool File::seek(uint32_t position) {
+    return impl && impl->fp && fseek(impl->fp, position, SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+    return (impl && impl->fp) ? (size_t)ftell(impl->fp) : 0;
+}
+
+size_t File::size() const {
+    if (!impl || !impl->fp) return 0;
+    fflush(impl->fp);
+    struct stat st;
+    return fstat(fileno(impl->fp), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+void File::close() {
+    if (!impl) return;
+    if (impl->fp) fclose(impl->fp);
+    if (impl->dir) closedir(impl->dir);
+    impl.reset();
+}
+
+const char* File::name() const { return impl ? impl->name.c_str() : ""; }
+const char* File::path() const { return impl ? impl->path.c_str() : ""; }
+bool File::isDirectory() const { return impl && impl->dir; }
+File::operator bool() const { return impl && (impl->fp || impl->dir); }
+
+File File::openNextFile() {
+    if (!impl || !impl->dir) return File();
+    while (struct dirent* entry = readdir(impl->dir)) {
+        if (entry->d_name[0] == '.') continue;
+        std::string childPath = impl->path == "/" ? "/" : impl->path + "/";
+        childPath += entry->d_name;
+        FILE* fp = fopen((impl->hostPath + "/" + entry->d_name).c_str(), "rb");
+        if (!fp) continue;
+        auto child = std::make_shared<HostFileImpl>();
+        child->fp = fp;
+        child->hostPath = impl->hostPath + "/" + entry->d_name;
+        child->path = childPath;
+        child->name = entry->d_name;
+        return File(child);
+    }
+    return File();
+}
+
+std::string FS::hostPath(const char* path) const {
+    std::string p = path ? path : "/";
+    if (p.empty() || p[0] != '/') p = "/" + p;
+    return root + p;
+}
+
+// SPIFFS has no real directories, so parents are created on demand
+static void makeParents(const std::string& path) {
+    for (size_t i = 1; i < path.size(); i++) {
+        if (path[i] == '/') ::mkdir(path.substr(0, i).c_str(), 0755);
+    }
+}
+
+File FS::open(const char* path, const char* mode) {
+    if (!mounted) return File();
+    std::string full = hostPath(path);
+    auto impl = std::make_shared<HostFileImpl>();
+    impl->hostPath = full;
+    impl->path = path;
+    impl->name = impl->path.substr(impl->path.find_last_of('/') + 1);
+
+    struct stat st;
+    if (mode[0] == 'r' && stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        impl->dir = opendir(full.c_str());
+        return impl->dir ? File(impl) : File();
+    }
+
+    if (mode[0] != 'r') makeParents(full);
+    std::string fmode = std::string(mode) + "b";
+    impl->fp = fopen(full.c_str(), fmode.c_str());
+    return impl->fp ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) const {
+    struct stat st;
+    return mounted && stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return mounted && ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    if (!mounted) return false;
+    makeParents(hostPath(to));
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    if (!mounted) return false;
+    std::string full = hostPath(path);
+    makeParents(full + "/");
+    return true;
+}
+
+bool SPIFFSFS::begin(bool formatOnFail, const char*, uint8_t, const char*) {
+    const char* env = getenv("SPIFFS_HOST_ROOT");
+    root = env && env[0] ? env : "./.spiffs";
+    ::mkdir(root.c_str(), 0755);
+    struct stat st;
+    mounted = stat(root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    if (!mounted && formatOnFail) mounted = format();
+    return mounted;
+}
+
+static void removeTree(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        std::string child = path + "/" + name;
+        struct stat st;
+        if (stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            removeTree(child);
+            rmdir(child.c_str());
+        } else {
+            unlink(child.c_str());
+        }
+    }
+    closedir(dir);
+}
+
+bool SPIFFSFS::format() {
+    if (root.empty()) return false;
+    removeTree(root);
+    ::mkdir(root.c_str(), 0755);
+    mounted = true;
+    return true;
+}
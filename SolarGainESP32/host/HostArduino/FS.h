@@ -0,0 +1,61 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Stream.h"
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+struct HostFileImpl;
+
+// Directory-backed stand-in for fs::File; a File is either an open file or a
+// directory listing walked with openNextFile()
+class File : public Stream {
+private:
+    std::shared_ptr<HostFileImpl> impl;
+
+public:
+    File() {}
+    explicit File(std::shared_ptr<HostFileImpl> impl) : impl(impl) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+    size_t read(uint8_t* buffer, size_t size);
+    bool seek(uint32_t position);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    const char* name() const;
+    const char* path() const;
+    bool isDirectory() const;
+    File openNextFile();
+    operator bool() const;
+    using Print::write;
+};
+
+class FS {
+protected:
+    std::string root;
+    bool mounted = false;
+    std::string hostPath(const char* path) const;
+
+public:
+    File open(const char* path, const char* mode = FILE_READ);
+    File open(const String& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool exists(const char* path) const;
+    bool exists(const String& path) const { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to);
+    bool mkdir(const char* path);
+};
+
+#endif // HOST_FS_H
@@ -0,0 +1,145 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <Arduino.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Shared by every portMUX: good enough for the short sections the libraries use
+static std::recursive_mutex criticalMutex;
+
+void hostEnterCritical(portMUX_TYPE*) { criticalMutex.lock(); }
+void hostExitCritical(portMUX_TYPE*) { criticalMutex.unlock(); }
+
+BaseType_t xPortGetCoreID() { return 0; }
+
+struct HostTask {
+    std::mutex lock;
+    std::condition_variable wake;
+    uint32_t notifyCount = 0;
+    bool deleted = false;
+};
+
+static thread_local HostTask* currentTask = nullptr;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* param,
+                                   UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    // Tasks live for the process lifetime, like most firmware tasks
+    HostTask* task = new HostTask();
+    if (handle) *handle = task;
+    std::thread([fn, param, task]() {
+        currentTask = task;
+        fn(param);
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(fn, name, stackDepth, param, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+    HostTask* task = handle ? handle : currentTask;
+    if (!task) return;
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->deleted = true;
+    }
+    if (task == currentTask) {
+        // Park the calling thread forever; returning would run past the task body
+        for (;;) std::this_thread::sleep_for(std::chrono::hours(1));
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t period) {
+    *previousWake += period;
+    int32_t remaining = (int32_t)(*previousWake - xTaskGetTickCount());
+    if (remaining > 0) vTaskDelay((TickType_t)remaining);
+}
+
+TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return currentTask; }
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+    HostTask* task = currentTask;
+    if (!task) {
+        vTaskDelay(ticksToWait == portMAX_DELAY ? 0 : ticksToWait);
+        return 0;
+    }
+
+    std::unique_lock<std::mutex> guard(task->lock);
+    auto ready = [task]() { return task->notifyCount > 0; };
+    if (ticksToWait == portMAX_DELAY) {
+        task->wake.wait(guard, ready);
+    } else {
+        task->wake.wait_for(guard, std::chrono::milliseconds(ticksToWait), ready);
+    }
+
+    uint32_t value = task->notifyCount;
+    if (value > 0) task->notifyCount = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+    if (!handle) return pdFAIL;
+    {
+        std::lock_guard<std::mutex> guard(handle->lock);
+        handle->notifyCount++;
+    }
+    handle->wake.notify_one();
+    return pdPASS;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 0; }
+
+struct HostSemaphore {
+    std::mutex lock;
+    std::condition_variable changed;
+    bool available;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    HostSemaphore* sem = new HostSemaphore();
+    sem->available = true;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    HostSemaphore* sem = new HostSemaphore();
+    sem->available = false;
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait) {
+    if (!sem) return pdFAIL;
+    std::unique_lock<std::mutex> guard(sem->lock);
+    auto ready = [sem]() { return sem->available; };
+    if (ticksToWait == portMAX_DELAY) {
+        sem->changed.wait(guard, ready);
+    } else if (!sem->changed.wait_for(guard, std::chrono::milliseconds(ticksToWait), ready)) {
+        return pdFAIL;
+    }
+    sem->available = false;
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    if (!sem) return pdFAIL;
+    {
+        std::lock_guard<std::mutex> guard(sem->lock);
+        if (sem->available) return pdFAIL;
+        sem->available = true;
+    }
+    sem->changed.notify_one();
+    return pdPASS;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
@@ -0,0 +1,24 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <stdint.h>
+#include "WString.h"
+
+class IPAddress {
+private:
+    uint32_t address; // network byte order, as on the ESP32
+
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : address((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t raw) : address(raw) {}
+    operator uint32_t() const { return address; }
+    uint8_t operator[](int index) const { return (address >> (index * 8)) & 0xFF; }
+    String toString() const {
+        return String((int)(*this)[0]) + "." + String((int)(*this)[1]) + "." +
+               String((int)(*this)[2]) + "." + String((int)(*this)[3]);
+    }
+};
+
+#endif // HOST_IPADDRESS_H
@@ -0,0 +1,95 @@
+#include "Preferences.h"
+#include <mutex>
+
+static std::map<std::string, std::map<std::string, std::string>> namespaces;
+static std::mutex namespacesLock;
+
+std::map<std::string, std::string>* Preferences::store() {
+    return started ? &namespaces[ns] : nullptr;
+}
+
+bool Preferences::begin(const char* name, bool) {
+    std::lock_guard<std::mutex> guard(namespacesLock);
+    ns = name ? name : "";
+    started = true;
+    namespaces[ns];
+    return true;
+}
+
+bool Preferences::clear() {
+    std::lock_guard<std::mutex> guard(namespacesLock);
+    if (!started) return false;
+    store()->clear();
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    std::lock_guard<std::mutex> guard(namespacesLock);
+    return started && store()->erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    std::lock_guard<std::mutex> guard(namespacesLock);
+    return started && store()->count(key) > 0;
+}
+
+static size_t putRaw(std::map<std::string, std::string>* map, const char* key,
+                     const std::string& value, size_t size) {
+    std::lock_guard<std::mutex> guard(namespacesLock);
+    if (!map) return 0;
+    (*map)[key] = value;
+    return size;
+}
+
+static bool getRaw(std::map<std::string, std::string>* map, const char* key, std::string& value) {
+    std::lock_guard<std::mutex> guard(namespacesLock);
+    if (!map) return false;
+    auto it = map->find(key);
+    if (it == map->end()) return false;
+    value = it->second;
+    return true;
+}
+
+size_t Preferences::putString(const char* key, const String& value) {
+    return putRaw(store(), key, value.str(), value.length());
+}
+size_t Preferences::putInt(const char* key, int32_t value) {
+    return putRaw(store(), key, std::to_string(value), sizeof(value));
+}
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    return putRaw(store(), key, std::to_string(value), sizeof(value));
+}
+size_t Preferences::putULong64(const char* key, uint64_t value) {
+    return putRaw(store(), key, std::to_string(value), sizeof(value));
+}
+size_t Preferences::putFloat(const char* key, float value) {
+    return putRaw(store(), key, std::to_string(value), sizeof(value));
+}
+size_t Preferences::putBool(const char* key, bool value) {
+    return putRaw(store(), key, value ? "1" : "0", 1);
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+    std::string v;
+    return getRaw(store(), key, v) ? String(v) : defaultValue;
+}
+int32_t Preferences::getInt(const char* key, int32_t defaultValue) {
+    std::string v;
+    return getRaw(store(), key, v) ? (int32_t)strtol(v.c_str(), nullptr, 10) : defaultValue;
+}
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    std::string v;
+    return getRaw(store(), key, v) ? (uint32_t)strtoul(v.c_str(), nullptr, 10) : defaultValue;
+}
+uint64_t Preferences::getULong64(const char* key, uint64_t defaultValue) {
+    std::string v;
+    return getRaw(store(), key, v) ? (uint64_t)strtoull(v.c_str(), nullptr, 10) : defaultValue;
+}
+float Preferences::getFloat(const char* key, float defaultValue) {
+    std::string v;
+    return getRaw(store(), key, v) ? strtof(v.c_str(), nullptr) : defaultValue;
+}
+bool Preferences::getBool(const char* key, bool defaultValue) {
+    std::string v;
+    return getRaw(store(), key, v) ? v == "1" : defaultValue;
+}
@@ -0,0 +1,37 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <map>
+#include <string>
+#include "WString.h"
+
+// In-memory NVS: namespaces survive end()/begin() within one process
+class Preferences {
+private:
+    std::string ns;
+    bool started = false;
+    std::map<std::string, std::string>* store();
+
+public:
+    bool begin(const char* name, bool readOnly = false);
+    void end() { started = false; }
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putString(const char* key, const String& value);
+    size_t putInt(const char* key, int32_t value);
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putULong64(const char* key, uint64_t value);
+    size_t putFloat(const char* key, float value);
+    size_t putBool(const char* key, bool value);
+
+    String getString(const char* key, const String& defaultValue = String());
+    int32_t getInt(const char* key, int32_t defaultValue = 0);
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    uint64_t getULong64(const char* key, uint64_t defaultValue = 0);
+    float getFloat(const char* key, float defaultValue = 0);
+    bool getBool(const char* key, bool defaultValue = false);
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,29 @@
+#include "Print.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <vector>
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        if (write(*buffer++)) n++;
+        else break;
+    }
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char small[128];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    if ((size_t)len < sizeof(small)) return write((const uint8_t*)small, len);
+
+    std::vector<char> large(len + 1);
+    va_start(args, format);
+    vsnprintf(large.data(), large.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)large.data(), len);
+}
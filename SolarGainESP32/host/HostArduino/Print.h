@@ -0,0 +1,35 @@
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "WString.h"
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    virtual void flush() {}
+
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value, int base = 10) { return print(String(value, (unsigned char)base)); }
+    size_t print(unsigned int value, int base = 10) { return print(String(value, (unsigned char)base)); }
+    size_t print(long value, int base = 10) { return print(String(value, (unsigned char)base)); }
+    size_t print(unsigned long value, int base = 10) { return print(String(value, (unsigned char)base)); }
+    size_t print(long long value) { return print(String(value)); }
+    size_t print(unsigned long long value) { return print(String(value)); }
+    size_t print(double value, int digits = 2) { return print(String(value, (unsigned int)digits)); }
+
+    template <typename T> size_t println(const T& value) { return print(value) + println(); }
+    size_t println() { return write((const uint8_t*)"\r\n", 2); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#endif // HOST_PRINT_H
@@ -0,0 +1,19 @@
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+#include "FS.h"
+
+// SPIFFS mapped onto a host directory: $SPIFFS_HOST_ROOT, default ./.spiffs
+class SPIFFSFS : public FS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/spiffs",
+               uint8_t maxOpenFiles = 10, const char* partitionLabel = nullptr);
+    void end() { mounted = false; }
+    bool format();
+    size_t totalBytes() const { return 1024 * 1024; }
+    size_t usedBytes() const { return 0; }
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif // HOST_SPIFFS_H
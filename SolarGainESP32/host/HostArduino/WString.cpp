@@ -0,0 +1,116 @@
+#include "WString.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <algorithm>
+
+static std::string formatInteger(long long value, unsigned char base) {
+    if (base == 10) return std::to_string(value);
+    bool negative = value < 0;
+    unsigned long long v = negative ? -(unsigned long long)value : (unsigned long long)value;
+    std::string out;
+    do {
+        int digit = v % base;
+        out += (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        v /= base;
+    } while (v);
+    if (negative) out += '-';
+    std::reverse(out.begin(), out.end());
+    return out;
+}
+
+String::String(int value, unsigned char base) : s(formatInteger(value, base)) {}
+String::String(unsigned int value, unsigned char base) : s(formatInteger(value, base)) {}
+String::String(long value, unsigned char base) : s(formatInteger(value, base)) {}
+String::String(unsigned long value, unsigned char base) : s(formatInteger((long long)value, base)) {}
+String::String(long long value) : s(std::to_string(value)) {}
+String::String(unsigned long long value) : s(std::to_string(value)) {}
+
+String::String(float value, unsigned int decimals) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, (double)value);
+    s = buffer;
+}
+
+String::String(double value, unsigned int decimals) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    s = buffer;
+}
+
+bool String::equalsIgnoreCase(const String& rhs) const {
+    if (s.size() != rhs.s.size()) return false;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (tolower((unsigned char)s[i]) != tolower((unsigned char)rhs.s[i])) return false;
+    }
+    return true;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+    size_t pos = s.find(c, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& str, unsigned int from) const {
+    size_t pos = s.find(str.s, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char c) const {
+    size_t pos = s.rfind(c);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char c, unsigned int from) const {
+    size_t pos = s.rfind(c, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int from) const {
+    if (from >= s.size()) return String();
+    return String(s.substr(from));
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= s.size()) return String();
+    return String(s.substr(from, to - from));
+}
+
+bool String::startsWith(const String& prefix) const {
+    return s.compare(0, prefix.s.size(), prefix.s) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+    return s.size() >= suffix.s.size() &&
+           s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+}
+
+void String::replace(const String& find, const String& with) {
+    if (find.s.empty()) return;
+    size_t pos = 0;
+    while ((pos = s.find(find.s, pos)) != std::string::npos) {
+        s.replace(pos, find.s.size(), with.s);
+        pos += with.s.size();
+    }
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+    if (index >= s.size()) return;
+    s.erase(index, count);
+}
+
+void String::trim() {
+    size_t begin = 0;
+    while (begin < s.size() && isspace((unsigned char)s[begin])) begin++;
+    size_t end = s.size();
+    while (end > begin && isspace((unsigned char)s[end - 1])) end--;
+    s = s.substr(begin, end - begin);
+}
+
+void String::toLowerCase() {
+    for (auto& c : s) c = (char)tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+    for (auto& c : s) c = (char)toupper((unsigned char)c);
+}
@@ -0,0 +1,82 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+
+// std::string-backed subset of the Arduino String API used by the libraries
+class String {
+private:
+    std::string s;
+
+public:
+    String() {}
+    String(const char* str) : s(str ? str : "") {}
+    String(const std::string& str) : s(str) {}
+    String(char c) : s(1, c) {}
+    String(int value, unsigned char base = 10);
+    String(unsigned int value, unsigned char base = 10);
+    String(long value, unsigned char base = 10);
+    String(unsigned long value, unsigned char base = 10);
+    String(long long value);
+    String(unsigned long long value);
+    String(float value, unsigned int decimals = 2);
+    String(double value, unsigned int decimals = 2);
+
+    unsigned int length() const { return (unsigned int)s.size(); }
+    const char* c_str() const { return s.c_str(); }
+    bool isEmpty() const { return s.empty(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+    const std::string& str() const { return s; }
+
+    String& operator+=(const String& rhs) { s += rhs.s; return *this; }
+    String& operator+=(const char* rhs) { s += rhs ? rhs : ""; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    String& operator+=(int value) { return *this += String(value); }
+    String& operator+=(unsigned int value) { return *this += String(value); }
+    String& operator+=(long value) { return *this += String(value); }
+    String& operator+=(unsigned long value) { return *this += String(value); }
+    bool concat(const String& rhs) { s += rhs.s; return true; }
+    bool concat(const char* rhs, unsigned int len) { s.append(rhs, len); return true; }
+    bool concat(char c) { s += c; return true; }
+
+    bool operator==(const String& rhs) const { return s == rhs.s; }
+    bool operator==(const char* rhs) const { return s == (rhs ? rhs : ""); }
+    bool operator!=(const String& rhs) const { return s != rhs.s; }
+    bool operator!=(const char* rhs) const { return !(*this == rhs); }
+    bool operator<(const String& rhs) const { return s < rhs.s; }
+    bool equals(const String& rhs) const { return s == rhs.s; }
+    bool equalsIgnoreCase(const String& rhs) const;
+
+    char operator[](unsigned int index) const { return index < s.size() ? s[index] : 0; }
+    char& operator[](unsigned int index) { return s[index]; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& str, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    int lastIndexOf(char c, unsigned int from) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    bool startsWith(const String& prefix) const;
+    bool endsWith(const String& suffix) const;
+
+    void replace(const String& find, const String& with);
+    void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+
+    long toInt() const { return strtol(s.c_str(), nullptr, 10); }
+    float toFloat() const { return (float)strtod(s.c_str(), nullptr); }
+    double toDouble() const { return strtod(s.c_str(), nullptr); }
+
+    friend String operator+(const String& lhs, const String& rhs) { return String(lhs.s + rhs.s); }
+    friend String operator+(const String& lhs, const char* rhs) { return String(lhs.s + (rhs ? rhs : "")); }
+    friend String operator+(const char* lhs, const String& rhs) { return String(std::string(lhs ? lhs : "") + rhs.s); }
+    friend String operator+(const String& lhs, char rhs) { return String(lhs.s + rhs); }
+};
+
+#endif // HOST_WSTRING_H
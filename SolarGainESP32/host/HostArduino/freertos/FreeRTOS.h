@@ -0,0 +1,39 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// Host stand-in for the ESP-IDF FreeRTOS API. Tasks are std::threads, ticks
+// are milliseconds and critical sections are a process-wide mutex.
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE  ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS ((TickType_t)1)
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+struct HostMux {
+    void* impl;
+};
+typedef HostMux portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {nullptr}
+
+void hostEnterCritical(portMUX_TYPE* mux);
+void hostExitCritical(portMUX_TYPE* mux);
+#define portENTER_CRITICAL(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) hostExitCritical(mux)
+#define taskENTER_CRITICAL(mux) hostEnterCritical(mux)
+#define taskEXIT_CRITICAL(mux) hostExitCritical(mux)
+
+BaseType_t xPortGetCoreID();
+
+#endif // HOST_FREERTOS_H
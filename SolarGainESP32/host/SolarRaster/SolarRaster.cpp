@@ -0,0 +1,203 @@
+#include "SolarRaster.h"
+#include <atomic>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include "../../lib/SolarCalc/SolarCalc.h"
+#include "../../lib/EpochTime/EpochTime.h"
+
+static const float DEG = (float)(PI / 180.0);
+
+static bool writeAll(int fd, const void* data, size_t bytes) {
+    const char* p = (const char*)data;
+    while (bytes) {
+        ssize_t n = write(fd, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+SolarRaster::SolarRaster(const RasterGrid& grid, const RasterPanel& panel)
+    : grid(grid), panel(panel), cosLongitude(grid.width), sinLongitude(grid.width), year(0), month(0), day(0) {
+    for (uint32_t column = 0; column < grid.width; column++) {
+        float longitude = (grid.west + (column + 0.5f) * grid.step) * DEG;
+        cosLongitude[column] = cosf(longitude);
+        sinLongitude[column] = sinf(longitude);
+    }
+
+    // The beam depends on the sun only through its elevation; tabulate it once
+    SolarCalc model(0, 0, panel.elevation, 0, 0);
+    for (int i = 0; i <= SOLAR_RASTER_DNI_STEPS; i++) {
+        dniTable[i] = model.getClearSkyDni(asinf((float)i / SOLAR_RASTER_DNI_STEPS));
+    }
+    dniTable[SOLAR_RASTER_DNI_STEPS + 1] = dniTable[SOLAR_RASTER_DNI_STEPS];
+
+    cosTilt = cosf(panel.tilt * DEG);
+    sinTilt = sinf(panel.tilt * DEG);
+    cosPanelAzimuth = cosf(panel.azimuth * DEG);
+    sinPanelAzimuth = sinf(panel.azimuth * DEG);
+    diffuseGain = SOLAR_DIFFUSE_FRACTION * (1 + cosTilt) / 2 +
+                  SOLAR_ALBEDO * SOLAR_DIFFUSE_FRACTION * (1 - cosTilt) / 2;
+    groundGain = SOLAR_ALBEDO * (1 - cosTilt) / 2;
+
+    memset(sinDeclination, 0, sizeof(sinDeclination));
+    memset(cosDeclination, 0, sizeof(cosDeclination));
+    memset(cosHourAngle0, 0, sizeof(cosHourAngle0));
+    memset(sinHourAngle0, 0, sizeof(sinHourAngle0));
+}
+
+void SolarRaster::setDate(int y, int m, int d) {
+    year = y;
+    month = m;
+    day = d;
+
+    // The sun at longitude 0 for each hour SolarCalc samples
+    SolarCalc sun(0, 0, 0, 0, 0);
+    time_t dayStart = EpochTime::fromCivil(y, m, d);
+    for (int hour = 0; hour < 24; hour++) {
+        SolarPosition position = sun.positionAt(dayStart + hour * 3600L + 1800);
+        sinDeclination[hour] = sinf(position.declination * DEG);
+        cosDeclination[hour] = cosf(position.declination * DEG);
+        cosHourAngle0[hour] = cosf(position.hourAngle * DEG);
+        sinHourAngle0[hour] = sinf(position.hourAngle * DEG);
+    }
+}
+
+// Terms fixed along a row for one hour
+struct RasterHour {
+    float a, b, c, d;
+    float towardsPanel, acrossPanel;
+    float cosHour, sinHour;
+    float panelUp, skyGain, albedoGain;
+};
+
+// The cell loop. Restrict-qualified parameters, not locals, are what let
+// GCC prove the table gather cannot alias the totals and vectorise it.
+static void accumulateHour(const RasterHour h, const float* __restrict cosLon, const float* __restrict sinLon,
+                           const float* __restrict table, float* __restrict total, uint32_t width) {
+    for (uint32_t column = 0; column < width; column++) {
+        float cosOmega = h.cosHour * cosLon[column] - h.sinHour * sinLon[column];
+        float sinOmega = h.sinHour * cosLon[column] + h.cosHour * sinLon[column];
+
+        // max(v, 0) as (v + |v|) / 2: exact, and no compare for the compiler
+        // to turn back into a branch
+        float sinElevation = h.a + h.b * cosOmega;
+        float up = 0.5f * (sinElevation + fabsf(sinElevation));
+
+        // sin(elevation) <= cos(latitude - declination) <= 1, so with the
+        // guard entry the top step needs no clamp and the loop stays branch-free
+        float x = up * SOLAR_RASTER_DNI_STEPS;
+        int index = (int)x;
+        float dni = table[index] + (table[index + 1] - table[index]) * (x - index);
+
+        float cosIncidence = up * h.panelUp + h.towardsPanel * (h.c - h.d * cosOmega) - h.acrossPanel * sinOmega;
+        cosIncidence = 0.5f * (cosIncidence + fabsf(cosIncidence));
+
+        // Below the horizon up is 0 and so is table[0]: no test needed
+        total[column] += dni * (cosIncidence + h.skyGain + h.albedoGain * up) * 0.001f;
+    }
+}
+
+void SolarRaster::computeRow(uint32_t row, float* out) const {
+    float latitude = (grid.north - (row + 0.5f) * grid.step) * DEG;
+    float sinLatitude = sinf(latitude);
+    float cosLatitude = cosf(latitude);
+
+    for (uint32_t column = 0; column < grid.width; column++) {
+        out[column] = 0;
+    }
+
+    RasterHour h;
+    h.panelUp = cosTilt;
+    h.skyGain = diffuseGain;
+    h.albedoGain = groundGain;
+    h.towardsPanel = sinTilt * cosPanelAzimuth;
+    for (int hour = 0; hour < 24; hour++) {
+        // sin(elevation) = a + b cos(hour angle); skip hours the sun is down along the whole row
+        h.a = sinLatitude * sinDeclination[hour];
+        h.b = cosLatitude * cosDeclination[hour];
+        if (h.a + h.b <= 0) continue;
+
+        // cos(elevation) cos(sun azimuth) = c - d cos(hour angle);
+        // cos(elevation) sin(sun azimuth) = -cos(declination) sin(hour angle)
+        h.c = sinDeclination[hour] * cosLatitude;
+        h.d = cosDeclination[hour] * sinLatitude;
+        h.acrossPanel = sinTilt * sinPanelAzimuth * cosDeclination[hour];
+        h.cosHour = cosHourAngle0[hour];
+        h.sinHour = sinHourAngle0[hour];
+
+        accumulateHour(h, cosLongitude.data(), sinLongitude.data(), dniTable, out, grid.width);
+    }
+}
+
+bool SolarRaster::writeTiled(int fd, uint16_t tileSize, unsigned threads) {
+    if (tileSize == 0) return false;
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    uint8_t header[64];
+    memset(header, 0, sizeof(header));
+    uint16_t version = 1;
+    int16_t headerYear = (int16_t)year;
+    memcpy(header, "SGRT", 4);
+    memcpy(header + 4, &version, 2);
+    memcpy(header + 6, &tileSize, 2);
+    memcpy(header + 8, &grid.width, 4);
+    memcpy(header + 12, &grid.height, 4);
+    memcpy(header + 16, &grid.north, 4);
+    memcpy(header + 20, &grid.west, 4);
+    memcpy(header + 24, &grid.step, 4);
+    memcpy(header + 28, &headerYear, 2);
+    header[30] = (uint8_t)month;
+    header[31] = (uint8_t)day;
+    memcpy(header + 32, &panel.tilt, 4);
+    memcpy(header + 36, &panel.azimuth, 4);
+    memcpy(header + 40, &panel.elevation, 4);
+    if (!writeAll(fd, header, sizeof(header))) return false;
+
+    uint32_t tilesX = (grid.width + tileSize - 1) / tileSize;
+    std::vector<float> band((size_t)tileSize * grid.width);
+    std::vector<float> tile((size_t)tileSize * tileSize);
+
+    for (uint32_t bandStart = 0; bandStart < grid.height; bandStart += tileSize) {
+        uint32_t rows = grid.height - bandStart < tileSize ? grid.height - bandStart : tileSize;
+
+        // Rows of the band shared out to the threads
+        std::atomic<uint32_t> nextRow(0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([this, &band, &nextRow, rows, bandStart] {
+                uint32_t row;
+                while ((row = nextRow++) < rows) {
+                    computeRow(bandStart + row, &band[(size_t)row * grid.width]);
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        for (uint32_t tx = 0; tx < tilesX; tx++) {
+            uint32_t firstColumn = tx * tileSize;
+            uint32_t columns = grid.width - firstColumn < tileSize ? grid.width - firstColumn : tileSize;
+            for (uint32_t row = 0; row < tileSize; row++) {
+                float* destination = &tile[(size_t)row * tileSize];
+                uint32_t filled = 0;
+                if (row < rows) {
+                    memcpy(destination, &band[(size_t)row * grid.width + firstColumn], columns * sizeof(float));
+                    filled = columns;
+                }
+                for (uint32_t column = filled; column < tileSize; column++) {
+                    destination[column] = NAN;
+                }
+            }
+            if (!writeAll(fd, tile.data(), tile.size() * sizeof(float))) return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef SOLAR_RASTER_H
+#define SOLAR_RASTER_H
+
+// Clear-sky daily irradiation on a lat/lon grid, the same quantity as
+// SolarCalc::calculateDailyForecast() with no time zone (24 UTC hours) for
+// every cell, without running SolarCalc per cell.
+//
+// The model separates. Per date and hour, declination, equation of time
+// and the hour angle at longitude 0 come from one SolarCalc::positionAt().
+// Longitude only adds to the hour angle, so per column cos and sin of the
+// longitude rotate it. Per row, the latitude products are fixed. What is
+// left per cell and hour is multiply-adds and a beam lookup by sin(elevation),
+// laid out over contiguous columns so the compiler can vectorise it.
+//
+// Tiled file, little-endian. A 64-byte header:
+//   char magic[4] "SGRT", uint16 version (1), uint16 tileSize,
+//   uint32 width, uint32 height, float north, float west, float step (degrees),
+//   int16 year, uint8 month, uint8 day, float tilt, float azimuth, float elevation,
+//   then zero padding to 64 bytes
+// then tiles in row-major tile order, each tileSize x tileSize float kWh/m²,
+// row-major inside the tile. Edge tiles are padded with NaN, so tile (tx, ty)
+// is at 64 + (ty * tilesX + tx) * tileSize² * 4.
+
+#include <stdint.h>
+#include <vector>
+
+#ifndef SOLAR_RASTER_TILE
+#define SOLAR_RASTER_TILE 256
+#endif
+
+// Entries in the beam table over sin(elevation) 0..1
+#define SOLAR_RASTER_DNI_STEPS 4096
+
+// Cell centres: latitude north - (row + 0.5) * step, longitude west + (column + 0.5) * step
+struct RasterGrid {
+    float north;
+    float west;
+    float step;             // degrees
+    uint32_t width;
+    uint32_t height;
+};
+
+struct RasterPanel {
+    float tilt;             // degrees; 0 for a horizontal surface
+    float azimuth;          // degrees clockwise from north
+    float elevation;        // meters, the same for every cell
+};
+
+class SolarRaster {
+private:
+    RasterGrid grid;
+    RasterPanel panel;
+
+    // Per column
+    std::vector<float> cosLongitude;
+    std::vector<float> sinLongitude;
+
+    // Per hour of the date
+    int year, month, day;
+    float sinDeclination[24];
+    float cosDeclination[24];
+    float cosHourAngle0[24];   // hour angle at longitude 0
+    float sinHourAngle0[24];
+
+    // Beam normal irradiance by sin(elevation), from SolarCalc::getClearSkyDni(),
+    // plus a guard entry for sin(elevation) rounding up to 1
+    float dniTable[SOLAR_RASTER_DNI_STEPS + 2];
+
+    // Panel terms
+    float cosTilt, sinTilt, cosPanelAzimuth, sinPanelAzimuth;
+    float diffuseGain;         // sky diffuse and ground reflection per unit of beam, without the sin(elevation) part
+    float groundGain;          // ground reflection per unit of beam and sin(elevation)
+
+public:
+    SolarRaster(const RasterGrid& grid, const RasterPanel& panel);
+
+    // Hoist the per-date terms; call before computeRow()
+    void setDate(int year, int month, int day);
+
+    // One grid row, width values in kWh/m². Safe to call from several
+    // threads for different rows once the date is set.
+    void computeRow(uint32_t row, float* out) const;
+
+    // Compute the whole grid in bands of one tile row and write the tiled
+    // file; threads 0 uses one per core. Memory is one band.
+    bool writeTiled(int fd, uint16_t tileSize = SOLAR_RASTER_TILE, unsigned threads = 0);
+
+    const RasterGrid& getGrid() const { return grid; }
+};
+
+#endif // SOLAR_RASTER_H
@@ -0,0 +1,82 @@
+// solarraster: tiled clear-sky irradiation map for a date (pio run -e solarraster).
+//
+//   solarraster --date 2025-06-21 --out map.sgrt [--north 60 --south -60 --west -180 --east 180]
+//               [--step 0.05] [--tilt 0 --azimuth 180 --elevation 0] [--tile 256] [--threads N]
+
+#ifdef SOLAR_RASTER_MAIN
+
+#include <chrono>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "SolarRaster.h"
+
+static void usage() {
+    fprintf(stderr,
+            "usage: solarraster --date YYYY-MM-DD --out FILE [--north DEG --south DEG --west DEG --east DEG]\n"
+            "                   [--step DEG] [--tilt DEG --azimuth DEG --elevation M] [--tile N] [--threads N]\n");
+}
+
+int main(int argc, char** argv) {
+    float north = 60, south = -60, west = -180, east = 180, step = 0.05f;
+    RasterPanel panel = {0, 180, 0};
+    int year = 0, month = 0, day = 0;
+    const char* outputPath = nullptr;
+    unsigned tileSize = SOLAR_RASTER_TILE;
+    unsigned threads = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (strcmp(argv[i], "--date") == 0) sscanf(value, "%d-%d-%d", &year, &month, &day);
+        else if (strcmp(argv[i], "--out") == 0) outputPath = value;
+        else if (strcmp(argv[i], "--north") == 0) north = strtof(value, nullptr);
+        else if (strcmp(argv[i], "--south") == 0) south = strtof(value, nullptr);
+        else if (strcmp(argv[i], "--west") == 0) west = strtof(value, nullptr);
+        else if (strcmp(argv[i], "--east") == 0) east = strtof(value, nullptr);
+        else if (strcmp(argv[i], "--step") == 0) step = strtof(value, nullptr);
+        else if (strcmp(argv[i], "--tilt") == 0) panel.tilt = strtof(value, nullptr);
+        else if (strcmp(argv[i], "--azimuth") == 0) panel.azimuth = strtof(value, nullptr);
+        else if (strcmp(argv[i], "--elevation") == 0) panel.elevation = strtof(value, nullptr);
+        else if (strcmp(argv[i], "--tile") == 0) tileSize = atoi(value);
+        else if (strcmp(argv[i], "--threads") == 0) threads = atoi(value);
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (!outputPath || year < 1900 || month < 1 || month > 12 || day < 1 || day > 31 || step <= 0 ||
+        north <= south || east <= west || tileSize == 0 || tileSize > 4096) {
+        usage();
+        return 2;
+    }
+
+    RasterGrid grid;
+    grid.north = north;
+    grid.west = west;
+    grid.step = step;
+    grid.width = (uint32_t)ceilf((east - west) / step);
+    grid.height = (uint32_t)ceilf((north - south) / step);
+
+    int fd = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "solarraster: cannot write %s\n", outputPath);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SolarRaster raster(grid, panel);
+    raster.setDate(year, month, day);
+    bool ok = raster.writeTiled(fd, (uint16_t)tileSize, threads);
+    close(fd);
+    float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    double cells = (double)grid.width * grid.height;
+    fprintf(stderr, "solarraster: %u x %u cells in %.2f s, %.1f M cells/s%s\n", grid.width, grid.height, seconds,
+            cells / seconds / 1e6, ok ? "" : " (write failed)");
+    return ok ? 0 : 1;
+}
+
+#endif // SOLAR_RASTER_MAIN
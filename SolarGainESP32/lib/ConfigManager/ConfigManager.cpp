@@ -1,9 +1,77 @@
 #include "ConfigManager.h"
+#include "../Trace/Trace.h"
+#include "../MemoryMonitor/MemoryMonitor.h"
 
-ConfigManager::ConfigManager() : initialized(false) {
+ConfigManager::ConfigManager() : initialized(false), activeZone(0), loaded(false) {
+    // The public Graph API until the file or Preferences name another endpoint
+    whatsappConfig.apiHost = "graph.facebook.com";
+    whatsappConfig.apiPort = 443;
+    whatsappConfig.apiVersion = "v18.0";
+    for (uint8_t i = 0; i < CONFIG_MAX_LISTENERS; i++) {
+        listeners[i].mask = 0;
+    }
+}
+
+// Recipients are stored in Preferences as one comma-separated string
+static String joinRecipients(const std::vector<String>& list) {
+    String joined;
+    for (size_t i = 0; i < list.size(); i++) {
+        if (i > 0) joined += ",";
+        joined += list[i];
+    }
+    return joined;
+}
+
+static std::vector<String> splitRecipients(const String& joined) {
+    std::vector<String> list;
+    int start = 0;
+    while (start < (int)joined.length()) {
+        int comma = joined.indexOf(',', start);
+        if (comma < 0) comma = joined.length();
+        String number = joined.substring(start, comma);
+        number.trim();
+        if (number.length() > 0) list.push_back(number);
+        start = comma + 1;
+    }
+    return list;
+}
+
+// Keep recipientNumber and recipients consistent whichever one was configured
+static void normalizeRecipients(WhatsAppConfig& config) {
+    if (config.recipients.empty() && config.recipientNumber.length() > 0) {
+        config.recipients.push_back(config.recipientNumber);
+    }
+    if (!config.recipients.empty()) {
+        config.recipientNumber = config.recipients[0];
+    }
+}
+
+// Which sections differ between two versions of the configuration
+static uint16_t whatsappChanges(const WhatsAppConfig& a, const WhatsAppConfig& b) {
+    uint16_t changes = 0;
+    if (a.phoneNumberId != b.phoneNumberId || a.accessToken != b.accessToken || a.apiHost != b.apiHost ||
+        a.apiPort != b.apiPort || a.apiVersion != b.apiVersion) {
+        changes |= CONFIG_WHATSAPP;
+    }
+    if (a.recipientNumber != b.recipientNumber || a.recipients != b.recipients) {
+        changes |= CONFIG_RECIPIENTS;
+    }
+    return changes;
+}
+
+static uint16_t locationChanges(const LocationConfig& a, const LocationConfig& b) {
+    uint16_t changes = 0;
+    if (a.latitude != b.latitude || a.longitude != b.longitude || a.elevation != b.elevation) {
+        changes |= CONFIG_SITE;
+    }
+    if (a.timezoneOffset != b.timezoneOffset || a.timezone != b.timezone) changes |= CONFIG_TIMEZONE;
+    if (a.name != b.name) changes |= CONFIG_SITE_NAME;
+    return changes;
 }
 
 bool ConfigManager::begin() {
+    TRACE_SCOPE("config.begin");
+    
     // Initialize SPIFFS
     if (!SPIFFS.begin(true)) {
         Serial.println("Failed to mount SPIFFS");
@@ -24,7 +92,8 @@ bool ConfigManager::loadFromFile(const String& filename) {
         return false;
     }
     
-    StaticJsonDocument<1024> doc;
+    // Room for a few dozen recipients
+    StaticJsonDocument<2048> doc;
     DeserializationError error = deserializeJson(doc, file);
     file.close();
     
@@ -44,6 +113,14 @@ bool ConfigManager::loadFromFile(const String& filename) {
         whatsappConfig.phoneNumberId = doc["whatsapp"]["phone_number_id"].as<String>();
         whatsappConfig.accessToken = doc["whatsapp"]["access_token"].as<String>();
         whatsappConfig.recipientNumber = doc["whatsapp"]["recipient_number"].as<String>();
+        whatsappConfig.recipients.clear();
+        for (JsonVariant number : doc["whatsapp"]["recipients"].as<JsonArray>()) {
+            whatsappConfig.recipients.push_back(number.as<String>());
+        }
+        whatsappConfig.apiHost = doc["whatsapp"]["api_host"] | "graph.facebook.com";
+        whatsappConfig.apiPort = doc["whatsapp"]["api_port"] | 443;
+        whatsappConfig.apiVersion = doc["whatsapp"]["api_version"] | "v18.0";
+        normalizeRecipients(whatsappConfig);
     }
     
     // Load location config
@@ -53,6 +130,7 @@ bool ConfigManager::loadFromFile(const String& filename) {
         locationConfig.longitude = doc["location"]["longitude"];
         locationConfig.elevation = doc["location"]["elevation"];
         locationConfig.timezoneOffset = doc["location"]["timezone_offset"];
+        locationConfig.timezone = doc["location"]["timezone"] | "";
     }
     
     // Load panel config
@@ -71,6 +149,11 @@ bool ConfigManager::loadFromFile(const String& filename) {
     // Load sleep config
     if (doc.containsKey("sleep")) {
         sleepConfig.durationMinutes = doc["sleep"]["duration_minutes"];
+        sleepConfig.twilightMinutes = doc["sleep"]["twilight_minutes"] | 10;
+        sleepConfig.twilightWindowMinutes = doc["sleep"]["twilight_window_minutes"] | 45;
+        sleepConfig.maxSleepHours = doc["sleep"]["max_sleep_hours"] | 12;
+        sleepConfig.idleCpuMhz = doc["sleep"]["idle_cpu_mhz"] | 80;
+        sleepConfig.activeCpuMhz = doc["sleep"]["active_cpu_mhz"] | 240;
     }
     
     Serial.println("Configuration loaded from file");
@@ -86,6 +169,10 @@ void ConfigManager::saveToPreferences() {
     preferences.putString("wa_phone_id", whatsappConfig.phoneNumberId);
     preferences.putString("wa_token", whatsappConfig.accessToken);
     preferences.putString("wa_recipient", whatsappConfig.recipientNumber);
+    preferences.putString("wa_recipients", joinRecipients(whatsappConfig.recipients));
+    preferences.putString("wa_api_host", whatsappConfig.apiHost);
+    preferences.putInt("wa_api_port", whatsappConfig.apiPort);
+    preferences.putString("wa_api_ver", whatsappConfig.apiVersion);
     
     // Save location settings
     preferences.putString("loc_name", locationConfig.name);
@@ -93,6 +180,7 @@ void ConfigManager::saveToPreferences() {
     preferences.putFloat("loc_lon", locationConfig.longitude);
     preferences.putFloat("loc_elev", locationConfig.elevation);
     preferences.putInt("loc_tz", locationConfig.timezoneOffset);
+    preferences.putString("loc_tzstr", locationConfig.timezone);
     
     // Save panel settings
     preferences.putFloat("panel_tilt", panelConfig.tilt);
@@ -105,6 +193,11 @@ void ConfigManager::saveToPreferences() {
     
     // Save sleep settings
     preferences.putInt("sleep_mins", sleepConfig.durationMinutes);
+    preferences.putInt("sleep_twi", sleepConfig.twilightMinutes);
+    preferences.putInt("sleep_twi_win", sleepConfig.twilightWindowMinutes);
+    preferences.putInt("sleep_max_h", sleepConfig.maxSleepHours);
+    preferences.putInt("cpu_idle_mhz", sleepConfig.idleCpuMhz);
+    preferences.putInt("cpu_act_mhz", sleepConfig.activeCpuMhz);
     
     Serial.println("Configuration saved to preferences");
 }
@@ -118,6 +211,11 @@ void ConfigManager::loadFromPreferences() {
     whatsappConfig.phoneNumberId = preferences.getString("wa_phone_id", "");
     whatsappConfig.accessToken = preferences.getString("wa_token", "");
     whatsappConfig.recipientNumber = preferences.getString("wa_recipient", "");
+    whatsappConfig.recipients = splitRecipients(preferences.getString("wa_recipients", ""));
+    whatsappConfig.apiHost = preferences.getString("wa_api_host", whatsappConfig.apiHost);
+    whatsappConfig.apiPort = preferences.getInt("wa_api_port", whatsappConfig.apiPort);
+    whatsappConfig.apiVersion = preferences.getString("wa_api_ver", whatsappConfig.apiVersion);
+    normalizeRecipients(whatsappConfig);
     
     // Load location settings with defaults for Harare
     locationConfig.name = preferences.getString("loc_name", "32 George Road, Hatfield, Harare");
@@ -125,6 +223,7 @@ void ConfigManager::loadFromPreferences() {
     locationConfig.longitude = preferences.getFloat("loc_lon", 31.0909);
     locationConfig.elevation = preferences.getFloat("loc_elev", 650);
     locationConfig.timezoneOffset = preferences.getInt("loc_tz", 2);
+    locationConfig.timezone = preferences.getString("loc_tzstr", locationConfig.timezone);
     
     // Load panel settings
     panelConfig.tilt = preferences.getFloat("panel_tilt", 30);
@@ -137,16 +236,26 @@ void ConfigManager::loadFromPreferences() {
     
     // Load sleep settings
     sleepConfig.durationMinutes = preferences.getInt("sleep_mins", 30);
+    sleepConfig.twilightMinutes = preferences.getInt("sleep_twi", 10);
+    sleepConfig.twilightWindowMinutes = preferences.getInt("sleep_twi_win", 45);
+    sleepConfig.maxSleepHours = preferences.getInt("sleep_max_h", 12);
+    sleepConfig.idleCpuMhz = preferences.getInt("cpu_idle_mhz", 80);
+    sleepConfig.activeCpuMhz = preferences.getInt("cpu_act_mhz", 240);
     
     Serial.println("Configuration loaded from preferences");
 }
 
 bool ConfigManager::loadConfig() {
+    TRACE_SCOPE("config.load");
+    MEMORY_SCOPE(MEM_TAG_CONFIG);
+    
     if (!initialized) {
         Serial.println("ConfigManager not initialized!");
         return false;
     }
     
+    Snapshot before = snapshot();
+    
     // First try to load from file
     bool fileLoaded = loadFromFile("/config.json");
     
@@ -158,6 +267,7 @@ bool ConfigManager::loadConfig() {
         saveToPreferences();
     }
     
+    publishChanges(before);
     return isValid();
 }
 
@@ -171,31 +281,124 @@ void ConfigManager::saveConfig() {
 }
 
 void ConfigManager::setWiFiConfig(const WiFiConfig& config) {
+    Snapshot before = snapshot();
     wifiConfig = config;
+    publishChanges(before);
 }
 
 void ConfigManager::setWhatsAppConfig(const WhatsAppConfig& config) {
+    Snapshot before = snapshot();
     whatsappConfig = config;
+    normalizeRecipients(whatsappConfig);
+    publishChanges(before);
 }
 
 void ConfigManager::setLocationConfig(const LocationConfig& config) {
+    Snapshot before = snapshot();
     locationConfig = config;
+    publishChanges(before);
+}
+
+void ConfigManager::compileTimeZone() {
+    // The transition table is built once here; conversions never parse.
+    // Other tasks may be reading the active zone, so build the other one.
+    uint8_t next = activeZone.load(std::memory_order_relaxed) ^ 1;
+    TimeZone& zone = zones[next];
+    bool compiled = false;
+    if (locationConfig.timezone.length() > 0) {
+        compiled = zone.begin(locationConfig.timezone.c_str());
+        if (!compiled) {
+            Serial.println("Invalid timezone \"" + locationConfig.timezone + "\", using GMT+" +
+                           String(locationConfig.timezoneOffset));
+        }
+    }
+    if (!compiled) zone.setFixed((int32_t)locationConfig.timezoneOffset * 3600);
+    activeZone.store(next, std::memory_order_release);
 }
 
 void ConfigManager::setPanelConfig(const PanelConfig& config) {
+    Snapshot before = snapshot();
     panelConfig = config;
+    publishChanges(before);
 }
 
 void ConfigManager::setNotificationConfig(const NotificationConfig& config) {
+    Snapshot before = snapshot();
     notificationConfig = config;
+    publishChanges(before);
 }
 
 void ConfigManager::setSleepConfig(const SleepConfig& config) {
+    Snapshot before = snapshot();
     sleepConfig = config;
+    publishChanges(before);
+}
+
+int8_t ConfigManager::subscribe(uint16_t mask, const ConfigListener& listener) {
+    for (int8_t i = 0; i < CONFIG_MAX_LISTENERS; i++) {
+        if (listeners[i].mask == 0) {
+            listeners[i].mask = mask;
+            listeners[i].callback = listener;
+            return i;
+        }
+    }
+    Serial.println("ConfigManager: no room for another listener");
+    return -1;
+}
+
+void ConfigManager::unsubscribe(int8_t id) {
+    if (id < 0 || id >= CONFIG_MAX_LISTENERS) return;
+    listeners[id].mask = 0;
+    listeners[id].callback = nullptr;
+}
+
+ConfigManager::Snapshot ConfigManager::snapshot() {
+    Snapshot state = {wifiConfig, whatsappConfig, locationConfig, panelConfig, notificationConfig, sleepConfig};
+    return state;
+}
+
+void ConfigManager::publishChanges(const Snapshot& before) {
+    // Nothing to diff against until the first load or reset; everything is new
+    uint16_t changes = CONFIG_ALL;
+    if (loaded) {
+        changes = whatsappChanges(before.whatsapp, whatsappConfig) | locationChanges(before.location, locationConfig);
+        if (before.wifi.ssid != wifiConfig.ssid || before.wifi.password != wifiConfig.password) {
+            changes |= CONFIG_WIFI;
+        }
+        if (before.panel.tilt != panelConfig.tilt || before.panel.azimuth != panelConfig.azimuth) {
+            changes |= CONFIG_PANEL;
+        }
+        const NotificationConfig& n = before.notifications;
+        if (n.enabled != notificationConfig.enabled || n.hour != notificationConfig.hour ||
+            n.minute != notificationConfig.minute) {
+            changes |= CONFIG_NOTIFICATIONS;
+        }
+        const SleepConfig& z = before.sleep;
+        if (z.durationMinutes != sleepConfig.durationMinutes || z.twilightMinutes != sleepConfig.twilightMinutes ||
+            z.twilightWindowMinutes != sleepConfig.twilightWindowMinutes ||
+            z.maxSleepHours != sleepConfig.maxSleepHours || z.idleCpuMhz != sleepConfig.idleCpuMhz ||
+            z.activeCpuMhz != sleepConfig.activeCpuMhz) {
+            changes |= CONFIG_SLEEP;
+        }
+    }
+    loaded = true;
+    
+    // Compile before anyone holding the zone hears about it
+    if (changes & CONFIG_TIMEZONE) compileTimeZone();
+    publish(changes);
+}
+
+void ConfigManager::publish(uint16_t changes) {
+    if (changes == 0) return;
+    for (uint8_t i = 0; i < CONFIG_MAX_LISTENERS; i++) {
+        uint16_t relevant = changes & listeners[i].mask;
+        if (relevant && listeners[i].callback) listeners[i].callback(relevant);
+    }
 }
 
 void ConfigManager::factoryReset() {
     preferences.clear();
+    Snapshot before = snapshot();
     
     // Set default values
     locationConfig.name = "32 George Road, Hatfield, Harare";
@@ -203,6 +406,7 @@ void ConfigManager::factoryReset() {
     locationConfig.longitude = 31.0909;
     locationConfig.elevation = 650;
     locationConfig.timezoneOffset = 2;
+    locationConfig.timezone = "CAT-2";
     
     panelConfig.tilt = 30;
     panelConfig.azimuth = 180;
@@ -212,6 +416,11 @@ void ConfigManager::factoryReset() {
     notificationConfig.minute = 0;
     
     sleepConfig.durationMinutes = 30;
+    sleepConfig.twilightMinutes = 10;
+    sleepConfig.twilightWindowMinutes = 45;
+    sleepConfig.maxSleepHours = 12;
+    sleepConfig.idleCpuMhz = 80;
+    sleepConfig.activeCpuMhz = 240;
     
     // Clear sensitive data
     wifiConfig.ssid = "";
@@ -219,7 +428,12 @@ void ConfigManager::factoryReset() {
     whatsappConfig.phoneNumberId = "";
     whatsappConfig.accessToken = "";
     whatsappConfig.recipientNumber = "";
+    whatsappConfig.recipients.clear();
+    whatsappConfig.apiHost = "graph.facebook.com";
+    whatsappConfig.apiPort = 443;
+    whatsappConfig.apiVersion = "v18.0";
     
+    publishChanges(before);
     Serial.println("Factory reset completed");
 }
 
@@ -5,6 +5,10 @@
 #include <Preferences.h>
 #include <ArduinoJson.h>
 #include <SPIFFS.h>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include "../EpochTime/TimeZone.h"
 
 struct WiFiConfig {
     String ssid;
@@ -14,7 +18,11 @@ struct WiFiConfig {
 struct WhatsAppConfig {
     String phoneNumberId;
     String accessToken;
-    String recipientNumber;
+    String recipientNumber;              // first recipient, kept for single-recipient callers
+    std::vector<String> recipients;      // everyone who gets the daily forecast
+    String apiHost;                      // Graph API endpoint; override to test against a stand-in
+    uint16_t apiPort;
+    String apiVersion;
 };
 
 struct LocationConfig {
@@ -22,7 +30,8 @@ struct LocationConfig {
     float latitude;
     float longitude;
     float elevation;
-    int timezoneOffset;
+    int timezoneOffset;          // whole hours east of UTC, used when timezone is empty
+    String timezone;             // POSIX TZ string, e.g. "CAT-2" or "CET-1CEST,M3.5.0,M10.5.0/3"
 };
 
 struct PanelConfig {
@@ -37,9 +46,41 @@ struct NotificationConfig {
 };
 
 struct SleepConfig {
-    int durationMinutes;
+    int durationMinutes;         // daytime wake cadence
+    int twilightMinutes;         // cadence around sunrise and sunset
+    int twilightWindowMinutes;   // how far either side of the event that applies
+    int maxSleepHours;           // longest single deep sleep
+    int idleCpuMhz;              // CPU clock while nothing needs speed
+    int activeCpuMhz;            // CPU clock for rendering and WiFi
 };
 
+// Sections a change can touch; listeners subscribe to a mask of them.
+// Each bit is a node in the dependency graph, and the subscriber decides
+// what it derives from it:
+//   CONFIG_SITE       -> SolarCalc sun positions -> transposition -> forecast
+//   CONFIG_TIMEZONE   -> TimeSync, Scheduler, SolarCalc sun positions
+//   CONFIG_PANEL      -> SolarCalc transposition -> forecast
+//   CONFIG_RECIPIENTS -> WhatsAppClient only, no solar math
+enum ConfigChange : uint16_t {
+    CONFIG_WIFI          = 1 << 0,
+    CONFIG_WHATSAPP      = 1 << 1,   // credentials and endpoint
+    CONFIG_RECIPIENTS    = 1 << 2,
+    CONFIG_SITE          = 1 << 3,   // latitude, longitude, elevation
+    CONFIG_TIMEZONE      = 1 << 4,
+    CONFIG_SITE_NAME     = 1 << 5,
+    CONFIG_PANEL         = 1 << 6,
+    CONFIG_NOTIFICATIONS = 1 << 7,
+    CONFIG_SLEEP         = 1 << 8,
+    CONFIG_ALL           = 0x1FF
+};
+
+// Called with the sections that changed (masked to the subscription)
+typedef std::function<void(uint16_t changes)> ConfigListener;
+
+#ifndef CONFIG_MAX_LISTENERS
+#define CONFIG_MAX_LISTENERS 8
+#endif
+
 class ConfigManager {
 private:
     Preferences preferences;
@@ -53,6 +94,33 @@ private:
     NotificationConfig notificationConfig;
     SleepConfig sleepConfig;
     
+    // Compiled from locationConfig whenever it changes, into the zone not in
+    // use, then switched to; the one readers hold is never rewritten under them
+    TimeZone zones[2];
+    std::atomic<uint8_t> activeZone;
+    void compileTimeZone();
+    
+    // Change events
+    struct Listener {
+        uint16_t mask;
+        ConfigListener callback;
+    };
+    Listener listeners[CONFIG_MAX_LISTENERS];
+    bool loaded;
+    
+    // Every section, to diff a set or reload against what listeners last saw
+    struct Snapshot {
+        WiFiConfig wifi;
+        WhatsAppConfig whatsapp;
+        LocationConfig location;
+        PanelConfig panel;
+        NotificationConfig notifications;
+        SleepConfig sleep;
+    };
+    Snapshot snapshot();
+    void publishChanges(const Snapshot& before);
+    void publish(uint16_t changes);
+    
     // Load configuration from JSON file
     bool loadFromFile(const String& filename);
     
@@ -68,7 +136,8 @@ public:
     // Initialize configuration manager
     bool begin();
     
-    // Load configuration (first from file, then from preferences)
+    // Load configuration (first from file, then from preferences). Calling it
+    // again reloads, and listeners hear only about the sections that changed.
     bool loadConfig();
     
     // Save current configuration to preferences
@@ -82,7 +151,18 @@ public:
     NotificationConfig getNotificationConfig() { return notificationConfig; }
     SleepConfig getSleepConfig() { return sleepConfig; }
     
-    // Set configuration values
+    // Site time zone, for TimeSync, SolarCalc and the Scheduler to hold. A
+    // change compiles a new zone at another address and publishes
+    // CONFIG_TIMEZONE; fetch it again then. The previous zone stays valid
+    // until the change after that.
+    const TimeZone& getTimeZone() { return zones[activeZone.load(std::memory_order_acquire)]; }
+    
+    // Listen for changes to the sections in mask; returns an id, or -1 when
+    // full. Listeners run in the setter's context and must not call setters.
+    int8_t subscribe(uint16_t mask, const ConfigListener& listener);
+    void unsubscribe(int8_t id);
+    
+    // Set configuration values; each publishes only what actually changed
     void setWiFiConfig(const WiFiConfig& config);
     void setWhatsAppConfig(const WhatsAppConfig& config);
     void setLocationConfig(const LocationConfig& config);
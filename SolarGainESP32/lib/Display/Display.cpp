@@ -1,7 +1,10 @@
 #include "Display.h"
+#include "../Trace/Trace.h"
+#include "../MemoryMonitor/MemoryMonitor.h"
 // Note: PWM brightness for ESP32 is optional; fallback uses digital on/off
 
 Display::Display() : tft(TFT_eSPI()), initialized(false) {
+    canvas = &tft;
     // Set color scheme
     bgColor = TFT_BLACK;
     fgColor = TFT_WHITE;
@@ -38,7 +41,7 @@ void Display::begin() {
 }
 
 void Display::clear() {
-    tft.fillScreen(bgColor);
+    canvas->fillScreen(bgColor);
 }
 
 void Display::showSplashScreen() {
@@ -49,7 +52,7 @@ void Display::showSplashScreen() {
     int centerY = screenHeight / 2 - 20;
     int sunRadius = 30;
     
-    tft.fillCircle(centerX, centerY, sunRadius, TFT_YELLOW);
+    canvas->fillCircle(centerX, centerY, sunRadius, TFT_YELLOW);
     
     // Draw rays
     for (int i = 0; i < 8; i++) {
@@ -58,44 +61,45 @@ void Display::showSplashScreen() {
         int y1 = centerY + (sunRadius + 5) * sin(angle);
         int x2 = centerX + (sunRadius + 15) * cos(angle);
         int y2 = centerY + (sunRadius + 15) * sin(angle);
-        tft.drawLine(x1, y1, x2, y2, TFT_YELLOW);
+        canvas->drawLine(x1, y1, x2, y2, TFT_YELLOW);
     }
     
     // Draw title
-    tft.setTextSize(2);
-    tft.setTextDatum(TC_DATUM);
-    tft.drawString("SolarGain ESP32", centerX, centerY + 50);
+    canvas->setTextSize(2);
+    canvas->setTextDatum(TC_DATUM);
+    canvas->drawString("SolarGain ESP32", centerX, centerY + 50);
     
-    tft.setTextSize(1);
-    tft.drawString("Solar Irradiance Forecast", centerX, centerY + 75);
-    tft.drawString("Harare, Zimbabwe", centerX, centerY + 90);
+    canvas->setTextSize(1);
+    canvas->drawString("Solar Irradiance Forecast", centerX, centerY + 75);
+    canvas->drawString("Harare, Zimbabwe", centerX, centerY + 90);
     
-    tft.setTextDatum(TL_DATUM); // Reset datum
+    canvas->setTextDatum(TL_DATUM); // Reset datum
 }
 
 void Display::showLoading(const String& message) {
     clear();
     
-    tft.setTextSize(2);
-    tft.setTextDatum(MC_DATUM);
-    tft.drawString("Loading...", screenWidth / 2, screenHeight / 2 - 20);
+    canvas->setTextSize(2);
+    canvas->setTextDatum(MC_DATUM);
+    canvas->drawString("Loading...", screenWidth / 2, screenHeight / 2 - 20);
     
-    tft.setTextSize(1);
-    tft.drawString(message, screenWidth / 2, screenHeight / 2 + 10);
+    canvas->setTextSize(1);
+    canvas->drawString(message, screenWidth / 2, screenHeight / 2 + 10);
     
-    tft.setTextDatum(TL_DATUM);
+    canvas->setTextDatum(TL_DATUM);
 }
 
 void Display::showError(const String& error) {
+    MEMORY_SCOPE(MEM_TAG_DISPLAY);
     clear();
     
-    tft.setTextSize(2);
-    tft.setTextColor(TFT_RED, bgColor);
-    tft.setTextDatum(MC_DATUM);
-    tft.drawString("ERROR", screenWidth / 2, screenHeight / 2 - 20);
+    canvas->setTextSize(2);
+    canvas->setTextColor(TFT_RED, bgColor);
+    canvas->setTextDatum(MC_DATUM);
+    canvas->drawString("ERROR", screenWidth / 2, screenHeight / 2 - 20);
     
-    tft.setTextSize(1);
-    tft.setTextColor(textColor, bgColor);
+    canvas->setTextSize(1);
+    canvas->setTextColor(textColor, bgColor);
     
     // Word wrap error message
     int maxWidth = screenWidth - 40;
@@ -107,66 +111,75 @@ void Display::showError(const String& error) {
         if (spacePos == -1) spacePos = min(40, (int)remaining.length());
         
         String line = remaining.substring(0, spacePos);
-        tft.drawString(line, screenWidth / 2, yPos);
+        canvas->drawString(line, screenWidth / 2, yPos);
         
         remaining = remaining.substring(spacePos);
         remaining.trim();
         yPos += 15;
     }
     
-    tft.setTextDatum(TL_DATUM);
+    canvas->setTextDatum(TL_DATUM);
 }
 
 void Display::drawHeader(const String& title, const String& date) {
-    tft.setTextSize(2);
-    tft.setTextDatum(TC_DATUM);
-    tft.drawString(title, screenWidth / 2, 10);
+    canvas->setTextSize(2);
+    canvas->setTextDatum(TC_DATUM);
+    canvas->drawString(title, screenWidth / 2, 10);
     
-    tft.setTextSize(1);
-    tft.drawString(date, screenWidth / 2, 30);
-    tft.setTextDatum(TL_DATUM);
+    canvas->setTextSize(1);
+    canvas->drawString(date, screenWidth / 2, 30);
+    canvas->setTextDatum(TL_DATUM);
 }
 
-void Display::drawFooter(float totalIrradiance) {
+void Display::drawFooter(const DailyForecast& forecast) {
     int yPos = screenHeight - 25;
     
-    tft.setTextSize(1);
-    tft.setTextDatum(TL_DATUM);
-    tft.drawString("Daily Total:", 20, yPos);
+    canvas->setTextSize(1);
+    canvas->setTextDatum(TL_DATUM);
+    canvas->drawString("Daily Total:", 20, yPos);
     
     char buffer[20];
-    snprintf(buffer, sizeof(buffer), "%.2f kWh/m2", totalIrradiance);
-    
-    tft.setTextSize(2);
-    tft.setTextColor(TFT_GREEN, bgColor);
-    tft.drawString(buffer, 100, yPos - 3);
-    tft.setTextColor(textColor, bgColor);
-    tft.setTextSize(1);
+    snprintf(buffer, sizeof(buffer), "%.2f kWh/m2", forecast.totalIrradiance);
+    
+    canvas->setTextSize(2);
+    canvas->setTextColor(TFT_GREEN, bgColor);
+    canvas->drawString(buffer, 100, yPos - 3);
+    canvas->setTextColor(textColor, bgColor);
+    canvas->setTextSize(1);
+    
+    // Sun events from the forecast, right-aligned
+    if (forecast.sunrise >= 0 && forecast.sunset >= 0) {
+        int rise = lroundf(forecast.sunrise * 60), set = lroundf(forecast.sunset * 60);
+        snprintf(buffer, sizeof(buffer), "%02d:%02d - %02d:%02d", rise / 60, rise % 60, set / 60, set % 60);
+        canvas->setTextDatum(TR_DATUM);
+        canvas->drawString(buffer, screenWidth - 20, yPos);
+        canvas->setTextDatum(TL_DATUM);
+    }
 }
 
 void Display::drawGrid() {
     // Draw axes
-    tft.drawLine(chartX, chartY + chartHeight, chartX + chartWidth, chartY + chartHeight, fgColor);
-    tft.drawLine(chartX, chartY, chartX, chartY + chartHeight, fgColor);
+    canvas->drawLine(chartX, chartY + chartHeight, chartX + chartWidth, chartY + chartHeight, fgColor);
+    canvas->drawLine(chartX, chartY, chartX, chartY + chartHeight, fgColor);
     
     // Draw horizontal grid lines
     for (int i = 0; i <= 5; i++) {
         int y = chartY + (chartHeight * i / 5);
-        tft.drawLine(chartX, y, chartX + chartWidth, y, gridColor);
+        canvas->drawLine(chartX, y, chartX + chartWidth, y, gridColor);
         
         // Draw value labels
         float value = (5 - i) * 0.2; // 0 to 1.0 kWh/m²
         char buffer[10];
         snprintf(buffer, sizeof(buffer), "%.1f", value);
-        tft.setTextDatum(MR_DATUM);
-        tft.drawString(buffer, chartX - 5, y);
+        canvas->setTextDatum(MR_DATUM);
+        canvas->drawString(buffer, chartX - 5, y);
     }
     
-    tft.setTextDatum(TL_DATUM);
+    canvas->setTextDatum(TL_DATUM);
 }
 
 void Display::drawTimeLabels() {
-    tft.setTextSize(1);
+    canvas->setTextSize(1);
     
     for (int hour = 0; hour < 24; hour += 3) {
         int x = chartX + hour * (barWidth + barSpacing) + barWidth / 2;
@@ -175,11 +188,11 @@ void Display::drawTimeLabels() {
         char buffer[3];
         snprintf(buffer, sizeof(buffer), "%02d", hour);
         
-        tft.setTextDatum(TC_DATUM);
-        tft.drawString(buffer, x, y);
+        canvas->setTextDatum(TC_DATUM);
+        canvas->drawString(buffer, x, y);
     }
     
-    tft.setTextDatum(TL_DATUM);
+    canvas->setTextDatum(TL_DATUM);
 }
 
 void Display::drawBar(int hour, float value, float maxValue) {
@@ -201,11 +214,13 @@ void Display::drawBar(int hour, float value, float maxValue) {
     
     // Draw bar
     if (barHeight > 0) {
-        tft.fillRect(x, y, barWidth, barHeight, color);
+        canvas->fillRect(x, y, barWidth, barHeight, color);
     }
 }
 
 void Display::showDailyForecast(const DailyForecast& forecast) {
+    TRACE_SCOPE("display.forecast");
+    
     clear();
     
     // Draw header
@@ -235,49 +250,53 @@ void Display::showDailyForecast(const DailyForecast& forecast) {
     drawTimeLabels();
     
     // Draw footer with total
-    drawFooter(forecast.totalIrradiance);
+    drawFooter(forecast);
 }
 
 void Display::showStatus(const String& time, const String& status, bool wifiConnected) {
     // Status bar at top
-    tft.fillRect(0, 0, screenWidth, 20, TFT_DARKGREY);
+    canvas->fillRect(0, 0, screenWidth, 20, TFT_DARKGREY);
     
-    tft.setTextSize(1);
-    tft.setTextColor(TFT_WHITE, TFT_DARKGREY);
-    tft.setTextDatum(TL_DATUM);
+    canvas->setTextSize(1);
+    canvas->setTextColor(TFT_WHITE, TFT_DARKGREY);
+    canvas->setTextDatum(TL_DATUM);
     
     // Time on left
-    tft.drawString(time, 5, 5);
+    canvas->drawString(time, 5, 5);
     
     // WiFi status on right
-    tft.setTextDatum(TR_DATUM);
+    canvas->setTextDatum(TR_DATUM);
     if (wifiConnected) {
-        tft.setTextColor(TFT_GREEN, TFT_DARKGREY);
-        tft.drawString("WiFi OK", screenWidth - 5, 5);
+        canvas->setTextColor(TFT_GREEN, TFT_DARKGREY);
+        canvas->drawString("WiFi OK", screenWidth - 5, 5);
     } else {
-        tft.setTextColor(TFT_RED, TFT_DARKGREY);
-        tft.drawString("No WiFi", screenWidth - 5, 5);
+        canvas->setTextColor(TFT_RED, TFT_DARKGREY);
+        canvas->drawString("No WiFi", screenWidth - 5, 5);
     }
     
     // Status in center
-    tft.setTextDatum(TC_DATUM);
-    tft.setTextColor(TFT_WHITE, TFT_DARKGREY);
-    tft.drawString(status, screenWidth / 2, 5);
+    canvas->setTextDatum(TC_DATUM);
+    canvas->setTextColor(TFT_WHITE, TFT_DARKGREY);
+    canvas->drawString(status, screenWidth / 2, 5);
     
     // Reset
-    tft.setTextDatum(TL_DATUM);
-    tft.setTextColor(textColor, bgColor);
+    canvas->setTextDatum(TL_DATUM);
+    canvas->setTextColor(textColor, bgColor);
 }
 
 void Display::updateHourBar(int hour, float value, float maxValue) {
     // Clear previous bar area
     int x = chartX + hour * (barWidth + barSpacing);
-    tft.fillRect(x, chartY, barWidth, chartHeight, bgColor);
+    canvas->fillRect(x, chartY, barWidth, chartHeight, bgColor);
     
     // Draw new bar
     drawBar(hour, value, maxValue);
 }
 
+void Display::setCanvas(TFT_eSPI* target) {
+    canvas = target ? target : &tft;
+}
+
 void Display::setBrightness(uint8_t brightness) {
     if (!initialized) return;
 
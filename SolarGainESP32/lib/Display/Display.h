@@ -9,6 +9,7 @@
 class Display {
 private:
     TFT_eSPI tft;
+    TFT_eSPI* canvas; // drawing target: the panel itself or an off-screen sprite
     int screenWidth;
     int screenHeight;
     bool initialized;
@@ -30,7 +31,7 @@ private:
     
     // Draw helper functions
     void drawHeader(const String& title, const String& date);
-    void drawFooter(float totalIrradiance);
+    void drawFooter(const DailyForecast& forecast);
     void drawGrid();
     void drawBar(int hour, float value, float maxValue);
     void drawTimeLabels();
@@ -62,6 +63,16 @@ public:
     // Update single hour bar
     void updateHourBar(int hour, float value, float maxValue);
     
+    // Redirect drawing to an off-screen target such as a sprite (nullptr restores the panel)
+    void setCanvas(TFT_eSPI* target);
+    
+    // Access the panel driver for direct pixel pushes
+    TFT_eSPI& getTFT() { return tft; }
+    
+    // Screen dimensions (valid after begin)
+    int getWidth() { return screenWidth; }
+    int getHeight() { return screenHeight; }
+    
     // Set display brightness (0-255)
     void setBrightness(uint8_t brightness);
     
@@ -0,0 +1,56 @@
+#include "EpochTime.h"
+
+// Both directions count from 0000-03-01 so the leap day falls at the end of
+// the year; 719468 is the day number of that date relative to 1970-01-01.
+
+int64_t EpochTime::daysFromCivil(int year, int month, int day) {
+    int64_t y = (int64_t)year - (month <= 2);
+    int64_t era = floorDiv(y, 400);
+    int64_t yoe = y - era * 400;
+    int64_t mp = month > 2 ? month - 3 : month + 9;
+    int64_t doy = (153 * mp + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void EpochTime::civilFromDays(int64_t days, int& year, int& month, int& day) {
+    int64_t z = days + 719468;
+    int64_t era = floorDiv(z, 146097);
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    year = (int)(yoe + era * 400 + (month <= 2));
+}
+
+uint16_t EpochTime::dayOfYear(int year, int month, int day) {
+    // Days before each month in a common year
+    static const uint16_t before[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    uint16_t n = before[(month - 1) % 12] + day;
+    if (month > 2 && isLeapYear(year)) n++;
+    return n;
+}
+
+time_t EpochTime::fromCivil(int year, int month, int day, int hour, int minute, int second) {
+    return (time_t)(daysFromCivil(year, month, day) * SECONDS_PER_DAY + hour * 3600L + minute * 60L + second);
+}
+
+UtcFields EpochTime::split(time_t t) {
+    UtcFields f;
+    f.dayNumber = floorDiv(t, SECONDS_PER_DAY);
+    f.secondOfDay = (uint32_t)((int64_t)t - f.dayNumber * SECONDS_PER_DAY);
+
+    int month, day;
+    civilFromDays(f.dayNumber, f.year, month, day);
+    f.month = (uint8_t)month;
+    f.day = (uint8_t)day;
+    f.dayOfYear = dayOfYear(f.year, month, day);
+
+    f.hour = (uint8_t)(f.secondOfDay / 3600);
+    f.minute = (uint8_t)(f.secondOfDay / 60 % 60);
+    f.second = (uint8_t)(f.secondOfDay % 60);
+    f.utcHours = f.secondOfDay / 3600.0f;
+    return f;
+}
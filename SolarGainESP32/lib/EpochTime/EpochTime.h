@@ -0,0 +1,54 @@
+#ifndef EPOCH_TIME_H
+#define EPOCH_TIME_H
+
+#include <Arduino.h>
+
+#define SECONDS_PER_DAY 86400L
+
+// A UTC instant taken apart. Everything is integer, so it is exact for any
+// time_t; only utcHours is a float, and it is built from the integer
+// second of the day so it never loses the date.
+struct UtcFields {
+    int64_t dayNumber;       // days since 1970-01-01
+    int year;
+    uint8_t month;           // 1-12
+    uint8_t day;             // 1-31
+    uint16_t dayOfYear;      // 1-366
+    uint32_t secondOfDay;    // 0-86399
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    float utcHours;          // secondOfDay / 3600
+};
+
+// Calendar arithmetic on UTC seconds since the epoch, proleptic Gregorian.
+// No TimeLib: nothing here depends on the clock being set.
+class EpochTime {
+public:
+    // Division rounding towards negative infinity, for instants before 1970
+    static int64_t floorDiv(int64_t a, int64_t b) {
+        int64_t q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    static bool isLeapYear(int year) {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+    static uint16_t daysInYear(int year) { return isLeapYear(year) ? 366 : 365; }
+
+    // Days since 1970-01-01 of a civil date, and back
+    static int64_t daysFromCivil(int year, int month, int day);
+    static void civilFromDays(int64_t days, int& year, int& month, int& day);
+
+    // 1-based day of the year
+    static uint16_t dayOfYear(int year, int month, int day);
+
+    static time_t fromCivil(int year, int month, int day, int hour = 0, int minute = 0, int second = 0);
+    static UtcFields split(time_t t);
+
+    // Start of the UTC day containing t
+    static time_t startOfDay(time_t t) { return (time_t)(floorDiv(t, SECONDS_PER_DAY) * SECONDS_PER_DAY); }
+};
+
+#endif // EPOCH_TIME_H
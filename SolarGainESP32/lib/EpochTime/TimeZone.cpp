@@ -0,0 +1,294 @@
+#include "TimeZone.h"
+
+TimeZone::TimeZone() {
+    setFixed(0);
+}
+
+void TimeZone::setFixed(int32_t offsetS) {
+    stdOffset = dstOffset = offsetS;
+    hasDst = false;
+    count = 0;
+    offsetBefore = offsetS;
+    tableStart = tableEnd = 0;
+    hint.store(0);
+
+    if (offsetS == 0) {
+        strcpy(stdName, "UTC");
+    } else {
+        int32_t magnitude = offsetS < 0 ? -offsetS : offsetS;
+        snprintf(stdName, sizeof(stdName), "%c%02ld%02ld", offsetS < 0 ? '-' : '+',
+                 (long)(magnitude / 3600 % 100), (long)(magnitude / 60 % 60));
+    }
+    strcpy(dstName, stdName);
+}
+
+bool TimeZone::parseName(const char*& p, char* name) {
+    const char* start = p;
+    uint8_t length = 0;
+    if (*p == '<') {
+        // Quoted form allows digits and signs: <+0545>
+        start = ++p;
+        while (*p && *p != '>') p++;
+        if (*p != '>') return false;
+        length = p - start;
+        p++;
+    } else {
+        while (isalpha((unsigned char)*p)) p++;
+        length = p - start;
+    }
+    if (length < 3 || length > TZ_NAME_LENGTH) return false;
+    memcpy(name, start, length);
+    name[length] = '\0';
+    return true;
+}
+
+bool TimeZone::parseOffset(const char*& p, int32_t& seconds, int maxHours) {
+    int sign = 1;
+    if (*p == '+' || *p == '-') {
+        if (*p == '-') sign = -1;
+        p++;
+    }
+    if (!isdigit((unsigned char)*p)) return false;
+
+    // hh[:mm[:ss]]
+    int32_t parts[3] = {0, 0, 0};
+    for (uint8_t i = 0; i < 3; i++) {
+        if (i > 0) {
+            if (*p != ':') break;
+            p++;
+            if (!isdigit((unsigned char)*p)) return false;
+        }
+        while (isdigit((unsigned char)*p)) {
+            parts[i] = parts[i] * 10 + (*p - '0');
+            if (parts[i] > 999) return false;
+            p++;
+        }
+    }
+    if (parts[0] > maxHours || parts[1] > 59 || parts[2] > 59) return false;
+    seconds = sign * (parts[0] * 3600 + parts[1] * 60 + parts[2]);
+    return true;
+}
+
+bool TimeZone::parseRuleDate(const char*& p, TzRuleDate& date) {
+    memset(&date, 0, sizeof(date));
+    if (*p == 'M') {
+        p++;
+        int values[3];
+        for (uint8_t i = 0; i < 3; i++) {
+            if (i > 0) {
+                if (*p != '.') return false;
+                p++;
+            }
+            if (!isdigit((unsigned char)*p)) return false;
+            values[i] = 0;
+            while (isdigit((unsigned char)*p)) values[i] = values[i] * 10 + (*p++ - '0');
+        }
+        if (values[0] < 1 || values[0] > 12 || values[1] < 1 || values[1] > 5 || values[2] > 6) return false;
+        date.kind = TzRuleDate::MONTH_WEEK_DAY;
+        date.month = values[0];
+        date.week = values[1];
+        date.weekday = values[2];
+    } else {
+        date.kind = TzRuleDate::JULIAN_ZERO;
+        if (*p == 'J') {
+            date.kind = TzRuleDate::JULIAN_NO_LEAP;
+            p++;
+        }
+        if (!isdigit((unsigned char)*p)) return false;
+        int n = 0;
+        while (isdigit((unsigned char)*p)) {
+            n = n * 10 + (*p++ - '0');
+            if (n > 365) return false;
+        }
+        if (date.kind == TzRuleDate::JULIAN_NO_LEAP && n < 1) return false;
+        date.day = n;
+    }
+
+    // Changes happen at 02:00 local unless given; RFC 8536 allows -167 to 167 hours
+    date.timeS = 2 * 3600;
+    if (*p == '/') {
+        p++;
+        if (!parseOffset(p, date.timeS, 167)) return false;
+    }
+    return true;
+}
+
+bool TimeZone::begin(const char* posixTz, int firstYear) {
+    setFixed(0);
+    if (!posixTz) return false;
+
+    TimeZone parsed;
+    const char* p = posixTz;
+    int32_t offset;
+    if (!parseName(p, parsed.stdName) || !parseOffset(p, offset, 24)) return false;
+    parsed.stdOffset = parsed.dstOffset = -offset;
+    strcpy(parsed.dstName, parsed.stdName);
+
+    if (*p) {
+        if (!parseName(p, parsed.dstName)) return false;
+        parsed.hasDst = true;
+        parsed.dstOffset = parsed.stdOffset + 3600;
+        if (*p && *p != ',') {
+            if (!parseOffset(p, offset, 24)) return false;
+            parsed.dstOffset = -offset;
+        }
+
+        if (*p == ',') {
+            p++;
+            if (!parseRuleDate(p, parsed.dstStart) || *p++ != ',' || !parseRuleDate(p, parsed.dstEnd)) {
+                return false;
+            }
+        } else {
+            // No rule given: the US rule, as glibc assumes
+            const char* defaults = "M3.2.0,M11.1.0";
+            parseRuleDate(defaults, parsed.dstStart);
+            defaults++;
+            parseRuleDate(defaults, parsed.dstEnd);
+        }
+    }
+    if (*p) return false;
+
+    *this = parsed;
+    if (!hasDst) return true;
+
+    // Compile the table; each rule year gives two changes, sorted as they happen
+    if (firstYear <= 0) firstYear = buildYear();
+    time_t when[2];
+    int32_t offsets[2];
+    transitionsIn(firstYear - 1, when, offsets);
+    offsetBefore = offsets[1];
+    for (int year = firstYear; year < firstYear + TZ_TABLE_YEARS; year++) {
+        uint8_t n = transitionsIn(year, when, offsets);
+        for (uint8_t i = 0; i < n; i++) {
+            at[count] = when[i];
+            offsetAfter[count] = offsets[i];
+            count++;
+        }
+    }
+    tableStart = EpochTime::fromCivil(firstYear, 1, 1);
+    tableEnd = EpochTime::fromCivil(firstYear + TZ_TABLE_YEARS, 1, 1);
+    hint.store(0);
+    return true;
+}
+
+time_t TimeZone::ruleDateUtc(int year, const TzRuleDate& date, int32_t offsetInForce) const {
+    int64_t days = EpochTime::daysFromCivil(year, 1, 1);
+    switch (date.kind) {
+        case TzRuleDate::JULIAN_NO_LEAP:
+            days += date.day - 1 + (date.day >= 60 && EpochTime::isLeapYear(year));
+            break;
+        case TzRuleDate::JULIAN_ZERO:
+            days += date.day;
+            break;
+        case TzRuleDate::MONTH_WEEK_DAY: {
+            int64_t first = EpochTime::daysFromCivil(year, date.month, 1);
+            int64_t next = date.month == 12 ? EpochTime::daysFromCivil(year + 1, 1, 1)
+                                            : EpochTime::daysFromCivil(year, date.month + 1, 1);
+            // 1970-01-01 was a Thursday
+            int64_t firstWeekday = ((first + 4) % 7 + 7) % 7;
+            days = first + (date.weekday - firstWeekday + 7) % 7 + (date.week - 1) * 7;
+            while (days >= next) days -= 7;
+            break;
+        }
+    }
+    return (time_t)(days * SECONDS_PER_DAY + date.timeS - offsetInForce);
+}
+
+uint8_t TimeZone::transitionsIn(int year, time_t* when, int32_t* offsets) const {
+    time_t start = ruleDateUtc(year, dstStart, stdOffset);
+    time_t end = ruleDateUtc(year, dstEnd, dstOffset);
+
+    // Southern hemisphere rules end daylight saving before they start it
+    if (start <= end) {
+        when[0] = start; offsets[0] = dstOffset;
+        when[1] = end;   offsets[1] = stdOffset;
+    } else {
+        when[0] = end;   offsets[0] = stdOffset;
+        when[1] = start; offsets[1] = dstOffset;
+    }
+    return 2;
+}
+
+int32_t TimeZone::ruleOffsetAt(time_t utc) const {
+    int year = EpochTime::split(utc + stdOffset).year;
+
+    // The latest change at or before utc, from the neighbouring rule years
+    time_t when[2];
+    int32_t offsets[2];
+    transitionsIn(year - 1, when, offsets);
+    time_t latest = when[1];
+    int32_t offset = offsets[1];
+    for (int y = year; y <= year + 1; y++) {
+        transitionsIn(y, when, offsets);
+        for (uint8_t i = 0; i < 2; i++) {
+            if (when[i] <= utc && when[i] >= latest) {
+                latest = when[i];
+                offset = offsets[i];
+            }
+        }
+    }
+    return offset;
+}
+
+int32_t TimeZone::offsetAt(time_t utc) const {
+    if (!hasDst) return stdOffset;
+    if (utc < tableStart || utc >= tableEnd) return ruleOffsetAt(utc);
+
+    // Interval i runs from at[i - 1] to at[i]; a clock stays in one for months
+    uint8_t i = hint.load();
+    if (i <= count && (i == 0 || at[i - 1] <= utc) && (i == count || utc < at[i])) {
+        return i == 0 ? offsetBefore : offsetAfter[i - 1];
+    }
+
+    // Count of transitions at or before utc
+    uint8_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint8_t mid = (lo + hi) / 2;
+        if (at[mid] <= utc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    hint.store(lo);
+    return lo == 0 ? offsetBefore : offsetAfter[lo - 1];
+}
+
+time_t TimeZone::toUtc(time_t local) const {
+    if (!hasDst) return local - stdOffset;
+
+    time_t asStd = local - stdOffset;
+    time_t asDst = local - dstOffset;
+    bool stdFits = offsetAt(asStd) == stdOffset;
+    bool dstFits = offsetAt(asDst) == dstOffset;
+
+    if (stdFits && dstFits) return min(asStd, asDst);
+    if (stdFits) return asStd;
+    if (dstFits) return asDst;
+
+    // Skipped wall time: read it with the offset in force before the change
+    time_t earlier = min(asStd, asDst);
+    return local - offsetAt(earlier);
+}
+
+String TimeZone::posixForOffset(int32_t offsetS) {
+    int32_t magnitude = offsetS < 0 ? -offsetS : offsetS;
+    long hours = magnitude / 3600;
+    long minutes = magnitude / 60 % 60;
+
+    // POSIX counts west of UTC as positive
+    char tz[24];
+    if (minutes) {
+        snprintf(tz, sizeof(tz), "<%c%02ld%02ld>%s%ld:%02ld", offsetS < 0 ? '-' : '+', hours, minutes,
+                 offsetS > 0 ? "-" : "", hours, minutes);
+    } else {
+        snprintf(tz, sizeof(tz), "<%c%02ld>%s%ld", offsetS < 0 ? '-' : '+', hours,
+                 offsetS > 0 ? "-" : "", hours);
+    }
+    return String(tz);
+}
+
+int TimeZone::buildYear() {
+    // __DATE__ is "Mmm dd yyyy"
+    return atoi(__DATE__ + 7);
+}
@@ -0,0 +1,121 @@
+#ifndef TIME_ZONE_H
+#define TIME_ZONE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "EpochTime.h"
+
+// Years of transitions compiled into the table
+#ifndef TZ_TABLE_YEARS
+#define TZ_TABLE_YEARS 10
+#endif
+
+#define TZ_MAX_TRANSITIONS (TZ_TABLE_YEARS * 2 + 2)
+#define TZ_NAME_LENGTH 7
+
+// One end of a POSIX daylight-saving rule
+struct TzRuleDate {
+    enum Kind : uint8_t {
+        JULIAN_NO_LEAP,     // Jn: 1-365, February 29 never counted
+        JULIAN_ZERO,        // n: 0-365, leap days counted
+        MONTH_WEEK_DAY      // Mm.w.d: day d (0 = Sunday) of week w (5 = last) of month m
+    };
+    Kind kind;
+    uint8_t month;
+    uint8_t week;
+    uint8_t weekday;
+    uint16_t day;
+    int32_t timeS;          // local wall time of the change, seconds (may be negative or past 24h)
+};
+
+// The interval offsetAt() last found. One zone is read from several tasks at
+// once, so the hint is atomic; relaxed is enough, as any value in range is
+// only a guess that offsetAt() checks. Copies take the value, so the zone
+// itself stays copyable.
+class TzHint {
+private:
+    std::atomic<uint8_t> value;
+
+public:
+    TzHint() : value(0) {}
+    TzHint(const TzHint& other) : value(other.load()) {}
+    TzHint& operator=(const TzHint& other) {
+        store(other.load());
+        return *this;
+    }
+    uint8_t load() const { return value.load(std::memory_order_relaxed); }
+    void store(uint8_t index) { value.store(index, std::memory_order_relaxed); }
+};
+
+// A POSIX TZ string ("CAT-2", "IST-5:30", "CET-1CEST,M3.5.0,M10.5.0/3")
+// compiled into a sorted table of UTC transition instants. Conversions inside
+// the table are a binary search, or O(1) when the instant is in the same
+// interval as the previous lookup, as it is for a clock. Instants outside
+// the table fall back to evaluating the rule for their year.
+//
+// Offsets are seconds east of UTC, the opposite sign to the TZ string.
+class TimeZone {
+private:
+    char stdName[TZ_NAME_LENGTH + 1];
+    char dstName[TZ_NAME_LENGTH + 1];
+    int32_t stdOffset;
+    int32_t dstOffset;
+    bool hasDst;
+    TzRuleDate dstStart;
+    TzRuleDate dstEnd;
+
+    // Transitions from tableStart to tableEnd; offsetAfter[i] applies from at[i]
+    time_t at[TZ_MAX_TRANSITIONS];
+    int32_t offsetAfter[TZ_MAX_TRANSITIONS];
+    uint8_t count;
+    int32_t offsetBefore;
+    time_t tableStart;
+    time_t tableEnd;
+    mutable TzHint hint;    // last interval found; a stale value only costs a search
+
+    static bool parseName(const char*& p, char* name);
+    static bool parseOffset(const char*& p, int32_t& seconds, int maxHours);
+    static bool parseRuleDate(const char*& p, TzRuleDate& date);
+
+    // The two changes in a UTC year, in the order they happen
+    uint8_t transitionsIn(int year, time_t* when, int32_t* offsets) const;
+    time_t ruleDateUtc(int year, const TzRuleDate& date, int32_t offsetInForce) const;
+    int32_t ruleOffsetAt(time_t utc) const;
+
+public:
+    TimeZone();
+
+    // Compile a POSIX TZ string for TZ_TABLE_YEARS years from firstYear (the
+    // build year by default). Returns false and leaves UTC on a parse error.
+    bool begin(const char* posixTz, int firstYear = 0);
+
+    // A fixed offset with no daylight saving
+    void setFixed(int32_t offsetS);
+
+    // Seconds east of UTC in force at a UTC instant
+    int32_t offsetAt(time_t utc) const;
+
+    time_t toLocal(time_t utc) const { return utc + offsetAt(utc); }
+
+    // Local wall time to UTC. A repeated wall time (clocks going back) gives
+    // the first instant; a skipped one (clocks going forward) is read with the
+    // offset from before the change, landing that far after it.
+    time_t toUtc(time_t local) const;
+
+    bool isDst(time_t utc) const { return hasDst && offsetAt(utc) == dstOffset; }
+    const char* abbreviation(time_t utc) const { return isDst(utc) ? dstName : stdName; }
+
+    int32_t getStandardOffset() const { return stdOffset; }
+    bool observesDst() const { return hasDst; }
+    uint8_t getTransitionCount() const { return count; }
+    time_t getTableStart() const { return tableStart; }
+    time_t getTableEnd() const { return tableEnd; }
+
+    // POSIX TZ string for a fixed offset, e.g. "<+0530>-5:30"
+    static String posixForOffset(int32_t offsetS);
+
+    // Year the firmware was built, from __DATE__
+    static int buildYear();
+};
+
+#endif // TIME_ZONE_H
@@ -0,0 +1,125 @@
+#include "ForecastCache.h"
+#include <utility>
+#include "../Trace/Trace.h"
+
+ForecastCache::ForecastCache() : latitude(0), longitude(0), generation(0) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void ForecastCache::setLocation(const String& name, float lat, float lon) {
+    locationName = name;
+    latitude = lat;
+    longitude = lon;
+}
+
+void ForecastCache::writeJsonString(String& out, const String& text) {
+    out += '"';
+    for (unsigned int i = 0; i < text.length(); i++) {
+        char c = text[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((uint8_t)c < 0x20) {
+            char escaped[7];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (uint8_t)c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void ForecastCache::appendClock(String& out, float hours) {
+    if (hours < 0 || hours >= 24) {
+        out += "null";
+        return;
+    }
+    int minutes = (int)(hours * 60 + 0.5f);
+    char clock[12];
+    snprintf(clock, sizeof(clock), "\"%02d:%02d\"", minutes / 60 % 24, minutes % 60);
+    out += clock;
+}
+
+void ForecastCache::publish(int year, int month, int day, const DailyForecast& forecast,
+                            float sunrise, float sunset, bool isToday) {
+    TRACE_SCOPE("api.publish");
+
+    std::shared_ptr<CachedBody> body = std::make_shared<CachedBody>();
+    body->year = year;
+    body->month = month;
+    body->day = day;
+    body->totalIrradiance = forecast.totalIrradiance;
+    body->publishedAt = millis();
+
+    String& json = body->json;
+    json.reserve(384 + forecast.hourlyData.size() * 8);
+
+    char number[48];
+    snprintf(number, sizeof(number), "{\"date\":\"%04d-%02d-%02d\",\"location\":", year, month, day);
+    json += number;
+    writeJsonString(json, locationName);
+    snprintf(number, sizeof(number), ",\"latitude\":%.4f,\"longitude\":%.4f", latitude, longitude);
+    json += number;
+    snprintf(number, sizeof(number), ",\"total_kwh_m2\":%.3f,\"sunrise\":", forecast.totalIrradiance);
+    json += number;
+    appendClock(json, sunrise);
+    json += ",\"sunset\":";
+    appendClock(json, sunset);
+    json += ",\"hourly_kwh_m2\":[";
+    for (size_t i = 0; i < forecast.hourlyData.size(); i++) {
+        snprintf(number, sizeof(number), i ? ",%.3f" : "%.3f", forecast.hourlyData[i].irradiance);
+        json += number;
+    }
+    json += "]}";
+
+    uint32_t hash = 2166136261u;
+    for (unsigned int i = 0; i < json.length(); i++) {
+        hash ^= (uint8_t)json[i];
+        hash *= 16777619u;
+    }
+    snprintf(body->etag, sizeof(body->etag), "\"%08lx\"", (unsigned long)hash);
+
+    // Replace the same date, else the oldest entry. The bodies replaced are
+    // swapped out and released after the lock: freeing a String's buffer
+    // with interrupts masked is not allowed.
+    CachedBodyRef replacedDay = body;
+    CachedBodyRef replacedToday;
+    if (isToday) replacedToday = body;
+    portENTER_CRITICAL(&lock);
+    int slot = 0;
+    for (int i = 0; i < FORECAST_CACHE_DAYS; i++) {
+        const CachedBodyRef& entry = days[i];
+        if (entry && entry->year == year && entry->month == month && entry->day == day) {
+            slot = i;
+            break;
+        }
+        if (!entry || (days[slot] && entry->publishedAt < days[slot]->publishedAt)) {
+            slot = i;
+        }
+    }
+    std::swap(days[slot], replacedDay);
+    if (isToday) std::swap(today, replacedToday);
+    generation++;
+    portEXIT_CRITICAL(&lock);
+}
+
+CachedBodyRef ForecastCache::getToday() {
+    portENTER_CRITICAL(&lock);
+    CachedBodyRef ref = today;
+    portEXIT_CRITICAL(&lock);
+    return ref;
+}
+
+CachedBodyRef ForecastCache::getDay(int year, int month, int day) {
+    CachedBodyRef ref;
+    portENTER_CRITICAL(&lock);
+    for (int i = 0; i < FORECAST_CACHE_DAYS; i++) {
+        if (days[i] && days[i]->year == year && days[i]->month == month && days[i]->day == day) {
+            ref = days[i];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+    return ref;
+}
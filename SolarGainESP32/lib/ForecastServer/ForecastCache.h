@@ -0,0 +1,62 @@
+#ifndef FORECAST_CACHE_H
+#define FORECAST_CACHE_H
+
+#include <Arduino.h>
+#include <memory>
+#include <freertos/FreeRTOS.h>
+#include "../SolarCalc/SolarCalc.h"
+
+// Days kept for /forecast?date= (today plus look-ahead)
+#ifndef FORECAST_CACHE_DAYS
+#define FORECAST_CACHE_DAYS 7
+#endif
+
+// One fully serialized response body. Immutable once published, so the server
+// can keep sending it while a newer forecast replaces it in the cache.
+struct CachedBody {
+    String json;
+    char etag[12];          // quoted FNV-1a of the body, e.g. "\"1a2b3c4d\""
+    int year;
+    int month;
+    int day;
+    float totalIrradiance;
+    uint32_t publishedAt;   // millis()
+};
+
+typedef std::shared_ptr<const CachedBody> CachedBodyRef;
+
+// Forecast JSON rendered once per recompute and shared by every request
+class ForecastCache {
+private:
+    CachedBodyRef days[FORECAST_CACHE_DAYS];
+    CachedBodyRef today;
+    String locationName;
+    float latitude;
+    float longitude;
+    uint32_t generation;
+    portMUX_TYPE lock;
+
+    static void writeJsonString(String& out, const String& text);
+    static void appendClock(String& out, float hours);
+
+public:
+    ForecastCache();
+
+    void setLocation(const String& name, float lat, float lon);
+
+    // Serialize a forecast and make it the answer for its date. sunrise and
+    // sunset are in local decimal hours (negative when the sun does not rise/set).
+    void publish(int year, int month, int day, const DailyForecast& forecast,
+                 float sunrise, float sunset, bool isToday);
+
+    // Current forecast, or nullptr before the first publish
+    CachedBodyRef getToday();
+
+    // Forecast for a date, or nullptr if it is not cached
+    CachedBodyRef getDay(int year, int month, int day);
+
+    // Bumped on every publish
+    uint32_t getGeneration() { return generation; }
+};
+
+#endif // FORECAST_CACHE_H
@@ -0,0 +1,509 @@
+#include "ForecastServer.h"
+#include "../Trace/Trace.h"
+#include <errno.h>
+
+#ifdef HOST_BUILD
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <lwip/sockets.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+const uint32_t ForecastServer::LATENCY_BOUNDS_US[FORECAST_SERVER_LATENCY_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 50000
+};
+
+ForecastServer::ForecastServer(ForecastCache& cache, uint16_t port)
+    : cache(cache), port(port), listenFd(-1), taskHandle(nullptr), running(false) {
+    statsLock = portMUX_INITIALIZER_UNLOCKED;
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < FORECAST_SERVER_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+}
+
+ForecastServer::~ForecastServer() {
+    stop();
+}
+
+bool ForecastServer::begin() {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        Serial.println("Forecast server: socket failed");
+        return false;
+    }
+
+    int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listenFd, FORECAST_SERVER_MAX_CLIENTS) < 0) {
+        Serial.println("Forecast server: cannot listen on port " + String(port));
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL, 0) | O_NONBLOCK);
+
+    socklen_t length = sizeof(addr);
+    if (getsockname(listenFd, (struct sockaddr*)&addr, &length) == 0) {
+        port = ntohs(addr.sin_port);
+    }
+    running = true;
+
+    Serial.println("Forecast API listening on port " + String(port));
+    return true;
+}
+
+bool ForecastServer::startTask() {
+    if (listenFd < 0) return false;
+    if (taskHandle) return true;
+
+    BaseType_t result = xTaskCreatePinnedToCore(taskMain, "httpd", FORECAST_SERVER_TASK_STACK, this,
+                                                FORECAST_SERVER_TASK_PRIORITY, &taskHandle,
+                                                FORECAST_SERVER_TASK_CORE);
+    if (result != pdPASS) {
+        taskHandle = nullptr;
+        Serial.println("Failed to start forecast server task");
+        return false;
+    }
+    return true;
+}
+
+void ForecastServer::taskMain(void* arg) {
+    ForecastServer* server = static_cast<ForecastServer*>(arg);
+    while (server->running) {
+        server->poll(1000);
+    }
+    server->taskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void ForecastServer::stop() {
+    running = false;
+    // Let the task finish its current poll before the sockets go away
+    while (taskHandle) {
+        delay(10);
+    }
+    for (int i = 0; i < FORECAST_SERVER_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) closeClient(clients[i]);
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+void ForecastServer::poll(uint32_t timeoutMs) {
+    if (listenFd < 0) return;
+
+    fd_set readSet, writeSet;
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+    int maxFd = -1;
+    bool slotFree = false;
+
+    for (int i = 0; i < FORECAST_SERVER_MAX_CLIENTS; i++) {
+        Connection& c = clients[i];
+        if (c.fd < 0) {
+            slotFree = true;
+            continue;
+        }
+        // A client with a response in flight is only read again once it is sent
+        FD_SET(c.fd, c.responding ? &writeSet : &readSet);
+        maxFd = max(maxFd, c.fd);
+    }
+    // With every slot busy, new clients wait in the listen backlog
+    if (slotFree) {
+        FD_SET(listenFd, &readSet);
+        maxFd = max(maxFd, listenFd);
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    int ready = select(maxFd + 1, &readSet, &writeSet, nullptr, &timeout);
+    if (ready < 0) return;
+
+    if (ready > 0 && FD_ISSET(listenFd, &readSet)) {
+        acceptClients();
+    }
+
+    uint32_t now = millis();
+    for (int i = 0; i < FORECAST_SERVER_MAX_CLIENTS; i++) {
+        Connection& c = clients[i];
+        if (c.fd < 0) continue;
+
+        if (FD_ISSET(c.fd, &readSet)) {
+            receive(c);
+        } else if (FD_ISSET(c.fd, &writeSet)) {
+            transmit(c);
+        } else if (now - c.lastActivity > FORECAST_SERVER_IDLE_TIMEOUT_MS) {
+            closeClient(c);
+        }
+    }
+}
+
+void ForecastServer::acceptClients() {
+    for (int i = 0; i < FORECAST_SERVER_MAX_CLIENTS; i++) {
+        Connection& c = clients[i];
+        if (c.fd >= 0) continue;
+
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) return;
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        // Header and body go out as two sends; do not hold the second back
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        c.fd = fd;
+        c.received = 0;
+        c.responding = false;
+        c.lastActivity = millis();
+
+        portENTER_CRITICAL(&statsLock);
+        stats.connections++;
+        stats.activeClients++;
+        portEXIT_CRITICAL(&statsLock);
+    }
+}
+
+void ForecastServer::closeClient(Connection& c) {
+    close(c.fd);
+    c.fd = -1;
+    c.cached.reset();
+    c.generated = String();
+
+    portENTER_CRITICAL(&statsLock);
+    stats.activeClients--;
+    portEXIT_CRITICAL(&statsLock);
+}
+
+void ForecastServer::receive(Connection& c) {
+    int n = recv(c.fd, c.request + c.received, sizeof(c.request) - 1 - c.received, 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        closeClient(c);
+        return;
+    }
+    if (n < 0) return;
+
+    c.received += n;
+    c.lastActivity = millis();
+    dispatch(c);
+}
+
+void ForecastServer::dispatch(Connection& c) {
+    for (size_t i = 3; i < c.received; i++) {
+        if (c.request[i - 3] == '\r' && c.request[i - 2] == '\n' &&
+            c.request[i - 1] == '\r' && c.request[i] == '\n') {
+            handleRequest(c, i - 3);
+            // Send right away; select() only gets involved if the socket is full
+            transmit(c);
+            return;
+        }
+    }
+
+    if (c.received >= sizeof(c.request) - 1) {
+        c.requestStartUs = micros();
+        c.keepAlive = false;
+        c.headOnly = false;
+        c.received = 0;
+        respond(c, 431, "text/plain", "Request header too large\n", 25);
+        transmit(c);
+    }
+}
+
+void ForecastServer::handleRequest(Connection& c, size_t headEnd) {
+    c.requestStartUs = micros();
+    size_t consumed = headEnd + 4;
+    c.request[headEnd] = '\0';
+
+    // Request line: METHOD SP target SP version
+    char* method = c.request;
+    char* lineEnd = strstr(method, "\r\n");
+    char* headers = nullptr;
+    if (lineEnd) {
+        *lineEnd = '\0';
+        headers = lineEnd + 2;
+    }
+    char* target = strchr(method, ' ');
+    char* version = target ? strchr(target + 1, ' ') : nullptr;
+
+    const char* ifNoneMatch = nullptr;
+    c.keepAlive = version && strcmp(version + 1, "HTTP/1.1") == 0;
+    while (headers && *headers) {
+        char* next = strstr(headers, "\r\n");
+        if (next) *next = '\0';
+        char* value = strchr(headers, ':');
+        if (value) {
+            *value++ = '\0';
+            while (*value == ' ') value++;
+            if (strcasecmp(headers, "If-None-Match") == 0) {
+                ifNoneMatch = value;
+            } else if (strcasecmp(headers, "Connection") == 0) {
+                c.keepAlive = strcasecmp(value, "close") != 0 &&
+                              (c.keepAlive || strcasecmp(value, "keep-alive") == 0);
+            }
+        }
+        headers = next ? next + 2 : nullptr;
+    }
+
+    if (!target || !version) {
+        c.keepAlive = false;
+        c.headOnly = false;
+        respond(c, 400, "text/plain", "Bad request\n", 12);
+    } else {
+        *target++ = '\0';
+        *version = '\0';
+        c.headOnly = strcmp(method, "HEAD") == 0;
+
+        char* query = strchr(target, '?');
+        if (query) *query++ = '\0';
+
+        if (strcmp(method, "GET") != 0 && !c.headOnly) {
+            respond(c, 405, "text/plain", "Method not allowed\n", 19);
+        } else if (strcmp(target, "/forecast") == 0) {
+            routeForecast(c, query, ifNoneMatch);
+        } else if (strcmp(target, "/health") == 0) {
+            c.generated = String();
+            renderHealth(c.generated);
+            respond(c, 200, "application/json", c.generated.c_str(), c.generated.length());
+        } else if (strcmp(target, "/metrics") == 0) {
+            c.generated = String();
+            renderMetrics(c.generated);
+            respond(c, 200, "text/plain; version=0.0.4", c.generated.c_str(), c.generated.length());
+        } else {
+            respond(c, 404, "text/plain", "Not found\n", 10);
+        }
+    }
+
+    // Keep any pipelined bytes for the next request
+    memmove(c.request, c.request + consumed, c.received - consumed);
+    c.received -= consumed;
+}
+
+void ForecastServer::routeForecast(Connection& c, const char* query, const char* ifNoneMatch) {
+    if (!query || !*query) {
+        CachedBodyRef today = cache.getToday();
+        if (!today) {
+            respond(c, 503, "text/plain", "Forecast not ready\n", 19);
+            return;
+        }
+        respondCached(c, today, ifNoneMatch);
+        return;
+    }
+
+    int year, month, day;
+    if (strncmp(query, "date=", 5) != 0 || sscanf(query + 5, "%d-%d-%d", &year, &month, &day) != 3 ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+        respond(c, 400, "text/plain", "Expected date=YYYY-MM-DD\n", 25);
+        return;
+    }
+
+    CachedBodyRef body = cache.getDay(year, month, day);
+    if (!body) {
+        respond(c, 404, "text/plain", "Date not in forecast cache\n", 27);
+        return;
+    }
+    respondCached(c, body, ifNoneMatch);
+}
+
+void ForecastServer::respondCached(Connection& c, const CachedBodyRef& body, const char* ifNoneMatch) {
+    c.cached = body;
+    if (ifNoneMatch && (strstr(ifNoneMatch, body->etag) || strcmp(ifNoneMatch, "*") == 0)) {
+        respond(c, 304, nullptr, nullptr, 0, body->etag);
+        return;
+    }
+    respond(c, 200, "application/json", body->json.c_str(), body->json.length(), body->etag);
+}
+
+void ForecastServer::respond(Connection& c, int status, const char* contentType, const char* body,
+                             size_t length, const char* etag) {
+    int n = snprintf(c.head, sizeof(c.head), "HTTP/1.1 %d %s\r\n", status, statusText(status));
+    if (contentType) {
+        n += snprintf(c.head + n, sizeof(c.head) - n, "Content-Type: %s\r\n", contentType);
+    }
+    if (status != 304) {
+        n += snprintf(c.head + n, sizeof(c.head) - n, "Content-Length: %u\r\n", (unsigned)length);
+    }
+    if (etag) {
+        n += snprintf(c.head + n, sizeof(c.head) - n, "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+    }
+    if (status == 405) {
+        n += snprintf(c.head + n, sizeof(c.head) - n, "Allow: GET, HEAD\r\n");
+    }
+    n += snprintf(c.head + n, sizeof(c.head) - n, "Connection: %s\r\n\r\n",
+                  c.keepAlive ? "keep-alive" : "close");
+
+    c.headLength = min((size_t)n, sizeof(c.head) - 1);
+    c.body = body;
+    c.bodyLength = c.headOnly ? 0 : length;
+    c.sent = 0;
+    c.responding = true;
+
+    portENTER_CRITICAL(&statsLock);
+    stats.requests++;
+    if (status == 304) stats.notModified++;
+    else if (status == 404) stats.notFound++;
+    else if (status == 400 || status == 405 || status == 431) stats.badRequests++;
+    portEXIT_CRITICAL(&statsLock);
+}
+
+void ForecastServer::transmit(Connection& c) {
+    size_t total = c.headLength + c.bodyLength;
+    while (c.sent < total) {
+        const char* data;
+        size_t length;
+        if (c.sent < c.headLength) {
+            data = c.head + c.sent;
+            length = c.headLength - c.sent;
+        } else {
+            data = c.body + (c.sent - c.headLength);
+            length = total - c.sent;
+        }
+
+        int n = send(c.fd, data, length, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) closeClient(c);
+            return;
+        }
+        c.sent += n;
+    }
+
+    recordLatency(micros() - c.requestStartUs);
+    portENTER_CRITICAL(&statsLock);
+    stats.bytesSent += total;
+    portEXIT_CRITICAL(&statsLock);
+
+    c.responding = false;
+    c.cached.reset();
+    c.lastActivity = millis();
+    if (!c.keepAlive) {
+        closeClient(c);
+        return;
+    }
+    // A pipelined request may already be waiting
+    if (c.received > 0) dispatch(c);
+}
+
+void ForecastServer::recordLatency(uint32_t us) {
+    int bucket = 0;
+    while (bucket < FORECAST_SERVER_LATENCY_BUCKETS && us > LATENCY_BOUNDS_US[bucket]) {
+        bucket++;
+    }
+    portENTER_CRITICAL(&statsLock);
+    stats.latencyBuckets[bucket]++;
+    stats.latencySumUs += us;
+    portEXIT_CRITICAL(&statsLock);
+}
+
+void ForecastServer::renderHealth(String& out) {
+    CachedBodyRef today = cache.getToday();
+    char json[160];
+    if (today) {
+        snprintf(json, sizeof(json),
+                 "{\"status\":\"ok\",\"uptime_s\":%lu,\"forecast_age_s\":%lu,\"free_heap\":%lu}",
+                 millis() / 1000UL, (millis() - today->publishedAt) / 1000UL,
+                 (unsigned long)ESP.getFreeHeap());
+    } else {
+        snprintf(json, sizeof(json),
+                 "{\"status\":\"no_forecast\",\"uptime_s\":%lu,\"forecast_age_s\":null,\"free_heap\":%lu}",
+                 millis() / 1000UL, (unsigned long)ESP.getFreeHeap());
+    }
+    out += json;
+}
+
+void ForecastServer::renderMetrics(String& out) {
+    TRACE_SCOPE("api.metrics");
+    ForecastServerStats s = getStats();
+    CachedBodyRef today = cache.getToday();
+    char line[192];
+    out.reserve(2560);
+
+    struct Counter {
+        const char* name;
+        const char* type;
+        const char* help;
+        unsigned long value;
+    };
+    const Counter counters[] = {
+        {"solargain_http_requests_total", "counter", "HTTP requests answered", s.requests},
+        {"solargain_http_not_modified_total", "counter", "304 answers to If-None-Match", s.notModified},
+        {"solargain_http_not_found_total", "counter", "404 answers", s.notFound},
+        {"solargain_http_bad_requests_total", "counter", "400, 405 and 431 answers", s.badRequests},
+        {"solargain_http_connections_total", "counter", "Accepted connections", s.connections},
+        {"solargain_http_active_connections", "gauge", "Open connections", s.activeClients},
+        {"solargain_http_sent_bytes_total", "counter", "Response bytes sent", s.bytesSent},
+        {"solargain_forecast_generation", "counter", "Forecasts published", cache.getGeneration()},
+        {"solargain_uptime_seconds", "gauge", "Seconds since boot", millis() / 1000UL},
+        {"solargain_heap_free_bytes", "gauge", "Free heap", ESP.getFreeHeap()},
+        {"solargain_heap_min_free_bytes", "gauge", "Lowest free heap since boot", ESP.getMinFreeHeap()},
+    };
+    for (const Counter& counter : counters) {
+        snprintf(line, sizeof(line), "# HELP %s %s.\n# TYPE %s %s\n%s %lu\n", counter.name, counter.help,
+                 counter.name, counter.type, counter.name, counter.value);
+        out += line;
+    }
+
+    if (today) {
+        snprintf(line, sizeof(line), "# TYPE solargain_forecast_kwh_m2 gauge\nsolargain_forecast_kwh_m2 %.3f\n",
+                 today->totalIrradiance);
+        out += line;
+        snprintf(line, sizeof(line), "# TYPE solargain_forecast_age_seconds gauge\nsolargain_forecast_age_seconds %lu\n",
+                 (millis() - today->publishedAt) / 1000UL);
+        out += line;
+    }
+
+    out += "# HELP solargain_http_request_duration_seconds Request parsed to response sent.\n"
+           "# TYPE solargain_http_request_duration_seconds histogram\n";
+    unsigned long cumulative = 0;
+    for (int i = 0; i <= FORECAST_SERVER_LATENCY_BUCKETS; i++) {
+        cumulative += s.latencyBuckets[i];
+        if (i < FORECAST_SERVER_LATENCY_BUCKETS) {
+            snprintf(line, sizeof(line), "solargain_http_request_duration_seconds_bucket{le=\"%g\"} %lu\n",
+                     LATENCY_BOUNDS_US[i] / 1e6, cumulative);
+        } else {
+            snprintf(line, sizeof(line), "solargain_http_request_duration_seconds_bucket{le=\"+Inf\"} %lu\n",
+                     cumulative);
+        }
+        out += line;
+    }
+    snprintf(line, sizeof(line), "solargain_http_request_duration_seconds_sum %.6f\n"
+             "solargain_http_request_duration_seconds_count %lu\n", s.latencySumUs / 1e6, cumulative);
+    out += line;
+}
+
+ForecastServerStats ForecastServer::getStats() {
+    portENTER_CRITICAL(&statsLock);
+    ForecastServerStats copy = stats;
+    portEXIT_CRITICAL(&statsLock);
+    return copy;
+}
+
+const char* ForecastServer::statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 431: return "Request Header Fields Too Large";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef FORECAST_SERVER_H
+#define FORECAST_SERVER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "ForecastCache.h"
+
+#ifndef FORECAST_SERVER_PORT
+#define FORECAST_SERVER_PORT 80
+#endif
+
+// Concurrent keep-alive connections; further clients wait in the listen backlog
+#ifndef FORECAST_SERVER_MAX_CLIENTS
+#define FORECAST_SERVER_MAX_CLIENTS 8
+#endif
+
+// Request line plus headers; larger requests get 431
+#ifndef FORECAST_SERVER_REQUEST_BUFFER
+#define FORECAST_SERVER_REQUEST_BUFFER 512
+#endif
+
+// Idle keep-alive connections are closed after this long
+#ifndef FORECAST_SERVER_IDLE_TIMEOUT_MS
+#define FORECAST_SERVER_IDLE_TIMEOUT_MS 5000
+#endif
+
+#ifndef FORECAST_SERVER_TASK_STACK
+#define FORECAST_SERVER_TASK_STACK 6144
+#endif
+
+#ifndef FORECAST_SERVER_TASK_PRIORITY
+#define FORECAST_SERVER_TASK_PRIORITY 1
+#endif
+
+#ifndef FORECAST_SERVER_TASK_CORE
+#define FORECAST_SERVER_TASK_CORE 0
+#endif
+
+// Upper bounds of the service-time histogram, in microseconds
+#define FORECAST_SERVER_LATENCY_BUCKETS 8
+
+struct ForecastServerStats {
+    uint32_t connections;
+    uint32_t requests;
+    uint32_t notModified;      // 304 answers to If-None-Match
+    uint32_t notFound;
+    uint32_t badRequests;      // 400, 405 and 431
+    uint32_t bytesSent;
+    uint8_t activeClients;
+    // Request parsed to last byte handed to the socket
+    uint32_t latencyBuckets[FORECAST_SERVER_LATENCY_BUCKETS + 1];   // last is +Inf
+    uint64_t latencySumUs;
+};
+
+// Non-blocking HTTP/1.1 server for the forecast API. One select() loop serves
+// every connection; /forecast answers come from ForecastCache buffers, so a
+// poll costs a header snprintf and a send, never a solar calculation.
+//
+//   GET /forecast                today's forecast (ETag, 304 on If-None-Match)
+//   GET /forecast?date=Y-M-D     a cached day, 404 when not computed
+//   GET /health                  uptime, forecast age and free heap
+//   GET /metrics                 Prometheus text format
+class ForecastServer {
+private:
+    struct Connection {
+        int fd;
+        char request[FORECAST_SERVER_REQUEST_BUFFER];
+        size_t received;
+        char head[256];
+        size_t headLength;
+        CachedBodyRef cached;      // keeps the body alive while it is sent
+        String generated;          // /health, /metrics and error bodies
+        const char* body;
+        size_t bodyLength;
+        size_t sent;               // over head + body
+        bool responding;
+        bool keepAlive;
+        bool headOnly;             // HEAD request: headers without the body
+        uint32_t lastActivity;
+        uint32_t requestStartUs;
+    };
+
+    ForecastCache& cache;
+    uint16_t port;
+    int listenFd;
+    Connection clients[FORECAST_SERVER_MAX_CLIENTS];
+    ForecastServerStats stats;
+    portMUX_TYPE statsLock;
+    TaskHandle_t taskHandle;
+    volatile bool running;
+
+    static const uint32_t LATENCY_BOUNDS_US[FORECAST_SERVER_LATENCY_BUCKETS];
+
+    static void taskMain(void* arg);
+
+    void acceptClients();
+    void closeClient(Connection& c);
+    void receive(Connection& c);
+    void transmit(Connection& c);
+
+    // Handle the next buffered request once its headers are complete
+    void dispatch(Connection& c);
+
+    // Parse a complete request in c.request and queue its response
+    void handleRequest(Connection& c, size_t headEnd);
+    void routeForecast(Connection& c, const char* query, const char* ifNoneMatch);
+    void respond(Connection& c, int status, const char* contentType, const char* body,
+                 size_t length, const char* etag = nullptr);
+    void respondCached(Connection& c, const CachedBodyRef& body, const char* ifNoneMatch);
+
+    void renderHealth(String& out);
+    void renderMetrics(String& out);
+    void recordLatency(uint32_t us);
+
+    static const char* statusText(int status);
+
+public:
+    ForecastServer(ForecastCache& cache, uint16_t port = FORECAST_SERVER_PORT);
+    ~ForecastServer();
+
+    // Open the listening socket (port 0 picks a free one, see getPort())
+    bool begin();
+
+    // Serve from a background task instead of calling poll() yourself
+    bool startTask();
+
+    // Wait up to timeoutMs for socket activity and handle it
+    void poll(uint32_t timeoutMs);
+
+    void stop();
+
+    uint16_t getPort() { return port; }
+    ForecastServerStats getStats();
+};
+
+#endif // FORECAST_SERVER_H
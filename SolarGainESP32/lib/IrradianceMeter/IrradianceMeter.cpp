@@ -0,0 +1,285 @@
+#include "IrradianceMeter.h"
+#include "IrradianceSource.h"
+#include "../EpochTime/EpochTime.h"
+#include "../Trace/Trace.h"
+
+void RunningStats::clear() {
+    count = 0;
+    mean = 0;
+    m2 = 0;
+    min = 0;
+    max = 0;
+}
+
+void RunningStats::add(float value) {
+    count++;
+    if (count == 1) {
+        mean = value;
+        m2 = 0;
+        min = value;
+        max = value;
+        return;
+    }
+    float delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+    if (value < min) min = value;
+    if (value > max) max = value;
+}
+
+void RunningStats::merge(const RunningStats& other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    uint32_t total = count + other.count;
+    float delta = other.mean - mean;
+    float share = (float)other.count / total;
+    mean += delta * share;
+    m2 += other.m2 + delta * delta * count * share;
+    count = total;
+    if (other.min < min) min = other.min;
+    if (other.max > max) max = other.max;
+}
+
+static void clearDay(MeasuredDay& day) {
+    day.year = 0;
+    day.month = 0;
+    day.day = 0;
+    for (int hour = 0; hour < 24; hour++) {
+        day.hour[hour].clear();
+        day.minutes[hour] = 0;
+    }
+}
+
+IrradianceMeter::IrradianceMeter()
+    : source(nullptr), timeZone(nullptr), historyNext(0), historyCount(0), todayNumber(INT64_MIN), consumed(0),
+      late(0), samplerHandle(nullptr), consumerHandle(nullptr), samplerDone(false),
+      stopping(false), tasksRunning(0) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    open.start = 0;
+    open.stats.clear();
+    clearDay(today);
+    clearDay(yesterday);
+}
+
+bool IrradianceMeter::startTasks(BaseType_t core, UBaseType_t priority) {
+    stopping = false;
+    if (!consumerHandle) {
+        tasksRunning++;
+        // The consumer one step below the sampler, so sampling is never held up by it
+        BaseType_t result = xTaskCreatePinnedToCore(consumerMain, "irrmeter", IRRADIANCE_TASK_STACK, this,
+                                                    priority > 1 ? priority - 1 : priority, &consumerHandle, core);
+        if (result != pdPASS) {
+            tasksRunning--;
+            consumerHandle = nullptr;
+            Serial.println("Failed to start irradiance consumer task");
+            return false;
+        }
+    }
+    if (source && !samplerHandle && !samplerDone) {
+        tasksRunning++;
+        BaseType_t result = xTaskCreatePinnedToCore(samplerMain, "irrsample", IRRADIANCE_TASK_STACK, this,
+                                                    priority, &samplerHandle, core);
+        if (result != pdPASS) {
+            tasksRunning--;
+            samplerHandle = nullptr;
+            Serial.println("Failed to start irradiance sampling task");
+            return false;
+        }
+    }
+    return true;
+}
+
+void IrradianceMeter::samplerMain(void* arg) {
+    IrradianceMeter* meter = static_cast<IrradianceMeter*>(arg);
+    while (!meter->stopping) {
+        size_t pushed = meter->pump();
+        if (meter->source->finished()) break;
+
+        // Wake the consumer once a quarter of the ring is waiting
+        TaskHandle_t consumer = meter->consumerHandle;
+        if (consumer && meter->ring.size() >= IRRADIANCE_RING_SIZE / 4) xTaskNotifyGive(consumer);
+
+        // A burst was taken: yield and carry on; nothing was ready: wait a tick
+        vTaskDelay(pushed ? 0 : 1);
+    }
+    TaskHandle_t consumer = meter->consumerHandle;
+    if (consumer) xTaskNotifyGive(consumer);
+    meter->samplerHandle = nullptr;
+    meter->tasksRunning--;
+    vTaskDelete(nullptr);
+}
+
+void IrradianceMeter::consumerMain(void* arg) {
+    IrradianceMeter* meter = static_cast<IrradianceMeter*>(arg);
+    while (!meter->stopping) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IRRADIANCE_CONSUMER_WAIT_MS));
+        meter->process();
+    }
+    meter->consumerHandle = nullptr;
+    meter->tasksRunning--;
+    vTaskDelete(nullptr);
+}
+
+void IrradianceMeter::stopTasks() {
+    if (tasksRunning == 0) return;
+    stopping = true;
+    TaskHandle_t consumer = consumerHandle;
+    if (consumer) xTaskNotifyGive(consumer);
+    while (tasksRunning > 0) {
+        vTaskDelay(1);
+    }
+}
+
+size_t IrradianceMeter::pump() {
+    if (!source) return 0;
+    size_t pushed = source->fill(ring);
+    if (source->finished()) samplerDone = true;
+    return pushed;
+}
+
+size_t IrradianceMeter::process() {
+    TRACE_SCOPE("irradiance.process");
+    IrradianceSample batch[IRRADIANCE_BATCH];
+    size_t total = 0;
+    size_t count;
+    while ((count = ring.pop(batch, IRRADIANCE_BATCH)) > 0) {
+        portENTER_CRITICAL(&lock);
+        for (size_t i = 0; i < count; i++) {
+            accept(batch[i]);
+        }
+        consumed += count;
+        portEXIT_CRITICAL(&lock);
+        total += count;
+    }
+    return total;
+}
+
+void IrradianceMeter::accept(const IrradianceSample& sample) {
+    time_t minute = (time_t)(EpochTime::floorDiv(sample.utc, 60) * 60);
+    if (open.stats.count > 0 && minute != open.start) {
+        if (minute < open.start) {
+            late++;
+            return;
+        }
+        closeMinute();
+    }
+    open.start = minute;
+    open.stats.add(sample.irradiance);
+}
+
+void IrradianceMeter::localHour(time_t utc, int64_t& dayNumber, int& hour) const {
+    time_t local = timeZone ? timeZone->toLocal(utc) : utc;
+    dayNumber = EpochTime::floorDiv(local, SECONDS_PER_DAY);
+    hour = (int)((local - dayNumber * SECONDS_PER_DAY) / 3600);
+}
+
+void IrradianceMeter::closeMinute() {
+    history[historyNext] = open;
+    historyNext = (historyNext + 1) % IRRADIANCE_MINUTE_HISTORY;
+    if (historyCount < IRRADIANCE_MINUTE_HISTORY) historyCount++;
+
+    int64_t dayNumber;
+    int hour;
+    localHour(open.start, dayNumber, hour);
+    if (dayNumber != todayNumber) {
+        // A new date; a minute from before today's start is late and only kept in history
+        if (dayNumber < todayNumber) {
+            open.stats.clear();
+            return;
+        }
+        if (dayNumber == todayNumber + 1) {
+            yesterday = today;
+        } else {
+            clearDay(yesterday);
+        }
+        clearDay(today);
+        EpochTime::civilFromDays(dayNumber, today.year, today.month, today.day);
+        todayNumber = dayNumber;
+    }
+    today.hour[hour].merge(open.stats);
+    today.minutes[hour]++;
+    open.stats.clear();
+}
+
+void IrradianceMeter::flush() {
+    portENTER_CRITICAL(&lock);
+    if (open.stats.count > 0) closeMinute();
+    portEXIT_CRITICAL(&lock);
+}
+
+MinuteStats IrradianceMeter::getOpenMinute() {
+    portENTER_CRITICAL(&lock);
+    MinuteStats minute = open;
+    portEXIT_CRITICAL(&lock);
+    return minute;
+}
+
+bool IrradianceMeter::getMinute(uint8_t ago, MinuteStats& out) {
+    portENTER_CRITICAL(&lock);
+    bool found = ago < historyCount;
+    if (found) {
+        out = history[(historyNext + IRRADIANCE_MINUTE_HISTORY - 1 - ago) % IRRADIANCE_MINUTE_HISTORY];
+    }
+    portEXIT_CRITICAL(&lock);
+    return found;
+}
+
+MeasuredDay IrradianceMeter::getToday() {
+    portENTER_CRITICAL(&lock);
+    MeasuredDay day = today;
+    MinuteStats minute = open;
+    int64_t number = todayNumber;
+    portEXIT_CRITICAL(&lock);
+
+    // The open minute as if it had closed
+    if (minute.stats.count > 0) {
+        int64_t dayNumber;
+        int hour;
+        localHour(minute.start, dayNumber, hour);
+        if (dayNumber > number) {
+            clearDay(day);
+            EpochTime::civilFromDays(dayNumber, day.year, day.month, day.day);
+        }
+        if (dayNumber >= number) {
+            day.hour[hour].merge(minute.stats);
+            day.minutes[hour]++;
+        }
+    }
+    return day;
+}
+
+MeasuredDay IrradianceMeter::getYesterday() {
+    portENTER_CRITICAL(&lock);
+    MeasuredDay day = yesterday;
+    portEXIT_CRITICAL(&lock);
+    return day;
+}
+
+DailyForecast IrradianceMeter::toForecast(const MeasuredDay& day) {
+    DailyForecast forecast;
+    forecast.totalIrradiance = 0.0;
+    forecast.date = String(day.year) + "-" + String(day.month) + "-" + String(day.day);
+    for (int hour = 0; hour < 24; hour++) {
+        HourlyIrradiance hourData;
+        hourData.hour = hour;
+        hourData.irradiance = day.hour[hour].mean * day.minutes[hour] / 60.0f / 1000.0f;
+        forecast.hourlyData.push_back(hourData);
+        forecast.totalIrradiance += hourData.irradiance;
+    }
+    return forecast;
+}
+
+IrradianceMeterStats IrradianceMeter::getStats() {
+    IrradianceMeterStats stats;
+    stats.pushed = ring.getPushed();
+    stats.dropped = ring.getDropped();
+    stats.peakDepth = ring.getPeak();
+    portENTER_CRITICAL(&lock);
+    stats.consumed = consumed;
+    stats.late = late;
+    portEXIT_CRITICAL(&lock);
+    return stats;
+}
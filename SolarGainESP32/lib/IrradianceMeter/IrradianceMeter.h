@@ -0,0 +1,233 @@
+#ifndef IRRADIANCE_METER_H
+#define IRRADIANCE_METER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "../EpochTime/TimeZone.h"
+#include "../SolarCalc/SolarCalc.h"
+
+// Samples between the source and the consumer; a power of two. At 4 kHz
+// this is a quarter of a second of slack.
+#ifndef IRRADIANCE_RING_SIZE
+#define IRRADIANCE_RING_SIZE 1024
+#endif
+
+// Closed minutes kept for getMinute()
+#ifndef IRRADIANCE_MINUTE_HISTORY
+#define IRRADIANCE_MINUTE_HISTORY 60
+#endif
+
+// Samples folded in per lock taken by the consumer
+#ifndef IRRADIANCE_BATCH
+#define IRRADIANCE_BATCH 64
+#endif
+
+// The consumer drains the ring at least this often without a wake-up
+#ifndef IRRADIANCE_CONSUMER_WAIT_MS
+#define IRRADIANCE_CONSUMER_WAIT_MS 100
+#endif
+
+#ifndef IRRADIANCE_TASK_STACK
+#define IRRADIANCE_TASK_STACK 4096
+#endif
+
+#ifndef IRRADIANCE_TASK_PRIORITY
+#define IRRADIANCE_TASK_PRIORITY 2
+#endif
+
+// Sampling on the core the radio is not on
+#ifndef IRRADIANCE_TASK_CORE
+#define IRRADIANCE_TASK_CORE 1
+#endif
+
+struct IrradianceSample {
+    time_t utc;
+    float irradiance;     // W/m²
+};
+
+// Single-producer, single-consumer ring: the sampling task pushes, the
+// consumer pops, and neither takes a lock. Each index is written by one
+// side only; release stores publish the slots behind them.
+class SampleRing {
+private:
+    IrradianceSample slots[IRRADIANCE_RING_SIZE];
+    std::atomic<uint32_t> head;     // next slot to write, producer only
+    std::atomic<uint32_t> tail;     // next slot to read, consumer only
+    std::atomic<uint32_t> dropped;  // pushes refused because the ring was full
+    std::atomic<uint32_t> peak;     // most samples held at once
+
+public:
+    SampleRing() : head(0), tail(0), dropped(0), peak(0) {}
+
+    // Producer side; false and counted as dropped when full
+    bool push(const IrradianceSample& sample) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t used = h - tail.load(std::memory_order_acquire);
+        if (used >= IRRADIANCE_RING_SIZE) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[h & (IRRADIANCE_RING_SIZE - 1)] = sample;
+        head.store(h + 1, std::memory_order_release);
+        if (used + 1 > peak.load(std::memory_order_relaxed)) peak.store(used + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer side; up to max samples, oldest first
+    size_t pop(IrradianceSample* out, size_t max) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t available = head.load(std::memory_order_acquire) - t;
+        size_t count = available < max ? available : max;
+        for (size_t i = 0; i < count; i++) {
+            out[i] = slots[(t + i) & (IRRADIANCE_RING_SIZE - 1)];
+        }
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    // Free slots as the producer sees them
+    size_t space() const {
+        return IRRADIANCE_RING_SIZE - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+    }
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+    uint32_t getPeak() const { return peak.load(std::memory_order_relaxed); }
+    uint32_t getPushed() const { return head.load(std::memory_order_relaxed); }
+};
+
+// Count, mean, min, max and variance by Welford's update; merge() combines
+// two sets by Chan's formula. Floats are enough for a minute of samples;
+// hours are built from minutes, so neither sees millions of updates.
+struct RunningStats {
+    uint32_t count;
+    float mean;
+    float m2;             // sum of squared deviations from the mean
+    float min;
+    float max;
+
+    void clear();
+    void add(float value);
+    void merge(const RunningStats& other);
+
+    // Sample variance; 0 below two samples
+    float variance() const { return count > 1 ? m2 / (count - 1) : 0.0f; }
+    float stddev() const { return sqrtf(variance()); }
+};
+
+struct MinuteStats {
+    time_t start;         // UTC, on a minute
+    RunningStats stats;
+};
+
+// A date's wall-clock hours, the buckets of SolarCalc::calculateDailyForecast()
+struct MeasuredDay {
+    int year;             // 0 before the first sample
+    int month;
+    int day;
+    RunningStats hour[24];
+    uint8_t minutes[24];  // minutes of each hour with at least one sample
+};
+
+struct IrradianceMeterStats {
+    uint32_t pushed;      // samples the source put in the ring
+    uint32_t dropped;     // refused by a full ring
+    uint32_t consumed;    // folded into the aggregates
+    uint32_t late;        // older than the open minute; not counted
+    uint32_t peakDepth;   // most samples waiting at once
+};
+
+class IrradianceSource;
+
+// Measured irradiance from a pyranometer or reference cell. A source fills
+// the ring from the sampling task; the consumer task folds samples into the
+// open minute, and each minute into its wall-clock hour when it closes.
+// Memory is fixed: the ring, IRRADIANCE_MINUTE_HISTORY minutes and two days
+// of hours. Samples should arrive in time order; late ones are counted and
+// left out.
+//
+// process() and pump() run the two sides by hand when there are no tasks.
+class IrradianceMeter {
+private:
+    SampleRing ring;
+    IrradianceSource* source;
+    const TimeZone* timeZone;
+
+    MinuteStats open;                       // the minute being filled; count 0 before the first sample
+    MinuteStats history[IRRADIANCE_MINUTE_HISTORY];
+    uint8_t historyNext;
+    uint8_t historyCount;
+    MeasuredDay today;
+    MeasuredDay yesterday;
+    int64_t todayNumber;                    // local day number of today
+
+    uint32_t consumed;
+    uint32_t late;
+    portMUX_TYPE lock;
+
+    TaskHandle_t samplerHandle;
+    TaskHandle_t consumerHandle;
+    std::atomic<bool> samplerDone;
+    std::atomic<bool> stopping;
+    std::atomic<uint8_t> tasksRunning;
+
+    static void samplerMain(void* arg);
+    static void consumerMain(void* arg);
+
+    // Fold a sample in; the lock is held
+    void accept(const IrradianceSample& sample);
+
+    // Move the open minute into history and its hour; the lock is held
+    void closeMinute();
+
+    // Wall-clock day number and hour of an instant
+    void localHour(time_t utc, int64_t& dayNumber, int& hour) const;
+
+public:
+    IrradianceMeter();
+    ~IrradianceMeter() { stopTasks(); }
+
+    // Hours are on this zone's wall clock, as in SolarCalc; UTC without one.
+    // Set before the first sample.
+    void setTimeZone(const TimeZone* zone) { timeZone = zone; }
+    void setSource(IrradianceSource* value) { source = value; }
+
+    // Start the sampling task (with a source) and the consumer task
+    bool startTasks(BaseType_t core = IRRADIANCE_TASK_CORE, UBaseType_t priority = IRRADIANCE_TASK_PRIORITY);
+
+    // Ask both tasks to end and wait until they have; the ring keeps what was not consumed
+    void stopTasks();
+
+    // True once a finite source, such as a replay, has run out
+    bool sourceFinished() const { return samplerDone.load(); }
+
+    // One pass of the source into the ring; what the sampling task runs
+    size_t pump();
+
+    // Drain the ring into the aggregates; what the consumer task runs.
+    // Returns the samples taken.
+    size_t process();
+
+    // Close the open minute, at the end of a replay
+    void flush();
+
+    SampleRing& getRing() { return ring; }
+
+    // The open minute, and closed ones counting back from 0, the latest;
+    // false past the history
+    MinuteStats getOpenMinute();
+    bool getMinute(uint8_t ago, MinuteStats& out);
+
+    // The current date's hours, the open minute included, or the date before it
+    MeasuredDay getToday();
+    MeasuredDay getYesterday();
+
+    // Measured energy per wall-clock hour, kWh/m², in calculateDailyForecast()'s
+    // layout: the mean over each minute with samples, minutes without count as 0
+    static DailyForecast toForecast(const MeasuredDay& day);
+
+    IrradianceMeterStats getStats();
+};
+
+#endif // IRRADIANCE_METER_H
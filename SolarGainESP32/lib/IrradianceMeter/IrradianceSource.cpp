@@ -0,0 +1,138 @@
+#include "IrradianceSource.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../EpochTime/EpochTime.h"
+
+AdcIrradianceSource::AdcIrradianceSource(uint8_t pin, float wattsPerMillivolt, uint32_t periodUs)
+    : pin(pin), wattsPerMillivolt(wattsPerMillivolt), offsetMillivolts(0), periodUs(periodUs), nextDueUs(0),
+      started(false) {}
+
+size_t AdcIrradianceSource::fill(SampleRing& ring) {
+    uint32_t nowUs = micros();
+    int64_t utcUs = clock ? clock() : (int64_t)time(nullptr) * 1000000;
+    if (!started) {
+        nextDueUs = nowUs;
+        started = true;
+    }
+
+    size_t pushed = 0;
+    if (periodUs == 0) {
+        // Continuous: a burst of conversions, all stamped with this call's time
+        IrradianceSample sample;
+        sample.utc = (time_t)(utcUs / 1000000);
+        for (int i = 0; i < IRRADIANCE_ADC_BURST; i++) {
+            sample.irradiance = (analogReadMilliVolts(pin) - offsetMillivolts) * wattsPerMillivolt;
+            if (ring.push(sample)) pushed++;
+        }
+        return pushed;
+    }
+
+    // Every conversion due by now, each stamped with when it was due
+    while ((int32_t)(nowUs - nextDueUs) >= 0) {
+        IrradianceSample sample;
+        sample.utc = (time_t)((utcUs - (int32_t)(nowUs - nextDueUs)) / 1000000);
+        sample.irradiance = (analogReadMilliVolts(pin) - offsetMillivolts) * wattsPerMillivolt;
+        if (ring.push(sample)) pushed++;
+        nextDueUs += periodUs;
+    }
+    return pushed;
+}
+
+CsvReplaySource::CsvReplaySource(Stream& input, float speed)
+    : input(input), speed(speed), buffered(0), scanned(0), ended(false), skipping(false), hasPending(false),
+      firstUtc(0), startUs(0), paced(false), rejected(0) {
+    pending.utc = 0;
+    pending.irradiance = 0;
+}
+
+bool CsvReplaySource::parseLine(const char* line, IrradianceSample& out) {
+    int year, month, day, hour, minute, second;
+    float value;
+    int used = 0;
+    if (sscanf(line, "%d-%d-%d%*1[T ]%d:%d:%d%n", &year, &month, &day, &hour, &minute, &second, &used) == 6) {
+        if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+            return false;
+        }
+        const char* rest = line + used;
+        if (*rest == 'Z') rest++;
+        if (sscanf(rest, " ,%f", &value) != 1) return false;
+        out.utc = EpochTime::fromCivil(year, month, day, hour, minute, second);
+        out.irradiance = value;
+        return true;
+    }
+
+    char* end;
+    long long seconds = strtoll(line, &end, 10);
+    if (end == line || sscanf(end, " ,%f", &value) != 1) return false;
+    out.utc = (time_t)seconds;
+    out.irradiance = value;
+    return true;
+}
+
+bool CsvReplaySource::nextSample() {
+    for (;;) {
+        // A whole line in the buffer: parse it and drop it
+        char* newline = (char*)memchr(buffer + scanned, '\n', buffered - scanned);
+        if (newline || (ended && buffered > 0)) {
+            size_t length = newline ? (size_t)(newline - buffer) : buffered;
+            buffer[length] = '\0';
+            bool blank = buffer[0] == '\0' || buffer[0] == '\r';
+            bool parsed = !skipping && !blank && parseLine(buffer, pending);
+            if (!skipping && !blank && !parsed) rejected++;
+            skipping = false;
+            size_t next = newline ? length + 1 : buffered;
+            memmove(buffer, buffer + next, buffered - next);
+            buffered -= next;
+            scanned = 0;
+            if (parsed) return true;
+            continue;
+        }
+        scanned = buffered;
+        if (ended) return false;
+
+        // A line too long for the buffer is skipped up to its newline
+        if (buffered == sizeof(buffer) - 1) {
+            if (!skipping) rejected++;
+            skipping = true;
+            buffered = 0;
+            scanned = 0;
+        }
+
+        // Read only what is there, so a file never waits on the stream timeout
+        int available = input.available();
+        if (available <= 0) {
+            ended = true;
+            continue;
+        }
+        size_t room = sizeof(buffer) - 1 - buffered;
+        buffered += input.readBytes(buffer + buffered, (size_t)available < room ? (size_t)available : room);
+    }
+}
+
+size_t CsvReplaySource::fill(SampleRing& ring) {
+    size_t pushed = 0;
+    while (ring.space() > 0) {
+        if (!hasPending) {
+            if (!nextSample()) break;
+            hasPending = true;
+        }
+
+        if (speed > 0) {
+            // Hold the sample until its time comes round at this speed. 64-bit
+            // time: micros() wraps after 71.6 minutes, and a longer log would stall.
+            if (!paced) {
+                firstUtc = pending.utc;
+                startUs = now();
+                paced = true;
+            }
+            int64_t dueUs = (int64_t)((double)(pending.utc - firstUtc) * 1000000.0 / speed);
+            if (now() - startUs < dueUs) break;
+        }
+
+        ring.push(pending);
+        hasPending = false;
+        pushed++;
+    }
+    return pushed;
+}
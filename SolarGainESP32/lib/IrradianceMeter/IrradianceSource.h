@@ -0,0 +1,105 @@
+#ifndef IRRADIANCE_SOURCE_H
+#define IRRADIANCE_SOURCE_H
+
+#include <Arduino.h>
+#include <functional>
+#include <esp_timer.h>
+#include "IrradianceMeter.h"
+
+// Conversions read back-to-back per fill() in continuous mode
+#ifndef IRRADIANCE_ADC_BURST
+#define IRRADIANCE_ADC_BURST 64
+#endif
+
+// Longest CSV line, newline included; longer ones are skipped
+#define IRRADIANCE_CSV_LINE 128
+
+// UTC in microseconds since the epoch, e.g. SntpClock::now()
+typedef std::function<int64_t()> SampleClock;
+
+// Microseconds from any fixed point, 64 bits so it never wraps, e.g.
+// esp_timer_get_time()
+typedef std::function<int64_t()> PaceClock;
+
+// Where the samples come from. fill() is called over and over from the
+// sampling task and pushes whatever is ready without blocking.
+class IrradianceSource {
+public:
+    virtual ~IrradianceSource() {}
+
+    // Push ready samples into the ring; returns how many were pushed
+    virtual size_t fill(SampleRing& ring) = 0;
+
+    // No more samples will come
+    virtual bool finished() const { return false; }
+};
+
+// A pyranometer or reference cell on an ADC pin, through
+// analogReadMilliVolts() so the chip's calibration applies. Periodic mode
+// takes one conversion per period, catching up on the ones a late fill()
+// missed; a period of 0 converts continuously, a burst per fill(). A
+// sample the ring has no room for is dropped and counted there.
+class AdcIrradianceSource : public IrradianceSource {
+private:
+    uint8_t pin;
+    float wattsPerMillivolt;
+    float offsetMillivolts;   // reading in the dark
+    uint32_t periodUs;
+    uint32_t nextDueUs;
+    bool started;
+    SampleClock clock;
+
+public:
+    AdcIrradianceSource(uint8_t pin, float wattsPerMillivolt, uint32_t periodUs);
+
+    // Zero reading, from a covered sensor
+    void setOffset(float millivolts) { offsetMillivolts = millivolts; }
+
+    // Sample time source; time(nullptr) without one
+    void setClock(SampleClock fn) { clock = fn; }
+
+    size_t fill(SampleRing& ring) override;
+};
+
+// Replays a log of "utc,irradiance" lines, utc either epoch seconds or
+// YYYY-MM-DDTHH:MM:SS(Z), from a file or any stream that ends when it runs
+// out. Lines that do not parse (a header, say) are skipped and counted.
+// At speed 0 it goes as fast as the ring takes samples and never drops
+// one; otherwise it keeps the log's pace, sped up by that factor.
+class CsvReplaySource : public IrradianceSource {
+private:
+    Stream& input;
+    float speed;
+    char buffer[IRRADIANCE_CSV_LINE + 1];
+    size_t buffered;
+    size_t scanned;           // of buffered, already searched for a newline
+    bool ended;
+    bool skipping;            // inside a line that did not fit
+    bool hasPending;
+    IrradianceSample pending; // parsed, waiting for room or for its time
+    time_t firstUtc;
+    int64_t startUs;
+    bool paced;
+    uint32_t rejected;
+    PaceClock clock;
+
+    int64_t now() { return clock ? clock() : esp_timer_get_time(); }
+
+    // Next complete line into pending; false when none is buffered yet
+    bool nextSample();
+
+public:
+    CsvReplaySource(Stream& input, float speed = 0);
+
+    static bool parseLine(const char* line, IrradianceSample& out);
+
+    // Time source for pacing; esp_timer_get_time() without one. Set before
+    // the first fill().
+    void setClock(PaceClock fn) { clock = fn; }
+
+    size_t fill(SampleRing& ring) override;
+    bool finished() const override { return ended && !hasPending; }
+    uint32_t getRejected() const { return rejected; }
+};
+
+#endif // IRRADIANCE_SOURCE_H
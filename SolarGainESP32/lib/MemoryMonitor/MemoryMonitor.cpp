@@ -0,0 +1,146 @@
+#include "MemoryMonitor.h"
+#include <esp_heap_caps.h>
+#include "../Trace/Trace.h"
+
+static portMUX_TYPE tagLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* tagNames[MEM_TAG_COUNT] = {"config", "timesync", "solar", "display", "whatsapp", "other"};
+
+// Alert bits: heap conditions first, then one bit per watched task
+static const uint8_t ALERT_BIT_LOW_HEAP = 0;
+static const uint8_t ALERT_BIT_FRAGMENTED = 1;
+static const uint8_t ALERT_BIT_FIRST_TASK = 2;
+
+MemoryThresholds MemoryMonitor::thresholds = {20000, 8192, 60, 512};
+MemoryAlertHandler MemoryMonitor::alertHandler = nullptr;
+HeapSample MemoryMonitor::last = {0, 0, 0, 0, 0};
+TaskStackInfo MemoryMonitor::tasks[MEMORY_MONITOR_MAX_TASKS];
+uint8_t MemoryMonitor::taskCount = 0;
+TagCounters MemoryMonitor::tags[MEM_TAG_COUNT];
+uint32_t MemoryMonitor::activeAlerts = 0;
+TaskHandle_t MemoryMonitor::samplerTask = nullptr;
+uint32_t MemoryMonitor::periodMs = 0;
+
+bool MemoryMonitor::begin(uint32_t samplePeriodMs) {
+    periodMs = samplePeriodMs;
+    sample();
+
+    if (periodMs == 0 || samplerTask) return true;
+
+    if (xTaskCreate(samplerEntry, "memmon", 3072, nullptr, tskIDLE_PRIORITY + 1, &samplerTask) != pdPASS) {
+        samplerTask = nullptr;
+        Serial.println("Failed to start memory monitor task");
+        return false;
+    }
+    watchTask(samplerTask, "memmon");
+    return true;
+}
+
+void MemoryMonitor::samplerEntry(void* arg) {
+    TickType_t wake = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(periodMs));
+        sample();
+    }
+}
+
+bool MemoryMonitor::watchTask(TaskHandle_t handle, const char* name) {
+    if (!handle) handle = xTaskGetCurrentTaskHandle();
+
+    for (uint8_t i = 0; i < taskCount; i++) {
+        if (tasks[i].handle == handle) return true;
+    }
+    if (taskCount >= MEMORY_MONITOR_MAX_TASKS) return false;
+
+    tasks[taskCount].handle = handle;
+    tasks[taskCount].name = name ? name : pcTaskGetName(handle);
+    tasks[taskCount].highWaterMark = uxTaskGetStackHighWaterMark(handle);
+    taskCount++;
+    return true;
+}
+
+uint32_t MemoryMonitor::currentFreeHeap() {
+    return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+HeapSample MemoryMonitor::sample() {
+    HeapSample s;
+    s.timestampMs = millis();
+    s.freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    s.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    s.minFreeHeap = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    s.fragmentationPct = s.freeHeap > 0 ? 100 - (uint8_t)((uint64_t)s.largestBlock * 100 / s.freeHeap) : 0;
+    last = s;
+
+    TRACE_COUNTER("heap.free", s.freeHeap);
+    TRACE_COUNTER("heap.largest_block", s.largestBlock);
+    TRACE_COUNTER("heap.min_free", s.minFreeHeap);
+
+    raise(ALERT_BIT_LOW_HEAP, MEM_ALERT_LOW_HEAP, s.freeHeap, "heap",
+          s.freeHeap < thresholds.minFreeHeap);
+    raise(ALERT_BIT_FRAGMENTED, MEM_ALERT_FRAGMENTED, s.fragmentationPct, "heap",
+          s.largestBlock < thresholds.minLargestBlock || s.fragmentationPct > thresholds.maxFragmentationPct);
+
+    for (uint8_t i = 0; i < taskCount; i++) {
+        tasks[i].highWaterMark = uxTaskGetStackHighWaterMark(tasks[i].handle);
+        TRACE_COUNTER(tasks[i].name, tasks[i].highWaterMark);
+        raise(ALERT_BIT_FIRST_TASK + i, MEM_ALERT_LOW_STACK, tasks[i].highWaterMark, tasks[i].name,
+              tasks[i].highWaterMark < thresholds.minStackBytes);
+    }
+
+    return s;
+}
+
+void MemoryMonitor::raise(uint8_t bit, MemoryAlert alert, uint32_t value, const char* subject, bool active) {
+    uint32_t mask = 1UL << bit;
+    bool wasActive = activeAlerts & mask;
+
+    if (active && !wasActive) {
+        activeAlerts |= mask;
+        Serial.printf("Memory alert: %s %s (%lu)\n", subject,
+                      alert == MEM_ALERT_LOW_HEAP ? "low heap" :
+                      alert == MEM_ALERT_FRAGMENTED ? "fragmented" : "low stack",
+                      (unsigned long)value);
+        TRACE_INSTANT("memory.alert");
+        if (alertHandler) alertHandler(alert, value, subject);
+    } else if (!active && wasActive) {
+        activeAlerts &= ~mask;
+    }
+}
+
+void MemoryMonitor::recordScope(MemoryTag tag, uint32_t freeBefore, uint32_t freeAfter) {
+    if (tag >= MEM_TAG_COUNT) tag = MEM_TAG_OTHER;
+    int32_t growth = (int32_t)(freeBefore - freeAfter);
+
+    portENTER_CRITICAL(&tagLock);
+    TagCounters& counters = tags[tag];
+    counters.scopes++;
+    counters.netBytes += growth;
+    if (growth > 0 && (uint32_t)growth > counters.worstScopeBytes) {
+        counters.worstScopeBytes = growth;
+    }
+    portEXIT_CRITICAL(&tagLock);
+}
+
+const char* MemoryMonitor::tagName(MemoryTag tag) {
+    return tag < MEM_TAG_COUNT ? tagNames[tag] : "?";
+}
+
+void MemoryMonitor::printReport() {
+    const HeapSample& s = last;
+    Serial.printf("Heap: free %lu, largest block %lu, min ever %lu, fragmentation %u%%\n",
+                  (unsigned long)s.freeHeap, (unsigned long)s.largestBlock,
+                  (unsigned long)s.minFreeHeap, (unsigned)s.fragmentationPct);
+
+    for (uint8_t i = 0; i < taskCount; i++) {
+        Serial.printf("Stack %-12s %5lu bytes free (low-water)\n",
+                      tasks[i].name, (unsigned long)tasks[i].highWaterMark);
+    }
+
+    for (uint8_t t = 0; t < MEM_TAG_COUNT; t++) {
+        if (tags[t].scopes == 0) continue;
+        Serial.printf("Tag   %-12s %5lu scopes, net %+ld bytes, worst scope %lu bytes\n",
+                      tagNames[t], (unsigned long)tags[t].scopes,
+                      (long)tags[t].netBytes, (unsigned long)tags[t].worstScopeBytes);
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Maximum number of tasks whose stack watermark is tracked
+#ifndef MEMORY_MONITOR_MAX_TASKS
+#define MEMORY_MONITOR_MAX_TASKS 8
+#endif
+
+// Subsystems that heap usage is attributed to
+enum MemoryTag : uint8_t {
+    MEM_TAG_CONFIG,
+    MEM_TAG_TIMESYNC,
+    MEM_TAG_SOLAR,
+    MEM_TAG_DISPLAY,
+    MEM_TAG_WHATSAPP,
+    MEM_TAG_OTHER,
+    MEM_TAG_COUNT
+};
+
+enum MemoryAlert : uint8_t {
+    MEM_ALERT_LOW_HEAP,
+    MEM_ALERT_FRAGMENTED,
+    MEM_ALERT_LOW_STACK
+};
+
+struct MemoryThresholds {
+    uint32_t minFreeHeap;        // bytes
+    uint32_t minLargestBlock;    // bytes
+    uint8_t maxFragmentationPct; // 100 - largest block / free heap
+    uint32_t minStackBytes;      // per-task stack headroom
+};
+
+struct HeapSample {
+    uint32_t timestampMs;
+    uint32_t freeHeap;
+    uint32_t largestBlock;
+    uint32_t minFreeHeap;        // lowest free heap since boot
+    uint8_t fragmentationPct;
+};
+
+struct TaskStackInfo {
+    TaskHandle_t handle;
+    const char* name;
+    uint32_t highWaterMark;      // lowest unused stack ever, in bytes
+};
+
+// Heap activity seen inside MEMORY_SCOPE blocks for one subsystem. Figures are heap deltas
+// measured on entry and exit, so concurrent allocations by other tasks are included.
+struct TagCounters {
+    uint32_t scopes;             // number of scopes entered
+    int32_t netBytes;            // heap retained across all scopes (positive = growth)
+    uint32_t worstScopeBytes;    // largest growth seen in a single scope
+};
+
+typedef void (*MemoryAlertHandler)(MemoryAlert alert, uint32_t value, const char* subject);
+
+class MemoryMonitor {
+private:
+    static MemoryThresholds thresholds;
+    static MemoryAlertHandler alertHandler;
+    static HeapSample last;
+    static TaskStackInfo tasks[MEMORY_MONITOR_MAX_TASKS];
+    static uint8_t taskCount;
+    static TagCounters tags[MEM_TAG_COUNT];
+    static uint32_t activeAlerts; // bit per alert/task so alerts fire on transitions only
+    static TaskHandle_t samplerTask;
+    static uint32_t periodMs;
+
+    static void samplerEntry(void* arg);
+    static void raise(uint8_t bit, MemoryAlert alert, uint32_t value, const char* subject, bool active);
+
+public:
+    // Start periodic sampling on a low-priority task (0 = sample manually)
+    static bool begin(uint32_t samplePeriodMs = 10000);
+
+    static void setThresholds(const MemoryThresholds& limits) { thresholds = limits; }
+    static void setAlertHandler(MemoryAlertHandler handler) { alertHandler = handler; }
+
+    // Track the stack of a task (nullptr = calling task)
+    static bool watchTask(TaskHandle_t handle = nullptr, const char* name = nullptr);
+
+    // Take a sample now, check thresholds and emit trace counters
+    static HeapSample sample();
+
+    static HeapSample getLastSample() { return last; }
+    static uint8_t getTaskCount() { return taskCount; }
+    static TaskStackInfo getTask(uint8_t index) { return tasks[index]; }
+    static TagCounters getTag(MemoryTag tag) { return tags[tag]; }
+
+    // Record a scope's heap delta against a subsystem
+    static void recordScope(MemoryTag tag, uint32_t freeBefore, uint32_t freeAfter);
+
+    static uint32_t currentFreeHeap();
+
+    // Print heap, stack and per-subsystem figures to Serial
+    static void printReport();
+
+    static const char* tagName(MemoryTag tag);
+};
+
+#ifdef MEMORY_TAGS_ENABLED
+
+class MemoryScope {
+private:
+    MemoryTag tag;
+    uint32_t freeBefore;
+
+public:
+    MemoryScope(MemoryTag tag) : tag(tag), freeBefore(MemoryMonitor::currentFreeHeap()) {}
+    ~MemoryScope() { MemoryMonitor::recordScope(tag, freeBefore, MemoryMonitor::currentFreeHeap()); }
+};
+
+#define MEMORY_CONCAT_(a, b) a##b
+#define MEMORY_CONCAT(a, b) MEMORY_CONCAT_(a, b)
+#define MEMORY_SCOPE(tag) MemoryScope MEMORY_CONCAT(memoryScope_, __LINE__)(tag)
+
+#else
+
+#define MEMORY_SCOPE(tag) do {} while (0)
+
+#endif // MEMORY_TAGS_ENABLED
+
+#endif // MEMORY_MONITOR_H
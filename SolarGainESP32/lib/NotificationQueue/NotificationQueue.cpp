@@ -0,0 +1,517 @@
+#include "NotificationQueue.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "../Trace/Trace.h"
+
+// Flash record: header followed by `length` bytes of message text
+struct NotificationRecord {
+    uint32_t magic;
+    uint32_t sequence;
+    uint16_t length;
+    uint16_t reserved;
+};
+
+static const uint32_t RECORD_MAGIC = 0x314E4753; // "SGN1"
+
+// Print that fills a slot's text buffer and remembers whether it overflowed
+class SlotPrint : public Print {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t used;
+    bool overflow;
+
+public:
+    SlotPrint(char* buffer, size_t capacity)
+        : buffer(buffer), capacity(capacity), used(0), overflow(false) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        if (used + size > capacity) {
+            overflow = true;
+            return 0;
+        }
+        memcpy(buffer + used, data, size);
+        used += size;
+        return size;
+    }
+
+    size_t length() const { return used; }
+    bool overflowed() const { return overflow; }
+    using Print::write;
+};
+
+NotificationQueue::NotificationQueue()
+    : head(0), count(0), nextSequence(1), flashBacklog(false), spilling(0), spilled(0), useFlash(false),
+      latencyCount(0), latencyNext(0), taskHandle(nullptr), stopping(false), taskRunning(false) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    policy = {2000, 15UL * 60UL * 1000UL, 0};
+    memset(&stats, 0, sizeof(stats));
+    for (uint8_t i = 0; i < NOTIFICATION_QUEUE_SLOTS; i++) {
+        slots[i].state = SLOT_FREE;
+    }
+}
+
+String NotificationQueue::recordPath(uint32_t sequence) {
+    char path[32];
+    snprintf(path, sizeof(path), NOTIFICATION_OUTBOX_DIR "/%08lx.msg", (unsigned long)sequence);
+    return String(path);
+}
+
+bool NotificationQueue::begin(const String& id, bool flash) {
+    deviceId = id;
+    useFlash = flash;
+
+    preferences.begin("notifq", false);
+    nextSequence = std::max<uint32_t>(nextSequence, preferences.getUInt("next_seq", 1));
+
+    if (useFlash) {
+        flashBacklog = true;
+        loadBacklog();
+    }
+
+    Serial.println("Notification queue ready, " + String((int)count) + " pending, next #" +
+                   String((unsigned long)nextSequence));
+    return true;
+}
+
+bool NotificationQueue::startTask() {
+    if (taskHandle) return true;
+
+    stopping = false;
+    taskRunning = true;
+    BaseType_t result = xTaskCreatePinnedToCore(taskMain, "notifq", NOTIFICATION_TASK_STACK, this,
+                                                NOTIFICATION_TASK_PRIORITY, &taskHandle,
+                                                NOTIFICATION_TASK_CORE);
+    if (result != pdPASS) {
+        taskHandle = nullptr;
+        taskRunning = false;
+        Serial.println("Failed to start notification task");
+        return false;
+    }
+    return true;
+}
+
+void NotificationQueue::taskMain(void* arg) {
+    NotificationQueue* queue = static_cast<NotificationQueue*>(arg);
+    while (!queue->stopping) {
+        uint32_t waitMs = queue->process();
+        // Woken early by enqueue() or stopTask(); otherwise sleep until the next retry is due
+        ulTaskNotifyTake(pdTRUE, waitMs == NOTIFICATION_IDLE ? portMAX_DELAY : pdMS_TO_TICKS(waitMs));
+    }
+    queue->taskHandle = nullptr;
+    queue->taskRunning = false;
+    vTaskDelete(nullptr);
+}
+
+void NotificationQueue::stopTask() {
+    if (!taskRunning) return;
+    stopping = true;
+    TaskHandle_t task = taskHandle;
+    if (task) xTaskNotifyGive(task);
+    while (taskRunning) {
+        vTaskDelay(1);
+    }
+}
+
+NotificationQueue::Slot* NotificationQueue::reserve(uint32_t& flashSequence) {
+    Slot* slot = nullptr;
+    flashSequence = 0;
+
+    portENTER_CRITICAL(&lock);
+    if (flashBacklog) {
+        // Older messages are still on flash; a RAM slot now would send this one first
+        flashSequence = nextSequence++;
+        spilling++;
+    } else if (count < NOTIFICATION_QUEUE_SLOTS) {
+        slot = &slots[(head + count) % NOTIFICATION_QUEUE_SLOTS];
+        slot->state = SLOT_RESERVED;
+        slot->sequence = nextSequence++;
+        count++;
+    } else {
+        stats.overflowed++;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    return slot;
+}
+
+void NotificationQueue::commit(Slot* slot, uint16_t length) {
+    slot->length = length;
+    slot->attempts = 0;
+    slot->enqueuedAt = millis();
+    slot->nextAttemptAt = slot->enqueuedAt;
+
+    portENTER_CRITICAL(&lock);
+    slot->state = SLOT_READY;
+    stats.enqueued++;
+    portEXIT_CRITICAL(&lock);
+
+    if (taskHandle) xTaskNotifyGive(taskHandle);
+}
+
+bool NotificationQueue::spill(uint32_t sequence, const char* text, uint16_t length) {
+    // No text gives the sequence number up; loadBacklog() skips the gap
+    bool ok = text && writeRecord(sequence, text, length);
+
+    portENTER_CRITICAL(&lock);
+    spilling--;
+    spilled++;
+    if (ok) {
+        stats.enqueued++;
+    } else if (text) {
+        stats.persistFailures++;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (taskHandle) xTaskNotifyGive(taskHandle);
+    return ok;
+}
+
+bool NotificationQueue::enqueue(const char* text, size_t length) {
+    uint32_t start = micros();
+    if (length > NOTIFICATION_MAX_PAYLOAD) return false;
+
+    uint32_t flashSequence;
+    Slot* slot = reserve(flashSequence);
+    if (flashSequence) {
+        if (!spill(flashSequence, text, (uint16_t)length)) return false;
+    } else if (slot) {
+        memcpy(slot->text, text, length);
+        commit(slot, (uint16_t)length);
+    } else {
+        return false;
+    }
+
+    stats.lastEnqueueUs = micros() - start;
+    stats.maxEnqueueUs = std::max(stats.maxEnqueueUs, stats.lastEnqueueUs);
+    return true;
+}
+
+bool NotificationQueue::enqueue(const std::function<void(Print&)>& render) {
+    uint32_t start = micros();
+
+    uint32_t flashSequence;
+    Slot* slot = reserve(flashSequence);
+    if (flashSequence) {
+        // No slot to render into; only while a backlog drains, so the buffer is short-lived
+        std::unique_ptr<char[]> text(new char[NOTIFICATION_MAX_PAYLOAD]);
+        SlotPrint out(text.get(), NOTIFICATION_MAX_PAYLOAD);
+        render(out);
+        if (out.overflowed()) Serial.println("Notification too long, dropped");
+        if (!spill(flashSequence, out.overflowed() ? nullptr : text.get(), (uint16_t)out.length())) return false;
+
+        stats.lastEnqueueUs = micros() - start;
+        stats.maxEnqueueUs = std::max(stats.maxEnqueueUs, stats.lastEnqueueUs);
+        return true;
+    }
+    if (!slot) return false;
+
+    SlotPrint out(slot->text, NOTIFICATION_MAX_PAYLOAD);
+    render(out);
+    if (out.overflowed()) {
+        // Leave a hole that process() skips once it reaches the head
+        portENTER_CRITICAL(&lock);
+        slot->state = SLOT_FREE;
+        portEXIT_CRITICAL(&lock);
+        Serial.println("Notification too long, dropped");
+        return false;
+    }
+    commit(slot, (uint16_t)out.length());
+
+    stats.lastEnqueueUs = micros() - start;
+    stats.maxEnqueueUs = std::max(stats.maxEnqueueUs, stats.lastEnqueueUs);
+    return true;
+}
+
+bool NotificationQueue::writeRecord(uint32_t sequence, const char* text, uint16_t length) {
+    NotificationRecord record = {RECORD_MAGIC, sequence, length, 0};
+
+    // Write under a temporary name so a power cut never leaves a torn record
+    String path = recordPath(sequence);
+    String tmpPath = path + ".tmp";
+    File file = SPIFFS.open(tmpPath, FILE_WRITE);
+    if (!file) return false;
+
+    bool ok = file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+              file.write((const uint8_t*)text, length) == length;
+    file.close();
+
+    if (!ok || !SPIFFS.rename(tmpPath.c_str(), path.c_str())) {
+        SPIFFS.remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+void NotificationQueue::removeRecord(uint32_t sequence) {
+    if (useFlash) SPIFFS.remove(recordPath(sequence));
+}
+
+void NotificationQueue::persistPending() {
+    bool wrote = false;
+
+    for (uint8_t i = 0; ; i++) {
+        portENTER_CRITICAL(&lock);
+        bool inRange = i < count;
+        Slot* slot = &slots[(head + i) % NOTIFICATION_QUEUE_SLOTS];
+        bool ready = inRange && slot->state == SLOT_READY;
+        portEXIT_CRITICAL(&lock);
+        if (!inRange) break;
+        if (!ready) continue;
+
+        // Only this task moves a slot out of READY, so the write needs no lock
+        if (useFlash && !writeRecord(slot->sequence, slot->text, slot->length)) {
+            stats.persistFailures++;
+            continue;
+        }
+        slot->state = SLOT_PERSISTED;
+        wrote = true;
+    }
+
+    if (wrote) {
+        // Sequence numbers must never repeat, even once the outbox is empty
+        preferences.putUInt("next_seq", nextSequence);
+    }
+}
+
+void NotificationQueue::loadBacklog() {
+    // Anything enqueue() writes from here on may be missed by the listing below
+    portENTER_CRITICAL(&lock);
+    uint32_t spilledBefore = spilled;
+    portEXIT_CRITICAL(&lock);
+
+    std::vector<uint32_t> onFlash;
+    File dir = SPIFFS.open(NOTIFICATION_OUTBOX_DIR);
+    if (dir && dir.isDirectory()) {
+        for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+            const char* name = strrchr(file.name(), '/');
+            name = name ? name + 1 : file.name();
+            file.close();
+
+            unsigned long sequence;
+            char suffix[8] = {0};
+            if (sscanf(name, "%8lx.%7s", &sequence, suffix) == 2 && strcmp(suffix, "msg") == 0) {
+                onFlash.push_back((uint32_t)sequence);
+            } else if (strstr(name, ".tmp")) {
+                // Torn write from before a reset; the message was never acknowledged to anyone
+                SPIFFS.remove(String(NOTIFICATION_OUTBOX_DIR "/") + name);
+            }
+        }
+    }
+    if (dir) dir.close();
+    std::sort(onFlash.begin(), onFlash.end());
+
+    // Past every record, loaded or not, so a spilled message never takes a number in use
+    portENTER_CRITICAL(&lock);
+    if (!onFlash.empty() && onFlash.back() >= nextSequence) nextSequence = onFlash.back() + 1;
+    portEXIT_CRITICAL(&lock);
+
+    bool full = false;
+    bool loadedAny = false;
+    for (uint32_t sequence : onFlash) {
+        // Skip records already in RAM
+        bool loaded = false;
+        for (uint8_t i = 0; i < count && !loaded; i++) {
+            const Slot& slot = slots[(head + i) % NOTIFICATION_QUEUE_SLOTS];
+            loaded = slot.state != SLOT_FREE && slot.sequence == sequence;
+        }
+        if (loaded) continue;
+
+        // Claim the tail slot as reserve() does; enqueue() stays off RAM while the backlog is set
+        portENTER_CRITICAL(&lock);
+        Slot* slot = nullptr;
+        if (count < NOTIFICATION_QUEUE_SLOTS) {
+            slot = &slots[(head + count) % NOTIFICATION_QUEUE_SLOTS];
+            slot->state = SLOT_RESERVED;
+            count++;
+        }
+        portEXIT_CRITICAL(&lock);
+        if (!slot) {
+            full = true;
+            break;
+        }
+
+        File file = SPIFFS.open(recordPath(sequence), FILE_READ);
+        NotificationRecord record;
+        bool ok = file && file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+                  record.magic == RECORD_MAGIC && record.sequence == sequence &&
+                  record.length <= NOTIFICATION_MAX_PAYLOAD &&
+                  file.read((uint8_t*)slot->text, record.length) == record.length;
+        if (file) file.close();
+
+        if (!ok) {
+            // Leave a hole that process() skips once it reaches the head
+            portENTER_CRITICAL(&lock);
+            slot->state = SLOT_FREE;
+            portEXIT_CRITICAL(&lock);
+            Serial.println("Discarding corrupt notification #" + String((unsigned long)sequence));
+            SPIFFS.remove(recordPath(sequence));
+            continue;
+        }
+
+        slot->sequence = sequence;
+        slot->length = record.length;
+        slot->attempts = 0;
+        slot->enqueuedAt = millis();
+        slot->nextAttemptAt = slot->enqueuedAt;
+
+        portENTER_CRITICAL(&lock);
+        slot->state = SLOT_PERSISTED;
+        stats.recovered++;
+        portEXIT_CRITICAL(&lock);
+        loadedAny = true;
+    }
+
+    portENTER_CRITICAL(&lock);
+    // Back to RAM only once everything written to flash has been seen here
+    flashBacklog = full || spilling > 0 || spilled != spilledBefore;
+    uint32_t next = nextSequence;
+    portEXIT_CRITICAL(&lock);
+
+    // Spilled records are deleted only after loading, so the high-water mark is saved first
+    if (loadedAny) preferences.putUInt("next_seq", next);
+}
+
+uint32_t NotificationQueue::backoffDelay(uint16_t attempts) {
+    uint32_t delayMs = policy.baseDelayMs;
+    for (uint16_t i = 1; i < attempts && delayMs < policy.maxDelayMs; i++) {
+        delayMs *= 2;
+    }
+    delayMs = std::min(delayMs, policy.maxDelayMs);
+
+    // Equal jitter keeps retries from many devices from arriving in lockstep
+    uint32_t half = delayMs / 2;
+    return half + (uint32_t)random(half + 1);
+}
+
+void NotificationQueue::recordLatency(uint32_t latencyMs) {
+    latencies[latencyNext] = latencyMs;
+    latencyNext = (latencyNext + 1) % NOTIFICATION_LATENCY_SAMPLES;
+    if (latencyCount < NOTIFICATION_LATENCY_SAMPLES) latencyCount++;
+}
+
+void NotificationQueue::releaseHead() {
+    portENTER_CRITICAL(&lock);
+    slots[head].state = SLOT_FREE;
+    head = (head + 1) % NOTIFICATION_QUEUE_SLOTS;
+    count--;
+    portEXIT_CRITICAL(&lock);
+}
+
+uint32_t NotificationQueue::process() {
+    if (flashBacklog && useFlash) loadBacklog();
+    persistPending();
+
+    for (;;) {
+        portENTER_CRITICAL(&lock);
+        // Drop holes left by failed enqueues
+        while (count > 0 && slots[head].state == SLOT_FREE) {
+            head = (head + 1) % NOTIFICATION_QUEUE_SLOTS;
+            count--;
+        }
+        Slot* slot = count > 0 ? &slots[head] : nullptr;
+        SlotState state = slot ? slot->state : SLOT_FREE;
+        portEXIT_CRITICAL(&lock);
+
+        // Still being filled: commit() wakes the task again
+        if (!slot || state == SLOT_RESERVED) return NOTIFICATION_IDLE;
+
+        // A message that could not be written to flash is still sent from RAM
+        uint32_t now = millis();
+        int32_t wait = (int32_t)(slot->nextAttemptAt - now);
+        if (wait > 0) return (uint32_t)wait;
+        if (!sender) return NOTIFICATION_IDLE;
+
+        Notification notification;
+        notification.sequence = slot->sequence;
+        snprintf(notification.callbackKey, sizeof(notification.callbackKey), "%s-%lu",
+                 deviceId.c_str(), (unsigned long)slot->sequence);
+        notification.text = slot->text;
+        notification.length = slot->length;
+        notification.attempts = slot->attempts;
+        notification.enqueuedAt = slot->enqueuedAt;
+
+        NotificationResult result;
+        {
+            TRACE_SCOPE("notify.attempt");
+            result = sender(notification);
+        }
+        slot->attempts++;
+
+        if (result == NOTIFY_RETRY && policy.maxAttempts > 0 && slot->attempts >= policy.maxAttempts) {
+            Serial.println("Giving up on notification #" + String((unsigned long)slot->sequence));
+            result = NOTIFY_REJECTED;
+        }
+
+        if (result == NOTIFY_RETRY) {
+            uint32_t delayMs = backoffDelay(slot->attempts);
+            slot->nextAttemptAt = millis() + delayMs;
+            stats.retries++;
+            return delayMs;
+        }
+
+        if (result == NOTIFY_DELIVERED) {
+            recordLatency(millis() - slot->enqueuedAt);
+            stats.delivered++;
+        } else {
+            stats.rejected++;
+        }
+        removeRecord(slot->sequence);
+        releaseHead();
+
+        if (flashBacklog && useFlash) loadBacklog();
+    }
+}
+
+uint8_t NotificationQueue::pending() {
+    portENTER_CRITICAL(&lock);
+    uint8_t n = count;
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
+
+NotificationStats NotificationQueue::getStats() {
+    NotificationStats result;
+    uint32_t sorted[NOTIFICATION_LATENCY_SAMPLES];
+    uint8_t n;
+
+    portENTER_CRITICAL(&lock);
+    result = stats;
+    result.pending = count;
+    n = latencyCount;
+    memcpy(sorted, latencies, n * sizeof(uint32_t));
+    portEXIT_CRITICAL(&lock);
+
+    std::sort(sorted, sorted + n);
+    // Nearest-rank percentiles
+    auto rank = [&](uint8_t pct) { return n ? sorted[(n * pct + 99) / 100 - 1] : 0; };
+    result.latencyP50Ms = rank(50);
+    result.latencyP90Ms = rank(90);
+    result.latencyP99Ms = rank(99);
+    result.latencyMaxMs = n ? sorted[n - 1] : 0;
+    return result;
+}
+
+void NotificationQueue::printReport() {
+    NotificationStats s = getStats();
+    Serial.printf("Notifications: %lu queued, %lu delivered, %lu retries, %lu rejected, "
+                  "%lu overflowed, %lu recovered, %u pending\n",
+                  (unsigned long)s.enqueued, (unsigned long)s.delivered, (unsigned long)s.retries,
+                  (unsigned long)s.rejected, (unsigned long)s.overflowed,
+                  (unsigned long)s.recovered, (unsigned)s.pending);
+    Serial.printf("Enqueue %lu us (max %lu us); delivery latency p50 %lu ms, p90 %lu ms, "
+                  "p99 %lu ms, max %lu ms\n",
+                  (unsigned long)s.lastEnqueueUs, (unsigned long)s.maxEnqueueUs,
+                  (unsigned long)s.latencyP50Ms, (unsigned long)s.latencyP90Ms,
+                  (unsigned long)s.latencyP99Ms, (unsigned long)s.latencyMaxMs);
+}
+
+NotificationResult NotificationQueue::classifyHttpStatus(int httpCode) {
+    if (httpCode >= 200 && httpCode < 300) return NOTIFY_DELIVERED;
+    // Transport errors, throttling, timeouts and server faults are worth retrying
+    if (httpCode <= 0 || httpCode == 408 || httpCode == 429 || httpCode >= 500) return NOTIFY_RETRY;
+    return NOTIFY_REJECTED;
+}
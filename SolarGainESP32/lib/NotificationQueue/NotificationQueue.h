@@ -0,0 +1,208 @@
+#ifndef NOTIFICATION_QUEUE_H
+#define NOTIFICATION_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <Preferences.h>
+#include <SPIFFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// RAM slots; messages beyond this stay on flash until a slot frees up
+#ifndef NOTIFICATION_QUEUE_SLOTS
+#define NOTIFICATION_QUEUE_SLOTS 8
+#endif
+
+// Largest message text, in bytes (the daily forecast is ~700)
+#ifndef NOTIFICATION_MAX_PAYLOAD
+#define NOTIFICATION_MAX_PAYLOAD 1024
+#endif
+
+// Delivery latencies kept for the percentile report
+#ifndef NOTIFICATION_LATENCY_SAMPLES
+#define NOTIFICATION_LATENCY_SAMPLES 64
+#endif
+
+#ifndef NOTIFICATION_TASK_STACK
+#define NOTIFICATION_TASK_STACK 8192
+#endif
+
+#ifndef NOTIFICATION_TASK_PRIORITY
+#define NOTIFICATION_TASK_PRIORITY 1
+#endif
+
+#ifndef NOTIFICATION_TASK_CORE
+#define NOTIFICATION_TASK_CORE 0
+#endif
+
+// SPIFFS directory holding one file per undelivered message
+#define NOTIFICATION_OUTBOX_DIR "/outbox"
+
+// process() result when nothing is pending
+#define NOTIFICATION_IDLE 0xFFFFFFFFUL
+
+// What the sender reports back for one attempt
+enum NotificationResult {
+    NOTIFY_DELIVERED,   // accepted by the endpoint; removed from the queue
+    NOTIFY_RETRY,       // transient failure (timeout, 429, 5xx); retried with backoff
+    NOTIFY_REJECTED     // permanent failure (other 4xx); dropped
+};
+
+// One queued message as handed to the sender
+struct Notification {
+    uint32_t sequence;
+    char callbackKey[40];      // "<device>-<sequence>", stable across retries and reboots
+    const char* text;
+    uint16_t length;
+    uint16_t attempts;         // attempts made before this one
+    uint32_t enqueuedAt;       // millis() at enqueue or at recovery after a reboot
+};
+
+typedef std::function<NotificationResult(const Notification&)> NotificationSender;
+
+struct NotificationRetryPolicy {
+    uint32_t baseDelayMs;      // delay after the first failure
+    uint32_t maxDelayMs;       // backoff cap
+    uint16_t maxAttempts;      // 0 = retry until delivered
+};
+
+struct NotificationStats {
+    uint32_t enqueued;
+    uint32_t delivered;
+    uint32_t retries;
+    uint32_t rejected;         // dropped by the endpoint or after maxAttempts
+    uint32_t overflowed;       // enqueue() refused because every slot was busy
+    uint32_t recovered;        // loaded from flash: at boot, or from behind a backlog
+    uint32_t persistFailures;
+    uint8_t pending;
+    uint32_t lastEnqueueUs;
+    uint32_t maxEnqueueUs;
+    // Enqueue-to-delivery latency over the last NOTIFICATION_LATENCY_SAMPLES deliveries
+    uint32_t latencyP50Ms;
+    uint32_t latencyP90Ms;
+    uint32_t latencyP99Ms;
+    uint32_t latencyMaxMs;
+};
+
+// Durable outbound queue: enqueue() copies the message into a RAM slot and
+// returns in microseconds; the background task writes it to flash, delivers
+// it in order with exponential backoff and jitter, and deletes the file once
+// the endpoint has accepted it. While older messages wait on flash for a
+// slot, enqueue() writes to flash itself so sequence order holds.
+// Undelivered messages are resent after reboot under the same callback key.
+//
+// Delivery is at least once: an attempt whose answer is lost is retried, and
+// the endpoint may already have the message. The callback key lets a
+// receiver of status webhooks tell the copies apart; Graph does not drop them.
+class NotificationQueue {
+private:
+    enum SlotState : uint8_t {
+        SLOT_FREE,
+        SLOT_RESERVED,     // being filled by enqueue()
+        SLOT_READY,        // in RAM only
+        SLOT_PERSISTED     // also on flash
+    };
+
+    struct Slot {
+        volatile SlotState state;
+        uint32_t sequence;
+        uint32_t enqueuedAt;
+        uint32_t nextAttemptAt;
+        uint16_t attempts;
+        uint16_t length;
+        char text[NOTIFICATION_MAX_PAYLOAD];
+    };
+
+    Slot slots[NOTIFICATION_QUEUE_SLOTS];
+    uint8_t head;
+    uint8_t count;
+    uint32_t nextSequence;
+    bool flashBacklog;     // files on flash that did not fit into RAM; new messages go to flash too
+    uint8_t spilling;      // enqueue() calls writing straight to flash right now
+    uint32_t spilled;      // messages enqueue() has written straight to flash
+
+    String deviceId;
+    bool useFlash;
+    Preferences preferences;   // holds the sequence high-water mark
+    NotificationSender sender;
+    NotificationRetryPolicy policy;
+    NotificationStats stats;
+    uint32_t latencies[NOTIFICATION_LATENCY_SAMPLES];
+    uint8_t latencyCount;
+    uint8_t latencyNext;
+
+    portMUX_TYPE lock;
+    TaskHandle_t taskHandle;
+    std::atomic<bool> stopping;
+    std::atomic<bool> taskRunning;
+
+    static void taskMain(void* arg);
+
+    // Claim the tail slot, or nullptr when full. While there is a flash
+    // backlog it claims only a sequence number, in flashSequence (else 0).
+    Slot* reserve(uint32_t& flashSequence);
+
+    // Publish a reserved slot and wake the task
+    void commit(Slot* slot, uint16_t length);
+
+    // Write a message behind the flash backlog and wake the task
+    bool spill(uint32_t sequence, const char* text, uint16_t length);
+
+    // Write every RAM-only slot to flash
+    void persistPending();
+    bool writeRecord(uint32_t sequence, const char* text, uint16_t length);
+    void removeRecord(uint32_t sequence);
+
+    // Load undelivered files from flash into free slots, oldest first; runs
+    // on the task only, so slots between head and count are not released meanwhile
+    void loadBacklog();
+
+    // Delay before the next attempt: min(cap, base * 2^(attempts-1)), jittered to [d/2, d]
+    uint32_t backoffDelay(uint16_t attempts);
+
+    void recordLatency(uint32_t latencyMs);
+    void releaseHead();
+
+    static String recordPath(uint32_t sequence);
+
+public:
+    NotificationQueue();
+    ~NotificationQueue() { stopTask(); }
+
+    // Recover undelivered messages from flash (SPIFFS must be mounted;
+    // pass useFlash = false for a RAM-only queue)
+    bool begin(const String& deviceId, bool useFlash = true);
+
+    // Start the background delivery task
+    bool startTask();
+
+    // Ask the task to end after its current attempt and wait until it has
+    void stopTask();
+
+    // Set the function that performs one delivery attempt
+    void setSender(NotificationSender fn) { sender = fn; }
+
+    void setRetryPolicy(const NotificationRetryPolicy& retryPolicy) { policy = retryPolicy; }
+
+    // Queue a message; returns false when the queue is full or the text too long
+    bool enqueue(const char* text, size_t length);
+    bool enqueue(const String& text) { return enqueue(text.c_str(), text.length()); }
+
+    // Queue a message rendered straight into its slot (no intermediate String)
+    bool enqueue(const std::function<void(Print&)>& render);
+
+    // Persist new messages and attempt every due delivery. Returns the ms
+    // until the next attempt is due, or NOTIFICATION_IDLE when empty.
+    // Called by the task; call it directly when running without one.
+    uint32_t process();
+
+    uint8_t pending();
+    NotificationStats getStats();
+    void printReport();
+
+    // Map an HTTP status (or negative transport error) to a result
+    static NotificationResult classifyHttpStatus(int httpCode);
+};
+
+#endif // NOTIFICATION_QUEUE_H
@@ -0,0 +1,260 @@
+#include "PageCache.h"
+#include <esp_heap_caps.h>
+
+static const char* pageNames[PAGE_COUNT] = {"splash", "status", "forecast", "error", "history"};
+
+PageCache::PageCache(Display& display)
+    : display(display), sprite(&display.getTFT()), ready(false) {
+    chunk[0] = nullptr;
+    chunk[1] = nullptr;
+    for (int i = 0; i < PAGE_COUNT; i++) {
+        pages[i].runs = nullptr;
+        pages[i].words = 0;
+        memset(&pages[i].stats, 0, sizeof(PageStats));
+    }
+}
+
+PageCache::~PageCache() {
+    invalidateAll();
+    sprite.deleteSprite();
+    heap_caps_free(chunk[0]);
+    heap_caps_free(chunk[1]);
+}
+
+bool PageCache::begin() {
+    if (ready) return true;
+
+    if (!psramFound()) {
+        Serial.println("PageCache: no PSRAM, pages will be drawn directly");
+        return false;
+    }
+
+    // Full-screen 16-bit capture target; TFT_eSprite places it in PSRAM
+    sprite.setColorDepth(16);
+    sprite.setAttribute(PSRAM_ENABLE, true);
+    if (!sprite.createSprite(display.getWidth(), display.getHeight())) {
+        Serial.println("PageCache: failed to allocate capture sprite");
+        return false;
+    }
+
+    // DMA needs internal memory for the line buffers
+    size_t chunkBytes = PAGE_CACHE_CHUNK_PIXELS * sizeof(uint16_t);
+    chunk[0] = (uint16_t*)heap_caps_malloc(chunkBytes, MALLOC_CAP_DMA);
+    chunk[1] = (uint16_t*)heap_caps_malloc(chunkBytes, MALLOC_CAP_DMA);
+    if (!chunk[0] || !chunk[1]) {
+        Serial.println("PageCache: failed to allocate DMA buffers");
+        sprite.deleteSprite();
+        return false;
+    }
+
+    display.getTFT().initDMA();
+    ready = true;
+    return true;
+}
+
+bool PageCache::compress(Page& page) {
+    const uint16_t* pixels = (const uint16_t*)sprite.getPointer();
+    uint32_t total = (uint32_t)display.getWidth() * display.getHeight();
+    if (!pixels || total == 0) return false;
+
+    // First pass: count runs so the page is allocated exactly once
+    uint32_t runCount = 0;
+    uint32_t i = 0;
+    while (i < total) {
+        uint16_t color = pixels[i];
+        uint32_t run = 1;
+        while (i + run < total && pixels[i + run] == color && run < 0xFFFF) run++;
+        i += run;
+        runCount++;
+    }
+
+    uint32_t words = runCount * 2;
+    uint16_t* runs = (uint16_t*)heap_caps_malloc(words * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    if (!runs) return false;
+
+    // Second pass: emit (length, pixel) pairs
+    uint32_t out = 0;
+    i = 0;
+    while (i < total) {
+        uint16_t color = pixels[i];
+        uint32_t run = 1;
+        while (i + run < total && pixels[i + run] == color && run < 0xFFFF) run++;
+        runs[out++] = (uint16_t)run;
+        runs[out++] = color;
+        i += run;
+    }
+
+    release(page);
+    page.runs = runs;
+    page.words = words;
+    page.stats.compressedBytes = words * sizeof(uint16_t);
+    page.stats.rawBytes = total * sizeof(uint16_t);
+    return true;
+}
+
+void PageCache::push(const Page& page) {
+    TFT_eSPI& tft = display.getTFT();
+
+    // Sprite pixels are already in panel byte order
+    bool swap = tft.getSwapBytes();
+    tft.setSwapBytes(false);
+
+    tft.startWrite();
+    tft.setAddrWindow(0, 0, display.getWidth(), display.getHeight());
+
+    // Decode into one buffer while the other is in flight; pushPixelsDMA
+    // waits for the previous transfer before starting the next one
+    uint8_t active = 0;
+    uint32_t fill = 0;
+    for (uint32_t i = 0; i < page.words; i += 2) {
+        uint32_t run = page.runs[i];
+        uint16_t color = page.runs[i + 1];
+        while (run > 0) {
+            uint32_t n = min(run, (uint32_t)PAGE_CACHE_CHUNK_PIXELS - fill);
+            uint16_t* dst = chunk[active] + fill;
+            for (uint32_t k = 0; k < n; k++) dst[k] = color;
+            fill += n;
+            run -= n;
+            if (fill == PAGE_CACHE_CHUNK_PIXELS) {
+                tft.pushPixelsDMA(chunk[active], fill);
+                active ^= 1;
+                fill = 0;
+            }
+        }
+    }
+    if (fill > 0) {
+        tft.pushPixelsDMA(chunk[active], fill);
+    }
+
+    tft.dmaWait();
+    tft.endWrite();
+    tft.setSwapBytes(swap);
+}
+
+void PageCache::release(Page& page) {
+    if (page.runs) {
+        heap_caps_free(page.runs);
+        page.runs = nullptr;
+    }
+    page.words = 0;
+    page.stats.compressedBytes = 0;
+}
+
+bool PageCache::show(PageId id, uint32_t inputHash, const RenderFn& render) {
+    if (id >= PAGE_COUNT) return false;
+
+    if (!ready) {
+        render(display);
+        return false;
+    }
+
+    Page& page = pages[id];
+    uint32_t start = micros();
+
+    if (page.stats.valid && page.stats.inputHash == inputHash) {
+        push(page);
+        page.stats.hits++;
+        page.stats.lastSwitchUs = micros() - start;
+        return true;
+    }
+
+    // Miss: draw off-screen, keep the compressed copy, then show it
+    display.setCanvas(&sprite);
+    render(display);
+    display.setCanvas(nullptr);
+
+    page.stats.valid = compress(page);
+    page.stats.inputHash = inputHash;
+    page.stats.misses++;
+
+    sprite.pushSprite(0, 0);
+    page.stats.lastRenderUs = micros() - start;
+    return page.stats.valid;
+}
+
+bool PageCache::showSplashScreen() {
+    // The splash screen has no inputs, so it is rendered once per boot
+    return show(PAGE_SPLASH, 0, [](Display& d) { d.showSplashScreen(); });
+}
+
+bool PageCache::showDailyForecast(const DailyForecast& forecast) {
+    return show(PAGE_FORECAST, hashForecast(forecast),
+                [&forecast](Display& d) { d.showDailyForecast(forecast); });
+}
+
+bool PageCache::showError(const String& error) {
+    return show(PAGE_ERROR, hashString(error), [&error](Display& d) { d.showError(error); });
+}
+
+void PageCache::invalidate(PageId id) {
+    if (id >= PAGE_COUNT) return;
+    release(pages[id]);
+    pages[id].stats.valid = false;
+}
+
+void PageCache::invalidateAll() {
+    for (int i = 0; i < PAGE_COUNT; i++) {
+        invalidate((PageId)i);
+    }
+}
+
+PageStats PageCache::getStats(PageId id) {
+    if (id >= PAGE_COUNT) {
+        PageStats empty;
+        memset(&empty, 0, sizeof(empty));
+        return empty;
+    }
+    return pages[id].stats;
+}
+
+uint32_t PageCache::getTotalBytes() {
+    uint32_t total = 0;
+    for (int i = 0; i < PAGE_COUNT; i++) {
+        total += pages[i].stats.compressedBytes;
+    }
+    return total;
+}
+
+void PageCache::printReport() {
+    Serial.println("Page cache (RLE in PSRAM):");
+    for (int i = 0; i < PAGE_COUNT; i++) {
+        const PageStats& s = pages[i].stats;
+        if (!s.valid) {
+            Serial.printf("  %-8s not cached\n", pageNames[i]);
+            continue;
+        }
+        Serial.printf("  %-8s %6lu B (%4.1f%% of %lu B)  switch %5lu us  render %6lu us  hits %lu  misses %lu\n",
+                      pageNames[i], (unsigned long)s.compressedBytes,
+                      100.0f * s.compressedBytes / s.rawBytes, (unsigned long)s.rawBytes,
+                      (unsigned long)s.lastSwitchUs, (unsigned long)s.lastRenderUs,
+                      (unsigned long)s.hits, (unsigned long)s.misses);
+    }
+    Serial.printf("  total    %6lu B\n", (unsigned long)getTotalBytes());
+}
+
+uint32_t PageCache::hashBytes(const void* data, size_t length, uint32_t seed) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t hash = seed;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t PageCache::hashString(const String& text) {
+    return hashBytes(text.c_str(), text.length());
+}
+
+uint32_t PageCache::hashForecast(const DailyForecast& forecast) {
+    uint32_t hash = hashString(forecast.date);
+    hash = hashBytes(&forecast.totalIrradiance, sizeof(float), hash);
+    // Drawn in the footer, so part of the page
+    hash = hashBytes(&forecast.sunrise, sizeof(float), hash);
+    hash = hashBytes(&forecast.sunset, sizeof(float), hash);
+    for (const auto& hourData : forecast.hourlyData) {
+        hash = hashBytes(&hourData.hour, sizeof(int), hash);
+        hash = hashBytes(&hourData.irradiance, sizeof(float), hash);
+    }
+    return hash;
+}
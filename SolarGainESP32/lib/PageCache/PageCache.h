@@ -0,0 +1,94 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <functional>
+#include "../Display/Display.h"
+
+// Pixels decoded per DMA chunk (two chunk buffers are kept in internal RAM)
+#ifndef PAGE_CACHE_CHUNK_PIXELS
+#define PAGE_CACHE_CHUNK_PIXELS 2048
+#endif
+
+enum PageId : uint8_t {
+    PAGE_SPLASH,
+    PAGE_STATUS,
+    PAGE_FORECAST,
+    PAGE_ERROR,
+    PAGE_HISTORY,
+    PAGE_COUNT
+};
+
+struct PageStats {
+    bool valid;
+    uint32_t inputHash;       // hash of the data the page was rendered from
+    uint32_t compressedBytes; // RLE size held in PSRAM
+    uint32_t rawBytes;        // uncompressed frame size
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t lastRenderUs;    // full render + compress on a miss
+    uint32_t lastSwitchUs;    // decompress + push on a hit
+};
+
+class PageCache {
+public:
+    typedef std::function<void(Display&)> RenderFn;
+
+private:
+    Display& display;
+    TFT_eSprite sprite;   // full-screen capture target in PSRAM
+    uint16_t* chunk[2];   // DMA line buffers
+    bool ready;
+
+    // RLE-compressed page: alternating (run length, pixel) words
+    struct Page {
+        uint16_t* runs;
+        uint32_t words;
+        PageStats stats;
+    };
+    Page pages[PAGE_COUNT];
+
+    // Compress the sprite contents into a page slot
+    bool compress(Page& page);
+
+    // Decode a page and stream it to the panel through DMA
+    void push(const Page& page);
+
+    void release(Page& page);
+
+public:
+    PageCache(Display& display);
+    ~PageCache();
+
+    // Allocate the capture sprite and DMA buffers; requires display.begin()
+    bool begin();
+
+    // Show a page, re-rendering only when inputHash differs from the cached copy
+    bool show(PageId page, uint32_t inputHash, const RenderFn& render);
+
+    // Convenience wrappers for the built-in screens
+    bool showSplashScreen();
+    bool showDailyForecast(const DailyForecast& forecast);
+    bool showError(const String& error);
+
+    // Drop cached pages
+    void invalidate(PageId page);
+    void invalidateAll();
+
+    // Per-page memory and latency figures
+    PageStats getStats(PageId page);
+    uint32_t getTotalBytes();
+
+    // Print memory budget and switch latency for every page to Serial
+    void printReport();
+
+    // Input hashes (FNV-1a)
+    static uint32_t hashBytes(const void* data, size_t length, uint32_t seed = 2166136261u);
+    static uint32_t hashString(const String& text);
+    static uint32_t hashForecast(const DailyForecast& forecast);
+
+    bool isReady() { return ready; }
+};
+
+#endif // PAGE_CACHE_H
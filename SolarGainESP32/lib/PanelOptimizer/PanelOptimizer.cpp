@@ -0,0 +1,298 @@
+#include "PanelOptimizer.h"
+#include <math.h>
+#include "../SolarCalc/SolarCalc.h"
+#include "../EpochTime/EpochTime.h"
+#include "../Trace/Trace.h"
+
+static const float DEG = PI / 180.0;
+
+static float clampTo(float value, float low, float high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+static float wrapAzimuth(float azimuth) {
+    azimuth = fmodf(azimuth, 360.0f);
+    return azimuth < 0 ? azimuth + 360.0f : azimuth;
+}
+
+PanelOptimizer::PanelOptimizer()
+    : diffuseSum(0), groundSum(0), hasHorizon(false), weights(flatWeights()), inverterLimit(0), evaluations(0) {
+    memset(&horizon, 0, sizeof(horizon));
+}
+
+YieldWeights PanelOptimizer::flatWeights() {
+    YieldWeights flat;
+    for (int hour = 0; hour < 24; hour++) flat.hour[hour] = 1.0f;
+    for (int month = 0; month < 12; month++) flat.month[month] = 1.0f;
+    return flat;
+}
+
+void PanelOptimizer::setHorizon(const HorizonMask* mask) {
+    hasHorizon = mask != nullptr;
+    if (mask) horizon = *mask;
+}
+
+void PanelOptimizer::setWeights(const YieldWeights& yieldWeights) {
+    weights = yieldWeights;
+}
+
+float PanelOptimizer::horizonAt(float azimuthDegrees) const {
+    float position = wrapAzimuth(azimuthDegrees) / (360.0f / HORIZON_SECTORS);
+    int sector = (int)position;
+    float f = position - sector;
+    sector %= HORIZON_SECTORS;
+    return horizon.elevation[sector] + (horizon.elevation[(sector + 1) % HORIZON_SECTORS] - horizon.elevation[sector]) * f;
+}
+
+void PanelOptimizer::load(float latitude, float longitude, float elevation, int year, const TimeZone* zone) {
+    TRACE_SCOPE("optimizer.load");
+    sunEast.clear();
+    sunNorth.clear();
+    sunUp.clear();
+    beam.clear();
+    diffuse.clear();
+    weight.clear();
+    diffuseSum = 0;
+    groundSum = 0;
+
+    SolarCalc solar(latitude, longitude, elevation, 0, 0);
+    if (zone) solar.setTimeZone(zone);
+
+    int days = EpochTime::daysInYear(year);
+    int64_t firstDay = EpochTime::daysFromCivil(year, 1, 1);
+    for (int offset = 0; offset < days; offset += OPTIMIZER_DAY_STEP) {
+        int y, month, day;
+        EpochTime::civilFromDays(firstDay + offset, y, month, day);
+        float span = offset + OPTIMIZER_DAY_STEP <= days ? OPTIMIZER_DAY_STEP : days - offset;
+        float dayWeight = span * weights.month[month - 1] / 1000.0f;
+        if (dayWeight == 0) continue;
+
+        const SkyHour* sky = solar.getSky(y, month, day);
+        for (int hour = 0; hour < 24; hour++) {
+            float w = dayWeight * weights.hour[hour];
+            if (sky[hour].elevation <= 0 || w == 0) continue;
+
+            float sinElevation = sinf(sky[hour].elevation);
+            float cosElevation = cosf(sky[hour].elevation);
+            float dni = sky[hour].dni;
+            if (hasHorizon && sky[hour].elevation < horizonAt(sky[hour].azimuth / DEG) * DEG) dni = 0;
+
+            sunEast.push_back(cosElevation * sinf(sky[hour].azimuth));
+            sunNorth.push_back(cosElevation * cosf(sky[hour].azimuth));
+            sunUp.push_back(sinElevation);
+            beam.push_back(dni);
+            diffuse.push_back(sky[hour].dhi);
+            weight.push_back(w);
+            diffuseSum += w * sky[hour].dhi;
+            groundSum += w * SOLAR_ALBEDO * (dni * sinElevation + sky[hour].dhi);
+        }
+    }
+}
+
+float PanelOptimizer::planeYield(float tilt, float azimuth) const {
+    float nx = sinf(tilt * DEG) * sinf(azimuth * DEG);
+    float ny = sinf(tilt * DEG) * cosf(azimuth * DEG);
+    float nz = cosf(tilt * DEG);
+
+    // Beam: the only part that is not linear in the panel normal
+    float direct = 0;
+    size_t count = sunUp.size();
+    for (size_t i = 0; i < count; i++) {
+        float cosIncidence = nx * sunEast[i] + ny * sunNorth[i] + nz * sunUp[i];
+        if (cosIncidence > 0) direct += weight[i] * beam[i] * cosIncidence;
+    }
+    return direct + diffuseSum * (1 + nz) / 2 + groundSum * (1 - nz) / 2;
+}
+
+float PanelOptimizer::clippedYield(const std::vector<PlaneAngles>& angles, const std::vector<RoofPlane>& planes) const {
+    size_t planeCount = planes.size();
+    std::vector<float> normals(planeCount * 3);
+    float skyFactor = 0, groundFactor = 0;
+    for (size_t p = 0; p < planeCount; p++) {
+        float tilt = angles[p].tilt * DEG, azimuth = angles[p].azimuth * DEG;
+        normals[p * 3] = planes[p].share * sinf(tilt) * sinf(azimuth);
+        normals[p * 3 + 1] = planes[p].share * sinf(tilt) * cosf(azimuth);
+        normals[p * 3 + 2] = planes[p].share * cosf(tilt);
+        skyFactor += planes[p].share * (1 + cosf(tilt)) / 2;
+        groundFactor += planes[p].share * SOLAR_ALBEDO * (1 - cosf(tilt)) / 2;
+    }
+
+    float total = 0;
+    size_t count = sunUp.size();
+    for (size_t i = 0; i < count; i++) {
+        float power = diffuse[i] * skyFactor + (beam[i] * sunUp[i] + diffuse[i]) * groundFactor;
+        for (size_t p = 0; p < planeCount; p++) {
+            float cosIncidence = normals[p * 3] * sunEast[i] + normals[p * 3 + 1] * sunNorth[i] +
+                                 normals[p * 3 + 2] * sunUp[i];
+            if (cosIncidence > 0) power += beam[i] * cosIncidence;
+        }
+        total += weight[i] * (power < inverterLimit ? power : inverterLimit);
+    }
+    return total;
+}
+
+float PanelOptimizer::yield(const std::vector<PlaneAngles>& angles, const std::vector<RoofPlane>& planes) const {
+    if (angles.size() != planes.size()) return 0;
+    if (inverterLimit > 0) return clippedYield(angles, planes);
+
+    float total = 0;
+    for (size_t p = 0; p < planes.size(); p++) {
+        total += planes[p].share * planeYield(angles[p].tilt, angles[p].azimuth);
+    }
+    return total;
+}
+
+float PanelOptimizer::blockYield(int k, float tilt, float azimuth, std::vector<PlaneAngles>& angles,
+                                 const std::vector<RoofPlane>& planes) {
+    evaluations++;
+    angles[k].tilt = tilt;
+    angles[k].azimuth = azimuth;
+    for (size_t p = 0; p < planes.size(); p++) {
+        if (planes[p].mirrorOf != k) continue;
+        angles[p].tilt = tilt;
+        angles[p].azimuth = wrapAzimuth(azimuth + 180.0f);
+    }
+    if (inverterLimit > 0) return clippedYield(angles, planes);
+
+    // Without a limit the planes are independent; only this block changes
+    float total = 0;
+    for (size_t p = 0; p < planes.size(); p++) {
+        if ((int)p == k || planes[p].mirrorOf == k) {
+            total += planes[p].share * planeYield(angles[p].tilt, angles[p].azimuth);
+        }
+    }
+    return total;
+}
+
+void PanelOptimizer::searchPlane(int k, std::vector<PlaneAngles>& angles, const std::vector<RoofPlane>& planes) {
+    const RoofPlane& plane = planes[k];
+    float tiltLow = clampTo(plane.tiltMin, 0, 90);
+    float tiltHigh = clampTo(plane.tiltMax, tiltLow, 90);
+
+    // Azimuth as an offset from azimuthMin; a full circle wraps instead of clamping
+    float span = plane.azimuthMax - plane.azimuthMin;
+    bool fullCircle = span >= 360.0f;
+    if (span < 0) span += 360.0f;
+    if (fullCircle) span = 360.0f;
+
+    // Coarse grid over the whole range
+    int tiltSteps = (int)ceilf((tiltHigh - tiltLow) / OPTIMIZER_TILT_GRID);
+    int azimuthSteps = (int)ceilf(span / OPTIMIZER_AZIMUTH_GRID);
+    float bestTilt = tiltLow, bestOffset = 0, best = -1;
+    for (int i = 0; i <= tiltSteps; i++) {
+        float tilt = tiltSteps ? tiltLow + (tiltHigh - tiltLow) * i / tiltSteps : tiltLow;
+        for (int j = 0; j <= azimuthSteps - (fullCircle ? 1 : 0); j++) {
+            float offset = azimuthSteps ? span * j / azimuthSteps : 0;
+            float value = blockYield(k, tilt, wrapAzimuth(plane.azimuthMin + offset), angles, planes);
+            if (value > best) {
+                best = value;
+                bestTilt = tilt;
+                bestOffset = offset;
+            }
+        }
+    }
+
+    // Pattern search from the best cell: move to the best of the eight
+    // neighbours while one improves, otherwise halve the steps
+    float tiltStep = OPTIMIZER_TILT_GRID / 2, azimuthStep = OPTIMIZER_AZIMUTH_GRID / 2;
+    while (tiltStep >= OPTIMIZER_RESOLUTION || azimuthStep >= OPTIMIZER_RESOLUTION) {
+        float moveTilt = bestTilt, moveOffset = bestOffset, moveValue = best;
+        for (int dt = -1; dt <= 1; dt++) {
+            for (int da = -1; da <= 1; da++) {
+                if (dt == 0 && da == 0) continue;
+                float tilt = clampTo(bestTilt + dt * tiltStep, tiltLow, tiltHigh);
+                float offset = bestOffset + da * azimuthStep;
+                offset = fullCircle ? wrapAzimuth(offset) : clampTo(offset, 0, span);
+                if (tilt == bestTilt && offset == bestOffset) continue;
+
+                float value = blockYield(k, tilt, wrapAzimuth(plane.azimuthMin + offset), angles, planes);
+                if (value > moveValue) {
+                    moveValue = value;
+                    moveTilt = tilt;
+                    moveOffset = offset;
+                }
+            }
+        }
+        if (moveValue > best) {
+            best = moveValue;
+            bestTilt = moveTilt;
+            bestOffset = moveOffset;
+        } else {
+            tiltStep /= 2;
+            azimuthStep /= 2;
+        }
+    }
+
+    blockYield(k, bestTilt, wrapAzimuth(plane.azimuthMin + bestOffset), angles, planes);
+}
+
+OptimizerResult PanelOptimizer::optimize() {
+    std::vector<RoofPlane> single(1);
+    single[0].share = 1;
+    single[0].tiltMin = 0;
+    single[0].tiltMax = 90;
+    single[0].azimuthMin = 0;
+    single[0].azimuthMax = 360;
+    single[0].mirrorOf = -1;
+    return optimize(single);
+}
+
+OptimizerResult PanelOptimizer::optimize(const std::vector<RoofPlane>& planes) {
+    TRACE_SCOPE("optimizer.search");
+    OptimizerResult result;
+    result.yield = 0;
+    result.evaluations = 0;
+    evaluations = 0;
+
+    // A mirror must follow an earlier plane that is not itself a mirror
+    int freePlanes = 0;
+    for (size_t p = 0; p < planes.size(); p++) {
+        int mirror = planes[p].mirrorOf;
+        if (mirror >= (int)p || (mirror >= 0 && planes[mirror].mirrorOf >= 0)) return result;
+        if (mirror < 0) freePlanes++;
+    }
+    if (freePlanes == 0 || sunUp.empty()) return result;
+
+    // Start each plane mid-range, then search the free planes one at a time
+    std::vector<PlaneAngles> angles(planes.size());
+    for (size_t p = 0; p < planes.size(); p++) {
+        float span = planes[p].azimuthMax - planes[p].azimuthMin;
+        if (span < 0) span += 360.0f;
+        angles[p].tilt = clampTo((planes[p].tiltMin + planes[p].tiltMax) / 2, 0, 90);
+        angles[p].azimuth = wrapAzimuth(planes[p].azimuthMin + (span < 360.0f ? span / 2 : 180.0f));
+    }
+    for (size_t p = 0; p < planes.size(); p++) {
+        if (planes[p].mirrorOf >= 0) {
+            angles[p].tilt = angles[planes[p].mirrorOf].tilt;
+            angles[p].azimuth = wrapAzimuth(angles[planes[p].mirrorOf].azimuth + 180.0f);
+        }
+    }
+
+    // Independent planes need one pass. Under a shared inverter limit each
+    // plane's best depends on the others: start from the unlimited answer
+    // and repeat until the yield settles.
+    int rounds = 1;
+    if (inverterLimit > 0 && freePlanes > 1) {
+        float limit = inverterLimit;
+        inverterLimit = 0;
+        for (size_t p = 0; p < planes.size(); p++) {
+            if (planes[p].mirrorOf < 0) searchPlane(p, angles, planes);
+        }
+        inverterLimit = limit;
+        rounds = 6;
+    }
+    float previous = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (size_t p = 0; p < planes.size(); p++) {
+            if (planes[p].mirrorOf < 0) searchPlane(p, angles, planes);
+        }
+        float total = yield(angles, planes);
+        if (round > 0 && total - previous <= total * 1e-5f) break;
+        previous = total;
+    }
+
+    result.planes = angles;
+    result.yield = yield(angles, planes);
+    result.evaluations = evaluations;
+    return result;
+}
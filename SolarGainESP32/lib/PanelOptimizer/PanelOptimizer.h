@@ -0,0 +1,140 @@
+#ifndef PANEL_OPTIMIZER_H
+#define PANEL_OPTIMIZER_H
+
+#include <Arduino.h>
+#include <vector>
+#include "../EpochTime/TimeZone.h"
+
+// Sampled dates are this many days apart, each standing for the days up to
+// the next. Every day on the host; every 4th on the device keeps the sun
+// table near 25 KB.
+#ifndef OPTIMIZER_DAY_STEP
+#ifdef HOST_BUILD
+#define OPTIMIZER_DAY_STEP 1
+#else
+#define OPTIMIZER_DAY_STEP 4
+#endif
+#endif
+
+// Coarse grid before the fine search, degrees
+#ifndef OPTIMIZER_TILT_GRID
+#define OPTIMIZER_TILT_GRID 5.0f
+#endif
+#ifndef OPTIMIZER_AZIMUTH_GRID
+#define OPTIMIZER_AZIMUTH_GRID 10.0f
+#endif
+
+// The fine search stops when its tilt step falls below this, degrees
+#ifndef OPTIMIZER_RESOLUTION
+#define OPTIMIZER_RESOLUTION 0.05f
+#endif
+
+#define HORIZON_SECTORS 36
+
+// Skyline seen from the array: the lowest visible sun elevation in degrees,
+// sector i centred on azimuth i * 10, interpolated between sectors. Blocks
+// the beam, on the panel and on the ground; diffuse stays isotropic as in
+// SolarCalc.
+struct HorizonMask {
+    float elevation[HORIZON_SECTORS];
+};
+
+// What an hour of yield is worth. Hours are wall-clock hours in the zone
+// passed to load() (UTC without one); a month weight of 0 leaves the month
+// out, so {0,0,0,0,0,1,1,1,0,0,0,0} optimises for winter in the south.
+struct YieldWeights {
+    float hour[24];
+    float month[12];
+};
+
+// One plane of a roof. Shares are fractions of the array and should sum to 1.
+// An azimuth range with min > max wraps through north (e.g. 270..90); min ==
+// max fixes it, and 0..360 leaves it free. A plane with mirrorOf set is the
+// other side of a gable: the same tilt, facing the opposite way, and its own
+// ranges are ignored.
+struct RoofPlane {
+    float share;
+    float tiltMin;
+    float tiltMax;
+    float azimuthMin;
+    float azimuthMax;
+    int mirrorOf;         // -1, or the index of an earlier plane
+};
+
+struct PlaneAngles {
+    float tilt;
+    float azimuth;        // degrees clockwise from north, 0..360
+};
+
+struct OptimizerResult {
+    std::vector<PlaneAngles> planes;
+    float yield;              // weighted kWh/m² of array over the year
+    uint32_t evaluations;     // yields computed during the search
+};
+
+// Finds the panel angles that maximise weighted clear-sky yield. load()
+// tabulates every sun-up hour of the year once, from SolarCalc::getSky(),
+// with the horizon and weights applied; each yield after that is one pass
+// over the table with no trigonometry. The search is a coarse grid per
+// plane then a pattern search down to OPTIMIZER_RESOLUTION.
+class PanelOptimizer {
+private:
+    // Sun-up hours of the year as parallel arrays
+    std::vector<float> sunEast;       // unit vector towards the sun
+    std::vector<float> sunNorth;
+    std::vector<float> sunUp;
+    std::vector<float> beam;          // DNI, 0 behind the horizon mask, W/m²
+    std::vector<float> diffuse;       // DHI, W/m²
+    std::vector<float> weight;        // days represented x weights / 1000, to kWh
+
+    // Sums over the table for the linear parts of the model
+    float diffuseSum;                 // weighted DHI
+    float groundSum;                  // weighted GHI x albedo
+
+    HorizonMask horizon;
+    bool hasHorizon;
+    YieldWeights weights;
+    float inverterLimit;              // W/m² of array; 0 for none
+    uint32_t evaluations;
+
+    float horizonAt(float azimuthDegrees) const;
+
+    // Yield of one plane alone, per m² of that plane
+    float planeYield(float tilt, float azimuth) const;
+
+    // Yield of the whole array; with an inverter limit this is the only
+    // form, since the planes share the limit hour by hour
+    float clippedYield(const std::vector<PlaneAngles>& angles, const std::vector<RoofPlane>& planes) const;
+
+    // What moving plane k (and its mirrors) to these angles gives, with the
+    // other planes where they are
+    float blockYield(int k, float tilt, float azimuth, std::vector<PlaneAngles>& angles,
+                     const std::vector<RoofPlane>& planes);
+
+    void searchPlane(int k, std::vector<PlaneAngles>& angles, const std::vector<RoofPlane>& planes);
+
+public:
+    PanelOptimizer();
+
+    // Set before load(); they are folded into the table
+    void setHorizon(const HorizonMask* mask);       // nullptr: open horizon
+    void setWeights(const YieldWeights& weights);
+    static YieldWeights flatWeights();
+
+    // Combined output above this many W/m² of array is lost; 0 for no limit
+    void setInverterLimit(float wattsPerSquareMeter) { inverterLimit = wattsPerSquareMeter; }
+
+    // Tabulate the sun for a site and year. The zone must outlive the call only.
+    void load(float latitude, float longitude, float elevation, int year, const TimeZone* zone = nullptr);
+    uint32_t getSampleCount() const { return sunUp.size(); }
+
+    // Weighted yield, kWh/m², of one plane or of a whole array
+    float yield(float tilt, float azimuth) const { return planeYield(tilt, azimuth); }
+    float yield(const std::vector<PlaneAngles>& angles, const std::vector<RoofPlane>& planes) const;
+
+    // Best angles for one unconstrained plane, or for each plane of a roof
+    OptimizerResult optimize();
+    OptimizerResult optimize(const std::vector<RoofPlane>& planes);
+};
+
+#endif // PANEL_OPTIMIZER_H
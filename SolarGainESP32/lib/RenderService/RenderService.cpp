@@ -0,0 +1,260 @@
+#include "RenderService.h"
+
+RenderService::RenderService(Display& display)
+    : display(display), taskHandle(nullptr), head(0), count(0) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool RenderService::begin(BaseType_t core, UBaseType_t priority) {
+    if (taskHandle) return true;
+
+    BaseType_t result = xTaskCreatePinnedToCore(taskEntry, "render", RENDER_TASK_STACK,
+                                                this, priority, &taskHandle, core);
+    if (result != pdPASS) {
+        taskHandle = nullptr;
+        Serial.println("Failed to start render task");
+        return false;
+    }
+
+    Serial.println("Render task started on core " + String((int)core));
+    return true;
+}
+
+void RenderService::taskEntry(void* arg) {
+    static_cast<RenderService*>(arg)->run();
+}
+
+void RenderService::run() {
+    RenderCommand cmd;
+    for (;;) {
+        // Sleep until a producer signals new work
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (take(cmd)) {
+            uint32_t start = micros();
+            execute(cmd);
+            uint32_t end = micros();
+            recordLatency(end - cmd.enqueuedAt, end - start);
+        }
+    }
+}
+
+bool RenderService::isFullScreen(RenderCommandType type) {
+    return type == RENDER_FORECAST || type == RENDER_LOADING || type == RENDER_ERROR;
+}
+
+bool RenderService::sameRegion(const RenderCommand& a, const RenderCommand& b) {
+    if (a.type != b.type) return false;
+    if (a.type == RENDER_HOUR_BAR) return a.bar.hour == b.bar.hour;
+    return true;
+}
+
+bool RenderService::submit(const RenderCommand& cmd) {
+    bool accepted = true;
+    bool merged = false;
+
+    portENTER_CRITICAL(&lock);
+    stats.submitted++;
+
+    if (isFullScreen(cmd.type)) {
+        // A full redraw clears the screen, so drop every pending draw but keep
+        // brightness changes, which are not part of the frame
+        uint8_t kept = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            const RenderCommand& pending = queue[(head + i) % RENDER_QUEUE_LENGTH];
+            if (pending.type == RENDER_BRIGHTNESS) {
+                queue[(head + kept) % RENDER_QUEUE_LENGTH] = pending;
+                kept++;
+            } else {
+                stats.coalesced++;
+            }
+        }
+        count = kept;
+    } else {
+        // Replace a pending command that covers the same region in place
+        for (uint8_t i = 0; i < count; i++) {
+            RenderCommand& pending = queue[(head + i) % RENDER_QUEUE_LENGTH];
+            if (sameRegion(pending, cmd)) {
+                uint32_t enqueuedAt = pending.enqueuedAt;
+                pending = cmd;
+                pending.enqueuedAt = enqueuedAt; // latency is measured from the oldest request
+                stats.coalesced++;
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (!merged) {
+        if (count < RENDER_QUEUE_LENGTH) {
+            queue[(head + count) % RENDER_QUEUE_LENGTH] = cmd;
+            count++;
+            if (count > stats.maxQueueDepth) stats.maxQueueDepth = count;
+        } else {
+            stats.dropped++;
+            accepted = false;
+        }
+    }
+    stats.queueDepth = count;
+    portEXIT_CRITICAL(&lock);
+
+    if (accepted && taskHandle) xTaskNotifyGive(taskHandle);
+    return accepted;
+}
+
+bool RenderService::take(RenderCommand& cmd) {
+    bool available = false;
+
+    portENTER_CRITICAL(&lock);
+    if (count > 0) {
+        cmd = queue[head];
+        head = (head + 1) % RENDER_QUEUE_LENGTH;
+        count--;
+        stats.queueDepth = count;
+        available = true;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    return available;
+}
+
+void RenderService::execute(const RenderCommand& cmd) {
+    switch (cmd.type) {
+        case RENDER_FORECAST: {
+            DailyForecast forecast;
+            forecast.totalIrradiance = cmd.forecast.total;
+            forecast.date = cmd.forecast.date;
+            forecast.sunrise = cmd.forecast.sunrise;
+            forecast.sunset = cmd.forecast.sunset;
+            forecast.hourlyData.reserve(24);
+            for (int hour = 0; hour < 24; hour++) {
+                HourlyIrradiance hourData;
+                hourData.hour = hour;
+                hourData.irradiance = cmd.forecast.hourly[hour];
+                forecast.hourlyData.push_back(hourData);
+            }
+            display.showDailyForecast(forecast);
+            break;
+        }
+        case RENDER_HOUR_BAR:
+            display.updateHourBar(cmd.bar.hour, cmd.bar.value, cmd.bar.maxValue);
+            break;
+        case RENDER_STATUS:
+            display.showStatus(cmd.status.time, cmd.status.text, cmd.status.wifiConnected);
+            break;
+        case RENDER_BRIGHTNESS:
+            display.setBrightness(cmd.brightness);
+            break;
+        case RENDER_LOADING:
+            display.showLoading(cmd.message.text);
+            break;
+        case RENDER_ERROR:
+            display.showError(cmd.message.text);
+            break;
+    }
+}
+
+void RenderService::recordLatency(uint32_t latencyUs, uint32_t renderUs) {
+    portENTER_CRITICAL(&lock);
+    stats.rendered++;
+    stats.lastLatencyUs = latencyUs;
+    stats.lastRenderUs = renderUs;
+    if (latencyUs > stats.maxLatencyUs) stats.maxLatencyUs = latencyUs;
+
+    // EMA with alpha = 1/8
+    if (stats.rendered == 1) {
+        stats.avgLatencyUs = latencyUs;
+    } else {
+        stats.avgLatencyUs = stats.avgLatencyUs - (stats.avgLatencyUs >> 3) + (latencyUs >> 3);
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+bool RenderService::showDailyForecast(const DailyForecast& forecast) {
+    RenderCommand cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = RENDER_FORECAST;
+    cmd.enqueuedAt = micros();
+    cmd.forecast.total = forecast.totalIrradiance;
+    cmd.forecast.sunrise = forecast.sunrise;
+    cmd.forecast.sunset = forecast.sunset;
+    strncpy(cmd.forecast.date, forecast.date.c_str(), sizeof(cmd.forecast.date) - 1);
+    for (const auto& hourData : forecast.hourlyData) {
+        if (hourData.hour >= 0 && hourData.hour < 24) {
+            cmd.forecast.hourly[hourData.hour] = hourData.irradiance;
+        }
+    }
+    return submit(cmd);
+}
+
+bool RenderService::updateHourBar(int hour, float value, float maxValue) {
+    if (hour < 0 || hour >= 24) return false;
+
+    RenderCommand cmd;
+    cmd.type = RENDER_HOUR_BAR;
+    cmd.enqueuedAt = micros();
+    cmd.bar.hour = hour;
+    cmd.bar.value = value;
+    cmd.bar.maxValue = maxValue;
+    return submit(cmd);
+}
+
+bool RenderService::showStatus(const String& time, const String& status, bool wifiConnected) {
+    RenderCommand cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = RENDER_STATUS;
+    cmd.enqueuedAt = micros();
+    strncpy(cmd.status.time, time.c_str(), sizeof(cmd.status.time) - 1);
+    strncpy(cmd.status.text, status.c_str(), sizeof(cmd.status.text) - 1);
+    cmd.status.wifiConnected = wifiConnected;
+    return submit(cmd);
+}
+
+bool RenderService::setBrightness(uint8_t brightness) {
+    RenderCommand cmd;
+    cmd.type = RENDER_BRIGHTNESS;
+    cmd.enqueuedAt = micros();
+    cmd.brightness = brightness;
+    return submit(cmd);
+}
+
+bool RenderService::showLoading(const String& message) {
+    RenderCommand cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = RENDER_LOADING;
+    cmd.enqueuedAt = micros();
+    strncpy(cmd.message.text, message.c_str(), sizeof(cmd.message.text) - 1);
+    return submit(cmd);
+}
+
+bool RenderService::showError(const String& error) {
+    RenderCommand cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = RENDER_ERROR;
+    cmd.enqueuedAt = micros();
+    strncpy(cmd.message.text, error.c_str(), sizeof(cmd.message.text) - 1);
+    return submit(cmd);
+}
+
+RenderStats RenderService::getStats() {
+    portENTER_CRITICAL(&lock);
+    RenderStats snapshot = stats;
+    portEXIT_CRITICAL(&lock);
+    return snapshot;
+}
+
+void RenderService::resetStats() {
+    portENTER_CRITICAL(&lock);
+    uint8_t depth = stats.queueDepth;
+    memset(&stats, 0, sizeof(stats));
+    stats.queueDepth = depth;
+    portEXIT_CRITICAL(&lock);
+}
+
+uint8_t RenderService::getQueueDepth() {
+    portENTER_CRITICAL(&lock);
+    uint8_t depth = count;
+    portEXIT_CRITICAL(&lock);
+    return depth;
+}
@@ -0,0 +1,133 @@
+#ifndef RENDER_SERVICE_H
+#define RENDER_SERVICE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "../Display/Display.h"
+
+// Maximum number of pending render commands
+#ifndef RENDER_QUEUE_LENGTH
+#define RENDER_QUEUE_LENGTH 16
+#endif
+
+// Core the render task is pinned to (Arduino loop runs on core 1)
+#ifndef RENDER_TASK_CORE
+#define RENDER_TASK_CORE 0
+#endif
+
+#ifndef RENDER_TASK_PRIORITY
+#define RENDER_TASK_PRIORITY 1
+#endif
+
+#ifndef RENDER_TASK_STACK
+#define RENDER_TASK_STACK 4096
+#endif
+
+enum RenderCommandType : uint8_t {
+    RENDER_FORECAST,
+    RENDER_HOUR_BAR,
+    RENDER_STATUS,
+    RENDER_BRIGHTNESS,
+    RENDER_LOADING,
+    RENDER_ERROR
+};
+
+struct RenderCommand {
+    RenderCommandType type;
+    uint32_t enqueuedAt; // micros() when submitted
+    union {
+        struct {
+            float hourly[24];
+            float total;
+            float sunrise;
+            float sunset;
+            char date[16];
+        } forecast;
+        struct {
+            int hour;
+            float value;
+            float maxValue;
+        } bar;
+        struct {
+            char time[12];
+            char text[32];
+            bool wifiConnected;
+        } status;
+        struct {
+            char text[96];
+        } message;
+        uint8_t brightness;
+    };
+};
+
+struct RenderStats {
+    uint32_t submitted;
+    uint32_t coalesced;     // commands merged into a pending one
+    uint32_t dropped;       // commands rejected because the queue was full
+    uint32_t rendered;
+    uint8_t queueDepth;
+    uint8_t maxQueueDepth;
+    uint32_t lastLatencyUs; // submit to render complete
+    uint32_t maxLatencyUs;
+    uint32_t avgLatencyUs;  // exponential moving average
+    uint32_t lastRenderUs;  // time spent drawing the last command
+};
+
+class RenderService {
+private:
+    Display& display;
+    TaskHandle_t taskHandle;
+    portMUX_TYPE lock;
+
+    // Bounded ring of pending commands
+    RenderCommand queue[RENDER_QUEUE_LENGTH];
+    uint8_t head;
+    uint8_t count;
+
+    RenderStats stats;
+
+    // Task entry point
+    static void taskEntry(void* arg);
+    void run();
+
+    // Queue a command, merging it with pending commands for the same region
+    bool submit(const RenderCommand& cmd);
+
+    // Pop the oldest command; returns false when the queue is empty
+    bool take(RenderCommand& cmd);
+
+    // Full-screen commands repaint everything, so pending draws become redundant
+    static bool isFullScreen(RenderCommandType type);
+    static bool sameRegion(const RenderCommand& a, const RenderCommand& b);
+
+    // Execute a command against the display
+    void execute(const RenderCommand& cmd);
+
+    void recordLatency(uint32_t latencyUs, uint32_t renderUs);
+
+public:
+    RenderService(Display& display);
+
+    // Start the render task; the display must already be initialized
+    bool begin(BaseType_t core = RENDER_TASK_CORE, UBaseType_t priority = RENDER_TASK_PRIORITY);
+
+    // Non-blocking render requests; return false if the command was dropped
+    bool showDailyForecast(const DailyForecast& forecast);
+    bool updateHourBar(int hour, float value, float maxValue);
+    bool showStatus(const String& time, const String& status, bool wifiConnected);
+    bool setBrightness(uint8_t brightness);
+    bool showLoading(const String& message);
+    bool showError(const String& error);
+
+    // Snapshot of queue and latency metrics
+    RenderStats getStats();
+    void resetStats();
+
+    // Number of commands waiting to be drawn
+    uint8_t getQueueDepth();
+
+    bool isRunning() { return taskHandle != nullptr; }
+};
+
+#endif // RENDER_SERVICE_H
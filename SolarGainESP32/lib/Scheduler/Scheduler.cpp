@@ -0,0 +1,360 @@
+#include "Scheduler.h"
+#include "../Trace/Trace.h"
+#include "../EpochTime/EpochTime.h"
+
+Scheduler::Scheduler()
+    : heapSize(0), zone(&fixedZone), started(false), lastNow(0), usePreferences(false) {
+    for (uint8_t i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+        jobs[i].active = false;
+        jobs[i].name[0] = '\0';
+        jobs[i].heapIndex = -1;
+    }
+}
+
+bool Scheduler::begin(const char* ns) {
+    usePreferences = preferences.begin(ns, false);
+    return usePreferences;
+}
+
+void Scheduler::setUtcOffset(int32_t seconds) {
+    fixedZone.setFixed(seconds);
+    zone = &fixedZone;
+    rearmLocalJobs();
+}
+
+void Scheduler::setTimeZone(const TimeZone& timeZone) {
+    zone = &timeZone;
+    rearmLocalJobs();
+}
+
+void Scheduler::rearmLocalJobs() {
+    if (!started) return;
+
+    // Local-time occurrences move with the offset
+    for (int8_t id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+        if (jobs[id].name[0] && jobs[id].kind != JOB_ONCE) {
+            arm(id, max(lastNow - 1, jobs[id].lastScheduled));
+        }
+    }
+}
+
+int8_t Scheduler::addJob(const char* name, JobKind kind, int32_t param, const JobAction& action,
+                         const CatchUpPolicy& policy) {
+    int8_t id = -1;
+    for (int8_t i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+        if (!jobs[i].name[0]) {
+            id = i;
+            break;
+        }
+    }
+    if (id < 0) {
+        Serial.println("Scheduler full, cannot add " + String(name));
+        return -1;
+    }
+
+    Job& job = jobs[id];
+    strncpy(job.name, name, SCHEDULER_NAME_LENGTH);
+    job.name[SCHEDULER_NAME_LENGTH] = '\0';
+    job.kind = kind;
+    job.active = true;
+    job.event = SOLAR_SUNRISE;
+    job.param = param;
+    job.at = SCHEDULER_NEVER;
+    job.policy = policy;
+    job.action = action;
+    job.nextFire = SCHEDULER_NEVER;
+    job.lastScheduled = 0;
+    job.folded = 0;
+    job.heapIndex = -1;
+    memset(&job.stats, 0, sizeof(job.stats));
+    return id;
+}
+
+int8_t Scheduler::addDaily(const char* name, uint8_t hour, uint8_t minute, const JobAction& action,
+                           const CatchUpPolicy& policy) {
+    int8_t id = addJob(name, JOB_DAILY, (int32_t)hour * 3600 + minute * 60, action, policy);
+    if (id >= 0 && started) armFromHistory(id);
+    return id;
+}
+
+int8_t Scheduler::addInterval(const char* name, uint32_t periodS, const JobAction& action,
+                              const CatchUpPolicy& policy) {
+    if (periodS == 0) return -1;
+    int8_t id = addJob(name, JOB_INTERVAL, (int32_t)periodS, action, policy);
+    if (id >= 0 && started) armFromHistory(id);
+    return id;
+}
+
+int8_t Scheduler::addSolar(const char* name, SolarEvent event, int32_t offsetS, const JobAction& action,
+                           const CatchUpPolicy& policy) {
+    int8_t id = addJob(name, JOB_SOLAR, offsetS, action, policy);
+    if (id < 0) return id;
+    jobs[id].event = event;
+    if (started) armFromHistory(id);
+    return id;
+}
+
+int8_t Scheduler::addOnce(const char* name, time_t at, const JobAction& action, const CatchUpPolicy& policy) {
+    int8_t id = addJob(name, JOB_ONCE, 0, action, policy);
+    if (id < 0) return id;
+    jobs[id].at = at;
+    if (started) arm(id, at - 1);
+    return id;
+}
+
+void Scheduler::start(time_t now) {
+    started = true;
+    lastNow = now;
+    for (int8_t id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+        if (!jobs[id].name[0]) continue;
+        if (jobs[id].kind == JOB_ONCE) {
+            arm(id, jobs[id].at - 1);
+        } else {
+            armFromHistory(id);
+        }
+    }
+}
+
+void Scheduler::armFromHistory(int8_t id) {
+    Job& job = jobs[id];
+    // An occurrence exactly at lastNow is still due
+    time_t from = lastNow - 1;
+    if (job.policy.persist && usePreferences) {
+        time_t stored = (time_t)preferences.getULong64(job.name, 0);
+        if (stored > 0 && stored < lastNow) {
+            from = stored;
+            job.lastScheduled = stored;
+        }
+    }
+    arm(id, from);
+}
+
+bool Scheduler::reschedule(int8_t id, time_t at) {
+    if (id < 0 || id >= SCHEDULER_MAX_JOBS || !jobs[id].name[0] || jobs[id].kind != JOB_ONCE) return false;
+    jobs[id].at = at;
+    if (started) arm(id, at - 1);
+    return true;
+}
+
+bool Scheduler::setEnabled(int8_t id, bool enabled) {
+    if (id < 0 || id >= SCHEDULER_MAX_JOBS || !jobs[id].name[0]) return false;
+    jobs[id].active = enabled;
+    if (!enabled) {
+        heapRemove(id);
+    } else if (started) {
+        if (jobs[id].kind == JOB_ONCE) {
+            arm(id, jobs[id].at - 1);
+        } else {
+            arm(id, max(lastNow - 1, jobs[id].lastScheduled));
+        }
+    }
+    return true;
+}
+
+time_t Scheduler::nextOccurrence(const Job& job, time_t after) const {
+    switch (job.kind) {
+        case JOB_DAILY: {
+            // The wall-clock time today, else tomorrow; days around a change are 23 or 25 hours
+            int64_t day = EpochTime::floorDiv((int64_t)zone->toLocal(after), SECONDS_PER_DAY);
+            for (int64_t d = day; d <= day + 2; d++) {
+                time_t candidate = zone->toUtc((time_t)(d * SECONDS_PER_DAY + job.param));
+                if (candidate > after) return candidate;
+            }
+            return SCHEDULER_NEVER;
+        }
+        case JOB_INTERVAL: {
+            // Aligned to local midnight, so a 15-minute job runs at :00, :15, ...
+            int64_t anchor = -(int64_t)zone->offsetAt(after);
+            int64_t periods = EpochTime::floorDiv((int64_t)after - anchor, job.param) + 1;
+            return (time_t)(anchor + periods * job.param);
+        }
+        case JOB_SOLAR:
+            return nextSolar(job, after);
+        case JOB_ONCE:
+            return job.at > after ? job.at : SCHEDULER_NEVER;
+    }
+    return SCHEDULER_NEVER;
+}
+
+time_t Scheduler::nextSolar(const Job& job, time_t after) const {
+    if (!solarSource) return SCHEDULER_NEVER;
+
+    // From the local day before (a negative offset can pull an event back
+    // across midnight) through a year of polar days or nights
+    int64_t today = EpochTime::floorDiv((int64_t)zone->toLocal(after), SECONDS_PER_DAY);
+    for (int64_t d = today - 1; d <= today + 366; d++) {
+        int year, month, day;
+        EpochTime::civilFromDays(d, year, month, day);
+        time_t event = solarSource(year, month, day, job.event);
+        if (event == SCHEDULER_NEVER) continue;
+        time_t candidate = event + job.param;
+        if (candidate > after) return candidate;
+    }
+    return SCHEDULER_NEVER;
+}
+
+int Scheduler::runDue(time_t now) {
+    TRACE_SCOPE("scheduler.run");
+
+    lastNow = now;
+    int ran = 0;
+    while (heapSize > 0 && jobs[heap[0]].nextFire <= now) {
+        int8_t id = heap[0];
+        Job& job = jobs[id];
+        time_t due = job.nextFire;
+
+        if (job.policy.coalesce) {
+            time_t latest = due;
+            uint32_t skipped = 0;
+            if (job.kind == JOB_INTERVAL) {
+                // Straight to the latest missed period rather than stepping through each
+                skipped = (uint32_t)(((int64_t)now - due) / job.param);
+                latest += (time_t)skipped * job.param;
+            } else {
+                time_t following;
+                while ((following = nextOccurrence(job, latest)) != SCHEDULER_NEVER && following <= now) {
+                    latest = following;
+                    skipped++;
+                }
+            }
+            if (skipped > 0) {
+                // Requeue at the occurrence that will actually run, so jobs
+                // still run in the order of their scheduled instants
+                job.folded = (uint16_t)min(job.folded + skipped, (uint32_t)0xFFFF);
+                job.nextFire = latest;
+                siftDown(0);
+                continue;
+            }
+        }
+        uint16_t folded = job.folded;
+        job.folded = 0;
+
+        // Re-arm before running, so the action may reschedule or disable its own job
+        job.lastScheduled = due;
+        arm(id, due);
+
+        uint32_t lateness = (uint32_t)(now - due);
+        if (job.policy.graceS > 0 && lateness > job.policy.graceS) {
+            job.stats.skipped += 1 + folded;
+        } else {
+            job.stats.runs++;
+            job.stats.coalesced += folded;
+            job.stats.maxLatenessS = max(job.stats.maxLatenessS, lateness);
+            JobRun run = {id, job.name, due, now, folded};
+            if (job.action) job.action(run);
+            ran++;
+        }
+
+        if (job.policy.persist) saveLastRun(job);
+    }
+    return ran;
+}
+
+void Scheduler::saveLastRun(const Job& job) {
+    if (usePreferences) preferences.putULong64(job.name, (uint64_t)job.lastScheduled);
+}
+
+void Scheduler::clearHistory() {
+    if (usePreferences) preferences.clear();
+}
+
+time_t Scheduler::nextFireTime() const {
+    return heapSize > 0 ? jobs[heap[0]].nextFire : SCHEDULER_NEVER;
+}
+
+uint32_t Scheduler::secondsUntilNext(time_t now) const {
+    if (heapSize == 0) return 0xFFFFFFFFUL;
+    time_t next = jobs[heap[0]].nextFire;
+    return next <= now ? 0 : (uint32_t)min((int64_t)next - now, (int64_t)0xFFFFFFFE);
+}
+
+time_t Scheduler::getNextFire(int8_t id) const {
+    if (id < 0 || id >= SCHEDULER_MAX_JOBS) return SCHEDULER_NEVER;
+    return jobs[id].heapIndex >= 0 ? jobs[id].nextFire : SCHEDULER_NEVER;
+}
+
+const char* Scheduler::getName(int8_t id) const {
+    if (id < 0 || id >= SCHEDULER_MAX_JOBS) return "";
+    return jobs[id].name;
+}
+
+JobStats Scheduler::getStats(int8_t id) const {
+    JobStats empty = {0, 0, 0, 0};
+    if (id < 0 || id >= SCHEDULER_MAX_JOBS) return empty;
+    return jobs[id].stats;
+}
+
+void Scheduler::printReport(time_t now) {
+    for (int8_t id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+        const Job& job = jobs[id];
+        if (!job.name[0]) continue;
+        time_t next = getNextFire(id);
+        Serial.printf("%-12s next %s%-8ld %lu runs, %lu skipped, %lu coalesced, max late %lu s\n",
+                      job.name, next == SCHEDULER_NEVER ? "never" : "in ",
+                      next == SCHEDULER_NEVER ? 0L : (long)(next - now), (unsigned long)job.stats.runs,
+                      (unsigned long)job.stats.skipped, (unsigned long)job.stats.coalesced,
+                      (unsigned long)job.stats.maxLatenessS);
+    }
+}
+
+void Scheduler::arm(int8_t id, time_t from) {
+    Job& job = jobs[id];
+    heapRemove(id);
+    job.nextFire = job.active ? nextOccurrence(job, from) : SCHEDULER_NEVER;
+    if (job.nextFire != SCHEDULER_NEVER) heapPush(id);
+}
+
+bool Scheduler::earlier(int8_t a, int8_t b) const {
+    // Ties go to the job registered first, so catch-up order never varies
+    return jobs[a].nextFire < jobs[b].nextFire || (jobs[a].nextFire == jobs[b].nextFire && a < b);
+}
+
+void Scheduler::swapNodes(uint8_t a, uint8_t b) {
+    int8_t t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    jobs[heap[a]].heapIndex = a;
+    jobs[heap[b]].heapIndex = b;
+}
+
+void Scheduler::siftUp(uint8_t index) {
+    while (index > 0) {
+        uint8_t parent = (index - 1) / 2;
+        if (!earlier(heap[index], heap[parent])) break;
+        swapNodes(index, parent);
+        index = parent;
+    }
+}
+
+void Scheduler::siftDown(uint8_t index) {
+    for (;;) {
+        uint8_t smallest = index;
+        uint8_t left = 2 * index + 1;
+        uint8_t right = left + 1;
+        if (left < heapSize && earlier(heap[left], heap[smallest])) smallest = left;
+        if (right < heapSize && earlier(heap[right], heap[smallest])) smallest = right;
+        if (smallest == index) break;
+        swapNodes(index, smallest);
+        index = smallest;
+    }
+}
+
+void Scheduler::heapPush(int8_t id) {
+    heap[heapSize] = id;
+    jobs[id].heapIndex = heapSize;
+    heapSize++;
+    siftUp(heapSize - 1);
+}
+
+void Scheduler::heapRemove(int8_t id) {
+    int8_t index = jobs[id].heapIndex;
+    if (index < 0) return;
+    jobs[id].heapIndex = -1;
+    heapSize--;
+    if (index == heapSize) return;
+
+    heap[index] = heap[heapSize];
+    jobs[heap[index]].heapIndex = index;
+    siftUp(index);
+    siftDown(jobs[heap[index]].heapIndex);
+}
@@ -0,0 +1,171 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <functional>
+#include <Preferences.h>
+#include "../EpochTime/TimeZone.h"
+
+#ifndef SCHEDULER_MAX_JOBS
+#define SCHEDULER_MAX_JOBS 16
+#endif
+
+// Job names double as Preferences keys, so they are short
+#define SCHEDULER_NAME_LENGTH 12
+
+// nextFireTime() when nothing is scheduled
+#define SCHEDULER_NEVER ((time_t)0)
+
+enum JobKind : uint8_t {
+    JOB_DAILY,         // local time of day
+    JOB_INTERVAL,      // fixed period, aligned to local midnight
+    JOB_SOLAR,         // offset from sunrise or sunset
+    JOB_ONCE           // a single instant; reschedule() to re-arm
+};
+
+enum SolarEvent : uint8_t {
+    SOLAR_SUNRISE,
+    SOLAR_SUNSET
+};
+
+// What happens to occurrences missed while the device was off or asleep
+struct CatchUpPolicy {
+    uint32_t graceS;     // later than this and the occurrence is skipped (0 = always run)
+    bool coalesce;       // several missed occurrences run once, for the latest
+    bool persist;        // remember the last run across reboots
+};
+
+// Handed to the job when it runs
+struct JobRun {
+    int8_t id;
+    const char* name;
+    time_t scheduledAt;  // UTC instant of the occurrence being run
+    time_t firedAt;      // UTC when runDue() ran it
+    uint16_t coalesced;  // earlier missed occurrences folded into this run
+};
+
+typedef std::function<void(const JobRun&)> JobAction;
+
+// UTC instant of sunrise or sunset on a local date (SolarCalc::getSunriseAt()
+// and friends); SCHEDULER_NEVER when it does not happen
+typedef std::function<time_t(int year, int month, int day, SolarEvent event)> SolarEventSource;
+
+struct JobStats {
+    uint32_t runs;
+    uint32_t skipped;        // missed by more than graceS
+    uint32_t coalesced;
+    uint32_t maxLatenessS;   // firedAt - scheduledAt, worst case
+};
+
+// Event-driven job scheduler. Every job knows the UTC instant of its next
+// occurrence; a min-heap keyed on that instant makes nextFireTime() O(1),
+// so the main loop can sleep until exactly then instead of polling the
+// clock each minute. runDue() runs everything that has come due in
+// (instant, job id) order, so after a reboot or a long sleep missed
+// occurrences are caught up deterministically under each job's
+// CatchUpPolicy.
+//
+// Times are UTC seconds passed in by the caller; local-time jobs follow the
+// zone from setTimeZone(), so daily jobs keep their wall-clock time across
+// daylight-saving changes.
+class Scheduler {
+private:
+    struct Job {
+        char name[SCHEDULER_NAME_LENGTH + 1];
+        JobKind kind;
+        bool active;
+        SolarEvent event;
+        int32_t param;           // seconds after local midnight, period, or solar offset
+        time_t at;               // JOB_ONCE instant
+        CatchUpPolicy policy;
+        JobAction action;
+        time_t nextFire;         // SCHEDULER_NEVER when not armed
+        time_t lastScheduled;    // occurrence handled last (run or skipped)
+        uint16_t folded;         // missed occurrences coalesced into nextFire
+        int8_t heapIndex;        // -1 when not in the heap
+        JobStats stats;
+    };
+
+    Job jobs[SCHEDULER_MAX_JOBS];
+    int8_t heap[SCHEDULER_MAX_JOBS];
+    uint8_t heapSize;
+
+    TimeZone fixedZone;      // from setUtcOffset()
+    const TimeZone* zone;
+    SolarEventSource solarSource;
+    bool started;
+    time_t lastNow;          // from start() or the latest runDue()
+    bool usePreferences;
+    Preferences preferences;
+
+    int8_t addJob(const char* name, JobKind kind, int32_t param, const JobAction& action,
+                  const CatchUpPolicy& policy);
+
+    // First occurrence strictly after `after`, or SCHEDULER_NEVER
+    time_t nextOccurrence(const Job& job, time_t after) const;
+    time_t nextSolar(const Job& job, time_t after) const;
+
+    // Put the job in the heap at its first occurrence after `from`, or take it out
+    void arm(int8_t id, time_t from);
+
+    // Arm from the persisted last run, or from lastNow
+    void armFromHistory(int8_t id);
+
+    void heapRemove(int8_t id);
+    void heapPush(int8_t id);
+    void siftUp(uint8_t index);
+    void siftDown(uint8_t index);
+    bool earlier(int8_t a, int8_t b) const;
+    void swapNodes(uint8_t a, uint8_t b);
+
+    void saveLastRun(const Job& job);
+    void rearmLocalJobs();
+
+public:
+    Scheduler();
+
+    // Open Preferences for persisted last-run times; skip for a RAM-only scheduler
+    bool begin(const char* ns = "sched");
+
+    // A fixed offset, or a compiled zone that must outlive the scheduler
+    void setUtcOffset(int32_t seconds);
+    void setTimeZone(const TimeZone& timeZone);
+    void setSolarSource(const SolarEventSource& source) { solarSource = source; }
+
+    // Register jobs; each returns a job id, or -1 when full.
+    int8_t addDaily(const char* name, uint8_t hour, uint8_t minute, const JobAction& action,
+                    const CatchUpPolicy& policy = {0, true, true});
+    int8_t addInterval(const char* name, uint32_t periodS, const JobAction& action,
+                       const CatchUpPolicy& policy = {0, true, false});
+    int8_t addSolar(const char* name, SolarEvent event, int32_t offsetS, const JobAction& action,
+                    const CatchUpPolicy& policy = {0, true, true});
+    int8_t addOnce(const char* name, time_t at, const JobAction& action,
+                   const CatchUpPolicy& policy = {0, true, false});
+
+    // Arm every job once the clock is valid. Persisted jobs resume from their
+    // last run, so occurrences missed since then come due immediately; the
+    // rest start from now.
+    void start(time_t now);
+
+    // Move a JOB_ONCE job to a new instant (e.g. the next NTP resync)
+    bool reschedule(int8_t id, time_t at);
+    bool setEnabled(int8_t id, bool enabled);
+
+    // Run every job due at `now`; returns how many ran
+    int runDue(time_t now);
+
+    // Next occurrence across all jobs, SCHEDULER_NEVER when none
+    time_t nextFireTime() const;
+    uint32_t secondsUntilNext(time_t now) const;
+    int8_t nextJob() const { return heapSize ? heap[0] : -1; }
+
+    time_t getNextFire(int8_t id) const;
+    const char* getName(int8_t id) const;
+    JobStats getStats(int8_t id) const;
+    void printReport(time_t now);
+
+    // Forget persisted last-run times
+    void clearHistory();
+};
+
+#endif // SCHEDULER_H
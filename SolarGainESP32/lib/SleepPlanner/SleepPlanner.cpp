@@ -0,0 +1,248 @@
+#include "SleepPlanner.h"
+#include "../Trace/Trace.h"
+#include "../EpochTime/EpochTime.h"
+
+#ifndef HOST_BUILD
+#include <esp_sleep.h>
+#endif
+
+SleepPlanner::SleepPlanner() : cachedDay(INT64_MIN), eventCount(0) {
+    config.durationMinutes = 30;
+    config.twilightMinutes = 10;
+    config.twilightWindowMinutes = 45;
+    config.maxSleepHours = 12;
+    config.idleCpuMhz = 80;
+    config.activeCpuMhz = 240;
+}
+
+void SleepPlanner::setConfig(const SleepConfig& sleepConfig) {
+    config = sleepConfig;
+    cachedDay = INT64_MIN;
+}
+
+void SleepPlanner::setSolarSource(const SolarEventSource& source) {
+    solarSource = source;
+    cachedDay = INT64_MIN;
+}
+
+void SleepPlanner::loadEvents(int64_t day) {
+    cachedDay = day;
+    eventCount = 0;
+    if (!solarSource) return;
+
+    for (int64_t d = day - 2; d <= day + 2; d++) {
+        int year, month, date;
+        EpochTime::civilFromDays(d, year, month, date);
+        for (uint8_t e = SOLAR_SUNRISE; e <= SOLAR_SUNSET; e++) {
+            time_t at = solarSource(year, month, date, (SolarEvent)e);
+            if (at == SCHEDULER_NEVER) continue;
+
+            // Insert in time order
+            uint8_t i = eventCount++;
+            while (i > 0 && events[i - 1] > at) {
+                events[i] = events[i - 1];
+                eventKinds[i] = eventKinds[i - 1];
+                i--;
+            }
+            events[i] = at;
+            eventKinds[i] = (SolarEvent)e;
+        }
+    }
+}
+
+DayPhase SleepPlanner::phaseAt(time_t now, time_t* boundary) {
+    int64_t day = EpochTime::floorDiv(now, SECONDS_PER_DAY);
+    if (day != cachedDay) loadEvents(day);
+
+    // Latest event at or before now, and the first one after
+    int8_t prev = -1, next = -1;
+    for (uint8_t i = 0; i < eventCount; i++) {
+        if (events[i] <= now) {
+            prev = i;
+        } else {
+            next = i;
+            break;
+        }
+    }
+
+    time_t window = (time_t)max(config.twilightWindowMinutes, 0) * 60;
+    DayPhase phase;
+    time_t until;
+    if (prev >= 0 && now < events[prev] + window) {
+        phase = PHASE_TWILIGHT;
+        until = events[prev] + window;
+    } else if (next >= 0 && now >= events[next] - window) {
+        phase = PHASE_TWILIGHT;
+        until = events[next] + window;
+    } else {
+        if (prev >= 0) {
+            phase = eventKinds[prev] == SOLAR_SUNRISE ? PHASE_DAY : PHASE_NIGHT;
+        } else if (next >= 0) {
+            phase = eventKinds[next] == SOLAR_SUNRISE ? PHASE_NIGHT : PHASE_DAY;
+        } else {
+            // Polar day or night: the source cannot say which, so keep the daytime cadence
+            phase = PHASE_DAY;
+        }
+        until = next >= 0 ? events[next] - window : SCHEDULER_NEVER;
+    }
+
+    if (boundary) *boundary = until;
+    return phase;
+}
+
+SleepPlan SleepPlanner::plan(time_t now, time_t nextJob) {
+    TRACE_SCOPE("sleep.plan");
+
+    SleepPlan plan;
+    time_t boundary;
+    plan.phase = phaseAt(now, &boundary);
+
+    time_t limit = now + (time_t)max(config.maxSleepHours, 1) * 3600;
+    time_t wake = limit;
+    plan.reason = WAKE_LIMIT;
+
+    if (boundary != SCHEDULER_NEVER && boundary < wake) {
+        wake = boundary;
+        plan.reason = WAKE_PHASE;
+    }
+
+    // Display refreshes on a grid, so they land on :00, :30, ...
+    if (plan.phase != PHASE_NIGHT) {
+        int minutes = plan.phase == PHASE_DAY ? config.durationMinutes : config.twilightMinutes;
+        time_t cadence = (time_t)max(minutes, 1) * 60;
+        time_t refresh = (time_t)((EpochTime::floorDiv(now, cadence) + 1) * cadence);
+        if (refresh < wake) {
+            wake = refresh;
+            plan.reason = WAKE_CADENCE;
+        }
+    }
+
+    if (nextJob != SCHEDULER_NEVER && nextJob < wake) {
+        wake = max(nextJob, now);
+        plan.reason = WAKE_JOB;
+    }
+
+    plan.wakeAt = wake;
+    uint32_t span = (uint32_t)(wake - now);
+    if (plan.reason == WAKE_JOB) {
+        span -= (uint32_t)((uint64_t)span * SLEEP_RTC_GUARD_PPM / 1000000ULL);
+    }
+    plan.sleepS = span >= SLEEP_MIN_SECONDS ? span : 0;
+    return plan;
+}
+
+uint32_t SleepPlanner::validCpuMhz(int mhz) {
+    // Frequencies the ESP32-S3 supports with a 40 MHz crystal; WiFi needs 80 or more
+    static const uint32_t steps[] = {240, 160, 80, 40, 20, 10};
+    for (uint8_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        if (mhz >= (int)steps[i]) return steps[i];
+    }
+    return 10;
+}
+
+void SleepPlanner::enterIdle() {
+    uint32_t mhz = validCpuMhz(config.idleCpuMhz);
+    if (getCpuFrequencyMhz() != mhz) setCpuFrequencyMhz(mhz);
+}
+
+void SleepPlanner::enterActive() {
+    uint32_t mhz = validCpuMhz(config.activeCpuMhz);
+    if (getCpuFrequencyMhz() != mhz) setCpuFrequencyMhz(mhz);
+}
+
+void SleepPlanner::sleep(const SleepPlan& plan) {
+    if (plan.sleepS == 0) return;
+
+    Serial.println("Deep sleep for " + String(plan.sleepS) + " s");
+#ifndef HOST_BUILD
+    Serial.flush();
+    esp_sleep_enable_timer_wakeup((uint64_t)plan.sleepS * 1000000ULL);
+    esp_deep_sleep_start();
+#endif
+}
+
+EnergyReport SleepPlanner::simulate(time_t from, time_t to, Scheduler* scheduler, const EnergyModel& model) {
+    EnergyReport report;
+    memset(&report, 0, sizeof(report));
+    float activeS = 0, idleS = 0, sleepS = 0;
+
+    time_t now = from;
+    bool woke = true;
+    bool refresh = true;     // the first wake renders the display
+    while (now < to) {
+        bool worked = refresh;
+        if (scheduler && scheduler->runDue(now) > 0) worked = true;
+
+        float awake = 0;
+        if (woke) {
+            report.wakes++;
+            awake = worked ? model.activeS : model.idleS;
+            if (!worked) report.idleWakes++;
+        } else if (worked) {
+            awake = model.activeS;
+        }
+        if (worked) {
+            activeS += awake;
+        } else {
+            idleS += awake;
+        }
+
+        time_t after = now + (time_t)ceilf(awake);
+        if (after >= to) break;
+
+        SleepPlan next = plan(after, scheduler ? scheduler->nextFireTime() : SCHEDULER_NEVER);
+        if (next.sleepS == 0) {
+            // Not worth sleeping: wait at the idle clock
+            time_t until = min(max(next.wakeAt, after), to);
+            idleS += (float)(until - after);
+            now = until;
+            woke = false;
+        } else {
+            sleepS += (float)min((time_t)next.sleepS, to - after);
+            report.longestSleepS = max(report.longestSleepS, next.sleepS);
+            now = after + next.sleepS;
+            woke = true;
+        }
+        // Woken early by the RTC guard, only the corrective sleep is planned
+        refresh = now >= next.wakeAt && next.reason == WAKE_CADENCE;
+    }
+
+    report.awakeS = activeS + idleS;
+    report.mAh = (activeS * model.activeMa + idleS * model.idleMa + sleepS * model.sleepUa / 1000.0f) / 3600.0f;
+    report.mWh = report.mAh * model.volts;
+    return report;
+}
+
+EnergyReport SleepPlanner::simulateFixed(time_t from, time_t to, uint32_t intervalS, const EnergyModel& model) {
+    EnergyReport report;
+    memset(&report, 0, sizeof(report));
+    float activeS = 0, sleepS = 0;
+
+    // Work, then sleep the whole interval, as the fixed durationMinutes does
+    time_t period = (time_t)intervalS + (time_t)ceilf(model.activeS);
+    for (time_t now = from; now < to; now += period) {
+        report.wakes++;
+        activeS += model.activeS;
+        time_t after = now + (time_t)ceilf(model.activeS);
+        if (after < to) sleepS += (float)min((time_t)intervalS, to - after);
+    }
+    report.longestSleepS = intervalS;
+
+    report.awakeS = activeS;
+    report.mAh = (activeS * model.activeMa + sleepS * model.sleepUa / 1000.0f) / 3600.0f;
+    report.mWh = report.mAh * model.volts;
+    return report;
+}
+
+EnergyModel SleepPlanner::defaultModel() {
+    // Typical ESP32-S3 datasheet figures, not measurements of this board; idle
+    // is the S3 at 80 MHz with the radio off. Pass a measured model for real numbers.
+    EnergyModel model = {150.0f, 30.0f, 10.0f, 3.3f, 8.0f, 0.3f};
+    return model;
+}
+
+void SleepPlanner::printReport(const char* label, const EnergyReport& report) {
+    Serial.printf("%s: %lu wakes (%lu idle), %.0f s awake, longest sleep %.1f h, %.2f mAh, %.2f mWh\n",
+                  label, (unsigned long)report.wakes, (unsigned long)report.idleWakes, report.awakeS,
+                  report.longestSleepS / 3600.0f, report.mAh, report.mWh);
+}
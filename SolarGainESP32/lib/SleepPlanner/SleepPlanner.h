@@ -0,0 +1,110 @@
+#ifndef SLEEP_PLANNER_H
+#define SLEEP_PLANNER_H
+
+#include <Arduino.h>
+#include "../ConfigManager/ConfigManager.h"
+#include "../Scheduler/Scheduler.h"
+
+// Sleeps shorter than this cost more in boot time than they save; stay awake instead
+#ifndef SLEEP_MIN_SECONDS
+#define SLEEP_MIN_SECONDS 20
+#endif
+
+// The RTC slow clock can run a few percent fast or slow, so a sleep that ends
+// at a scheduled job wakes this much early and finishes with a short one.
+// Other wakes tolerate arriving a little late.
+#ifndef SLEEP_RTC_GUARD_PPM
+#define SLEEP_RTC_GUARD_PPM 20000
+#endif
+
+enum DayPhase : uint8_t {
+    PHASE_NIGHT,       // after the evening twilight window; no periodic wakes
+    PHASE_TWILIGHT,    // within the window around sunrise or sunset
+    PHASE_DAY
+};
+
+enum WakeReason : uint8_t {
+    WAKE_CADENCE,      // periodic display refresh for the phase
+    WAKE_JOB,          // the scheduler's next job
+    WAKE_PHASE,        // a twilight window opens or closes
+    WAKE_LIMIT         // maxSleepHours
+};
+
+struct SleepPlan {
+    time_t wakeAt;     // UTC instant the device should be awake
+    uint32_t sleepS;   // timer to arm, less the RTC guard; 0 = stay awake until wakeAt
+    DayPhase phase;    // phase at the time of planning
+    WakeReason reason;
+};
+
+// Supply current for the energy simulation
+struct EnergyModel {
+    float activeMa;    // awake at activeCpuMhz, display and WiFi on
+    float idleMa;      // awake at idleCpuMhz, radio off
+    float sleepUa;     // deep sleep
+    float volts;
+    float activeS;     // awake time for a wake that does work
+    float idleS;       // awake time for a wake that only plans the next sleep
+};
+
+struct EnergyReport {
+    uint32_t wakes;
+    uint32_t idleWakes;        // wakes that found nothing to do
+    uint32_t longestSleepS;
+    float awakeS;
+    float mAh;
+    float mWh;
+};
+
+// Plans each deep sleep as long as it can safely be. Nights are slept through
+// in one span (broken only by scheduled jobs), daytime wakes follow
+// SleepConfig::durationMinutes and the cadence tightens to twilightMinutes
+// around sunrise and sunset. Times are UTC seconds.
+class SleepPlanner {
+private:
+    SleepConfig config;
+    SolarEventSource solarSource;
+
+    // Sunrise and sunset for the five dates around cachedDay (a UTC day), in
+    // time order; enough for the events either side of now in any zone
+    int64_t cachedDay;
+    time_t events[10];
+    SolarEvent eventKinds[10];
+    uint8_t eventCount;
+
+    void loadEvents(int64_t day);
+
+    static uint32_t validCpuMhz(int mhz);
+
+public:
+    SleepPlanner();
+
+    void setConfig(const SleepConfig& sleepConfig);
+    void setSolarSource(const SolarEventSource& source);
+
+    // Phase at `now` and the instant it next changes
+    DayPhase phaseAt(time_t now, time_t* boundary = nullptr);
+
+    // Next wake given the next scheduled job (SCHEDULER_NEVER for none)
+    SleepPlan plan(time_t now, time_t nextJob);
+    SleepPlan plan(time_t now, const Scheduler& scheduler) { return plan(now, scheduler.nextFireTime()); }
+
+    // CPU clock for planning and waiting, and for rendering and WiFi
+    void enterIdle();
+    void enterActive();
+
+    // Arm the wake-up timer and enter deep sleep; does not return on the device
+    void sleep(const SleepPlan& plan);
+
+    // Simulate [from, to) waking per plan(). Scheduled jobs are run on each
+    // wake; a wake that runs one or refreshes the display counts as active.
+    EnergyReport simulate(time_t from, time_t to, Scheduler* scheduler, const EnergyModel& model);
+
+    // The same span with a wake every intervalS, each one active
+    static EnergyReport simulateFixed(time_t from, time_t to, uint32_t intervalS, const EnergyModel& model);
+
+    static EnergyModel defaultModel();
+    static void printReport(const char* label, const EnergyReport& report);
+};
+
+#endif // SLEEP_PLANNER_H
@@ -0,0 +1,164 @@
+#include "ClockDiscipline.h"
+
+// Shortest sample span the drift fit trusts
+#define CLOCK_MIN_FIT_SPAN_US 60000000LL
+
+ClockDiscipline::ClockDiscipline()
+    : minIntervalS(CLOCK_MIN_INTERVAL_S), maxIntervalS(CLOCK_MAX_INTERVAL_S),
+      targetErrorUs(CLOCK_TARGET_ERROR_US) {
+    reset();
+}
+
+void ClockDiscipline::reset() {
+    count = 0;
+    baseLocalUs = 0;
+    baseUtcUs = 0;
+    rateAdjPpb = 0;
+    slewUs = 0;
+    set = false;
+    intervalS = minIntervalS;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void ClockDiscipline::setIntervalBounds(uint32_t minSeconds, uint32_t maxSeconds) {
+    minIntervalS = minSeconds;
+    maxIntervalS = max(minSeconds, maxSeconds);
+    intervalS = constrain(intervalS, minIntervalS, maxIntervalS);
+}
+
+int64_t ClockDiscipline::slewApplied(int64_t elapsedUs) const {
+    if (slewUs == 0 || elapsedUs <= 0) return 0;
+    int64_t limit = elapsedUs * CLOCK_MAX_SLEW_PPM / 1000000;
+    return slewUs > 0 ? min(slewUs, limit) : max(slewUs, -limit);
+}
+
+int64_t ClockDiscipline::now(int64_t localUs) const {
+    if (!set) return 0;
+    int64_t elapsed = localUs - baseLocalUs;
+    return baseUtcUs + elapsed + elapsed * rateAdjPpb / 1000000000LL + slewApplied(elapsed);
+}
+
+void ClockDiscipline::rebase(int64_t localUs) {
+    int64_t applied = slewApplied(localUs - baseLocalUs);
+    baseUtcUs = now(localUs);
+    slewUs -= applied;
+    baseLocalUs = localUs;
+}
+
+bool ClockDiscipline::addSample(int64_t localUs, int64_t utcUs, uint32_t delayUs) {
+    bool stepped = false;
+    int64_t offset = 0;
+
+    if (!set) {
+        baseLocalUs = localUs;
+        baseUtcUs = utcUs;
+        slewUs = 0;
+        set = true;
+        stepped = true;
+        intervalS = minIntervalS;
+    } else {
+        rebase(localUs);
+        offset = utcUs - baseUtcUs;
+        if (offset > CLOCK_STEP_THRESHOLD_US || offset < -CLOCK_STEP_THRESHOLD_US) {
+            // Too far out to slew: the local timer restarted or the server changed
+            baseUtcUs = utcUs;
+            slewUs = 0;
+            count = 0;
+            intervalS = minIntervalS;
+            stats.steps++;
+            stepped = true;
+        } else {
+            // Replaces what is left of the previous offset, which this one already includes
+            slewUs = offset;
+        }
+    }
+
+    if (count == CLOCK_DRIFT_SAMPLES) {
+        memmove(history, history + 1, sizeof(Sample) * (CLOCK_DRIFT_SAMPLES - 1));
+        count--;
+    }
+    history[count++] = {localUs, utcUs, delayUs};
+
+    stats.offsetUs = (int32_t)offset;
+    stats.delayUs = delayUs;
+    stats.samples++;
+    stats.lastSampleUs = utcUs;
+
+    fitDrift();
+    if (!stepped) adaptInterval(offset);
+    return stepped;
+}
+
+void ClockDiscipline::fitDrift() {
+    if (count < 2) {
+        stats.jitterUs = history[0].delayUs / 2;
+        return;
+    }
+    if (history[count - 1].localUs - history[0].localUs < CLOCK_MIN_FIT_SPAN_US) return;
+
+    // Centred on the oldest sample so the sums keep their precision
+    double meanX = 0, meanY = 0, meanDelay = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        meanX += (double)(history[i].localUs - history[0].localUs);
+        meanY += (double)(history[i].utcUs - history[0].utcUs);
+        meanDelay += history[i].delayUs;
+    }
+    meanX /= count;
+    meanY /= count;
+    meanDelay /= count;
+
+    double sxx = 0, sxy = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        double dx = (double)(history[i].localUs - history[0].localUs) - meanX;
+        double dy = (double)(history[i].utcUs - history[0].utcUs) - meanY;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    double slope = sxy / sxx;
+    double drift = 1.0 / slope - 1.0;
+    if (fabs(drift) * 1e6 > CLOCK_MAX_DRIFT_PPM) return;
+
+    double residuals = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        double dx = (double)(history[i].localUs - history[0].localUs) - meanX;
+        double dy = (double)(history[i].utcUs - history[0].utcUs) - meanY;
+        double r = dy - slope * dx;
+        residuals += r * r;
+    }
+    double rms = count > 2 ? sqrt(residuals / (count - 2)) : 0;
+
+    // Two samples fit exactly, so the error of each is bounded by half its delay instead
+    double sigma = max(rms, meanDelay / 4);
+
+    rateAdjPpb = (int32_t)lround((slope - 1.0) * 1e9);
+    stats.driftPpm = (float)(drift * 1e6);
+    stats.driftErrorPpm = (float)(sigma / sqrt(sxx) * 1e6);
+    stats.jitterUs = (uint32_t)(count > 2 ? rms : meanDelay / 2);
+}
+
+void ClockDiscipline::adaptInterval(int64_t offsetUs) {
+    if (offsetUs > (int64_t)targetErrorUs || offsetUs < -(int64_t)targetErrorUs) {
+        // The model mispredicted (temperature change, bad fit): sync sooner and
+        // refit from the two newest samples
+        intervalS = max(minIntervalS, intervalS / 2);
+        if (count > 2) {
+            memmove(history, history + count - 2, sizeof(Sample) * 2);
+            count = 2;
+        }
+        return;
+    }
+
+    // Error expected after twice the interval: drift uncertainty times time, plus noise
+    if (count >= 3 && intervalS < maxIntervalS) {
+        double predictedUs = stats.driftErrorPpm * 2.0 * intervalS + stats.jitterUs;
+        if (predictedUs < targetErrorUs) intervalS = min(maxIntervalS, intervalS * 2);
+    }
+}
+
+ClockStats ClockDiscipline::getStats(int64_t localUs) const {
+    ClockStats result = stats;
+    result.synchronized = set;
+    result.intervalS = intervalS;
+    result.slewRemainingUs = (int32_t)(slewUs - slewApplied(localUs - baseLocalUs));
+    return result;
+}
@@ -0,0 +1,117 @@
+#ifndef CLOCK_DISCIPLINE_H
+#define CLOCK_DISCIPLINE_H
+
+#include <Arduino.h>
+
+// Server samples kept for the drift fit
+#ifndef CLOCK_DRIFT_SAMPLES
+#define CLOCK_DRIFT_SAMPLES 8
+#endif
+
+// Offsets larger than this are stepped; smaller ones are slewed
+#ifndef CLOCK_STEP_THRESHOLD_US
+#define CLOCK_STEP_THRESHOLD_US 128000
+#endif
+
+// Fastest rate at which an offset is slewed out (500 ppm: 50 ms in 100 s)
+#ifndef CLOCK_MAX_SLEW_PPM
+#define CLOCK_MAX_SLEW_PPM 500
+#endif
+
+// Fitted drift beyond this is treated as a bad fit; crystals are within +-50 ppm
+#define CLOCK_MAX_DRIFT_PPM 500
+
+// Sync interval bounds, in seconds
+#ifndef CLOCK_MIN_INTERVAL_S
+#define CLOCK_MIN_INTERVAL_S 3600UL
+#endif
+
+#ifndef CLOCK_MAX_INTERVAL_S
+#define CLOCK_MAX_INTERVAL_S 345600UL      // 4 days
+#endif
+
+// Error the interval is sized for: the clock should drift less than this between syncs
+#ifndef CLOCK_TARGET_ERROR_US
+#define CLOCK_TARGET_ERROR_US 50000
+#endif
+
+struct ClockStats {
+    bool synchronized;
+    int32_t offsetUs;          // last measured offset: server minus our clock
+    uint32_t delayUs;          // round-trip delay of that measurement
+    uint32_t jitterUs;         // RMS residual of the drift fit
+    float driftPpm;            // oscillator rate error; positive when the local timer runs fast
+    float driftErrorPpm;       // standard error of driftPpm
+    int32_t slewRemainingUs;   // part of the last offset not yet slewed out
+    uint32_t intervalS;        // current sync interval
+    uint32_t samples;
+    uint32_t steps;            // corrections too large to slew (the initial set is not counted)
+    int64_t lastSampleUs;      // UTC of the last sample, microseconds since the epoch
+};
+
+// Software clock disciplined by server time samples. It runs off a local
+// 64-bit microsecond timer, corrects that timer's rate by the drift fitted
+// over the last CLOCK_DRIFT_SAMPLES samples, and slews small offsets out at
+// up to CLOCK_MAX_SLEW_PPM so time never jumps or runs backwards. The sync
+// interval doubles while the drift model predicts the clock stays within
+// CLOCK_TARGET_ERROR_US for twice as long, and halves when an offset
+// exceeds it.
+//
+// Pure arithmetic on timestamps passed in by the caller: no I/O, no locking.
+class ClockDiscipline {
+private:
+    struct Sample {
+        int64_t localUs;
+        int64_t utcUs;
+        uint32_t delayUs;
+    };
+
+    Sample history[CLOCK_DRIFT_SAMPLES];   // oldest first
+    uint8_t count;
+
+    // UTC = baseUtcUs + elapsed + elapsed * rateAdjPpb / 1e9 + slew, elapsed = local - baseLocalUs
+    int64_t baseLocalUs;
+    int64_t baseUtcUs;
+    int32_t rateAdjPpb;
+    int64_t slewUs;            // offset still to be applied at the start of the current base
+    bool set;
+
+    uint32_t intervalS;
+    uint32_t minIntervalS;
+    uint32_t maxIntervalS;
+    uint32_t targetErrorUs;
+    ClockStats stats;
+
+    // Portion of slewUs applied after elapsedUs local microseconds
+    int64_t slewApplied(int64_t elapsedUs) const;
+
+    // Move the base to localUs without changing the time it reads
+    void rebase(int64_t localUs);
+
+    // Least-squares rate of server time against local time
+    void fitDrift();
+
+    void adaptInterval(int64_t offsetUs);
+
+public:
+    ClockDiscipline();
+
+    void setIntervalBounds(uint32_t minSeconds, uint32_t maxSeconds);
+    void setTargetError(uint32_t errorUs) { targetErrorUs = errorUs; }
+
+    // Feed one measurement: the server read utcUs at local timer instant
+    // localUs. Returns true when the clock was set or stepped rather than slewed.
+    bool addSample(int64_t localUs, int64_t utcUs, uint32_t delayUs);
+
+    // UTC microseconds at local timer instant localUs (0 until the first sample)
+    int64_t now(int64_t localUs) const;
+
+    bool isSet() const { return set; }
+    uint32_t getInterval() const { return intervalS; }
+    ClockStats getStats(int64_t localUs) const;
+
+    // Forget every sample, e.g. after the local timer restarted
+    void reset();
+};
+
+#endif // CLOCK_DISCIPLINE_H
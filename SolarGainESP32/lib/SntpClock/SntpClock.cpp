@@ -0,0 +1,367 @@
+#include "SntpClock.h"
+#include "../Trace/Trace.h"
+#include <esp_timer.h>
+
+#ifdef HOST_BUILD
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#endif
+
+#define SNTP_PACKET_SIZE 48
+
+// Seconds from the NTP epoch (1900) to the Unix epoch
+#define NTP_UNIX_OFFSET 2208988800LL
+
+static uint32_t readBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void writeBE32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// 64-bit NTP timestamp to Unix microseconds; era 1 starts in 2036
+static int64_t ntpToUnixUs(const uint8_t* p) {
+    uint32_t seconds = readBE32(p);
+    uint32_t fraction = readBE32(p + 4);
+    int64_t unixSeconds = (int64_t)seconds - NTP_UNIX_OFFSET;
+    if (seconds < 0x80000000UL) unixSeconds += 4294967296LL;
+    return unixSeconds * 1000000 + (int64_t)(((uint64_t)fraction * 1000000) >> 32);
+}
+
+static void unixUsToNtp(int64_t us, uint8_t* p) {
+    writeBE32(p, (uint32_t)(us / 1000000 + NTP_UNIX_OFFSET));
+    writeBE32(p + 4, (uint32_t)(((uint64_t)(us % 1000000) << 32) / 1000000));
+}
+
+SntpClock::SntpClock()
+    : port(SNTP_PORT), fd(-1), serverAddr(0), state(SNTP_IDLE), nextSyncUs(0), burstStartUs(0),
+      sentUs(0), burstSent(0), consecutiveFailures(0), haveSample(false), taskHandle(nullptr),
+      running(false) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    memset(cookie, 0, sizeof(cookie));
+    memset(&stats, 0, sizeof(stats));
+}
+
+SntpClock::~SntpClock() {
+    stop();
+}
+
+int64_t SntpClock::localMicros() {
+    return esp_timer_get_time();
+}
+
+bool SntpClock::begin(const char* host, uint16_t serverPort) {
+    server = host;
+    port = serverPort;
+    serverAddr = 0;
+    state = SNTP_IDLE;
+    consecutiveFailures = 0;
+    syncNow();
+    running = true;
+
+    Serial.println("SNTP client using " + server + ":" + String(port));
+    return true;
+}
+
+void SntpClock::setIntervalBounds(uint32_t minSeconds, uint32_t maxSeconds) {
+    portENTER_CRITICAL(&lock);
+    discipline.setIntervalBounds(minSeconds, maxSeconds);
+    portEXIT_CRITICAL(&lock);
+}
+
+void SntpClock::setTargetError(uint32_t errorUs) {
+    portENTER_CRITICAL(&lock);
+    discipline.setTargetError(errorUs);
+    portEXIT_CRITICAL(&lock);
+}
+
+bool SntpClock::startTask() {
+    if (!running) return false;
+    if (taskHandle) return true;
+
+    BaseType_t result = xTaskCreatePinnedToCore(taskMain, "sntp", SNTP_TASK_STACK, this,
+                                                SNTP_TASK_PRIORITY, &taskHandle, SNTP_TASK_CORE);
+    if (result != pdPASS) {
+        taskHandle = nullptr;
+        Serial.println("Failed to start SNTP task");
+        return false;
+    }
+    return true;
+}
+
+void SntpClock::taskMain(void* arg) {
+    SntpClock* clock = static_cast<SntpClock*>(arg);
+    while (clock->running) {
+        uint32_t wait = clock->poll(250);
+        // Wake at least once a second so stop() and syncNow() are noticed
+        if (wait > 0) delay(min(wait, (uint32_t)1000));
+    }
+    clock->taskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void SntpClock::stop() {
+    running = false;
+    while (taskHandle) {
+        delay(10);
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    state = SNTP_IDLE;
+}
+
+void SntpClock::syncNow() {
+    int64_t local = localMicros();
+    portENTER_CRITICAL(&lock);
+    nextSyncUs = local;
+    portEXIT_CRITICAL(&lock);
+}
+
+uint32_t SntpClock::msUntilSync() {
+    portENTER_CRITICAL(&lock);
+    int64_t due = nextSyncUs;
+    portEXIT_CRITICAL(&lock);
+    int64_t remaining = due - localMicros();
+    return remaining <= 0 ? 0 : (uint32_t)min(remaining / 1000 + 1, (int64_t)0xFFFFFFFE);
+}
+
+bool SntpClock::resolve() {
+    if (serverAddr) return true;
+
+    struct addrinfo hints;
+    struct addrinfo* result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(server.c_str(), nullptr, &hints, &result) != 0 || !result) {
+        Serial.println("SNTP: cannot resolve " + server);
+        return false;
+    }
+    serverAddr = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(result);
+    return true;
+}
+
+bool SntpClock::openSocket() {
+    if (fd >= 0) return true;
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+}
+
+bool SntpClock::sendRequest() {
+    uint8_t packet[SNTP_PACKET_SIZE];
+    memset(packet, 0, sizeof(packet));
+    packet[0] = (0 << 6) | (4 << 3) | 3;   // no leap warning, version 4, client
+
+    // Transmit timestamp: our time, with random low bits so replies cannot be guessed
+    int64_t local = localMicros();
+    int64_t reading = now();
+    unixUsToNtp(reading ? reading : local, cookie);
+    cookie[7] = (uint8_t)random(256);
+    memcpy(packet + 40, cookie, sizeof(cookie));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = serverAddr;
+
+    sentUs = localMicros();
+    if (sendto(fd, packet, sizeof(packet), 0, (struct sockaddr*)&addr, sizeof(addr)) != SNTP_PACKET_SIZE) {
+        return false;
+    }
+    stats.requests++;
+    burstSent++;
+    state = SNTP_WAITING;
+    return true;
+}
+
+bool SntpClock::receive() {
+    uint8_t packet[SNTP_PACKET_SIZE + 32];
+    struct sockaddr_in from;
+    socklen_t fromLength = sizeof(from);
+    int length = recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr*)&from, &fromLength);
+    int64_t receivedUs = localMicros();
+    if (length < 0) return false;
+
+    // Stray datagrams and replies to an earlier request are ignored
+    if (from.sin_addr.s_addr != serverAddr || from.sin_port != htons(port) ||
+        length < SNTP_PACKET_SIZE || memcmp(packet + 24, cookie, sizeof(cookie)) != 0) {
+        return false;
+    }
+    stats.replies++;
+
+    uint8_t leap = packet[0] >> 6;
+    uint8_t mode = packet[0] & 7;
+    uint8_t stratum = packet[1];
+    if (stratum == 0) {
+        // Kiss-o'-death: the server wants us gone, so end the burst
+        stats.rejected++;
+        burstSent = SNTP_BURST;
+        return true;
+    }
+    if (mode != 4 || leap == 3 || stratum > 15 || readBE32(packet + 40) == 0) {
+        stats.rejected++;
+        return true;
+    }
+
+    int64_t serverReceiveUs = ntpToUnixUs(packet + 32);
+    int64_t serverTransmitUs = ntpToUnixUs(packet + 40);
+    int64_t roundTripUs = receivedUs - sentUs;
+    int64_t delayUs = max(roundTripUs - (serverTransmitUs - serverReceiveUs), (int64_t)0);
+
+    // Server time at the local midpoint of the exchange; keep the fastest exchange
+    if (!haveSample || delayUs < sampleDelayUs) {
+        haveSample = true;
+        sampleLocalUs = sentUs + roundTripUs / 2;
+        sampleUtcUs = serverReceiveUs + (serverTransmitUs - serverReceiveUs) / 2;
+        sampleDelayUs = (uint32_t)delayUs;
+    }
+    return true;
+}
+
+void SntpClock::finishBurst() {
+    TRACE_SCOPE("sntp.sync");
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    state = SNTP_IDLE;
+    int64_t local = localMicros();
+    stats.lastSyncMs = (uint32_t)((local - burstStartUs) / 1000);
+    stats.activeMs += stats.lastSyncMs;
+
+    if (!haveSample) {
+        stats.failures++;
+        consecutiveFailures = min(consecutiveFailures + 1, 16);
+        // Re-resolve next time: a pool name may hand out a live server
+        serverAddr = 0;
+        uint64_t retryMs = min((uint64_t)SNTP_RETRY_MS << (consecutiveFailures - 1),
+                               (uint64_t)discipline.getInterval() * 1000);
+        portENTER_CRITICAL(&lock);
+        nextSyncUs = local + (int64_t)retryMs * 1000;
+        portEXIT_CRITICAL(&lock);
+        Serial.println("SNTP: no reply from " + server + ", retry in " + String((unsigned long)(retryMs / 1000)) + " s");
+        return;
+    }
+
+    // Fit outside the lock (soft-float on the ESP32), then publish
+    portENTER_CRITICAL(&lock);
+    ClockDiscipline updated = discipline;
+    portEXIT_CRITICAL(&lock);
+    bool stepped = updated.addSample(sampleLocalUs, sampleUtcUs, sampleDelayUs);
+    portENTER_CRITICAL(&lock);
+    discipline = updated;
+    nextSyncUs = local + (int64_t)updated.getInterval() * 1000000;
+    portEXIT_CRITICAL(&lock);
+
+    stats.syncs++;
+    consecutiveFailures = 0;
+
+    ClockStats clock = updated.getStats(local);
+    Serial.printf("SNTP: %s %ld us, delay %lu us, drift %.2f ppm, next sync in %lu s\n",
+                  stepped ? "set, offset" : "offset", (long)clock.offsetUs,
+                  (unsigned long)clock.delayUs, clock.driftPpm, (unsigned long)clock.intervalS);
+}
+
+uint32_t SntpClock::poll(uint32_t timeoutMs) {
+    if (!running) return 1000;
+
+    if (state == SNTP_IDLE) {
+        uint32_t wait = msUntilSync();
+        if (wait > 0) return wait;
+
+        burstStartUs = localMicros();
+        burstSent = 0;
+        haveSample = false;
+        if (!resolve() || !openSocket() || !sendRequest()) {
+            finishBurst();
+            return msUntilSync();
+        }
+        return 0;
+    }
+
+    // Reply outstanding
+    if (timeoutMs > 0) {
+        int64_t left = (int64_t)SNTP_TIMEOUT_MS * 1000 - (localMicros() - sentUs);
+        int64_t waitUs = min((int64_t)timeoutMs * 1000, max(left, (int64_t)0));
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(fd, &readSet);
+        struct timeval timeout;
+        timeout.tv_sec = waitUs / 1000000;
+        timeout.tv_usec = waitUs % 1000000;
+        select(fd + 1, &readSet, nullptr, nullptr, &timeout);
+    }
+
+    bool answered = receive();
+    if (!answered && localMicros() - sentUs >= (int64_t)SNTP_TIMEOUT_MS * 1000) {
+        stats.timeouts++;
+        answered = true;
+    }
+    if (answered) {
+        if (burstSent >= SNTP_BURST || !sendRequest()) {
+            finishBurst();
+            return msUntilSync();
+        }
+    }
+    return 0;
+}
+
+int64_t SntpClock::now() {
+    int64_t local = localMicros();
+    portENTER_CRITICAL(&lock);
+    int64_t utc = discipline.now(local);
+    portEXIT_CRITICAL(&lock);
+    return utc;
+}
+
+bool SntpClock::isSynchronized() {
+    portENTER_CRITICAL(&lock);
+    bool set = discipline.isSet();
+    portEXIT_CRITICAL(&lock);
+    return set;
+}
+
+uint32_t SntpClock::secondsUntilSync() {
+    return msUntilSync() / 1000;
+}
+
+ClockStats SntpClock::getClockStats() {
+    int64_t local = localMicros();
+    portENTER_CRITICAL(&lock);
+    ClockStats result = discipline.getStats(local);
+    portEXIT_CRITICAL(&lock);
+    return result;
+}
+
+void SntpClock::printReport() {
+    ClockStats c = getClockStats();
+    Serial.printf("Clock: offset %ld us, jitter %lu us, drift %.3f +- %.3f ppm, slewing %ld us, "
+                  "interval %lu s, %lu samples, %lu steps\n",
+                  (long)c.offsetUs, (unsigned long)c.jitterUs, c.driftPpm, c.driftErrorPpm,
+                  (long)c.slewRemainingUs, (unsigned long)c.intervalS, (unsigned long)c.samples,
+                  (unsigned long)c.steps);
+    Serial.printf("SNTP: %lu syncs, %lu failed, %lu requests, %lu replies, %lu timeouts, "
+                  "%lu rejected, %lu ms active\n",
+                  (unsigned long)stats.syncs, (unsigned long)stats.failures,
+                  (unsigned long)stats.requests, (unsigned long)stats.replies,
+                  (unsigned long)stats.timeouts, (unsigned long)stats.rejected,
+                  (unsigned long)stats.activeMs);
+}
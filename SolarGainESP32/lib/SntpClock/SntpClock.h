@@ -0,0 +1,144 @@
+#ifndef SNTP_CLOCK_H
+#define SNTP_CLOCK_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "ClockDiscipline.h"
+
+#ifndef SNTP_DEFAULT_SERVER
+#define SNTP_DEFAULT_SERVER "pool.ntp.org"
+#endif
+
+#define SNTP_PORT 123
+
+// Requests per sync; the reply with the lowest round-trip delay is used
+#ifndef SNTP_BURST
+#define SNTP_BURST 3
+#endif
+
+// Wait for one reply
+#ifndef SNTP_TIMEOUT_MS
+#define SNTP_TIMEOUT_MS 1000
+#endif
+
+// First retry after a failed sync; doubles per failure, capped at the sync interval
+#ifndef SNTP_RETRY_MS
+#define SNTP_RETRY_MS 30000UL
+#endif
+
+#ifndef SNTP_TASK_STACK
+#define SNTP_TASK_STACK 4096
+#endif
+
+#ifndef SNTP_TASK_PRIORITY
+#define SNTP_TASK_PRIORITY 1
+#endif
+
+#ifndef SNTP_TASK_CORE
+#define SNTP_TASK_CORE 0
+#endif
+
+struct SntpStats {
+    uint32_t syncs;            // bursts that produced a sample
+    uint32_t failures;         // bursts without a usable reply
+    uint32_t requests;
+    uint32_t replies;
+    uint32_t timeouts;
+    uint32_t rejected;         // malformed, unsynchronised or kiss-o'-death replies
+    uint32_t activeMs;         // total time spent resolving and exchanging (radio needed)
+    uint32_t lastSyncMs;       // duration of the last burst
+};
+
+// Asynchronous SNTP (RFC 4330) client driving a ClockDiscipline. poll()
+// sends a request when a sync is due and picks up replies without waiting;
+// the clock itself is read from a 64-bit local timer, so now() costs a few
+// integer operations and never touches the network. Syncs start hourly and
+// stretch to days as the drift model settles (see ClockDiscipline).
+//
+// Resolving the server name is the one blocking step; it runs once per
+// burst, so run the background task when the caller must never wait.
+class SntpClock {
+private:
+    enum State : uint8_t {
+        SNTP_IDLE,
+        SNTP_WAITING       // request sent, reply outstanding
+    };
+
+    String server;
+    uint16_t port;
+    int fd;
+    uint32_t serverAddr;       // network byte order; 0 until resolved
+    State state;
+
+    ClockDiscipline discipline;
+    portMUX_TYPE lock;         // discipline is read by callers, written by poll()
+
+    int64_t nextSyncUs;        // local timer instant the next burst starts
+    int64_t burstStartUs;
+    int64_t sentUs;
+    uint8_t burstSent;
+    uint8_t consecutiveFailures;
+    uint8_t cookie[8];         // our transmit timestamp, echoed as the originate timestamp
+
+    // Best reply of the current burst
+    bool haveSample;
+    int64_t sampleLocalUs;
+    int64_t sampleUtcUs;
+    uint32_t sampleDelayUs;
+
+    SntpStats stats;
+    TaskHandle_t taskHandle;
+    volatile bool running;
+
+    static void taskMain(void* arg);
+
+    bool openSocket();
+    bool resolve();
+    bool sendRequest();
+    uint32_t msUntilSync();
+
+    // Read a reply if one is waiting; true once the outstanding request is
+    // answered, whether the reply was used or rejected
+    bool receive();
+    void finishBurst();
+
+    static int64_t localMicros();
+
+public:
+    SntpClock();
+    ~SntpClock();
+
+    // Set the server; the first sync starts on the next poll()
+    bool begin(const char* host = SNTP_DEFAULT_SERVER, uint16_t port = SNTP_PORT);
+
+    // Run poll() from a background task
+    bool startTask();
+
+    // Advance the exchange: start a burst when one is due and read any reply.
+    // Waits up to timeoutMs for an outstanding reply (0 never blocks).
+    // Returns the ms until poll() next has work, 0 while a reply is outstanding.
+    uint32_t poll(uint32_t timeoutMs = 0);
+
+    // Sync on the next poll() regardless of the interval
+    void syncNow();
+
+    void stop();
+
+    // UTC, microseconds since the epoch (0 until the first sync)
+    int64_t now();
+    time_t nowSeconds() { return (time_t)(now() / 1000000); }
+
+    bool isSynchronized();
+    uint32_t secondsUntilSync();
+
+    // See ClockDiscipline; call before begin()
+    void setIntervalBounds(uint32_t minSeconds, uint32_t maxSeconds);
+    void setTargetError(uint32_t errorUs);
+
+    ClockStats getClockStats();
+    SntpStats getStats() { return stats; }
+    void printReport();
+};
+
+#endif // SNTP_CLOCK_H
@@ -1,54 +1,91 @@
 #include "SolarCalc.h"
 #include <math.h>
+#include "../Trace/Trace.h"
+#include "../EpochTime/EpochTime.h"
 
 SolarCalc::SolarCalc(float lat, float lon, float elev, float tilt, float azimuth) 
-    : latitude(lat), longitude(lon), elevation(elev), panelTilt(tilt), panelAzimuth(azimuth) {
+    : latitude(lat), longitude(lon), elevation(elev), panelTilt(tilt), panelAzimuth(azimuth),
+      timeZone(nullptr), termsDay(INT64_MIN), skyYear(0), skyMonth(0), skyDay(0), forecastValid(false),
+      eventYearNumber(0), eventDayNumber(INT64_MIN) {
+    memset(&stats, 0, sizeof(stats));
+    sinLatitude = sin(latitude * PI / 180.0);
+    cosLatitude = cos(latitude * PI / 180.0);
 }
 
-float SolarCalc::getJulianDay(int year, int month, int day) {
-    int a = (14 - month) / 12;
-    int y = year + 4800 - a;
-    int m = month + 12 * a - 3;
-    
-    return day + (153 * m + 2) / 5 + 365 * y + y / 4 - y / 100 + y / 400 - 32045;
+float SolarCalc::getFractionalYear(int year, int dayOfYear, float utcHours) {
+    return 2 * PI / EpochTime::daysInYear(year) * (dayOfYear - 1 + (utcHours - 12.0f) / 24.0f);
 }
 
-float SolarCalc::getSolarDeclination(float julianDay) {
-    // Calculate the day angle
-    float dayAngle = 2 * PI * (julianDay - 1) / 365.25;
+float SolarCalc::getSolarDeclination(float fractionalYear) {
+    float g = fractionalYear;
     
     // Spencer's equation for solar declination
-    float declination = 0.006918 - 0.399912 * cos(dayAngle) + 0.070257 * sin(dayAngle)
-                       - 0.006758 * cos(2 * dayAngle) + 0.000907 * sin(2 * dayAngle)
-                       - 0.002697 * cos(3 * dayAngle) + 0.00148 * sin(3 * dayAngle);
+    float declination = 0.006918 - 0.399912 * cos(g) + 0.070257 * sin(g)
+                       - 0.006758 * cos(2 * g) + 0.000907 * sin(2 * g)
+                       - 0.002697 * cos(3 * g) + 0.00148 * sin(3 * g);
     
     return declination;
 }
 
-float SolarCalc::getEquationOfTime(float julianDay) {
-    float B = 2 * PI * (julianDay - 81) / 365.0;
-    float E = 229.2 * (0.000075 + 0.001868 * cos(B) - 0.032077 * sin(B)
-              - 0.014615 * cos(2 * B) - 0.04089 * sin(2 * B));
+float SolarCalc::getEquationOfTime(float fractionalYear) {
+    float g = fractionalYear;
+    float E = 229.18 * (0.000075 + 0.001868 * cos(g) - 0.032077 * sin(g)
+              - 0.014615 * cos(2 * g) - 0.040849 * sin(2 * g));
     return E; // in minutes
 }
 
+void SolarCalc::loadDayTerms(int64_t dayNumber) {
+    int year, month, day;
+    EpochTime::civilFromDays(dayNumber, year, month, day);
+    int doy = EpochTime::dayOfYear(year, month, day);
+    
+    for (int i = 0; i < 2; i++) {
+        float g = getFractionalYear(year, doy, i * 24.0f);
+        dayDeclination[i] = getSolarDeclination(g);
+        dayEquationOfTime[i] = getEquationOfTime(g);
+    }
+    termsDay = dayNumber;
+}
+
+SolarPosition SolarCalc::positionAt(time_t utc) {
+    int64_t dayNumber = EpochTime::floorDiv(utc, SECONDS_PER_DAY);
+    if (dayNumber != termsDay) loadDayTerms(dayNumber);
+    
+    uint32_t secondOfDay = (uint32_t)((int64_t)utc - dayNumber * SECONDS_PER_DAY);
+    float f = secondOfDay / (float)SECONDS_PER_DAY;
+    float declination = dayDeclination[0] + (dayDeclination[1] - dayDeclination[0]) * f;
+    float eot = dayEquationOfTime[0] + (dayEquationOfTime[1] - dayEquationOfTime[0]) * f;
+    
+    // Apparent solar time from the exact UTC second of the day
+    float solarTime = secondOfDay / 3600.0f + eot / 60.0f + longitude / 15.0f;
+    float hourAngle = getHourAngle(solarTime);
+    if (hourAngle > PI) hourAngle -= 2 * PI;
+    if (hourAngle < -PI) hourAngle += 2 * PI;
+    
+    float sunElevation = getSolarElevation(declination, hourAngle);
+    
+    SolarPosition position;
+    position.elevation = sunElevation * 180.0 / PI;
+    position.azimuth = getSolarAzimuth(declination, hourAngle, sunElevation) * 180.0 / PI;
+    position.declination = declination * 180.0 / PI;
+    position.hourAngle = hourAngle * 180.0 / PI;
+    position.equationOfTime = eot;
+    return position;
+}
+
 float SolarCalc::getHourAngle(float localSolarTime) {
     return 15.0 * (localSolarTime - 12.0) * PI / 180.0; // Convert to radians
 }
 
 float SolarCalc::getSolarElevation(float declination, float hourAngle) {
-    float latRad = latitude * PI / 180.0;
-    
-    float sinElevation = sin(latRad) * sin(declination) + 
-                        cos(latRad) * cos(declination) * cos(hourAngle);
+    float sinElevation = sinLatitude * sin(declination) + 
+                        cosLatitude * cos(declination) * cos(hourAngle);
     
     return asin(sinElevation);
 }
 
 float SolarCalc::getSolarAzimuth(float declination, float hourAngle, float elevation) {
-    float latRad = latitude * PI / 180.0;
-    
-    float cosAzimuth = (sin(declination) * cos(latRad) - cos(declination) * sin(latRad) * cos(hourAngle)) / cos(elevation);
+    float cosAzimuth = (sin(declination) * cosLatitude - cos(declination) * sinLatitude * cos(hourAngle)) / cos(elevation);
     float azimuth = acos(constrain(cosAzimuth, -1.0, 1.0));
     
     if (hourAngle > 0) {
@@ -76,17 +113,14 @@ float SolarCalc::getDirectNormalIrradiance(float airMass) {
     if (airMass > 40.0) return 0.0;
     
     // Clear sky model - simplified
-    float solarConstant = 1367.0; // W/m²
-    float k = 0.75 + 2e-5 * elevation; // Atmospheric extinction coefficient
-    
-    float dni = solarConstant * exp(-k * airMass);
+    float dni = SOLAR_CONSTANT * exp(-getExtinction() * airMass);
     
     return max(0.0f, dni);
 }
 
 float SolarCalc::getDiffuseHorizontalIrradiance(float dni) {
     // Simple model: DHI = 10% of DNI for clear sky
-    return 0.1 * dni;
+    return SOLAR_DIFFUSE_FRACTION * dni;
 }
 
 float SolarCalc::getGlobalHorizontalIrradiance(float dni, float dhi, float solarElevation) {
@@ -114,42 +148,58 @@ float SolarCalc::getTiltedSurfaceIrradiance(float dni, float dhi, float solarEle
     // Diffuse component (isotropic model)
     float diffuseTilted = dhi * (1 + cos(tiltRad)) / 2.0;
     
-    // Ground reflected component (albedo = 0.2)
+    // Ground reflected component
     float ghi = getGlobalHorizontalIrradiance(dni, dhi, solarElevation);
-    float groundReflected = 0.2 * ghi * (1 - cos(tiltRad)) / 2.0;
+    float groundReflected = SOLAR_ALBEDO * ghi * (1 - cos(tiltRad)) / 2.0;
     
     return directTilted + diffuseTilted + groundReflected;
 }
 
-DailyForecast SolarCalc::calculateDailyForecast(int year, int month, int day) {
-    DailyForecast forecast;
-    forecast.totalIrradiance = 0.0;
-    forecast.date = String(year) + "-" + String(month) + "-" + String(day);
+void SolarCalc::computeSky(int year, int month, int day) {
+    TRACE_SCOPE("solar.sky");
+    stats.ephemerisRuns++;
     
-    float julianDay = getJulianDay(year, month, day);
-    float declination = getSolarDeclination(julianDay);
-    float eot = getEquationOfTime(julianDay);
+    time_t dayStart = EpochTime::fromCivil(year, month, day);
     
-    // Calculate for each hour of the day
     for (int hour = 0; hour < 24; hour++) {
-        // Convert local time to solar time
-        float localTime = hour + 0.5; // Middle of the hour
-        float solarTime = localTime + eot / 60.0 + longitude / 15.0;
+        // Middle of the hour, on the wall clock
+        time_t wallClock = dayStart + hour * 3600L + 1800;
+        time_t utc = timeZone ? timeZone->toUtc(wallClock) : wallClock;
+        bool exists = !timeZone || timeZone->toLocal(utc) == wallClock;
         
-        float hourAngle = getHourAngle(solarTime);
-        float elevation = getSolarElevation(declination, hourAngle);
+        SolarPosition sun = positionAt(utc);
+        SkyHour& sky = skyHours[hour];
+        sky.elevation = exists ? sun.elevation * PI / 180.0 : 0.0f;
+        sky.azimuth = sun.azimuth * PI / 180.0;
+        sky.dni = 0.0;
+        sky.dhi = 0.0;
         
+        if (sky.elevation > 0) {
+            sky.dni = getDirectNormalIrradiance(getAirMass(sky.elevation));
+            sky.dhi = getDiffuseHorizontalIrradiance(sky.dni);
+        }
+    }
+    
+    skyYear = year;
+    skyMonth = month;
+    skyDay = day;
+    forecastValid = false;
+}
+
+void SolarCalc::transpose() {
+    stats.transpositions++;
+    
+    cachedForecast.totalIrradiance = 0.0;
+    cachedForecast.date = String(skyYear) + "-" + String(skyMonth) + "-" + String(skyDay);
+    cachedForecast.hourlyData.clear();
+    
+    for (int hour = 0; hour < 24; hour++) {
+        const SkyHour& sky = skyHours[hour];
         float hourlyIrradiance = 0.0;
         
-        if (elevation > 0) {
-            float azimuth = getSolarAzimuth(declination, hourAngle, elevation);
-            float airMass = getAirMass(elevation);
-            
-            float dni = getDirectNormalIrradiance(airMass);
-            float dhi = getDiffuseHorizontalIrradiance(dni);
-            
+        if (sky.elevation > 0) {
             // Calculate irradiance on tilted panel
-            float tiltedIrradiance = getTiltedSurfaceIrradiance(dni, dhi, elevation, azimuth, 
+            float tiltedIrradiance = getTiltedSurfaceIrradiance(sky.dni, sky.dhi, sky.elevation, sky.azimuth,
                                                                panelTilt, panelAzimuth);
             
             // Convert W/m² to kWh/m² for one hour
@@ -159,54 +209,388 @@ DailyForecast SolarCalc::calculateDailyForecast(int year, int month, int day) {
         HourlyIrradiance hourData;
         hourData.hour = hour;
         hourData.irradiance = hourlyIrradiance;
-        forecast.hourlyData.push_back(hourData);
+        cachedForecast.hourlyData.push_back(hourData);
         
-        forecast.totalIrradiance += hourlyIrradiance;
+        cachedForecast.totalIrradiance += hourlyIrradiance;
     }
+    cachedForecast.sunrise = getSunriseTime(skyYear, skyMonth, skyDay);
+    cachedForecast.sunset = getSunsetTime(skyYear, skyMonth, skyDay);
     
-    return forecast;
+    forecastValid = true;
 }
 
-float SolarCalc::getSunriseTime(int year, int month, int day) {
-    float julianDay = getJulianDay(year, month, day);
-    float declination = getSolarDeclination(julianDay);
-    float eot = getEquationOfTime(julianDay);
+DailyForecast SolarCalc::calculateDailyForecast(int year, int month, int day) {
+    TRACE_SCOPE("solar.forecast");
+    
+    // Recompute only the stages a change invalidated
+    if (year != skyYear || month != skyMonth || day != skyDay) computeSky(year, month, day);
+    if (forecastValid) {
+        stats.cacheHits++;
+    } else {
+        transpose();
+    }
     
-    float latRad = latitude * PI / 180.0;
+    return cachedForecast;
+}
+
+// A piece of sky with sin(elevation) below this at either end is split in
+// this many for the beam fit
+#define INTEGRATE_LOW_SUN 0.2
+#define INTEGRATE_LOW_PIECES 2
+
+// Gauss-Legendre abscissae for four points on [-1, 1]
+static const double QUADRATURE_INNER = 0.33998104358485626;
+static const double QUADRATURE_OUTER = 0.86113631159405258;
+
+// Integrals over [-1, 1] of x^k cos(r x) (even k) and x^k sin(r x) (odd k),
+// by series: r is at most pi/24 here, where the closed forms cancel badly
+static double trigMoment(int k, double r) {
+    double sum = 0, term = (k & 1) ? r : 1.0;
+    for (int n = 0; n < 8; n++) {
+        int power = (k & 1) ? 2 * n + 1 : 2 * n;
+        sum += term / (k + power + 1);
+        term *= -r * r / ((power + 1) * (power + 2));
+    }
+    return 2 * sum;
+}
+
+// Both roots of p + q cos(w) + s sin(w) = 0 that fall inside (from, to)
+static int addCrossings(double p, double q, double s, double from, double to, double* roots, int count) {
+    double amplitude = sqrt(q * q + s * s);
+    if (amplitude < 1e-12 || fabs(p) >= amplitude) return count;
+    double phase = atan2(s, q);
+    double half = acos(-p / amplitude);
+    for (int side = -1; side <= 1; side += 2) {
+        double root = phase + side * half;
+        root += 2 * PI * ceil((from - root) / (2 * PI));
+        for (; root < to; root += 2 * PI) {
+            if (root > from) roots[count++] = root;
+        }
+    }
+    return count;
+}
+
+// Coefficients of the cubic in x through values at the four Gauss points
+static void fitCubic(const double* values, double* c) {
+    double p2 = QUADRATURE_INNER * QUADRATURE_INNER, q2 = QUADRATURE_OUTER * QUADRATURE_OUTER;
+    double evenInner = (values[2] + values[1]) / 2, evenOuter = (values[3] + values[0]) / 2;
+    double oddInner = (values[2] - values[1]) / 2 / QUADRATURE_INNER;
+    double oddOuter = (values[3] - values[0]) / 2 / QUADRATURE_OUTER;
+    c[2] = (evenOuter - evenInner) / (q2 - p2);
+    c[0] = evenInner - c[2] * p2;
+    c[3] = (oddOuter - oddInner) / (q2 - p2);
+    c[1] = oddInner - c[3] * p2;
+}
+
+// Integral over x in [-1, 1] of the cubic times p + q cos(w) + s sin(w),
+// w = centre + radius x; each power of x against the weight exactly
+static double weighCubic(const double* c, double centre, double radius, const double* weight) {
+    double even = weight[1] * cos(centre) + weight[2] * sin(centre);
+    double odd = weight[2] * cos(centre) - weight[1] * sin(centre);
+    return c[0] * (2 * weight[0] + even * trigMoment(0, radius)) + c[1] * odd * trigMoment(1, radius) +
+           c[2] * (2 * weight[0] / 3 + even * trigMoment(2, radius)) + c[3] * odd * trigMoment(3, radius);
+}
+
+double SolarCalc::integrateSegment(const SunArc& arc, double start, double radius, const double* weight,
+                                   const double* weightDrift) {
+    // DNI, and DNI x (w - middle) for the drift, through cubics in
+    // x = (w - centre) / radius from four Gauss points
+    double centre = start + radius;
+    double dni[4], drifted[4];
+    static const double nodes[4] = {-QUADRATURE_OUTER, -QUADRATURE_INNER, QUADRATURE_INNER, QUADRATURE_OUTER};
+    for (int n = 0; n < 4; n++) {
+        double w = centre + radius * nodes[n];
+        double sinElevation = arc.a + arc.b * cos(w) + (arc.driftA + arc.driftB * cos(w)) * (w - arc.middle);
+        dni[n] = sinElevation > 0 ? getClearSkyDni(asin(sinElevation)) : 0;
+        drifted[n] = dni[n] * (w - arc.middle);
+    }
+    double c[4], cDrift[4];
+    fitCubic(dni, c);
+    fitCubic(drifted, cDrift);
+    return radius * (weighCubic(c, centre, radius, weight) + weighCubic(cDrift, centre, radius, weightDrift));
+}
+
+double SolarCalc::integrateStretch(time_t fromUtc, time_t toUtc) {
+    time_t middle = fromUtc + (toUtc - fromUtc) / 2;
+    SolarPosition sun = positionAt(middle);
+    
+    // Hour angle, radians per second: the clock's rate plus the equation of
+    // time's drift through the day (minutes per day)
+    double rate = 2 * PI / SECONDS_PER_DAY * (1 + (dayEquationOfTime[1] - dayEquationOfTime[0]) / 1440.0);
+    double declination = sun.declination * PI / 180.0;
+    double from = sun.hourAngle * PI / 180.0 - (middle - fromUtc) * rate;
+    double to = sun.hourAngle * PI / 180.0 + (toUtc - middle) * rate;
+    
+    // sin(elevation) = a + b cos(w) and cos(incidence) = A + B cos(w) + C sin(w)
+    // at the middle's declination; each moves with the declination's drift,
+    // linear over the day as in positionAt(), by its derivative x drift x
+    // (w - middle). The beam, exponential in air mass, is too sensitive to
+    // the low sun's elevation to leave that out.
+    double drift = (dayDeclination[1] - dayDeclination[0]) / (rate * SECONDS_PER_DAY);
+    double sinDeclination = sin(declination), cosDeclination = cos(declination);
+    double tilt = panelTilt * PI / 180.0, azimuth = panelAzimuth * PI / 180.0;
+    double a = sinLatitude * sinDeclination;
+    double b = cosLatitude * cosDeclination;
+    SunArc arc = {a, b, sinLatitude * cosDeclination * drift, -cosLatitude * sinDeclination * drift,
+                  sun.hourAngle * PI / 180.0};
+    double incidenceA = sin(tilt) * cos(azimuth) * sinDeclination * cosLatitude + cos(tilt) * a;
+    double incidenceB = cos(tilt) * b - sin(tilt) * cos(azimuth) * cosDeclination * sinLatitude;
+    double incidenceC = -sin(tilt) * sin(azimuth) * cosDeclination;
+    double incidenceDrift[3] = {
+        (sin(tilt) * cos(azimuth) * cosDeclination * cosLatitude + cos(tilt) * sinLatitude * cosDeclination) * drift,
+        (sin(tilt) * cos(azimuth) * sinDeclination * sinLatitude - cos(tilt) * cosLatitude * sinDeclination) * drift,
+        sin(tilt) * sin(azimuth) * sinDeclination * drift};
+    
+    // Per unit of DNI: diffuse and ground as in getTiltedSurfaceIrradiance()
+    double ground = SOLAR_ALBEDO * (1 - cos(tilt)) / 2;
+    double sky = SOLAR_DIFFUSE_FRACTION * (1 + cos(tilt)) / 2 + SOLAR_DIFFUSE_FRACTION * ground;
+    
+    // Cut the stretch where the sun crosses the horizon or the panel's plane;
+    // between cuts the geometry is one smooth trigonometric term
+    double cuts[10];
+    int count = 0;
+    cuts[count++] = from;
+    count = addCrossings(a, b, 0, from, to, cuts, count);
+    count = addCrossings(incidenceA, incidenceB, incidenceC, from, to, cuts, count);
+    cuts[count++] = to;
+    for (int i = 1; i < count; i++) {
+        for (int j = i; j > 0 && cuts[j] < cuts[j - 1]; j--) {
+            double swap = cuts[j];
+            cuts[j] = cuts[j - 1];
+            cuts[j - 1] = swap;
+        }
+    }
     
-    // Calculate sunrise hour angle
-    float cosHourAngle = -tan(latRad) * tan(declination);
+    double energy = 0;
+    for (int i = 0; i + 1 < count; i++) {
+        double centre = (cuts[i] + cuts[i + 1]) / 2;
+        if (cuts[i + 1] <= cuts[i] || a + b * cos(centre) <= 0) continue;
+        
+        // Weight per unit of DNI, p + q cos(w) + s sin(w), and its drift
+        bool lit = incidenceA + incidenceB * cos(centre) + incidenceC * sin(centre) > 0;
+        double weight[3] = {sky + ground * a + (lit ? incidenceA : 0), ground * b + (lit ? incidenceB : 0),
+                            lit ? incidenceC : 0};
+        double weightDrift[3] = {ground * arc.driftA + (lit ? incidenceDrift[0] : 0),
+                                 ground * arc.driftB + (lit ? incidenceDrift[1] : 0), lit ? incidenceDrift[2] : 0};
+        
+        // Near the horizon the beam climbs too steeply for one cubic; split
+        int pieces = min(a + b * cos(cuts[i]), a + b * cos(cuts[i + 1])) < INTEGRATE_LOW_SUN ? INTEGRATE_LOW_PIECES : 1;
+        double width = (cuts[i + 1] - cuts[i]) / pieces;
+        for (int piece = 0; piece < pieces; piece++) {
+            energy += integrateSegment(arc, cuts[i] + piece * width, width / 2, weight, weightDrift);
+        }
+    }
     
-    if (cosHourAngle > 1.0) return -1; // No sunrise (polar night)
-    if (cosHourAngle < -1.0) return -1; // No sunset (polar day)
+    // Radians of hour angle to hours, W to kW
+    return energy / rate / 3600 / 1000;
+}
+
+float SolarCalc::integrateEnergy(time_t fromUtc, time_t toUtc) {
+    TRACE_SCOPE("solar.integrate");
+    double energy = 0;
+    
+    // At most an hour at a time, and never across a UTC midnight
+    for (time_t at = fromUtc; at < toUtc;) {
+        time_t end = (time_t)((EpochTime::floorDiv(at, SECONDS_PER_DAY) + 1) * SECONDS_PER_DAY);
+        if (end > at + 3600) end = at + 3600;
+        if (end > toUtc) end = toUtc;
+        energy += integrateStretch(at, end);
+        at = end;
+    }
+    return energy;
+}
+
+DailyForecast SolarCalc::integrateDailyForecast(int year, int month, int day) {
+    DailyForecast forecast;
+    forecast.totalIrradiance = 0.0;
+    forecast.date = String(year) + "-" + String(month) + "-" + String(day);
     
-    float hourAngle = acos(cosHourAngle);
-    float sunriseTime = 12.0 - hourAngle * 180.0 / PI / 15.0;
+    time_t dayStart = EpochTime::fromCivil(year, month, day);
+    for (int hour = 0; hour < 24; hour++) {
+        // The same wall-clock hours as computeSky()
+        time_t wallClock = dayStart + hour * 3600L + 1800;
+        time_t utc = timeZone ? timeZone->toUtc(wallClock) : wallClock;
+        bool exists = !timeZone || timeZone->toLocal(utc) == wallClock;
+        
+        HourlyIrradiance hourData;
+        hourData.hour = hour;
+        hourData.irradiance = exists ? integrateEnergy(utc - 1800, utc + 1800) : 0.0f;
+        forecast.hourlyData.push_back(hourData);
+        forecast.totalIrradiance += hourData.irradiance;
+    }
+    forecast.sunrise = getSunriseTime(year, month, day);
+    forecast.sunset = getSunsetTime(year, month, day);
+    return forecast;
+}
+
+const SkyHour* SolarCalc::getSky(int year, int month, int day) {
+    if (year != skyYear || month != skyMonth || day != skyDay) computeSky(year, month, day);
+    return skyHours;
+}
+
+void SolarCalc::setSite(float lat, float lon, float elev) {
+    if (lat == latitude && lon == longitude && elev == elevation) return;
+    latitude = lat;
+    longitude = lon;
+    elevation = elev;
+    sinLatitude = sin(latitude * PI / 180.0);
+    cosLatitude = cos(latitude * PI / 180.0);
+    
+    // Declination and equation of time do not depend on the site; sun positions and events do
+    skyYear = 0;
+    eventYearNumber = 0;
+    eventDayNumber = INT64_MIN;
+}
+
+void SolarCalc::setPanel(float tilt, float azimuth) {
+    if (tilt == panelTilt && azimuth == panelAzimuth) return;
+    panelTilt = tilt;
+    panelAzimuth = azimuth;
     
-    // Convert solar time to local time
-    sunriseTime = sunriseTime - eot / 60.0 - longitude / 15.0;
+    // Same sun, new transposition
+    forecastValid = false;
+}
+
+void SolarCalc::setTimeZone(const TimeZone* zone) {
+    // Also called for the same zone recompiled in place, so always invalidate
+    timeZone = zone;
+    skyYear = 0;
+}
+
+// Iterations before findElevation() settles for its bracket
+#define EVENT_MAX_STEPS 16
+
+time_t SolarCalc::findElevation(time_t low, time_t high, time_t guess, float target) {
+    // Orient the bracket so the sun is below target at low, above at high
+    float sign = positionAt(low).elevation < target ? 1.0f : -1.0f;
+    time_t t = guess > low && guess < high ? guess : low + (high - low) / 2;
+    
+    for (int step = 0; step < EVENT_MAX_STEPS && high - low > 1; step++) {
+        SolarPosition sun = positionAt(t);
+        float error = sign * (sun.elevation - target);
+        if (error < 0) {
+            low = t;
+        } else {
+            high = t;
+        }
+        
+        // dE/dt from sin E = sin(lat) sin(dec) + cos(lat) cos(dec) cos(H), degrees per second;
+        // the hour angle turns 360 degrees a day
+        float cosElevation = cos(sun.elevation * PI / 180.0);
+        float slope = -cosLatitude * cos(sun.declination * PI / 180.0) * sin(sun.hourAngle * PI / 180.0) /
+                      cosElevation * (360.0f / SECONDS_PER_DAY);
+        
+        // Newton while it stays inside the bracket, bisection when it would not. A step
+        // that lands on an end of the bracket puts the crossing within a second of it.
+        float move = slope != 0 ? -(sun.elevation - target) / slope : INFINITY;
+        time_t next = fabsf(move) < (float)(high - low) ? t + (time_t)lroundf(move) : low - 1;
+        if (next == t || next == low || next == high) {
+            t = next;
+            break;
+        }
+        t = next > low && next < high ? next : low + (high - low) / 2;
+    }
+    return t;
+}
+
+// Standard refraction for an apparent horizon-ish sun, Saemundsson, degrees
+static float refraction(float elevation) {
+    if (elevation < -1) return 0;
+    return 1.02f / tan((elevation + 10.3f / (elevation + 5.11f)) * PI / 180.0) / 60.0f;
+}
+
+SolarCalc::SolarDayEntry SolarCalc::solveDay(int year, int month, int day) {
+    TRACE_SCOPE("solar.events");
+    stats.eventDays++;
+    time_t dayStart = EpochTime::fromCivil(year, month, day);
+    
+    // Solar noon: from mean noon at this longitude, Newton on the hour angle
+    time_t noon = dayStart + lroundf((12.0f - longitude / 15.0f) * 3600.0f);
+    SolarPosition sun = positionAt(noon);
+    noon -= lroundf(sun.equationOfTime * 60.0f);
+    for (int step = 0; step < 2; step++) {
+        sun = positionAt(noon);
+        noon -= lroundf(sun.hourAngle / 15.0f * 3600.0f);
+    }
+    sun = positionAt(noon);
+    
+    SolarDayEntry entry;
+    entry.at[0] = (int32_t)(noon - dayStart);
+    entry.maxElevation = sun.elevation + refraction(sun.elevation);
+    
+    // Each event either side of noon, bracketed by the lowest sun half a day away
+    time_t before = noon - SECONDS_PER_DAY / 2, after = noon + SECONDS_PER_DAY / 2;
+    float lowBefore = positionAt(before).elevation, lowAfter = positionAt(after).elevation;
+    float sinDeclination = sin(sun.declination * PI / 180.0), cosDeclination = cos(sun.declination * PI / 180.0);
+    static const float depressions[3] = {SOLAR_HORIZON, -6.0f, -12.0f};
+    for (int k = 0; k < 3; k++) {
+        float target = depressions[k];
+        int32_t* rise = &entry.at[1 + 2 * k];
+        int32_t* set = &entry.at[2 + 2 * k];
+        *rise = INT32_MIN;
+        *set = INT32_MIN;
+        if (sun.elevation <= target) continue;
+        
+        // The closed form at noon's declination to start from
+        float cosHourAngle = (sin(target * PI / 180.0) - sinLatitude * sinDeclination) / (cosLatitude * cosDeclination);
+        cosHourAngle = cosHourAngle < -1 ? -1 : (cosHourAngle > 1 ? 1 : cosHourAngle);
+        time_t offset = lroundf(acos(cosHourAngle) * 180.0 / PI / 15.0f * 3600.0f);
+        
+        if (lowBefore < target) *rise = (int32_t)(findElevation(before, noon, noon - offset, target) - dayStart);
+        if (lowAfter < target) *set = (int32_t)(findElevation(noon, after, noon + offset, target) - dayStart);
+    }
     
-    return sunriseTime;
+    if (sun.elevation <= SOLAR_HORIZON) {
+        entry.cycle = SUN_POLAR_NIGHT;
+    } else if (lowBefore >= SOLAR_HORIZON && lowAfter >= SOLAR_HORIZON) {
+        entry.cycle = SUN_POLAR_DAY;
+    } else {
+        entry.cycle = SUN_RISES_AND_SETS;
+    }
+    return entry;
+}
+
+void SolarCalc::loadSolarYear(int year) {
+    TRACE_SCOPE("solar.year");
+    int days = EpochTime::daysInYear(year);
+    int64_t firstDay = EpochTime::daysFromCivil(year, 1, 1);
+    eventYear.resize(days);
+    for (int i = 0; i < days; i++) {
+        int y, m, d;
+        EpochTime::civilFromDays(firstDay + i, y, m, d);
+        eventYear[i] = solveDay(y, m, d);
+    }
+    eventYearNumber = year;
+}
+
+const SolarDay& SolarCalc::getSolarDay(int year, int month, int day) {
+    int64_t dayNumber = EpochTime::daysFromCivil(year, month, day);
+    if (dayNumber == eventDayNumber) return eventDay;
+    
+    SolarDayEntry entry = year == eventYearNumber ? eventYear[EpochTime::dayOfYear(year, month, day) - 1]
+                                                  : solveDay(year, month, day);
+    time_t dayStart = dayNumber * SECONDS_PER_DAY;
+    time_t* times[7] = {&eventDay.solarNoon, &eventDay.sunrise, &eventDay.sunset, &eventDay.civilDawn,
+                        &eventDay.civilDusk, &eventDay.nauticalDawn, &eventDay.nauticalDusk};
+    for (int i = 0; i < 7; i++) {
+        *times[i] = entry.at[i] == INT32_MIN ? 0 : dayStart + entry.at[i];
+    }
+    eventDay.maxElevation = entry.maxElevation;
+    eventDay.cycle = entry.cycle;
+    eventDayNumber = dayNumber;
+    return eventDay;
+}
+
+float SolarCalc::getHoursOfDay(int year, int month, int day, time_t at) {
+    if (at == 0) return -1;
+    time_t local = timeZone ? timeZone->toLocal(at) : at;
+    return (local - EpochTime::fromCivil(year, month, day)) / 3600.0f;
+}
+
+float SolarCalc::getSunriseTime(int year, int month, int day) {
+    return getHoursOfDay(year, month, day, getSunriseAt(year, month, day));
 }
 
 float SolarCalc::getSunsetTime(int year, int month, int day) {
-    float julianDay = getJulianDay(year, month, day);
-    float declination = getSolarDeclination(julianDay);
-    float eot = getEquationOfTime(julianDay);
-    
-    float latRad = latitude * PI / 180.0;
-    
-    // Calculate sunset hour angle
-    float cosHourAngle = -tan(latRad) * tan(declination);
-    
-    if (cosHourAngle > 1.0) return -1; // No sunrise (polar night)
-    if (cosHourAngle < -1.0) return -1; // No sunset (polar day)
-    
-    float hourAngle = acos(cosHourAngle);
-    float sunsetTime = 12.0 + hourAngle * 180.0 / PI / 15.0;
-    
-    // Convert solar time to local time
-    sunsetTime = sunsetTime - eot / 60.0 - longitude / 15.0;
-    
-    return sunsetTime;
+    return getHoursOfDay(year, month, day, getSunsetAt(year, month, day));
 }
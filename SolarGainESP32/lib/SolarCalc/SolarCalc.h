@@ -3,6 +3,17 @@
 
 #include <Arduino.h>
 #include <vector>
+#include "../EpochTime/TimeZone.h"
+
+// Clear-sky model constants: extraterrestrial beam (W/m²), diffuse as a
+// fraction of the beam, and ground reflectance
+#define SOLAR_CONSTANT 1367.0f
+#define SOLAR_DIFFUSE_FRACTION 0.1f
+#define SOLAR_ALBEDO 0.2f
+
+// Geometric elevation of the sun's centre at sunrise and sunset, degrees:
+// 34' of refraction and 16' of semi-diameter
+#define SOLAR_HORIZON -0.8333f
 
 struct HourlyIrradiance {
     int hour;
@@ -13,6 +24,57 @@ struct DailyForecast {
     float totalIrradiance; // kWh/m²
     std::vector<HourlyIrradiance> hourlyData;
     String date;
+    float sunrise = -1;    // wall-clock hours as getSunriseTime(); -1 when there is none
+    float sunset = -1;
+};
+
+// How often each stage of the forecast ran
+struct SolarCalcStats {
+    uint32_t ephemerisRuns;     // sun positions and clear-sky beam for a date
+    uint32_t transpositions;    // beam and diffuse onto the panel
+    uint32_t cacheHits;         // forecast returned as it was
+    uint32_t eventDays;         // dates whose sun events were solved
+};
+
+// Sun position at an instant, geometric (no refraction)
+struct SolarPosition {
+    float elevation;      // degrees above the horizon
+    float azimuth;        // degrees clockwise from north
+    float declination;    // degrees
+    float hourAngle;      // degrees, negative before solar noon
+    float equationOfTime; // minutes
+};
+
+// Whether the sun crosses the horizon on a date
+enum SunCycle : uint8_t {
+    SUN_RISES_AND_SETS,
+    SUN_POLAR_DAY,        // above the horizon all day
+    SUN_POLAR_NIGHT       // below it all day
+};
+
+// The sun's events around a date's solar noon, UTC instants; 0 for an event
+// that does not happen. Sunrise and sunset put the upper limb on the horizon
+// through standard refraction, the centre at SOLAR_HORIZON; twilights put
+// the centre 6 and 12 degrees down. Twilights can be missing on their own:
+// at 60 degrees north in June the sun never gets 12 degrees down.
+struct SolarDay {
+    time_t solarNoon;
+    time_t sunrise;
+    time_t sunset;
+    time_t civilDawn;
+    time_t civilDusk;
+    time_t nauticalDawn;
+    time_t nauticalDusk;
+    float maxElevation;   // degrees at solar noon, refracted
+    SunCycle cycle;
+};
+
+// Sun and clear-sky irradiance for the middle of one hour of a date
+struct SkyHour {
+    float elevation;      // radians; 0 for an hour a DST change skips
+    float azimuth;        // radians clockwise from north
+    float dni;            // W/m²
+    float dhi;            // W/m²
 };
 
 class SolarCalc {
@@ -22,15 +84,59 @@ private:
     float elevation;
     float panelTilt;
     float panelAzimuth;
+    float sinLatitude;
+    float cosLatitude;
+    const TimeZone* timeZone;   // nullptr: dates and hours are UTC
     
-    // Calculate Julian day number
-    float getJulianDay(int year, int month, int day);
+    // Declination and equation of time at the start and end of one UTC day;
+    // positionAt() interpolates between them, so only a new day costs trig
+    int64_t termsDay;
+    float dayDeclination[2];
+    float dayEquationOfTime[2];
+    void loadDayTerms(int64_t dayNumber);
+    
+    // Forecast in two cached stages. The sun and clear-sky beam for each hour
+    // depend on the date, site and zone; only transposition depends on the
+    // panel, so a tilt change reuses the sky.
+    SkyHour skyHours[24];
+    int skyYear;              // 0 when the sky must be recomputed
+    int skyMonth;
+    int skyDay;
+    DailyForecast cachedForecast;
+    bool forecastValid;
+    SolarCalcStats stats;
+    void computeSky(int year, int month, int day);
+    void transpose();
+    
+    // Fractional year in radians (Spencer), from the exact day of the year
+    float getFractionalYear(int year, int dayOfYear, float utcHours);
     
     // Calculate solar declination angle
-    float getSolarDeclination(float julianDay);
+    float getSolarDeclination(float fractionalYear);
     
     // Calculate equation of time
-    float getEquationOfTime(float julianDay);
+    float getEquationOfTime(float fractionalYear);
+    
+    // Sun events, compact: seconds from 00:00 UTC of the date, INT32_MIN
+    // for none. One date solved on demand, or a whole year by loadSolarYear().
+    struct SolarDayEntry {
+        int32_t at[7];        // in SolarDay's order
+        float maxElevation;
+        SunCycle cycle;
+    };
+    std::vector<SolarDayEntry> eventYear;
+    int eventYearNumber;      // 0 when none is loaded
+    int64_t eventDayNumber;   // UTC day number held in eventDay
+    SolarDay eventDay;
+    SolarDayEntry solveDay(int year, int month, int day);
+    
+    // When the sun's centre passes a geometric elevation between two
+    // instants that bracket it, by Newton's method on positionAt() kept
+    // inside the bracket; starts from guess
+    time_t findElevation(time_t low, time_t high, time_t guess, float target);
+    
+    // Wall-clock hours of an instant after the start of the date; -1 for no event
+    float getHoursOfDay(int year, int month, int day, time_t at);
     
     // Calculate hour angle
     float getHourAngle(float localSolarTime);
@@ -53,6 +159,25 @@ private:
     // Calculate global horizontal irradiance (GHI)
     float getGlobalHorizontalIrradiance(float dni, float dhi, float solarElevation);
     
+    // The sun's elevation over a stretch, by hour angle w:
+    // sin(elevation) = a + b cos(w) + (driftA + driftB cos(w)) (w - middle),
+    // the last term carrying the declination's drift through the stretch
+    struct SunArc {
+        double a, b;
+        double driftA, driftB;
+        double middle;
+    };
+    
+    // Energy on the panel over a stretch of at most an hour within one UTC
+    // day, kWh/m²
+    double integrateStretch(time_t fromUtc, time_t toUtc);
+    
+    // Integral over hour angles start..start + 2 radius of DNI x the weight
+    // per unit of DNI, p + q cos(w) + s sin(w) plus its drift's p, q, s x
+    // (w - middle); W/m² x radians
+    double integrateSegment(const SunArc& arc, double start, double radius, const double* weight,
+                            const double* weightDrift);
+    
     // Calculate irradiance on tilted surface
     float getTiltedSurfaceIrradiance(float dni, float dhi, float solarElevation, 
                                     float solarAzimuth, float surfaceTilt, float surfaceAzimuth);
@@ -60,12 +185,67 @@ private:
 public:
     SolarCalc(float lat, float lon, float elev, float tilt, float azimuth);
     
-    // Calculate hourly irradiance for a specific day
+    // Read dates and hours in a compiled zone (ConfigManager::getTimeZone());
+    // it must outlive this object
+    void setTimeZone(const TimeZone* zone);
+    
+    // Hot-reload hooks for ConfigManager changes; each invalidates only the
+    // cached stages that depend on it
+    void setSite(float lat, float lon, float elev);
+    void setPanel(float tilt, float azimuth);
+    SolarCalcStats getStats() const { return stats; }
+    
+    // Sun position at a UTC instant. Consecutive calls on the same UTC day
+    // reuse the day's terms, so tracking loops can call it freely.
+    SolarPosition positionAt(time_t utc);
+    
+    // Clear-sky beam (DNI, W/m²) at this site's elevation for a sun elevation
+    // in radians; 0 at or below the horizon. Diffuse is a fixed fraction of it.
+    float getClearSkyDni(float solarElevation) {
+        return solarElevation > 0 ? getDirectNormalIrradiance(getAirMass(solarElevation)) : 0.0f;
+    }
+    
+    // The beam model's terms, for code that perturbs them: DNI is
+    // SOLAR_CONSTANT x exp(-extinction x air mass), 0 past an air mass of 40.
+    // Air mass is at this site's pressure, for a sun elevation in radians.
+    float getAirMassAt(float solarElevation) { return getAirMass(solarElevation); }
+    float getExtinction() const { return 0.75f + 2e-5f * elevation; }
+    
+    // The 24 sky hours behind calculateDailyForecast() for a date, computed
+    // once and cached like the forecast; valid until the date, site or zone changes
+    const SkyHour* getSky(int year, int month, int day);
+    
+    // Calculate hourly irradiance for a specific day. Hours are local with a
+    // zone set, UTC without; an hour skipped by a daylight-saving change is 0.
+    // Asking again for the same day returns the cached forecast.
     DailyForecast calculateDailyForecast(int year, int month, int day);
     
-    // Get sunrise and sunset times
+    // Energy on the panel between two UTC instants, kWh/m². The geometry is
+    // integrated in closed form between the exact sunrise, sunset and
+    // incidence cut-offs; only the beam's air-mass attenuation is sampled,
+    // at four points per stretch between cut-offs (eight near the horizon).
+    float integrateEnergy(time_t fromUtc, time_t toUtc);
+    
+    // calculateDailyForecast() with each hour integrated rather than sampled
+    // at its middle; not cached
+    DailyForecast integrateDailyForecast(int year, int month, int day);
+    
+    // Sunrise, sunset, solar noon and twilights for a date. From the year
+    // table when loadSolarYear() has run for the date's year, else solved
+    // once and kept until another date is asked for. Valid until the next call.
+    const SolarDay& getSolarDay(int year, int month, int day);
+    
+    // Solve every date of a year in one pass; until the site changes, dates
+    // in it cost a table lookup
+    void loadSolarYear(int year);
+    
+    // Get sunrise and sunset times, wall-clock hours after midnight of the date; -1 when there is none
     float getSunriseTime(int year, int month, int day);
     float getSunsetTime(int year, int month, int day);
+    
+    // The same events as UTC instants, for the Scheduler and SleepPlanner; 0 when there is none
+    time_t getSunriseAt(int year, int month, int day) { return getSolarDay(year, month, day).sunrise; }
+    time_t getSunsetAt(int year, int month, int day) { return getSolarDay(year, month, day).sunset; }
 };
 
 #endif // SOLAR_CALC_H
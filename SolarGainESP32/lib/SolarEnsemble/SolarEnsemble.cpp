@@ -0,0 +1,274 @@
+#include "SolarEnsemble.h"
+#include <algorithm>
+#include <math.h>
+#include "../Trace/Trace.h"
+#ifdef HOST_BUILD
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+#else
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#endif
+
+static const float DEG = PI / 180.0;
+
+// Draws per member: turbidity, extinction, albedo, then one per two hours of cloud
+#define DRAW_TURBIDITY 0
+#define DRAW_EXTINCTION 1
+#define DRAW_ALBEDO 2
+#define DRAW_CLOUD 3
+
+// SplitMix64 evaluated at a position rather than stepped: output n of the
+// stream for this seed, n from the member and the draw
+static uint64_t drawBits(uint64_t seed, uint32_t member, uint32_t draw) {
+    uint64_t z = seed + (((uint64_t)member << 32 | draw) + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Two 24-bit uniforms in (0, 1) from one draw
+static void uniformPair(uint64_t bits, float& first, float& second) {
+    first = ((bits >> 40) + 0.5f) / 16777216.0f;
+    second = ((bits & 0xFFFFFF) + 0.5f) / 16777216.0f;
+}
+
+// Box-Muller: two independent standard normals from one draw
+static void normalPair(uint64_t bits, float& first, float& second) {
+    float u, v;
+    uniformPair(bits, u, v);
+    float radius = sqrtf(-2.0f * logf(u));
+    first = radius * cosf(2 * PI * v);
+    second = radius * sinf(2 * PI * v);
+}
+
+static float clampTo(float value, float low, float high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+// Member values; PSRAM when the board has it. Null when there is no room.
+static float* allocateValues(size_t count) {
+#ifdef HOST_BUILD
+    return (float*)malloc(count * sizeof(float));
+#else
+    float* values = (float*)heap_caps_malloc(count * sizeof(float), MALLOC_CAP_SPIRAM);
+    return values ? values : (float*)heap_caps_malloc(count * sizeof(float), MALLOC_CAP_8BIT);
+#endif
+}
+
+SolarEnsemble::SolarEnsemble(float latitude, float longitude, float elevation, float tilt, float azimuth)
+    : solar(latitude, longitude, elevation, tilt, azimuth), panelTilt(tilt), panelAzimuth(azimuth),
+      spread(defaultSpread()), skyView(0), groundView(0), hourly(nullptr), daily(nullptr), memberCount(0),
+      seed(0) {
+    setCloudCover(nullptr);
+    memset(hours, 0, sizeof(hours));
+}
+
+EnsembleSpread SolarEnsemble::defaultSpread() {
+    EnsembleSpread value;
+    value.turbidity = 0.15f;
+    value.extinction = 0.03f;
+    value.albedoMin = 0.12f;
+    value.albedoMax = 0.30f;
+    value.cloud = 0.15f;
+    value.cloudCorrelation = 0.8f;
+    return value;
+}
+
+void SolarEnsemble::setCloudCover(const float* cover) {
+    for (int hour = 0; hour < 24; hour++) {
+        cloudCover[hour] = cover ? clampTo(cover[hour], 0, 1) : 0;
+    }
+}
+
+// One hour for a block of members. Restrict-qualified parameters let the
+// compiler keep it a straight pass, as in SolarRaster.
+static void accumulateHour(float airMass, float sinElevation, float cosIncidence, float skyView, float groundView,
+                           const float* __restrict depth, const float* __restrict albedo,
+                           const float* __restrict cover, float* __restrict out, float* __restrict total,
+                           uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        float beam = SOLAR_CONSTANT * expf(-depth[i] * airMass);
+        float clearGhi = beam * (sinElevation + SOLAR_DIFFUSE_FRACTION);
+
+        // Kasten-Czeplak for the global, the beam cut by the cover, the rest diffuse
+        float ghi = clearGhi * (1 - 0.75f * powf(cover[i], 3.4f));
+        float dni = beam * (1 - cover[i]);
+        float dhi = ghi - dni * sinElevation;
+
+        float energy = (dni * cosIncidence + dhi * skyView + albedo[i] * ghi * groundView) * 0.001f;
+        out[i] = energy;
+        total[i] += energy;
+    }
+}
+
+void SolarEnsemble::runBlock(uint32_t block) {
+    uint32_t first = block * ENSEMBLE_BLOCK;
+    uint32_t count = memberCount - first < ENSEMBLE_BLOCK ? memberCount - first : ENSEMBLE_BLOCK;
+    float depth[ENSEMBLE_BLOCK], albedo[ENSEMBLE_BLOCK], total[ENSEMBLE_BLOCK];
+    float error[ENSEMBLE_BLOCK], spare[ENSEMBLE_BLOCK], cover[ENSEMBLE_BLOCK];
+
+    // The member's atmosphere: optical depth is extinction x turbidity
+    float extinction = solar.getExtinction();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t member = first + i;
+        float turbidity, k, u, unused;
+        normalPair(drawBits(seed, member, DRAW_TURBIDITY), turbidity, unused);
+        normalPair(drawBits(seed, member, DRAW_EXTINCTION), k, unused);
+        uniformPair(drawBits(seed, member, DRAW_ALBEDO), u, unused);
+        depth[i] = max(0.0f, extinction + spread.extinction * k) * expf(spread.turbidity * turbidity);
+        albedo[i] = spread.albedoMin + (spread.albedoMax - spread.albedoMin) * u;
+        total[i] = 0;
+    }
+
+    float innovation = sqrtf(1 - spread.cloudCorrelation * spread.cloudCorrelation);
+    for (int hour = 0; hour < 24; hour++) {
+        // Cloud error, a stationary AR(1) through the day; a pair of hours per draw
+        for (uint32_t i = 0; i < count; i++) {
+            float z;
+            if (hour % 2 == 0) {
+                normalPair(drawBits(seed, first + i, DRAW_CLOUD + hour / 2), z, spare[i]);
+            } else {
+                z = spare[i];
+            }
+            error[i] = hour == 0 ? z : spread.cloudCorrelation * error[i] + innovation * z;
+            cover[i] = clampTo(cloudCover[hour] + spread.cloud * error[i], 0, 1);
+        }
+
+        float* out = &hourly[(size_t)hour * memberCount + first];
+        const HourTerms& h = hours[hour];
+        if (h.airMass <= 0) {
+            for (uint32_t i = 0; i < count; i++) out[i] = 0;
+            continue;
+        }
+        accumulateHour(h.airMass, h.sinElevation, h.cosIncidence, skyView, groundView, depth, albedo, cover, out,
+                       total, count);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        daily[first + i] = total[i];
+    }
+}
+
+void SolarEnsemble::runBlocks(std::atomic<uint32_t>* next) {
+    uint32_t blocks = (memberCount + ENSEMBLE_BLOCK - 1) / ENSEMBLE_BLOCK;
+    uint32_t block;
+    while ((block = (*next)++) < blocks) {
+        runBlock(block);
+    }
+}
+
+#ifndef HOST_BUILD
+struct EnsembleHelper {
+    SolarEnsemble* ensemble;
+    std::atomic<uint32_t>* next;
+    SemaphoreHandle_t done;
+};
+
+void SolarEnsemble::taskMain(void* param) {
+    EnsembleHelper* helper = (EnsembleHelper*)param;
+    helper->ensemble->runBlocks(helper->next);
+    xSemaphoreGive(helper->done);
+    vTaskDelete(nullptr);
+}
+#endif
+
+// P90/P50/P10 by exceedance, interpolated between ranks; sorts the values
+static EnsembleQuantiles quantiles(float* values, uint32_t count) {
+    double sum = 0;
+    for (uint32_t i = 0; i < count; i++) sum += values[i];
+    std::sort(values, values + count);
+
+    EnsembleQuantiles result;
+    const float fractions[3] = {0.1f, 0.5f, 0.9f};
+    float* targets[3] = {&result.p90, &result.p50, &result.p10};
+    for (int q = 0; q < 3; q++) {
+        float rank = fractions[q] * (count - 1);
+        uint32_t below = (uint32_t)rank;
+        uint32_t above = below + 1 < count ? below + 1 : below;
+        *targets[q] = values[below] + (values[above] - values[below]) * (rank - below);
+    }
+    result.mean = sum / count;
+    return result;
+}
+
+bool SolarEnsemble::run(int year, int month, int day, uint32_t members, uint64_t runSeed, EnsembleForecast& out,
+                        unsigned threads) {
+    TRACE_SCOPE("ensemble.run");
+    if (members == 0 || members > ENSEMBLE_MAX_MEMBERS) return false;
+    unsigned long start = micros();
+
+    // The sky once for every member
+    const SkyHour* sky = solar.getSky(year, month, day);
+    float cosTilt = cosf(panelTilt * DEG), sinTilt = sinf(panelTilt * DEG);
+    skyView = (1 + cosTilt) / 2;
+    groundView = (1 - cosTilt) / 2;
+    for (int hour = 0; hour < 24; hour++) {
+        HourTerms& h = hours[hour];
+        if (sky[hour].elevation <= 0) {
+            h.airMass = 0;
+            h.sinElevation = 0;
+            h.cosIncidence = 0;
+            continue;
+        }
+        h.airMass = solar.getAirMassAt(sky[hour].elevation);
+        h.sinElevation = sinf(sky[hour].elevation);
+        float cosIncidence = h.sinElevation * cosTilt +
+                             cosf(sky[hour].elevation) * sinTilt * cosf(sky[hour].azimuth - panelAzimuth * DEG);
+        h.cosIncidence = max(0.0f, cosIncidence);
+    }
+
+    hourly = allocateValues((size_t)members * 25);
+    if (!hourly) return false;
+    daily = hourly + (size_t)members * 24;
+    memberCount = members;
+    seed = runSeed;
+
+    std::atomic<uint32_t> next(0);
+#ifdef HOST_BUILD
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++) {
+        workers.emplace_back([this, &next] { runBlocks(&next); });
+    }
+    runBlocks(&next);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+#else
+    // The calling task and one helper on the other core
+    if (threads == 0 || threads > portNUM_PROCESSORS) threads = portNUM_PROCESSORS;
+    EnsembleHelper helper = {this, &next, nullptr};
+    if (threads > 1) {
+        helper.done = xSemaphoreCreateBinary();
+        if (!helper.done || xTaskCreatePinnedToCore(taskMain, "ensemble", ENSEMBLE_TASK_STACK, &helper,
+                                                    uxTaskPriorityGet(nullptr), nullptr,
+                                                    1 - xPortGetCoreID()) != pdPASS) {
+            threads = 1;
+        }
+    }
+    runBlocks(&next);
+    if (threads > 1) xSemaphoreTake(helper.done, portMAX_DELAY);
+    if (helper.done) vSemaphoreDelete(helper.done);
+#endif
+
+    for (int hour = 0; hour < 24; hour++) {
+        out.hour[hour] = quantiles(&hourly[(size_t)hour * members], members);
+    }
+    out.day = quantiles(daily, members);
+
+    // Nothing is kept between runs
+    free(hourly);
+    hourly = nullptr;
+    daily = nullptr;
+
+    out.members = members;
+    out.threads = threads;
+    out.seconds = (micros() - start) / 1000000.0f;
+    out.membersPerSecond = out.seconds > 0 ? members / out.seconds : 0;
+    return true;
+}
@@ -0,0 +1,112 @@
+#ifndef SOLAR_ENSEMBLE_H
+#define SOLAR_ENSEMBLE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "../SolarCalc/SolarCalc.h"
+
+// Members are computed in blocks of this many, one block per worker at a time
+#ifndef ENSEMBLE_BLOCK
+#define ENSEMBLE_BLOCK 64
+#endif
+
+// Each member keeps 25 floats, 100 bytes, until the quantiles are taken. On
+// the device 1024 members is 100 KB, which the internal heap of a board
+// without PSRAM can still hold; with PSRAM the cap can be raised.
+#ifndef ENSEMBLE_MAX_MEMBERS
+#ifdef HOST_BUILD
+#define ENSEMBLE_MAX_MEMBERS (1u << 20)
+#else
+#define ENSEMBLE_MAX_MEMBERS 1024
+#endif
+#endif
+
+// The helper task on the other core
+#ifndef ENSEMBLE_TASK_STACK
+#define ENSEMBLE_TASK_STACK 4096
+#endif
+
+// How far each member strays from SolarCalc's clear sky. Normal draws, with
+// the turbidity factor log-normal about 1 and the cloud error an AR(1)
+// series through the day.
+struct EnsembleSpread {
+    float turbidity;          // sd of ln(factor on the beam's optical depth)
+    float extinction;         // sd of SolarCalc's extinction coefficient k
+    float albedoMin;          // ground reflectance, uniform between these
+    float albedoMax;
+    float cloud;              // sd of each hour's cloud cover about the forecast, 0..1
+    float cloudCorrelation;   // of the cloud error from one hour to the next
+};
+
+// P90 is the energy 90% of members reach, the 10th percentile; P10 the 90th
+struct EnsembleQuantiles {
+    float p90;
+    float p50;
+    float p10;
+    float mean;
+};
+
+struct EnsembleForecast {
+    EnsembleQuantiles hour[24];   // kWh/m², the wall-clock hours of calculateDailyForecast()
+    EnsembleQuantiles day;        // of each member's daily total
+    uint32_t members;
+    unsigned threads;
+    float seconds;
+    float membersPerSecond;
+};
+
+// Monte Carlo spread around the clear-sky forecast. Each member draws its
+// own turbidity, extinction, albedo and hourly cloud cover; clouds follow
+// Kasten-Czeplak, GHI x (1 - 0.75 C^3.4), with the beam x (1 - C) and the
+// rest diffuse.
+//
+// Draws come from a counter-based generator keyed by (seed, member, draw),
+// so a member is the same whichever worker computes it: results do not
+// depend on the thread count. Members are laid out by hour, a block at a
+// time, and each hour is one branch-free pass over the block.
+class SolarEnsemble {
+private:
+    SolarCalc solar;
+    float panelTilt;
+    float panelAzimuth;
+    EnsembleSpread spread;
+    float cloudCover[24];
+
+    // Per-hour terms from the sky, shared by every member
+    struct HourTerms {
+        float airMass;        // 0 with the sun down or beyond the model's air mass
+        float sinElevation;
+        float cosIncidence;   // clamped at 0
+    };
+    HourTerms hours[24];
+    float skyView;            // (1 + cos tilt) / 2
+    float groundView;         // (1 - cos tilt) / 2
+
+    // Energy by hour then member, and each member's day; one allocation,
+    // held only while run() is computing
+    float* hourly;
+    float* daily;
+    uint32_t memberCount;
+    uint64_t seed;
+
+    void runBlock(uint32_t block);
+    void runBlocks(std::atomic<uint32_t>* next);
+    static void taskMain(void* param);
+
+public:
+    SolarEnsemble(float latitude, float longitude, float elevation, float tilt, float azimuth);
+
+    void setTimeZone(const TimeZone* zone) { solar.setTimeZone(zone); }
+    void setSpread(const EnsembleSpread& value) { spread = value; }
+    static EnsembleSpread defaultSpread();
+
+    // Forecast cloud cover 0..1 per wall-clock hour; nullptr for clear sky
+    void setCloudCover(const float* cover);
+
+    // Run members for a date. Threads 0 uses every core. False with no
+    // members, more than ENSEMBLE_MAX_MEMBERS or no memory for them.
+    bool run(int year, int month, int day, uint32_t members, uint64_t seed, EnsembleForecast& out,
+             unsigned threads = 0);
+};
+
+#endif // SOLAR_ENSEMBLE_H
@@ -1,78 +1,99 @@
 #include "TimeSync.h"
+#include "../Trace/Trace.h"
+#include "../MemoryMonitor/MemoryMonitor.h"
 
-TimeSync::TimeSync() : timeClient(nullptr), initialized(false), timezoneOffset(2), lastFiredDay(-1), lastFiredMinute(-1) {
+TimeSync* TimeSync::active = nullptr;
+
+TimeSync::TimeSync() : zone(&fixedZone), initialized(false), lastSamples(0) {
+    fixedZone.setFixed(2 * 3600);
 }
 
 TimeSync::~TimeSync() {
-    if (timeClient) {
-        delete timeClient;
+    sntp.stop();
+    if (active == this) {
+        setSyncProvider(nullptr);
+        active = nullptr;
     }
 }
 
-void TimeSync::begin(int offsetHours) {
-    timezoneOffset = offsetHours;
+void TimeSync::begin(int offsetHours, const char* server) {
+    fixedZone.setFixed((int32_t)offsetHours * 3600);
+    
+    // Sync from a background task; starts hourly and backs off to days as the drift settles
+    sntp.begin(server);
+    sntp.startTask();
     
-    // Initialize NTP client with pool.ntp.org and timezone offset
-    timeClient = new NTPClient(ntpUDP, "pool.ntp.org", offsetHours * 3600, 60000);
-    timeClient->begin();
+    // Keep TimeLib's now() on the disciplined clock for any code that uses it directly
+    active = this;
+    setSyncProvider(timeLibProvider);
+    setSyncInterval(60);
     
     initialized = true;
     
     Serial.println("TimeSync initialized with timezone offset: GMT+" + String(offsetHours));
 }
 
+void TimeSync::setTimeZone(const TimeZone* timeZone) {
+    zone = timeZone ? timeZone : &fixedZone;
+    Serial.println("TimeSync following timezone " + String(zone->abbreviation(sntp.nowSeconds())));
+}
+
+time_t TimeSync::timeLibProvider() {
+    if (!active || !active->sntp.isSynchronized()) return 0;
+    return active->localNow();
+}
+
+time_t TimeSync::localNow() {
+    return utcToLocal(sntp.nowSeconds());
+}
+
 bool TimeSync::update() {
-    if (!initialized || !timeClient) {
-        Serial.println("TimeSync not initialized!");
-        return false;
-    }
+    TRACE_SCOPE("timesync.update");
     
-    if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("WiFi not connected, cannot sync time");
+    if (!initialized) {
+        Serial.println("TimeSync not initialized!");
         return false;
     }
     
-    bool success = timeClient->update();
-    
-    if (success) {
-        // Set the system time
-        setTime(timeClient->getEpochTime());
-        Serial.println("Time synchronized: " + getDateTimeString());
-    } else {
-        Serial.println("Failed to sync time from NTP server");
+    ClockStats stats = sntp.getClockStats();
+    if (stats.samples != lastSamples) {
+        lastSamples = stats.samples;
+        Serial.println("Time synchronized: " + getDateTimeString() + " (offset " + String(stats.offsetUs) +
+                       " us, drift " + String(stats.driftPpm, 2) + " ppm, next in " +
+                       String(stats.intervalS) + " s)");
     }
     
-    return success;
+    return stats.synchronized;
 }
 
 int TimeSync::getHour() {
     if (!initialized) return -1;
-    return hour();
+    return hour(localNow());
 }
 
 int TimeSync::getMinute() {
     if (!initialized) return -1;
-    return minute();
+    return minute(localNow());
 }
 
 int TimeSync::getSecond() {
     if (!initialized) return -1;
-    return second();
+    return second(localNow());
 }
 
 int TimeSync::getDay() {
     if (!initialized) return -1;
-    return day();
+    return day(localNow());
 }
 
 int TimeSync::getMonth() {
     if (!initialized) return -1;
-    return month();
+    return month(localNow());
 }
 
 int TimeSync::getYear() {
     if (!initialized) return -1;
-    return year();
+    return year(localNow());
 }
 
 String TimeSync::getTimeString() {
@@ -94,39 +115,23 @@ String TimeSync::getDateString() {
 }
 
 String TimeSync::getDateTimeString() {
+    MEMORY_SCOPE(MEM_TAG_TIMESYNC);
     return getDateString() + " " + getTimeString();
 }
 
 unsigned long TimeSync::getEpochTime() {
-    if (!initialized || !timeClient) return 0;
-    return timeClient->getEpochTime();
+    if (!initialized || !sntp.isSynchronized()) return 0;
+    return localNow();
 }
 
 bool TimeSync::isSynchronized() {
     if (!initialized) return false;
     
-    // Consider synchronized if we have a valid time (year > 2020)
-    return getYear() > 2020;
+    // Consider synchronized once the first SNTP reply set the clock
+    return sntp.isSynchronized() && getYear() > 2020;
 }
 
 time_t TimeSync::utcToLocal(time_t utc) {
-    return utc + (timezoneOffset * 3600);
-}
-
-bool TimeSync::isScheduledTime(int targetHour, int targetMinute) {
-    if (!initialized) return false;
-    
-    int currentHour = getHour();
-    int currentMinute = getMinute();
-
-    if (currentHour == targetHour && currentMinute == targetMinute) {
-        int d = getDay();
-        if (lastFiredDay == d && lastFiredMinute == currentMinute) {
-            return false; // already fired this minute
-        }
-        lastFiredDay = d;
-        lastFiredMinute = currentMinute;
-        return true;
-    }
-    return false;
+    // O(1) while the clock stays between two transitions
+    return zone->toLocal(utc);
 }
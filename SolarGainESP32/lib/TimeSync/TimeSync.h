@@ -2,28 +2,38 @@
 #define TIME_SYNC_H
 
 #include <Arduino.h>
-#include <WiFi.h>
-#include <NTPClient.h>
-#include <WiFiUdp.h>
 #include <TimeLib.h>
+#include "../SntpClock/SntpClock.h"
+#include "../EpochTime/TimeZone.h"
 
 class TimeSync {
 private:
-    WiFiUDP ntpUDP;
-    NTPClient* timeClient;
-    int timezoneOffset;
+    SntpClock sntp;
+    TimeZone fixedZone;          // from begin(offsetHours)
+    const TimeZone* zone;        // fixedZone, or the site zone from setTimeZone()
     bool initialized;
-    int lastFiredDay;
-    int lastFiredMinute;
+    uint32_t lastSamples;
+    
+    // TimeLib sync provider: local time from the disciplined clock
+    static TimeSync* active;
+    static time_t timeLibProvider();
+    
+    // Current local time, whole seconds
+    time_t localNow();
     
 public:
     TimeSync();
     ~TimeSync();
     
-    // Initialize NTP client with timezone offset (in hours)
-    void begin(int offsetHours = 2); // Default to GMT+2 for Harare
+    // Start syncing in the background with timezone offset (in hours)
+    void begin(int offsetHours = 2, const char* server = SNTP_DEFAULT_SERVER); // Default to GMT+2 for Harare
+    
+    // Follow a compiled zone (ConfigManager::getTimeZone()) instead of the
+    // fixed offset; it must outlive this object. nullptr goes back to the offset.
+    void setTimeZone(const TimeZone* timeZone);
     
-    // Update time from NTP server
+    // Report a new sync if one landed; never waits on the network.
+    // Returns true while the clock is synchronized.
     bool update();
     
     // Get current time components
@@ -39,20 +49,29 @@ public:
     String getDateString();
     String getDateTimeString();
     
-    // Get Unix timestamp
+    // Get Unix timestamp (shifted by the timezone offset, as before)
     unsigned long getEpochTime();
     
+    // UTC, microseconds since the epoch
+    int64_t getEpochMicros() { return sntp.now(); }
+    
     // Check if time is synchronized
     bool isSynchronized();
     
-    // Get timezone offset
-    int getTimezoneOffset() { return timezoneOffset; }
+    // Offset in force now; whole hours, and exact seconds for half-hour zones
+    int getTimezoneOffset() { return getUtcOffsetSeconds() / 3600; }
+    int32_t getUtcOffsetSeconds() { return zone->offsetAt(sntp.nowSeconds()); }
+    const TimeZone& getTimeZone() { return *zone; }
     
     // Convert UTC to local time
     time_t utcToLocal(time_t utc);
     
-    // Check if it's time for scheduled task
-    bool isScheduledTime(int targetHour, int targetMinute);
+    // Offset, jitter and drift of the disciplined clock
+    ClockStats getClockStats() { return sntp.getClockStats(); }
+    SntpStats getSntpStats() { return sntp.getStats(); }
+    
+    // Seconds until the next sync needs the network
+    uint32_t secondsUntilSync() { return sntp.secondsUntilSync(); }
 };
 
 #endif // TIME_SYNC_H
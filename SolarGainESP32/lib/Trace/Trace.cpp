@@ -0,0 +1,125 @@
+#include "Trace.h"
+
+#ifdef TRACE_ENABLED
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+static portMUX_TYPE traceLock = portMUX_INITIALIZER_UNLOCKED;
+
+TraceEvent Trace::events[TRACE_BUFFER_SIZE];
+uint32_t Trace::next = 0;
+bool Trace::enabled = true;
+
+uint32_t Trace::nowUs() {
+    return (uint32_t)esp_timer_get_time();
+}
+
+TraceEvent* Trace::reserve() {
+    portENTER_CRITICAL(&traceLock);
+    TraceEvent* event = &events[next % TRACE_BUFFER_SIZE];
+    next++;
+    portEXIT_CRITICAL(&traceLock);
+    return event;
+}
+
+void Trace::complete(const char* name, uint32_t startUs, uint32_t startCycles, uint16_t startMhz) {
+    uint32_t cycles = nowCycles() - startCycles;
+    uint32_t endUs = nowUs();
+
+    // SleepPlanner may have changed the clock during the span; its cycles are
+    // then at two rates, and only the microsecond timer gives the length
+    uint16_t mhz = cpuMhz() == startMhz ? startMhz : 0;
+
+    TraceEvent* event = reserve();
+    event->name = name;
+    event->phase = 'X';
+    event->core = (uint8_t)xPortGetCoreID();
+    event->cpuMhz = mhz;
+    event->startUs = startUs;
+    event->endUs = endUs;
+    event->cycles = cycles;
+    event->value = 0;
+}
+
+void Trace::counter(const char* name, int32_t value) {
+    if (!enabled) return;
+
+    TraceEvent* event = reserve();
+    event->name = name;
+    event->phase = 'C';
+    event->core = (uint8_t)xPortGetCoreID();
+    event->cpuMhz = 0;
+    event->startUs = nowUs();
+    event->endUs = event->startUs;
+    event->cycles = 0;
+    event->value = value;
+}
+
+void Trace::instant(const char* name) {
+    if (!enabled) return;
+
+    TraceEvent* event = reserve();
+    event->name = name;
+    event->phase = 'i';
+    event->core = (uint8_t)xPortGetCoreID();
+    event->cpuMhz = 0;
+    event->startUs = nowUs();
+    event->endUs = event->startUs;
+    event->cycles = 0;
+    event->value = 0;
+}
+
+uint32_t Trace::size() {
+    return next < TRACE_BUFFER_SIZE ? next : TRACE_BUFFER_SIZE;
+}
+
+uint32_t Trace::overwritten() {
+    return next > TRACE_BUFFER_SIZE ? next - TRACE_BUFFER_SIZE : 0;
+}
+
+void Trace::clear() {
+    portENTER_CRITICAL(&traceLock);
+    next = 0;
+    portEXIT_CRITICAL(&traceLock);
+}
+
+void Trace::dump(Print& out) {
+    // Pause recording so the buffer is stable while it is printed
+    bool wasEnabled = enabled;
+    enabled = false;
+
+    uint32_t count = size();
+    uint32_t first = next - count;
+
+    out.print("{\"traceEvents\":[");
+    for (uint32_t i = 0; i < count; i++) {
+        const TraceEvent& e = events[(first + i) % TRACE_BUFFER_SIZE];
+        if (i > 0) out.print(",");
+
+        out.printf("\n{\"name\":\"%s\",\"cat\":\"solargain\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%lu",
+                   e.name, e.phase, (unsigned)e.core, (unsigned long)e.startUs);
+
+        if (e.phase == 'X') {
+            // Cycles give sub-microsecond resolution but wrap after ~17 s at 240 MHz;
+            // fall back to the microsecond timer for long spans and clock changes
+            uint32_t wallUs = e.endUs - e.startUs;
+            if (e.cpuMhz > 0 && wallUs < 0xFFFFFFFFUL / e.cpuMhz) {
+                out.printf(",\"dur\":%.3f,\"args\":{\"cycles\":%lu}}",
+                           (double)e.cycles / e.cpuMhz, (unsigned long)e.cycles);
+            } else {
+                out.printf(",\"dur\":%lu}", (unsigned long)wallUs);
+            }
+        } else if (e.phase == 'C') {
+            out.printf(",\"args\":{\"value\":%ld}}", (long)e.value);
+        } else {
+            out.print(",\"s\":\"t\"}");
+        }
+    }
+    out.printf("\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%lu}}\n",
+               (unsigned long)overwritten());
+
+    enabled = wasEnabled;
+}
+
+#endif // TRACE_ENABLED
@@ -0,0 +1,103 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+
+// Tracing is compiled out unless TRACE_ENABLED is defined (see platformio.ini).
+// Usage:
+//   void foo() {
+//       TRACE_SCOPE("foo");      // complete event covering the enclosing scope
+//       TRACE_COUNTER("heap", ESP.getFreeHeap());
+//   }
+//   Trace::dump(Serial);         // Chrome trace_event JSON (chrome://tracing, Perfetto)
+//
+// Event names must be string literals: only the pointer is stored.
+
+// Number of events kept in the ring buffer (oldest are overwritten)
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 256
+#endif
+
+#ifdef TRACE_ENABLED
+
+struct TraceEvent {
+    const char* name;
+    char phase;          // 'X' complete span, 'C' counter, 'i' instant
+    uint8_t core;
+    uint16_t cpuMhz;     // clock used to convert cycles to microseconds; 0 if it changed mid-span
+    uint32_t startUs;    // esp_timer time at start
+    uint32_t endUs;      // esp_timer time at end (spans only)
+    uint32_t cycles;     // CPU cycles between start and end (spans only)
+    int32_t value;       // counter value
+};
+
+class Trace {
+private:
+    static TraceEvent events[TRACE_BUFFER_SIZE];
+    static uint32_t next;     // total events recorded (ring index = next % size)
+    static bool enabled;
+
+    static TraceEvent* reserve();
+
+public:
+    // Runtime switch; events are recorded while enabled (default on)
+    static void setEnabled(bool on) { enabled = on; }
+    static bool isEnabled() { return enabled; }
+
+    // Record a finished span; startMhz is the CPU clock when it began
+    static void complete(const char* name, uint32_t startUs, uint32_t startCycles, uint16_t startMhz);
+
+    // Record a counter sample or instant marker
+    static void counter(const char* name, int32_t value);
+    static void instant(const char* name);
+
+    // Number of events currently held
+    static uint32_t size();
+
+    // Events lost to ring buffer wrap-around
+    static uint32_t overwritten();
+
+    // Forget all recorded events
+    static void clear();
+
+    // Write the buffer as Chrome trace_event JSON
+    static void dump(Print& out);
+
+    // Timestamp helpers
+    static uint32_t nowUs();
+    static uint32_t nowCycles() { return ESP.getCycleCount(); }
+    static uint16_t cpuMhz() { return (uint16_t)getCpuFrequencyMhz(); }
+};
+
+class TraceSpan {
+private:
+    const char* name;
+    uint32_t startUs;
+    uint32_t startCycles;
+    uint16_t startMhz;
+
+public:
+    TraceSpan(const char* name)
+        : name(name), startUs(Trace::nowUs()), startCycles(Trace::nowCycles()), startMhz(Trace::cpuMhz()) {}
+    ~TraceSpan() {
+        if (Trace::isEnabled()) Trace::complete(name, startUs, startCycles, startMhz);
+    }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) Trace::counter(name, value)
+#define TRACE_INSTANT(name) Trace::instant(name)
+#define TRACE_DUMP(out) Trace::dump(out)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+#define TRACE_DUMP(out) do {} while (0)
+
+#endif // TRACE_ENABLED
+
+#endif // TRACE_H
@@ -0,0 +1,89 @@
+#include "GraphResponse.h"
+#include <ArduinoJson.h>
+
+void GraphResponse::reset(int status) {
+    httpCode = status;
+    errorCode = 0;
+    messageId[0] = '\0';
+    displayPhoneNumber[0] = '\0';
+    parsed = false;
+    error = classify(status, 0);
+}
+
+void GraphResponse::parse(Stream& body, int status) {
+    reset(status);
+
+    // Keep only what we act on; everything else is skipped as it streams past
+    StaticJsonDocument<96> filter;
+    filter["messages"][0]["id"] = true;
+    filter["error"]["code"] = true;
+    filter["display_phone_number"] = true;
+
+    StaticJsonDocument<256> doc;
+    DeserializationError result = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+    parsed = result == DeserializationError::Ok;
+    if (!parsed && result != DeserializationError::EmptyInput) {
+        Serial.println("Graph response not parsed: " + String(result.c_str()));
+    }
+
+    const char* id = doc["messages"][0]["id"];
+    if (id) snprintf(messageId, sizeof(messageId), "%s", id);
+    const char* phone = doc["display_phone_number"];
+    if (phone) snprintf(displayPhoneNumber, sizeof(displayPhoneNumber), "%s", phone);
+    errorCode = doc["error"]["code"] | 0L;
+
+    error = classify(status, errorCode);
+}
+
+GraphError GraphResponse::classify(int status, long code) {
+    if (status <= 0) return GRAPH_TRANSPORT;
+    if (status >= 200 && status < 300 && code == 0) return GRAPH_OK;
+
+    // Graph error codes are more specific than the status, so check them first
+    switch (code) {
+        case 4:         // application request limit
+        case 80007:     // WhatsApp Business Account rate limit
+        case 130429:    // Cloud API throughput reached
+        case 131048:    // spam rate limit
+        case 131056:    // too many messages to the same recipient
+            return GRAPH_RATE_LIMITED;
+        case 1:         // unknown API error
+        case 2:         // temporary service error
+        case 131000:    // something went wrong
+        case 131016:    // service unavailable
+            return GRAPH_UNAVAILABLE;
+        case 0:
+            break;
+        case 10:        // permission denied
+        case 190:       // access token expired or invalid
+        case 131005:    // access denied
+            return GRAPH_AUTH;
+        case 131021:    // recipient is the sender
+        case 131026:    // message undeliverable
+        case 131030:    // recipient not in the allowed list
+        case 131047:    // outside the 24-hour customer service window
+        case 133010:    // phone number not registered
+            return GRAPH_RECIPIENT;
+        default:
+            if (code >= 200 && code <= 299) return GRAPH_AUTH; // permission errors
+            return GRAPH_REQUEST;
+    }
+
+    if (status == 429) return GRAPH_RATE_LIMITED;
+    if (status >= 500) return GRAPH_UNAVAILABLE;
+    if (status == 401 || status == 403) return GRAPH_AUTH;
+    if (status == 408) return GRAPH_TRANSPORT;
+    return GRAPH_REQUEST;
+}
+
+const char* GraphResponse::errorName() const {
+    switch (error) {
+        case GRAPH_OK:           return "ok";
+        case GRAPH_TRANSPORT:    return "transport";
+        case GRAPH_RATE_LIMITED: return "rate limited";
+        case GRAPH_UNAVAILABLE:  return "unavailable";
+        case GRAPH_AUTH:         return "auth";
+        case GRAPH_RECIPIENT:    return "recipient";
+        default:                 return "request";
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef GRAPH_RESPONSE_H
+#define GRAPH_RESPONSE_H
+
+#include <Arduino.h>
+
+// What went wrong with a Graph API request, grouped by what the caller should do
+enum GraphError {
+    GRAPH_OK = 0,
+    GRAPH_TRANSPORT,        // no HTTP response: connect, send, timeout or connection lost
+    GRAPH_RATE_LIMITED,     // 429 or a throttling code: back off, then retry
+    GRAPH_UNAVAILABLE,      // 5xx or a transient API fault: retry
+    GRAPH_AUTH,             // token expired or missing permission: needs new credentials
+    GRAPH_RECIPIENT,        // this recipient cannot be messaged; others may still work
+    GRAPH_REQUEST           // rejected for any other reason; retrying will not help
+};
+
+// The few fields we use from a Graph API response, parsed straight from the
+// socket through an ArduinoJson filter. Memory use does not depend on the
+// size of the body, so large error documents parse like small ones.
+struct GraphResponse {
+    int httpCode;                   // HTTP status, or a negative HTTP_SESSION_ERROR_*
+    GraphError error;
+    long errorCode;                 // error.code from the body, 0 when absent
+    char messageId[96];             // messages[0].id
+    char displayPhoneNumber[24];    // display_phone_number
+    bool parsed;                    // body was valid JSON
+
+    GraphResponse() { reset(0); }
+
+    // Clear all fields and record a status without a body (e.g. a transport error)
+    void reset(int status);
+
+    // Read the body from `body` and classify the result
+    void parse(Stream& body, int status);
+
+    bool ok() const { return error == GRAPH_OK; }
+
+    // Worth sending again later (with a back-off)
+    bool retryable() const {
+        return error == GRAPH_TRANSPORT || error == GRAPH_RATE_LIMITED || error == GRAPH_UNAVAILABLE;
+    }
+
+    const char* errorName() const;
+
+    // Map an HTTP status and Graph error code to a GraphError
+    static GraphError classify(int status, long errorCode);
+};
+
+#endif // GRAPH_RESPONSE_H
@@ -0,0 +1,249 @@
+#include "HttpSession.h"
+
+HttpSession::HttpSession(Client& client)
+    : client(client), port(443), timeoutMs(15000), status(0), contentLength(-1), remaining(0),
+      chunked(false), chunkStarted(false), bodyDone(true), closeAfter(false), reused(false), received(false),
+      peeked(-1), bodyStream(*this) {
+}
+
+int HttpSession::sendRequest(const char* method, const String& path, const String& authorization,
+                             const PayloadWriter* body, const char* contentType) {
+    reused = client.connected();
+    received = false;
+    if (!reused && !client.connect(host.c_str(), port)) {
+        return HTTP_SESSION_ERROR_CONNECT;
+    }
+
+    // First pass: measure the body
+    size_t length = 0;
+    if (body) {
+        CountingPrint counter;
+        (*body)(counter);
+        length = counter.bytes();
+    }
+
+    // Second pass: head and body go out through one small buffer
+    uint8_t buffer[HTTP_SESSION_WRITE_BUFFER];
+    BufferedPrint out(client, buffer, sizeof(buffer));
+
+    out.print(method);
+    out.print(' ');
+    out.print(path);
+    out.print(" HTTP/1.1\r\nHost: ");
+    out.print(host);
+    out.print("\r\nUser-Agent: SolarGainESP32\r\nConnection: keep-alive\r\n");
+    if (authorization.length() > 0) {
+        out.print("Authorization: ");
+        out.print(authorization);
+        out.print("\r\n");
+    }
+    if (body) {
+        out.print("Content-Type: ");
+        out.print(contentType);
+        out.print("\r\nContent-Length: ");
+        out.print((unsigned long)length);
+        out.print("\r\n");
+    }
+    out.print("\r\n");
+
+    if (body) {
+        (*body)(out);
+    }
+    out.flush();
+
+    if (out.hasFailed() || out.bytesWritten() == 0) {
+        client.stop();
+        return HTTP_SESSION_ERROR_SEND;
+    }
+    return 0;
+}
+
+int HttpSession::readByte(uint32_t deadline) {
+    while (true) {
+        if (client.available() > 0) {
+            int c = client.read();
+            if (c >= 0) {
+                received = true;
+                return c;
+            }
+        }
+        if (!client.connected() && client.available() <= 0) return -1;
+        if ((int32_t)(millis() - deadline) >= 0) return -1;
+        delay(1);
+    }
+}
+
+bool HttpSession::readLine(String& line, uint32_t deadline) {
+    line = "";
+    while (true) {
+        int c = readByte(deadline);
+        if (c < 0) return false;
+        if (c == '\n') break;
+        if (c != '\r') line += (char)c;
+    }
+    return true;
+}
+
+int HttpSession::readResponseHead() {
+    uint32_t deadline = millis() + timeoutMs;
+    String line;
+
+    status = 0;
+    contentLength = -1;
+    chunked = false;
+    chunkStarted = false;
+    closeAfter = false;
+    bodyDone = false;
+    peeked = -1;
+
+    if (!readLine(line, deadline)) {
+        int error = client.connected() ? HTTP_SESSION_ERROR_TIMEOUT : HTTP_SESSION_ERROR_LOST;
+        client.stop();
+        return error;
+    }
+
+    // "HTTP/1.1 200 OK"
+    int space = line.indexOf(' ');
+    if (!line.startsWith("HTTP/1.") || space < 0) {
+        client.stop();
+        return HTTP_SESSION_ERROR_PROTOCOL;
+    }
+    status = line.substring(space + 1).toInt();
+    if (line.startsWith("HTTP/1.0")) closeAfter = true;
+
+    while (true) {
+        if (!readLine(line, deadline)) {
+            client.stop();
+            return HTTP_SESSION_ERROR_TIMEOUT;
+        }
+        if (line.length() == 0) break;
+
+        int colon = line.indexOf(':');
+        if (colon < 0) continue;
+        String name = line.substring(0, colon);
+        String value = line.substring(colon + 1);
+        name.toLowerCase();
+        value.trim();
+        value.toLowerCase();
+
+        if (name == "content-length") {
+            contentLength = value.toInt();
+        } else if (name == "transfer-encoding") {
+            chunked = value.indexOf("chunked") >= 0;
+        } else if (name == "connection") {
+            if (value.indexOf("close") >= 0) closeAfter = true;
+            if (value.indexOf("keep-alive") >= 0) closeAfter = false;
+        }
+    }
+
+    if (chunked) {
+        remaining = 0;
+    } else if (contentLength >= 0) {
+        remaining = contentLength;
+        bodyDone = remaining == 0;
+    } else {
+        // No length: the body runs until the server closes the connection
+        remaining = -1;
+        closeAfter = true;
+    }
+    if (status == 204 || status == 304) bodyDone = true;
+
+    return status;
+}
+
+bool HttpSession::nextChunk(uint32_t deadline) {
+    String line;
+
+    // Every chunk after the first is preceded by the CRLF that ended the previous one
+    if (chunkStarted && !readLine(line, deadline)) return false;
+    if (!readLine(line, deadline)) return false;
+    chunkStarted = true;
+
+    remaining = strtol(line.c_str(), nullptr, 16);
+    if (remaining == 0) {
+        readLine(line, deadline); // blank line after the last chunk
+        bodyDone = true;
+        return false;
+    }
+    return true;
+}
+
+int HttpSession::bodyRead(bool consume) {
+    if (peeked >= 0) {
+        int c = peeked;
+        if (consume) peeked = -1;
+        return c;
+    }
+    if (bodyDone) return -1;
+
+    uint32_t deadline = millis() + timeoutMs;
+    if (chunked && remaining == 0 && !nextChunk(deadline)) {
+        bodyDone = true;
+        return -1;
+    }
+
+    int c = readByte(deadline);
+    if (c < 0) {
+        bodyDone = true;
+        return -1;
+    }
+    if (remaining > 0) {
+        remaining--;
+        if (remaining == 0 && !chunked) bodyDone = true;
+    }
+    if (!consume) peeked = c;
+    return c;
+}
+
+bool HttpSession::readBody(String& out) {
+    out = "";
+    if (contentLength > 0) out.reserve(contentLength);
+
+    int c;
+    while ((c = bodyRead(true)) >= 0) {
+        out += (char)c;
+    }
+    finish();
+    return true;
+}
+
+void HttpSession::finish() {
+    while (!bodyDone && bodyRead(true) >= 0) {
+    }
+    peeked = -1;
+    if (closeAfter) {
+        client.stop();
+    }
+}
+
+bool HttpSession::neverProcessed(int result) const {
+    if (result == HTTP_SESSION_ERROR_CONNECT || result == HTTP_SESSION_ERROR_SEND) return true;
+    return result == HTTP_SESSION_ERROR_LOST && reused && !received;
+}
+
+int HttpBodyStream::available() {
+    if (session.peeked >= 0) return 1;
+    if (session.bodyDone) return 0;
+    int avail = session.client.available();
+    if (session.remaining > 0 && avail > session.remaining) avail = session.remaining;
+    // Report at least one byte while the body is unfinished so parsers keep reading
+    return avail > 0 ? avail : 1;
+}
+
+int HttpBodyStream::read() {
+    return session.bodyRead(true);
+}
+
+int HttpBodyStream::peek() {
+    return session.bodyRead(false);
+}
+
+size_t HttpBodyStream::readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+        int c = session.bodyRead(true);
+        if (c < 0) break;
+        buffer[n++] = (char)c;
+    }
+    return n;
+}
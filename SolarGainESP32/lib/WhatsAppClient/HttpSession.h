@@ -0,0 +1,100 @@
+#ifndef HTTP_SESSION_H
+#define HTTP_SESSION_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include "PayloadWriter.h"
+
+// Error codes returned in place of an HTTP status (same values as HTTPClient)
+#define HTTP_SESSION_ERROR_CONNECT   (-1)
+#define HTTP_SESSION_ERROR_SEND      (-2)
+#define HTTP_SESSION_ERROR_LOST      (-5)
+#define HTTP_SESSION_ERROR_TIMEOUT   (-11)
+#define HTTP_SESSION_ERROR_PROTOCOL  (-12)
+
+// Bytes gathered before each socket write
+#ifndef HTTP_SESSION_WRITE_BUFFER
+#define HTTP_SESSION_WRITE_BUFFER 512
+#endif
+
+class HttpSession;
+
+// Response body as a Stream, with chunked transfer decoding and length limits applied
+class HttpBodyStream : public Stream {
+private:
+    HttpSession& session;
+
+public:
+    HttpBodyStream(HttpSession& session) : session(session) {}
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+    size_t write(uint8_t) override { return 0; }
+};
+
+// Minimal HTTP/1.1 keep-alive client that streams request bodies straight to the
+// socket. Works over any Client: TlsConnection on the device, plain TCP on the host.
+class HttpSession {
+private:
+    Client& client;
+    String host;
+    uint16_t port;
+    uint32_t timeoutMs;
+
+    // Response state
+    int status;
+    long contentLength;     // -1 when unknown
+    long remaining;         // bytes left in the body or current chunk
+    bool chunked;
+    bool chunkStarted;
+    bool bodyDone;
+    bool closeAfter;
+    bool reused;            // the last request went out on an open keep-alive connection
+    bool received;          // any byte of its response has arrived
+    int peeked;
+    HttpBodyStream bodyStream;
+
+    friend class HttpBodyStream;
+
+    int readByte(uint32_t deadline);
+    bool readLine(String& line, uint32_t deadline);
+    bool nextChunk(uint32_t deadline);
+    int bodyRead(bool consume);
+
+public:
+    HttpSession(Client& client);
+
+    void setHost(const String& hostname, uint16_t remotePort) { host = hostname; port = remotePort; }
+    void setTimeout(uint32_t ms) { timeoutMs = ms; }
+    const String& getHost() { return host; }
+
+    // Send a request. The body writer runs once to count Content-Length and once
+    // to stream the body, so no copy of the full body is ever held in memory.
+    int sendRequest(const char* method, const String& path, const String& authorization,
+                    const PayloadWriter* body = nullptr, const char* contentType = "application/json");
+
+    // Read the status line and headers; returns the status or a negative error
+    int readResponseHead();
+
+    // The response body; must be drained (or finish() called) before the next request
+    Stream& body() { return bodyStream; }
+
+    // Read the whole body into a String
+    bool readBody(String& out);
+
+    // Discard any unread body and close the connection if the server asked to
+    void finish();
+
+    // True when the last request, which ended in `result`, cannot have been
+    // acted on: the connect or the send failed, or a reused connection closed
+    // before any response byte, as when the server times out an idle one just
+    // as the request goes out. Anything else may have been processed, so a
+    // request that is not idempotent must not be sent again.
+    bool neverProcessed(int result) const;
+
+    int getStatus() { return status; }
+    long getContentLength() { return contentLength; }
+};
+
+#endif // HTTP_SESSION_H
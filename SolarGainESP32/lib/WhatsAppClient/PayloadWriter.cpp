@@ -0,0 +1,100 @@
+#include "PayloadWriter.h"
+
+size_t JsonEscapePrint::write(uint8_t c) {
+    switch (c) {
+        case '"':  return out.write((const uint8_t*)"\\\"", 2) == 2 ? 1 : 0;
+        case '\\': return out.write((const uint8_t*)"\\\\", 2) == 2 ? 1 : 0;
+        case '\n': return out.write((const uint8_t*)"\\n", 2) == 2 ? 1 : 0;
+        case '\r': return out.write((const uint8_t*)"\\r", 2) == 2 ? 1 : 0;
+        case '\t': return out.write((const uint8_t*)"\\t", 2) == 2 ? 1 : 0;
+        default:
+            if (c < 0x20) {
+                char escaped[7];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                return out.write((const uint8_t*)escaped, 6) == 6 ? 1 : 0;
+            }
+            // UTF-8 (emoji, °, ²) passes through unchanged
+            return out.write(c);
+    }
+}
+
+size_t JsonEscapePrint::write(const uint8_t* buffer, size_t size) {
+    // Forward runs that need no escaping in one call
+    size_t start = 0;
+    for (size_t i = 0; i < size; i++) {
+        uint8_t c = buffer[i];
+        if (c == '"' || c == '\\' || c < 0x20) {
+            if (i > start) out.write(buffer + start, i - start);
+            write(c);
+            start = i + 1;
+        }
+    }
+    if (size > start) out.write(buffer + start, size - start);
+    return size;
+}
+
+size_t BufferedPrint::write(const uint8_t* data, size_t size) {
+    if (failed) return 0;
+
+    size_t written = 0;
+    while (written < size) {
+        size_t n = min(capacity - used, size - written);
+        memcpy(buffer + used, data + written, n);
+        used += n;
+        written += n;
+        if (used == capacity) flush();
+        if (failed) break;
+    }
+    total += written;
+    return written;
+}
+
+void BufferedPrint::flush() {
+    if (used == 0 || failed) return;
+    if (out.write(buffer, used) != used) failed = true;
+    used = 0;
+}
+
+// Fills a preallocated array of exactly the counted size
+class ArrayPrint : public Print {
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t used;
+
+public:
+    ArrayPrint(uint8_t* buffer, size_t capacity) : buffer(buffer), capacity(capacity), used(0) {}
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t size) override {
+        size_t n = min(size, capacity - used);
+        memcpy(buffer + used, data, n);
+        used += n;
+        return n;
+    }
+};
+
+bool PatchedPayload::prepare(const char* headText, const PayloadWriter& tailWriter) {
+    free(tail);
+    tail = nullptr;
+    head = headText;
+
+    CountingPrint counter;
+    tailWriter(counter);
+    tailLength = counter.bytes();
+
+    tail = (uint8_t*)malloc(tailLength ? tailLength : 1);
+    if (!tail) {
+        tailLength = 0;
+        return false;
+    }
+    ArrayPrint fill(tail, tailLength);
+    tailWriter(fill);
+    return true;
+}
+
+void PatchedPayload::write(Print& out, const String& field) const {
+    out.print(head);
+    JsonEscapePrint escaped(out);
+    escaped.print(field);
+    out.write(tail, tailLength);
+}
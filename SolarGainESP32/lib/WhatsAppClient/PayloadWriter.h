@@ -0,0 +1,79 @@
+#ifndef PAYLOAD_WRITER_H
+#define PAYLOAD_WRITER_H
+
+#include <Arduino.h>
+#include <functional>
+
+// Writes a request body to a Print. It is called twice per request: once to
+// measure Content-Length and once to stream the bytes, so it must be deterministic.
+typedef std::function<void(Print&)> PayloadWriter;
+
+// Counts bytes without storing them
+class CountingPrint : public Print {
+private:
+    size_t count;
+
+public:
+    CountingPrint() : count(0) {}
+    size_t write(uint8_t) override { count++; return 1; }
+    size_t write(const uint8_t*, size_t size) override { count += size; return size; }
+    size_t bytes() const { return count; }
+};
+
+// Escapes everything written through it as the inside of a JSON string
+class JsonEscapePrint : public Print {
+private:
+    Print& out;
+
+public:
+    JsonEscapePrint(Print& out) : out(out) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+};
+
+// Collects small writes into one buffer so the socket sees few large writes
+class BufferedPrint : public Print {
+private:
+    Print& out;
+    uint8_t* buffer;
+    size_t capacity;
+    size_t used;
+    size_t total;
+    bool failed;
+
+public:
+    BufferedPrint(Print& out, uint8_t* buffer, size_t capacity)
+        : out(out), buffer(buffer), capacity(capacity), used(0), total(0), failed(false) {}
+    ~BufferedPrint() { flush(); }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t size) override;
+    void flush();
+    size_t bytesWritten() const { return total; }
+    bool hasFailed() const { return failed; }
+};
+
+// A payload rendered once and replayed with one string field patched in: the
+// fixed head, the JSON-escaped field, then a tail cached from the first render.
+// Lets one message go to many recipients without rendering the body again.
+class PatchedPayload {
+private:
+    const char* head;
+    uint8_t* tail;
+    size_t tailLength;
+
+public:
+    PatchedPayload() : head(""), tail(nullptr), tailLength(0) {}
+    ~PatchedPayload() { free(tail); }
+    PatchedPayload(const PatchedPayload&) = delete;
+    PatchedPayload& operator=(const PatchedPayload&) = delete;
+
+    // Render the tail into one heap block; false if it cannot be allocated
+    bool prepare(const char* head, const PayloadWriter& tail);
+
+    // Write head + escaped field + tail
+    void write(Print& out, const String& field) const;
+
+    size_t getTailLength() const { return tailLength; }
+};
+
+#endif // PAYLOAD_WRITER_H
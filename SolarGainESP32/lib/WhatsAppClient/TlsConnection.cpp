@@ -0,0 +1,386 @@
+// mbedtls/lwip transport: device only. env:native uses the plain TCP
+// variant in TlsConnectionHost.cpp.
+#ifndef HOST_BUILD
+
+#include "TlsConnection.h"
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#include <esp_timer.h>
+#include "FBRootCA.h"
+
+// mbedtls 3 (IDF 5) hides session fields behind MBEDTLS_PRIVATE
+#if MBEDTLS_VERSION_MAJOR >= 3
+#define SESSION_FIELD(s, f) (s).MBEDTLS_PRIVATE(f)
+#else
+#define SESSION_FIELD(s, f) (s).f
+#endif
+
+static uint32_t nowUs() {
+    return (uint32_t)esp_timer_get_time();
+}
+
+TlsConnection::TlsConnection()
+    : contextReady(false), haveSession(false), open(false), port(443), addressValid(false),
+      resolvedAtMs(0), lastUsedMs(0), timeoutMs(15000), lastWriteEndUs(0) {
+    policy = {3, 500, 50000, 3600000UL};
+    memset(&timing, 0, sizeof(timing));
+    mbedtls_net_init(&net);
+    mbedtls_ssl_session_init(&session);
+}
+
+TlsConnection::~TlsConnection() {
+    stop();
+    if (contextReady) {
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_config_free(&conf);
+        mbedtls_ctr_drbg_free(&drbg);
+        mbedtls_entropy_free(&entropy);
+        mbedtls_x509_crt_free(&caCert);
+    }
+    mbedtls_ssl_session_free(&session);
+}
+
+bool TlsConnection::setupContext() {
+    if (contextReady) return true;
+
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_x509_crt_init(&caCert);
+
+    int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, nullptr, 0);
+    if (ret != 0) {
+        logError("seed", ret);
+        return false;
+    }
+
+    ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0) {
+        logError("config", ret);
+        return false;
+    }
+
+    // Same trust policy as the previous WiFiClientSecure setup
+    #if !defined(USE_INSECURE_TLS) && defined(FB_ROOT_CA_PEM)
+      ret = mbedtls_x509_crt_parse(&caCert, (const unsigned char*)FB_ROOT_CA_PEM, strlen(FB_ROOT_CA_PEM) + 1);
+      if (ret != 0) {
+          logError("ca", ret);
+          return false;
+      }
+      mbedtls_ssl_conf_ca_chain(&conf, &caCert, nullptr);
+      mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    #else
+      mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE); // Fallback until CA is provisioned
+    #endif
+
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+    #if defined(MBEDTLS_SSL_SESSION_TICKETS)
+      mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    #endif
+
+    ret = mbedtls_ssl_setup(&ssl, &conf);
+    if (ret != 0) {
+        logError("setup", ret);
+        return false;
+    }
+
+    contextReady = true;
+    return true;
+}
+
+bool TlsConnection::resolve(const char* hostname) {
+    bool sameHost = host == hostname;
+    bool fresh = addressValid && sameHost && (millis() - resolvedAtMs) < policy.dnsTtlMs;
+    if (fresh) return true;
+
+    if (!sameHost) {
+        // A different host invalidates the connection and the session
+        stop();
+        clearSession();
+        host = hostname;
+    }
+
+    uint32_t start = nowUs();
+    IPAddress ip;
+    if (!WiFi.hostByName(hostname, ip)) {
+        Serial.println("DNS lookup failed for " + String(hostname));
+        addressValid = false;
+        return false;
+    }
+    timing.dnsUs = nowUs() - start;
+
+    address = ip;
+    addressValid = true;
+    resolvedAtMs = millis();
+    return true;
+}
+
+bool TlsConnection::connectSocket(int32_t timeout) {
+    int fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        Serial.println("TLS: socket() failed");
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = (uint32_t)address;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    uint32_t start = nowUs();
+    int res = lwip_connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (res < 0 && errno != EINPROGRESS) {
+        Serial.println("TLS: connect() failed, errno " + String(errno));
+        lwip_close(fd);
+        return false;
+    }
+
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    if (lwip_select(fd + 1, nullptr, &writeSet, nullptr, &tv) <= 0) {
+        Serial.println("TLS: connect timed out");
+        lwip_close(fd);
+        return false;
+    }
+
+    int sockErr = 0;
+    socklen_t len = sizeof(sockErr);
+    lwip_getsockopt(fd, SOL_SOCKET, SO_ERROR, &sockErr, &len);
+    if (sockErr != 0) {
+        Serial.println("TLS: connect failed, errno " + String(sockErr));
+        lwip_close(fd);
+        return false;
+    }
+    timing.connectUs = nowUs() - start;
+
+    int one = 1;
+    lwip_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    lwip_setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+
+    net.fd = fd;
+    return true;
+}
+
+bool TlsConnection::handshake(int32_t timeout) {
+    mbedtls_ssl_session_reset(&ssl);
+    mbedtls_ssl_set_hostname(&ssl, host.c_str());
+    mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+    // Offer the previous session; the server echoes its ID if it accepts
+    unsigned char offeredId[32];
+    size_t offeredLen = 0;
+    if (haveSession && mbedtls_ssl_set_session(&ssl, &session) == 0) {
+        offeredLen = SESSION_FIELD(session, id_len);
+        memcpy(offeredId, SESSION_FIELD(session, id), offeredLen);
+    }
+
+    uint32_t start = nowUs();
+    uint32_t startMs = millis();
+    int ret;
+    while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            logError("handshake", ret);
+            return false;
+        }
+        if ((int32_t)(millis() - startMs) > timeout) {
+            Serial.println("TLS: handshake timed out");
+            return false;
+        }
+        delay(1);
+    }
+    timing.handshakeUs = nowUs() - start;
+
+    // Keep the negotiated session (with its ticket) for the next connection
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    haveSession = mbedtls_ssl_get_session(&ssl, &session) == 0;
+
+    timing.resumed = haveSession && offeredLen > 0 &&
+                     SESSION_FIELD(session, id_len) == offeredLen &&
+                     memcmp(SESSION_FIELD(session, id), offeredId, offeredLen) == 0;
+    return true;
+}
+
+int TlsConnection::connect(const char* hostname, uint16_t remotePort, int32_t timeout) {
+    // Drop connections the server is likely to have closed already
+    if (open && (millis() - lastUsedMs) > policy.idleTimeoutMs) {
+        stop();
+    }
+
+    if (open && host == hostname && port == remotePort && connected()) {
+        timing.reused = true;
+        return 1;
+    }
+    stop();
+
+    if (!setupContext()) return 0;
+    if (!resolve(hostname)) return 0;
+    port = remotePort;
+
+    timing.reused = false;
+    timing.resumed = false;
+    if (!connectSocket(timeout)) return 0;
+    if (!handshake(timeout)) {
+        stop();
+        return 0;
+    }
+
+    open = true;
+    lastUsedMs = millis();
+    return 1;
+}
+
+int TlsConnection::connect(const char* hostname, uint16_t remotePort) {
+    return connect(hostname, remotePort, (int32_t)timeoutMs);
+}
+
+int TlsConnection::connect(IPAddress ip, uint16_t remotePort, int32_t timeout) {
+    // Certificates are issued for names, so connect through the known host
+    if (host.length() == 0) return 0;
+    address = ip;
+    addressValid = true;
+    resolvedAtMs = millis();
+    return connect(host.c_str(), remotePort, timeout);
+}
+
+int TlsConnection::connect(IPAddress ip, uint16_t remotePort) {
+    return connect(ip, remotePort, (int32_t)timeoutMs);
+}
+
+bool TlsConnection::warm(const char* hostname, uint16_t remotePort) {
+    return connect(hostname, remotePort, (int32_t)timeoutMs) == 1;
+}
+
+size_t TlsConnection::write(const uint8_t* buf, size_t size) {
+    if (!open) return 0;
+
+    uint32_t start = nowUs();
+    uint32_t startMs = millis();
+    size_t sent = 0;
+    while (sent < size) {
+        int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+        if (ret > 0) {
+            sent += ret;
+        } else if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            if (millis() - startMs > timeoutMs) break;
+            delay(1);
+        } else {
+            logError("write", ret);
+            stop();
+            break;
+        }
+    }
+    lastWriteEndUs = nowUs();
+    timing.requestUs += lastWriteEndUs - start;
+    lastUsedMs = millis();
+    return sent;
+}
+
+size_t TlsConnection::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+int TlsConnection::available() {
+    if (!open) return 0;
+
+    // A zero-length read processes any pending record without blocking
+    int ret = mbedtls_ssl_read(&ssl, nullptr, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        if (ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) logError("read", ret);
+        stop();
+        return 0;
+    }
+    return (int)mbedtls_ssl_get_bytes_avail(&ssl);
+}
+
+int TlsConnection::read(uint8_t* buf, size_t size) {
+    if (!open) return -1;
+
+    int ret = mbedtls_ssl_read(&ssl, buf, size);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) return -1;
+    if (ret <= 0) {
+        if (ret != 0 && ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) logError("read", ret);
+        stop();
+        return -1;
+    }
+    lastUsedMs = millis();
+    return ret;
+}
+
+int TlsConnection::read() {
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+}
+
+int TlsConnection::peek() {
+    // HTTPClient never peeks; TLS records cannot be peeked without buffering
+    return -1;
+}
+
+void TlsConnection::flush() {
+}
+
+void TlsConnection::stop() {
+    if (open) {
+        mbedtls_ssl_close_notify(&ssl);
+    }
+    if (net.fd >= 0) {
+        mbedtls_net_free(&net);
+        mbedtls_net_init(&net);
+    }
+    open = false;
+}
+
+uint8_t TlsConnection::connected() {
+    if (!open) return 0;
+
+    // A readable socket with nothing to read means the peer closed it
+    uint8_t probe;
+    int res = lwip_recv(net.fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (res == 0 || (res < 0 && errno != EWOULDBLOCK && errno != EAGAIN)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void TlsConnection::beginRequest() {
+    timing.dnsUs = 0;
+    timing.connectUs = 0;
+    timing.handshakeUs = 0;
+    timing.requestUs = 0;
+    timing.responseUs = 0;
+    // HttpSession skips connect() on an open connection, so note reuse here
+    timing.reused = open;
+    timing.resumed = false;
+}
+
+void TlsConnection::endRequest() {
+    if (lastWriteEndUs != 0) {
+        timing.responseUs = nowUs() - lastWriteEndUs;
+    }
+    lastWriteEndUs = 0;
+}
+
+void TlsConnection::clearSession() {
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    haveSession = false;
+}
+
+void TlsConnection::logError(const char* phase, int ret) {
+    char buffer[96];
+    mbedtls_strerror(ret, buffer, sizeof(buffer));
+    Serial.printf("TLS %s error -0x%04x: %s\n", phase, -ret, buffer);
+}
+
+#endif // HOST_BUILD
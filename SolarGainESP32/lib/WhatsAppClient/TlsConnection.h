@@ -0,0 +1,172 @@
+#ifndef TLS_CONNECTION_H
+#define TLS_CONNECTION_H
+
+#include <Arduino.h>
+#ifdef HOST_BUILD
+#include <Client.h>
+#else
+#include <WiFi.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/error.h>
+#endif
+
+// Time spent in each phase of the last request, in microseconds
+struct ConnectionTiming {
+    uint32_t dnsUs;        // 0 when the cached address was used
+    uint32_t connectUs;    // TCP connect, 0 when the connection was reused
+    uint32_t handshakeUs;  // TLS handshake, 0 when the connection was reused
+    uint32_t requestUs;    // writing the request
+    uint32_t responseUs;   // waiting for and reading the response
+    bool reused;           // keep-alive connection reused
+    bool resumed;          // abbreviated handshake using a saved TLS session
+};
+
+struct ReconnectPolicy {
+    uint8_t maxAttempts;    // attempts per request, including the first
+    uint32_t backoffMs;     // delay before the first retry, doubled on each retry
+    uint32_t idleTimeoutMs; // close connections idle for longer (the server drops them anyway)
+    uint32_t dnsTtlMs;      // re-resolve the host after this long
+};
+
+#ifdef HOST_BUILD
+
+// env:native: the same interface over plain TCP, so WhatsAppClient runs unchanged
+// against a local Graph API stand-in (host/GraphStandIn). There is no TLS:
+// handshakeUs stays 0 and a failed handshake shows up as a dropped connection.
+class TlsConnection : public Client {
+private:
+    int fd;
+    bool open;
+
+    String host;
+    uint16_t port;
+    uint32_t address;       // network byte order
+    bool addressValid;
+    uint32_t resolvedAtMs;
+    uint32_t lastUsedMs;
+    uint32_t timeoutMs;
+    ReconnectPolicy policy;
+
+    ConnectionTiming timing;
+    uint32_t lastWriteEndUs;
+
+    bool connectSocket(int32_t timeout);
+
+public:
+    TlsConnection();
+    ~TlsConnection();
+
+    void setPolicy(const ReconnectPolicy& reconnectPolicy) { policy = reconnectPolicy; }
+    void setIoTimeout(uint32_t ms) { timeoutMs = ms; }
+
+    bool resolve(const char* hostname);
+    bool warm(const char* hostname, uint16_t port);
+
+    int connect(const char* hostname, uint16_t port) override;
+    int connect(const char* hostname, uint16_t port, int32_t timeout);
+    int connect(IPAddress ip, uint16_t port) override;
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+
+    void beginRequest();
+    void endRequest();
+    ConnectionTiming getTiming() { return timing; }
+
+    void clearSession() {}
+};
+
+#else
+
+// TLS transport that keeps its socket and TLS session across requests.
+// It plugs into HTTPClient like WiFiClientSecure, but resolves DNS, connects and
+// handshakes as separately timed phases and offers the previous session on reconnect.
+class TlsConnection : public WiFiClient {
+private:
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_entropy_context entropy;
+    mbedtls_x509_crt caCert;
+    mbedtls_net_context net;
+    mbedtls_ssl_session session;
+    bool contextReady;
+    bool haveSession;
+    bool open;
+
+    String host;
+    uint16_t port;
+    IPAddress address;
+    bool addressValid;
+    uint32_t resolvedAtMs;
+    uint32_t lastUsedMs;
+    uint32_t timeoutMs;
+    ReconnectPolicy policy;
+
+    ConnectionTiming timing;
+    uint32_t lastWriteEndUs;
+
+    // Set up the mbedtls contexts once; they are reset, not rebuilt, on reconnect
+    bool setupContext();
+
+    // Open a non-blocking TCP socket to the resolved address
+    bool connectSocket(int32_t timeout);
+
+    // Run the handshake, offering the saved session if any
+    bool handshake(int32_t timeout);
+
+    void logError(const char* phase, int ret);
+
+public:
+    TlsConnection();
+    ~TlsConnection();
+
+    void setPolicy(const ReconnectPolicy& reconnectPolicy) { policy = reconnectPolicy; }
+    void setIoTimeout(uint32_t ms) { timeoutMs = ms; }
+
+    // Resolve the host now so the first request does not pay for DNS
+    bool resolve(const char* hostname);
+
+    // Establish the connection ahead of the first request
+    bool warm(const char* hostname, uint16_t port);
+
+    // Client interface used by HTTPClient; connecting to the current host while
+    // the connection is open is a no-op
+    int connect(const char* hostname, uint16_t port);
+    int connect(const char* hostname, uint16_t port, int32_t timeout);
+    int connect(IPAddress ip, uint16_t port);
+    int connect(IPAddress ip, uint16_t port, int32_t timeout);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t* buf, size_t size);
+    int available();
+    int read();
+    int read(uint8_t* buf, size_t size);
+    int peek();
+    void flush();
+    void stop();
+    uint8_t connected();
+    operator bool() { return connected(); }
+
+    // Phase timing: call beginRequest() before sending and endRequest() after the response
+    void beginRequest();
+    void endRequest();
+    ConnectionTiming getTiming() { return timing; }
+
+    // Forget the saved TLS session (forces a full handshake next time)
+    void clearSession();
+};
+
+#endif // HOST_BUILD
+
+#endif // TLS_CONNECTION_H
@@ -0,0 +1,248 @@
+// Plain TCP transport for env:native (see TlsConnection.h)
+#ifdef HOST_BUILD
+
+#include "TlsConnection.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+TlsConnection::TlsConnection()
+    : fd(-1), open(false), port(443), address(0), addressValid(false), resolvedAtMs(0),
+      lastUsedMs(0), timeoutMs(15000), lastWriteEndUs(0) {
+    policy = {3, 500, 50000, 3600000UL};
+    memset(&timing, 0, sizeof(timing));
+}
+
+TlsConnection::~TlsConnection() {
+    stop();
+}
+
+bool TlsConnection::resolve(const char* hostname) {
+    bool sameHost = host == hostname;
+    bool fresh = addressValid && sameHost && (millis() - resolvedAtMs) < policy.dnsTtlMs;
+    if (fresh) return true;
+
+    if (!sameHost) {
+        stop();
+        host = hostname;
+    }
+
+    uint32_t start = micros();
+    struct addrinfo hints;
+    struct addrinfo* result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(hostname, nullptr, &hints, &result) != 0 || !result) {
+        Serial.println("DNS lookup failed for " + String(hostname));
+        addressValid = false;
+        return false;
+    }
+    address = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(result);
+    timing.dnsUs = micros() - start;
+
+    addressValid = true;
+    resolvedAtMs = millis();
+    return true;
+}
+
+bool TlsConnection::connectSocket(int32_t timeout) {
+    fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        Serial.println("TCP: socket() failed");
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = address;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    uint32_t start = micros();
+    int res = ::connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (res < 0 && errno != EINPROGRESS) {
+        Serial.println("TCP: connect() failed, errno " + String(errno));
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    int sockErr = 0;
+    socklen_t len = sizeof(sockErr);
+    if (select(fd + 1, nullptr, &writeSet, nullptr, &tv) <= 0 ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &sockErr, &len) < 0 || sockErr != 0) {
+        Serial.println("TCP: connect failed, errno " + String(sockErr));
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    timing.connectUs = micros() - start;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return true;
+}
+
+int TlsConnection::connect(const char* hostname, uint16_t remotePort, int32_t timeout) {
+    if (open && (millis() - lastUsedMs) > policy.idleTimeoutMs) {
+        stop();
+    }
+
+    if (open && host == hostname && port == remotePort && connected()) {
+        timing.reused = true;
+        return 1;
+    }
+    stop();
+
+    if (!resolve(hostname)) return 0;
+    port = remotePort;
+
+    timing.reused = false;
+    if (!connectSocket(timeout)) return 0;
+
+    open = true;
+    lastUsedMs = millis();
+    return 1;
+}
+
+int TlsConnection::connect(const char* hostname, uint16_t remotePort) {
+    return connect(hostname, remotePort, (int32_t)timeoutMs);
+}
+
+int TlsConnection::connect(IPAddress ip, uint16_t remotePort) {
+    if (host.length() == 0) return 0;
+    address = (uint32_t)ip;
+    addressValid = true;
+    resolvedAtMs = millis();
+    return connect(host.c_str(), remotePort, (int32_t)timeoutMs);
+}
+
+bool TlsConnection::warm(const char* hostname, uint16_t remotePort) {
+    return connect(hostname, remotePort, (int32_t)timeoutMs) == 1;
+}
+
+size_t TlsConnection::write(const uint8_t* buf, size_t size) {
+    if (!open) return 0;
+
+    uint32_t start = micros();
+    uint32_t startMs = millis();
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t ret = send(fd, buf + sent, size - sent, MSG_NOSIGNAL);
+        if (ret > 0) {
+            sent += ret;
+        } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (millis() - startMs > timeoutMs) break;
+            delay(1);
+        } else {
+            Serial.println("TCP: write failed, errno " + String(errno));
+            stop();
+            break;
+        }
+    }
+    lastWriteEndUs = micros();
+    timing.requestUs += lastWriteEndUs - start;
+    lastUsedMs = millis();
+    return sent;
+}
+
+size_t TlsConnection::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+int TlsConnection::available() {
+    if (!open) return 0;
+
+    int pending = 0;
+    if (ioctl(fd, FIONREAD, &pending) < 0) {
+        stop();
+        return 0;
+    }
+    // Nothing buffered and a readable socket: the peer closed or reset it
+    if (pending == 0 && !connected()) return 0;
+    return pending;
+}
+
+int TlsConnection::read(uint8_t* buf, size_t size) {
+    if (!open) return -1;
+
+    ssize_t ret = recv(fd, buf, size, 0);
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return -1;
+    if (ret <= 0) {
+        stop();
+        return -1;
+    }
+    lastUsedMs = millis();
+    return (int)ret;
+}
+
+int TlsConnection::read() {
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+}
+
+int TlsConnection::peek() {
+    if (!open) return -1;
+    uint8_t data;
+    return recv(fd, &data, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? data : -1;
+}
+
+void TlsConnection::stop() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    open = false;
+}
+
+uint8_t TlsConnection::connected() {
+    if (!open) return 0;
+
+    uint8_t probe;
+    ssize_t res = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (res == 0 || (res < 0 && errno != EWOULDBLOCK && errno != EAGAIN)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void TlsConnection::beginRequest() {
+    timing.dnsUs = 0;
+    timing.connectUs = 0;
+    timing.handshakeUs = 0;
+    timing.requestUs = 0;
+    timing.responseUs = 0;
+    // HttpSession skips connect() on an open connection, so note reuse here
+    timing.reused = open;
+    timing.resumed = false;
+}
+
+void TlsConnection::endRequest() {
+    if (lastWriteEndUs != 0) {
+        timing.responseUs = micros() - lastWriteEndUs;
+    }
+    lastWriteEndUs = 0;
+}
+
+#endif // HOST_BUILD
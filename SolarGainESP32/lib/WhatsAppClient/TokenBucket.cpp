@@ -0,0 +1,97 @@
+#include "TokenBucket.h"
+
+TokenBucket::TokenBucket(float ratePerSecond, float burst) : pausedUntilUs(0), paused(false) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    reset(ratePerSecond, burst);
+}
+
+void TokenBucket::reset(float ratePerSecond, float burstSize) {
+    rate = ratePerSecond;
+    burst = burstSize < 1 ? 1 : burstSize;
+    tokens = burst;
+    lastRefillUs = now();
+}
+
+void TokenBucket::configure(float ratePerSecond, float burstSize) {
+    portENTER_CRITICAL(&lock);
+    reset(ratePerSecond, burstSize);
+    portEXIT_CRITICAL(&lock);
+}
+
+void TokenBucket::setClock(BucketClock fn) {
+    portENTER_CRITICAL(&lock);
+    clock = fn;
+    reset(rate, burst);
+    paused = false;
+    portEXIT_CRITICAL(&lock);
+}
+
+void TokenBucket::refill(uint32_t nowUs) {
+    if (paused) {
+        // Nothing accrues while paused
+        paused = false;
+        lastRefillUs = nowUs;
+    }
+    uint32_t elapsedUs = nowUs - lastRefillUs;
+    lastRefillUs = nowUs;
+    tokens += elapsedUs * rate / 1000000.0f;
+    if (tokens > burst) tokens = burst;
+}
+
+uint32_t TokenBucket::due() {
+    if (rate <= 0) return 0;
+
+    uint32_t nowUs = now();
+    int32_t pausedUs = (int32_t)(pausedUntilUs - nowUs);
+    if (paused && pausedUs > 0) return (uint32_t)pausedUs;
+
+    refill(nowUs);
+    if (tokens >= 1) return 0;
+    return (uint32_t)((1 - tokens) * 1000000.0f / rate) + 1;
+}
+
+uint32_t TokenBucket::take() {
+    uint32_t waitUs = due();
+    if (waitUs == 0 && rate > 0) tokens -= 1;
+    return waitUs;
+}
+
+bool TokenBucket::tryAcquire() {
+    portENTER_CRITICAL(&lock);
+    uint32_t waitUs = take();
+    portEXIT_CRITICAL(&lock);
+    return waitUs == 0;
+}
+
+uint32_t TokenBucket::waitTimeUs() {
+    portENTER_CRITICAL(&lock);
+    uint32_t waitUs = due();
+    portEXIT_CRITICAL(&lock);
+    return waitUs;
+}
+
+uint32_t TokenBucket::acquire() {
+    uint32_t start = millis();
+    for (;;) {
+        // Another task may take the token first; then wait again
+        portENTER_CRITICAL(&lock);
+        uint32_t waitUs = take();
+        portEXIT_CRITICAL(&lock);
+        if (waitUs == 0) break;
+
+        if (waitUs >= 1000) {
+            delay(waitUs / 1000);
+        } else {
+            delayMicroseconds(waitUs);
+        }
+    }
+    return millis() - start;
+}
+
+void TokenBucket::pause(uint32_t ms) {
+    portENTER_CRITICAL(&lock);
+    tokens = 0;
+    paused = true;
+    pausedUntilUs = now() + ms * 1000;
+    portEXIT_CRITICAL(&lock);
+}
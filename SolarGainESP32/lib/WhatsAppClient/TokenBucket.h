@@ -0,0 +1,58 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <Arduino.h>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+
+// Microseconds from any fixed point, wrapping like micros()
+typedef std::function<uint32_t()> BucketClock;
+
+// Client-side rate limiter: `rate` tokens per second accumulate up to `burst`,
+// and each request takes one. Keeps fan-out under the Graph API throughput limit.
+// Safe to share between tasks: the state is behind a lock, and acquire()
+// waits with the lock released.
+class TokenBucket {
+private:
+    float rate;            // tokens per second; <= 0 disables limiting
+    float burst;
+    float tokens;
+    uint32_t lastRefillUs;
+    uint32_t pausedUntilUs;
+    bool paused;
+    BucketClock clock;
+    portMUX_TYPE lock;
+
+    uint32_t now() { return clock ? clock() : micros(); }
+    void refill(uint32_t nowUs);
+
+    // Microseconds until a token is due, and take() takes it when that is 0;
+    // the lock is held for both
+    uint32_t due();
+    uint32_t take();
+    void reset(float ratePerSecond, float burst);
+
+public:
+    TokenBucket(float ratePerSecond, float burst);
+
+    void configure(float ratePerSecond, float burst);
+
+    // Time source; micros() without one. Starts a full bucket on the new clock.
+    void setClock(BucketClock fn);
+
+    // Take a token if one is available now
+    bool tryAcquire();
+
+    // Microseconds until a token will be available (0 if one is available now)
+    uint32_t waitTimeUs();
+
+    // Block until a token is available and take it; returns the ms spent waiting
+    uint32_t acquire();
+
+    // Empty the bucket and hold off for `ms`, e.g. after a 429 response
+    void pause(uint32_t ms);
+
+    float getRate() { return rate; }
+};
+
+#endif // TOKEN_BUCKET_H
@@ -1,21 +1,55 @@
 #include "WhatsAppClient.h"
-#include <ArduinoJson.h>
+#include "../Trace/Trace.h"
+#include "../MemoryMonitor/MemoryMonitor.h"
 
-WhatsAppClient::WhatsAppClient() : initialized(false) {
+// Start of every message payload, up to the recipient number
+static const char* const MESSAGE_HEAD =
+    "{\"messaging_product\":\"whatsapp\",\"recipient_type\":\"individual\",\"to\":\"";
+
+WhatsAppClient::WhatsAppClient()
+    : initialized(false), apiHost(WHATSAPP_API_HOST), apiVersion(WHATSAPP_API_VERSION),
+      apiPort(WHATSAPP_API_PORT), http(connection), connectionLock(nullptr),
+      rateLimiter(WHATSAPP_RATE_LIMIT, WHATSAPP_RATE_BURST) {
+    reconnectPolicy = {3, 500, 50000, 3600000UL};
+    memset(&lastTiming, 0, sizeof(lastTiming));
+    memset(&warmUpTiming, 0, sizeof(warmUpTiming));
 }
 
 void WhatsAppClient::begin(const String& phoneId, const String& token, const String& recipient) {
     phoneNumberId = phoneId;
     accessToken = token;
     recipientNumber = formatPhoneNumber(recipient);
+    recipients.assign(1, recipientNumber);
+    
+    if (!connectionLock) {
+        connectionLock = xSemaphoreCreateMutex();
+    }
+    connection.setPolicy(reconnectPolicy);
+    http.setHost(apiHost, apiPort);
     initialized = true;
     
     Serial.println("WhatsApp Business API client initialized");
     Serial.println("Phone Number ID: " + phoneNumberId);
 }
 
-String WhatsAppClient::buildApiUrl() {
-    return String("https://") + apiHost + "/" + apiVersion + "/" + phoneNumberId + "/messages";
+void WhatsAppClient::setEndpoint(const String& host, uint16_t port, const String& version) {
+    bool locked = connectionLock && xSemaphoreTake(connectionLock, portMAX_DELAY) == pdTRUE;
+    
+    if ((host.length() > 0 && host != apiHost) || port != apiPort) {
+        connection.stop();
+    }
+    if (host.length() > 0) apiHost = host;
+    if (version.length() > 0) apiVersion = version;
+    apiPort = port;
+    http.setHost(apiHost, apiPort);
+    
+    if (locked) xSemaphoreGive(connectionLock);
+    Serial.println("WhatsApp API endpoint: " + apiHost + ":" + String(apiPort) + "/" + apiVersion);
+}
+
+String WhatsAppClient::buildApiPath() {
+    MEMORY_SCOPE(MEM_TAG_WHATSAPP);
+    return String("/") + apiVersion + "/" + phoneNumberId + "/messages";
 }
 
 String WhatsAppClient::formatPhoneNumber(const String& number) {
@@ -36,18 +70,38 @@ String WhatsAppClient::formatPhoneNumber(const String& number) {
     return formatted;
 }
 
-String WhatsAppClient::formatDailyMessage(const DailyForecast& forecast, const String& location) {
-    String message = "🌞 *Solar Gain Forecast*\n";
-    message += "📍 " + location + "\n";
-    message += "📅 " + forecast.date + "\n\n";
-    message += "⚡ *Daily Total: " + String(forecast.totalIrradiance, 2) + " kWh/m²*\n\n";
-    message += "📊 *Hourly Breakdown:*\n";
+// "🌅 Sunrise: " and the like, with the solved time when the forecast has one
+// and the first or last sunlit hour when it does not
+static void printSunEvent(Print& out, const char* label, float hours, int fallbackHour) {
+    char clock[24];      // any two ints, so no format can truncate
+    int minutes = lroundf(hours * 60);
+    if (hours >= 0 && minutes < 24 * 60) {
+        snprintf(clock, sizeof(clock), "%02d:%02d", minutes / 60, minutes % 60);
+    } else {
+        snprintf(clock, sizeof(clock), "%d:00", fallbackHour);
+    }
+    out.print(label);
+    out.print(clock);
+    out.print("\n");
+}
+
+void WhatsAppClient::writeDailyMessage(Print& out, const DailyForecast& forecast, const String& location) {
+    char number[16];
+    
+    out.print("🌞 *Solar Gain Forecast*\n📍 ");
+    out.print(location);
+    out.print("\n📅 ");
+    out.print(forecast.date);
+    out.print("\n\n⚡ *Daily Total: ");
+    snprintf(number, sizeof(number), "%.2f", forecast.totalIrradiance);
+    out.print(number);
+    out.print(" kWh/m²*\n\n📊 *Hourly Breakdown:*\n");
     
     // Find sunrise and sunset hours
     int sunriseHour = -1;
     int sunsetHour = -1;
     
-    for (int i = 0; i < forecast.hourlyData.size(); i++) {
+    for (int i = 0; i < (int)forecast.hourlyData.size(); i++) {
         if (forecast.hourlyData[i].irradiance > 0 && sunriseHour == -1) {
             sunriseHour = i;
         }
@@ -59,106 +113,248 @@ String WhatsAppClient::formatDailyMessage(const DailyForecast& forecast, const S
     // Only show hours with sunlight
     if (sunriseHour >= 0 && sunsetHour >= 0) {
         for (int i = sunriseHour; i <= sunsetHour; i++) {
-            char timeStr[6];
+            char timeStr[16];
             snprintf(timeStr, sizeof(timeStr), "%02d:00", i);
-            
-            message += String(timeStr) + " → ";
+            out.print(timeStr);
+            out.print(" → ");
             
             // Add visual bar representation
             float irr = forecast.hourlyData[i].irradiance;
             int bars = round(irr * 10); // Scale to 0-10 bars
             
             for (int j = 0; j < bars; j++) {
-                message += "▪";
+                out.print("▪");
             }
             
-            message += " " + String(irr, 2) + " kWh/m²\n";
+            snprintf(number, sizeof(number), " %.2f", irr);
+            out.print(number);
+            out.print(" kWh/m²\n");
         }
     }
     
-    message += "\n🌅 Sunrise: " + String(sunriseHour) + ":00\n";
-    message += "🌇 Sunset: " + String(sunsetHour) + ":00\n";
-    
-    return message;
+    out.print("\n");
+    printSunEvent(out, "🌅 Sunrise: ", forecast.sunrise, sunriseHour);
+    printSunEvent(out, "🌇 Sunset: ", forecast.sunset, sunsetHour);
 }
 
-String WhatsAppClient::buildMessagePayload(const String& recipient, const String& message) {
-    StaticJsonDocument<2048> doc;
-    
-    doc["messaging_product"] = "whatsapp";
-    doc["recipient_type"] = "individual";
-    doc["to"] = recipient;
-    doc["type"] = "text";
-    
-    JsonObject text = doc.createNestedObject("text");
-    text["preview_url"] = false;
-    text["body"] = message;
+void WhatsAppClient::writeMessagePayload(Print& out, const String& recipient, const PayloadWriter& body,
+                                         const char* callbackData) {
+    // Same document the ArduinoJson builder produced, without the 2 KB size limit
+    out.print(MESSAGE_HEAD);
+    JsonEscapePrint escaped(out);
+    escaped.print(recipient);
+    writeMessageTail(out, body, callbackData);
+}
+
+void WhatsAppClient::writeMessageTail(Print& out, const PayloadWriter& body, const char* callbackData) {
+    JsonEscapePrint escaped(out);
+    out.print("\"");
+    if (callbackData) {
+        out.print(",\"biz_opaque_callback_data\":\"");
+        escaped.print(callbackData);
+        out.print("\"");
+    }
+    out.print(",\"type\":\"text\",\"text\":{\"preview_url\":false,\"body\":\"");
+    body(escaped);
+    out.print("\"}}");
+}
+
+int WhatsAppClient::performRequest(const char* method, const String& path, const PayloadWriter* payload, GraphResponse& response) {
+    MEMORY_SCOPE(MEM_TAG_WHATSAPP);
+    response.reset(HTTP_SESSION_ERROR_CONNECT);
     
-    String payload;
-    serializeJson(doc, payload);
-    return payload;
+    // Wait for a warm-up in progress; it leaves the connection open for us
+    if (xSemaphoreTake(connectionLock, portMAX_DELAY) != pdTRUE) {
+        return response.httpCode;
+    }
+
+    uint32_t backoff = reconnectPolicy.backoffMs;
+    String authorization = "Bearer " + accessToken;
+    bool idempotent = strcmp(method, "GET") == 0;
+
+    for (uint8_t attempt = 0; attempt < reconnectPolicy.maxAttempts; attempt++) {
+        if (attempt > 0) {
+            Serial.println("Retrying in " + String(backoff) + " ms");
+            delay(backoff);
+            backoff *= 2;
+        }
+
+        connection.beginRequest();
+        int httpCode = http.sendRequest(method, path, authorization, payload);
+        if (httpCode == 0) {
+            httpCode = http.readResponseHead();
+        }
+        if (httpCode > 0) {
+            // Parsed from the socket; leaves it open when the server allows keep-alive
+            response.parse(http.body(), httpCode);
+            http.finish();
+        } else {
+            response.reset(httpCode);
+        }
+        connection.endRequest();
+        lastTiming = connection.getTiming();
+
+        if (response.ok()) break;
+        Serial.println("Request failed: HTTP " + String(httpCode) + ", " + response.errorName() +
+                       " error " + String(response.errorCode));
+
+        // Rate limits are left to the caller, which can hold off every request
+        if (response.error != GRAPH_TRANSPORT && response.error != GRAPH_UNAVAILABLE) break;
+        if (response.error == GRAPH_TRANSPORT) connection.stop();
+
+        // A message may be delivered despite a 5xx or a timeout; resending it is
+        // the caller's call (NotificationQueue does, at least once)
+        if (!idempotent && !http.neverProcessed(httpCode)) break;
+    }
+
+    xSemaphoreGive(connectionLock);
+    return response.httpCode;
 }
 
 bool WhatsAppClient::sendMessage(const String& message) {
+    TRACE_SCOPE("whatsapp.send");
+    
     if (!initialized) {
         Serial.println("WhatsApp client not initialized!");
         return false;
     }
     
-    WiFiClientSecure client;
-    // TODO: provide CA certificate for graph.facebook.com; fallback to insecure only if explicitly allowed
-    #ifdef USE_INSECURE_TLS
-      client.setInsecure();
-    #else
-      #ifdef FB_ROOT_CA_PEM
-        client.setCACert(FB_ROOT_CA_PEM);
-      #else
-        client.setInsecure(); // Fallback until CA is provisioned
-      #endif
-    #endif
-
-    HTTPClient https;
-    String url = buildApiUrl();
-
-    bool success = false;
-    if (https.begin(client, url)) {
-        https.addHeader("Authorization", "Bearer " + accessToken);
-        https.addHeader("Content-Type", "application/json");
-
-        String payload = buildMessagePayload(recipientNumber, message);
-        Serial.println("Sending WhatsApp message...");
-
-        int httpCode = https.POST(payload);
-        String response = https.getString();
-        Serial.println("HTTP Response code: " + String(httpCode));
-
-        if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_CREATED) {
-            // Parse response to check for message ID
-            StaticJsonDocument<512> responseDoc;
-            if (deserializeJson(responseDoc, response) == DeserializationError::Ok) {
-                if (responseDoc.containsKey("messages")) {
-                    String messageId = responseDoc["messages"][0]["id"].as<String>();
-                    Serial.println("Message ID: " + messageId);
-                }
-            }
-            success = true;
-        } else if (httpCode > 0) {
-            // Log concise error
-            Serial.println("Failed to send message. HTTP " + String(httpCode));
+    PayloadWriter body = [&message](Print& out) { out.print(message); };
+    return postMessage(body, nullptr).ok();
+}
+
+void WhatsAppClient::setRecipients(const std::vector<String>& numbers) {
+    recipients.clear();
+    for (const String& number : numbers) {
+        if (number.length() > 0) recipients.push_back(formatPhoneNumber(number));
+    }
+}
+
+FanOutResult WhatsAppClient::broadcast(const PayloadWriter& body) {
+    TRACE_SCOPE("whatsapp.broadcast");
+    
+    FanOutResult result;
+    memset(&result, 0, sizeof(result));
+    result.recipients = recipients.size();
+    
+    if (!initialized) {
+        Serial.println("WhatsApp client not initialized!");
+        result.failed = result.recipients;
+        return result;
+    }
+    
+    // Render the message once; each request only splices in its recipient
+    PatchedPayload message;
+    PayloadWriter tail = [this, &body](Print& out) { writeMessageTail(out, body, nullptr); };
+    if (!message.prepare(MESSAGE_HEAD, tail)) {
+        Serial.println("Not enough memory to prepare broadcast");
+        result.failed = result.recipients;
+        return result;
+    }
+    
+    Serial.println("Broadcasting to " + String((int)recipients.size()) + " recipients (" +
+                   String((unsigned long)message.getTailLength()) + " byte body)");
+    String path = buildApiPath();
+    uint32_t start = millis();
+    
+    for (const String& to : recipients) {
+        PayloadWriter payload = [&message, &to](Print& out) { message.write(out, to); };
+        GraphResponse response;
+        
+        for (uint8_t attempt = 0; attempt <= WHATSAPP_THROTTLE_RETRIES; attempt++) {
+            result.waitedMs += rateLimiter.acquire();
+            performRequest("POST", path, &payload, response);
+            if (response.error != GRAPH_RATE_LIMITED) break;
+            
+            // Throttled: stop everyone, not just this recipient
+            result.throttled++;
+            rateLimiter.pause((uint32_t)WHATSAPP_THROTTLE_PAUSE_MS << attempt);
+        }
+        
+        if (response.ok()) {
+            result.delivered++;
         } else {
-            Serial.println("HTTP POST failed, error: " + https.errorToString(httpCode));
+            result.failed++;
+            Serial.println("Broadcast to " + to + " failed: " + response.errorName());
+            // A bad token fails every remaining recipient the same way
+            if (response.error == GRAPH_AUTH) {
+                result.failed += result.recipients - result.delivered - result.failed;
+                break;
+            }
         }
-        https.end();
-    } else {
-        Serial.println("Failed to connect to WhatsApp Business API");
     }
+    
+    result.elapsedMs = millis() - start;
+    Serial.printf("Broadcast: %u/%u delivered in %lu ms (%lu ms rate limited, %u throttled)\n",
+                  (unsigned)result.delivered, (unsigned)result.recipients,
+                  (unsigned long)result.elapsedMs, (unsigned long)result.waitedMs,
+                  (unsigned)result.throttled);
+    return result;
+}
+
+FanOutResult WhatsAppClient::broadcastDailyForecast(const DailyForecast& forecast, const String& location) {
+    PayloadWriter body = [this, &forecast, &location](Print& out) {
+        writeDailyMessage(out, forecast, location);
+    };
+    return broadcast(body);
+}
+
+GraphResponse WhatsAppClient::sendQueued(const char* text, size_t length, const char* callbackKey) {
+    TRACE_SCOPE("whatsapp.send");
+    
+    if (!initialized) {
+        Serial.println("WhatsApp client not initialized!");
+        GraphResponse response;
+        response.reset(HTTP_SESSION_ERROR_CONNECT);
+        return response;
+    }
+    
+    Serial.println("Delivering queued message " + String(callbackKey));
+    PayloadWriter body = [text, length](Print& out) { out.write((const uint8_t*)text, length); };
+    return postMessage(body, callbackKey);
+}
 
-    return success;
+GraphResponse WhatsAppClient::postMessage(const PayloadWriter& body, const char* callbackData) {
+    PayloadWriter payload = [this, &body, callbackData](Print& out) {
+        writeMessagePayload(out, recipientNumber, body, callbackData);
+    };
+    Serial.println("Sending WhatsApp message...");
+    
+    GraphResponse response;
+    rateLimiter.acquire();
+    {
+        TRACE_SCOPE("whatsapp.post");
+        performRequest("POST", buildApiPath(), &payload, response);
+    }
+    Serial.println("HTTP Response code: " + String(response.httpCode));
+    printTiming("send", lastTiming);
+    
+    if (response.ok()) {
+        if (response.messageId[0]) {
+            Serial.println("Message ID: " + String(response.messageId));
+        }
+    } else if (response.error == GRAPH_TRANSPORT) {
+        Serial.println("Failed to connect to WhatsApp Business API");
+    } else {
+        // Log concise error
+        Serial.println("Failed to send message. HTTP " + String(response.httpCode) + ", " +
+                       response.errorName() + " error " + String(response.errorCode));
+    }
+    
+    return response;
 }
 
 bool WhatsAppClient::sendDailyForecast(const DailyForecast& forecast, const String& location) {
-    String message = formatDailyMessage(forecast, location);
-    return sendMessage(message);
+    if (!initialized) {
+        Serial.println("WhatsApp client not initialized!");
+        return false;
+    }
+    
+    // The message is generated straight into the socket; it never exists as a whole
+    PayloadWriter body = [this, &forecast, &location](Print& out) {
+        writeDailyMessage(out, forecast, location);
+    };
+    return postMessage(body, nullptr).ok();
 }
 
 bool WhatsAppClient::testConnection() {
@@ -167,40 +363,66 @@ bool WhatsAppClient::testConnection() {
         return false;
     }
     
-    WiFiClientSecure client;
-    #ifdef USE_INSECURE_TLS
-      client.setInsecure();
-    #else
-      #ifdef FB_ROOT_CA_PEM
-        client.setCACert(FB_ROOT_CA_PEM);
-      #else
-        client.setInsecure();
-      #endif
-    #endif
-
-    HTTPClient https;
-    String url = String("https://") + apiHost + "/" + apiVersion + "/" + phoneNumberId;
-
-    bool ok = false;
-    if (https.begin(client, url)) {
-        https.addHeader("Authorization", "Bearer " + accessToken);
-        int httpCode = https.GET();
-        if (httpCode == HTTP_CODE_OK) {
-            String response = https.getString();
-            StaticJsonDocument<512> doc;
-            if (deserializeJson(doc, response) == DeserializationError::Ok) {
-                if (doc.containsKey("display_phone_number")) {
-                    String displayNumber = doc["display_phone_number"].as<String>();
-                    Serial.println("Connected phone number: " + displayNumber);
-                }
-            }
-            ok = true;
-        } else {
-            Serial.println("WhatsApp Business API connection test failed. HTTP code: " + String(httpCode));
+    String path = String("/") + apiVersion + "/" + phoneNumberId;
+    GraphResponse response;
+    performRequest("GET", path, nullptr, response);
+    printTiming("test", lastTiming);
+    
+    if (response.ok()) {
+        if (response.displayPhoneNumber[0]) {
+            Serial.println("Connected phone number: " + String(response.displayPhoneNumber));
         }
-        https.end();
-    } else {
-        Serial.println("Failed to connect to WhatsApp Business API");
+        return true;
+    }
+    
+    Serial.println("WhatsApp Business API connection test failed. HTTP code: " + String(response.httpCode) +
+                   " (" + response.errorName() + ")");
+    return false;
+}
+
+void WhatsAppClient::warmUpTask(void* arg) {
+    WhatsAppClient* client = static_cast<WhatsAppClient*>(arg);
+    
+    if (xSemaphoreTake(client->connectionLock, portMAX_DELAY) == pdTRUE) {
+        TRACE_SCOPE("whatsapp.warmup");
+        client->connection.beginRequest();
+        if (client->connection.warm(client->apiHost.c_str(), client->apiPort)) {
+            client->warmUpTiming = client->connection.getTiming();
+        }
+        xSemaphoreGive(client->connectionLock);
     }
-    return ok;
-}
\ No newline at end of file
+    vTaskDelete(nullptr);
+}
+
+bool WhatsAppClient::warmUp() {
+    if (!initialized) return false;
+#ifndef HOST_BUILD
+    if (WiFi.status() != WL_CONNECTED) return false;
+#endif
+    
+    // Core 0 runs the WiFi stack; the handshake overlaps work on the loop core
+    return xTaskCreatePinnedToCore(warmUpTask, "wa_warmup", 8192, this, 1, nullptr, 0) == pdPASS;
+}
+
+void WhatsAppClient::disconnect() {
+    if (!connectionLock) return;
+    
+    if (xSemaphoreTake(connectionLock, portMAX_DELAY) == pdTRUE) {
+        connection.stop();
+        xSemaphoreGive(connectionLock);
+    }
+}
+
+void WhatsAppClient::setReconnectPolicy(const ReconnectPolicy& policy) {
+    reconnectPolicy = policy;
+    if (reconnectPolicy.maxAttempts == 0) reconnectPolicy.maxAttempts = 1;
+    connection.setPolicy(reconnectPolicy);
+}
+
+void WhatsAppClient::printTiming(const char* label, const ConnectionTiming& timing) {
+    Serial.printf("WhatsApp %s timing (us): dns %lu, connect %lu, handshake %lu%s, request %lu, response %lu%s\n",
+                  label, (unsigned long)timing.dnsUs, (unsigned long)timing.connectUs,
+                  (unsigned long)timing.handshakeUs, timing.resumed ? " (resumed)" : "",
+                  (unsigned long)timing.requestUs, (unsigned long)timing.responseUs,
+                  timing.reused ? ", reused connection" : "");
+}
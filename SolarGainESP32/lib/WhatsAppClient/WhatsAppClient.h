@@ -2,34 +2,104 @@
 #define WHATSAPP_CLIENT_H
 
 #include <Arduino.h>
-#include <WiFiClientSecure.h>
-#include <HTTPClient.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "../SolarCalc/SolarCalc.h"
-#include "FBRootCA.h"
+#include "TlsConnection.h"
+#include "HttpSession.h"
+#include "PayloadWriter.h"
+#include "TokenBucket.h"
+#include "GraphResponse.h"
+
+// Graph API endpoint; setEndpoint() overrides it at run time
+#ifndef WHATSAPP_API_HOST
+#define WHATSAPP_API_HOST "graph.facebook.com"
+#endif
+
+#ifndef WHATSAPP_API_PORT
+#define WHATSAPP_API_PORT 443
+#endif
+
+#ifndef WHATSAPP_API_VERSION
+#define WHATSAPP_API_VERSION "v18.0"
+#endif
+
+// Client-side send rate (messages per second) and burst, kept below the
+// Graph API per-number throughput limit
+#ifndef WHATSAPP_RATE_LIMIT
+#define WHATSAPP_RATE_LIMIT 20
+#endif
+
+#ifndef WHATSAPP_RATE_BURST
+#define WHATSAPP_RATE_BURST 10
+#endif
+
+// Pause after a 429 (doubled on each retry of the same recipient)
+#ifndef WHATSAPP_THROTTLE_PAUSE_MS
+#define WHATSAPP_THROTTLE_PAUSE_MS 1000
+#endif
+
+#ifndef WHATSAPP_THROTTLE_RETRIES
+#define WHATSAPP_THROTTLE_RETRIES 2
+#endif
+
+// Outcome of sending one message to every recipient
+struct FanOutResult {
+    uint16_t recipients;
+    uint16_t delivered;
+    uint16_t failed;
+    uint16_t throttled;    // rate-limit responses received
+    uint32_t waitedMs;     // time spent waiting on the rate limiter
+    uint32_t elapsedMs;
+};
 
 class WhatsAppClient {
 private:
     String phoneNumberId;
     String accessToken;
     String recipientNumber;
+    std::vector<String> recipients;
     bool initialized;
     
     // WhatsApp Business API endpoint
-    const char* apiHost = "graph.facebook.com";
-    const char* apiVersion = "v18.0";
-    const int apiPort = 443;
+    String apiHost;
+    String apiVersion;
+    uint16_t apiPort;
+    
+    // Long-lived keep-alive connection shared by all requests
+    TlsConnection connection;
+    HttpSession http;
+    SemaphoreHandle_t connectionLock;
+    ReconnectPolicy reconnectPolicy;
+    ConnectionTiming lastTiming;
+    ConnectionTiming warmUpTiming;
+    TokenBucket rateLimiter;
+    
+    // Background warm-up task
+    static void warmUpTask(void* arg);
+    
+    // Perform a request over the shared connection, parsing the response as it
+    // arrives. A GET is retried after transport failures and transient API
+    // errors; a POST only when it cannot have reached the server.
+    int performRequest(const char* method, const String& path, const PayloadWriter* payload, GraphResponse& response);
     
-    // Build API URL
-    String buildApiUrl();
+    // POST a text message whose body is produced by a writer
+    GraphResponse postMessage(const PayloadWriter& body, const char* callbackData);
+    
+    // Build API path for the messages endpoint
+    String buildApiPath();
     
     // Format phone number (remove special characters)
     String formatPhoneNumber(const String& number);
     
-    // Format message body for WhatsApp
-    String formatDailyMessage(const DailyForecast& forecast, const String& location);
+    // Write the JSON payload for the API, escaping the body as it is written.
+    // callbackData (optional) is echoed back in status webhooks.
+    void writeMessagePayload(Print& out, const String& recipient, const PayloadWriter& body,
+                             const char* callbackData);
     
-    // Build JSON payload for API
-    String buildMessagePayload(const String& recipient, const String& message);
+    // Everything after the recipient number; identical for every recipient
+    void writeMessageTail(Print& out, const PayloadWriter& body, const char* callbackData);
     
 public:
     WhatsAppClient();
@@ -37,15 +107,58 @@ public:
     // Initialize with WhatsApp Business API credentials
     void begin(const String& phoneId, const String& token, const String& recipient);
     
+    // Point the client at another Graph API endpoint, such as a local stand-in.
+    // Empty values keep the current setting; a new host drops the open connection.
+    void setEndpoint(const String& host, uint16_t port = WHATSAPP_API_PORT,
+                     const String& version = WHATSAPP_API_VERSION);
+    const String& getApiHost() { return apiHost; }
+    
     // Send WhatsApp message
     bool sendMessage(const String& message);
     
     // Send daily solar forecast
     bool sendDailyForecast(const DailyForecast& forecast, const String& location);
     
+    // Recipients for broadcast(); begin() sets this to the single recipient
+    void setRecipients(const std::vector<String>& numbers);
+    const std::vector<String>& getRecipients() { return recipients; }
+    
+    // Send one message to every recipient over the shared connection. The body
+    // is rendered once; only the "to" field changes between requests.
+    FanOutResult broadcast(const PayloadWriter& body);
+    FanOutResult broadcastDailyForecast(const DailyForecast& forecast, const String& location);
+    
+    // Client-side rate limit for all sends (messages per second, burst size)
+    void setRateLimit(float messagesPerSecond, float burst) { rateLimiter.configure(messagesPerSecond, burst); }
+    
+    // Single delivery attempt for NotificationQueue. The callback key goes out as
+    // biz_opaque_callback_data, which Graph only echoes in status webhooks; it
+    // does not deduplicate on it.
+    GraphResponse sendQueued(const char* text, size_t length, const char* callbackKey);
+    
+    // Write the daily forecast message text (also used to render queued messages)
+    void writeDailyMessage(Print& out, const DailyForecast& forecast, const String& location);
+    
     // Test connection to WhatsApp Business API
     bool testConnection();
     
+    // Resolve DNS and open the TLS connection on a background task, so the
+    // handshake overlaps other work such as the forecast calculation
+    bool warmUp();
+    
+    // Close the connection (the TLS session is kept for resumption)
+    void disconnect();
+    
+    // Configure retries, idle timeout and DNS caching
+    void setReconnectPolicy(const ReconnectPolicy& policy);
+    
+    // Phase timings of the last request and of the last warm-up
+    ConnectionTiming getLastTiming() { return lastTiming; }
+    ConnectionTiming getWarmUpTiming() { return warmUpTiming; }
+    
+    // Print phase timings to Serial
+    static void printTiming(const char* label, const ConnectionTiming& timing);
+    
     // Check if client is initialized
     bool isInitialized() { return initialized; }
 };
@@ -0,0 +1,396 @@
+#include <unity.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BatchForecast.h"
+#include "SolarCalc.h"
+
+// Host only: the batchforecast pipeline on temporary files under /tmp
+
+static const char* const INPUT_PATH = "/tmp/test_batch_forecast.csv";
+static const char* const OUTPUT_PATH = "/tmp/test_batch_forecast.out";
+
+static void writeFile(const char* path, const std::string& text) {
+    FILE* file = fopen(path, "w");
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+}
+
+static std::string readFile(const char* path) {
+    std::string text;
+    FILE* file = fopen(path, "r");
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.append(chunk, n);
+    }
+    fclose(file);
+    return text;
+}
+
+// Sites with tiltsPerSite consecutive rows each, every tenth in another zone
+static std::string makeSites(int sites, int tiltsPerSite) {
+    std::string csv = "id,latitude,longitude,elevation,tilt,azimuth,timezone\n";
+    char line[128];
+    for (int site = 0; site < sites; site++) {
+        float latitude = -40.0f + (site * 7 % 80);
+        float longitude = -170.0f + (site * 13 % 340);
+        for (int tilt = 0; tilt < tiltsPerSite; tilt++) {
+            snprintf(line, sizeof(line), "s%d-t%d,%.2f,%.2f,%d,%d,%d,%s\n", site, tilt * 5, latitude, longitude,
+                     site % 5 * 100, tilt * 5, latitude < 0 ? 0 : 180,
+                     site % 10 == 0 ? "CET-1CEST,M3.5.0,M10.5.0/3" : "");
+            csv += line;
+        }
+    }
+    return csv;
+}
+
+static BatchStats runBatch(BatchOptions options) {
+    int fd = open(OUTPUT_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    BatchForecast batch(options);
+    TEST_ASSERT_TRUE(batch.run(INPUT_PATH, fd));
+    close(fd);
+    return batch.getStats();
+}
+
+static float annualFromSolarCalc(float latitude, float longitude, float elevation, float tilt, float azimuth,
+                                 const char* zoneText, int year) {
+    TimeZone zone;
+    zone.begin(zoneText, year);
+    SolarCalc solar(latitude, longitude, elevation, tilt, azimuth);
+    solar.setTimeZone(&zone);
+    double total = 0;
+    for (int64_t day = EpochTime::daysFromCivil(year, 1, 1); day < EpochTime::daysFromCivil(year + 1, 1, 1); day++) {
+        int y, m, d;
+        EpochTime::civilFromDays(day, y, m, d);
+        total += solar.calculateDailyForecast(y, m, d).totalIrradiance;
+    }
+    return (float)total;
+}
+
+// Columns are packed, so values may be unaligned
+template <typename T>
+static T valueAt(const char* column, size_t index) {
+    T value;
+    memcpy(&value, column + index * sizeof(T), sizeof(T));
+    return value;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+    unlink(INPUT_PATH);
+    unlink(OUTPUT_PATH);
+}
+
+void test_reader_blocks_are_whole_lines() {
+    // Uneven lines, no newline at the end
+    std::string text;
+    for (int i = 0; i < 500; i++) {
+        text += "line" + std::to_string(i) + std::string(i % 37, 'x') + "\n";
+    }
+    text += "last";
+    writeFile(INPUT_PATH, text);
+
+    for (int mapped = 0; mapped < 2; mapped++) {
+        CsvChunkReader reader(100);
+        TEST_ASSERT_TRUE(reader.open(INPUT_PATH, mapped));
+        TEST_ASSERT_EQUAL(mapped, reader.isMapped());
+
+        std::string buffer, joined;
+        const char* data;
+        size_t size;
+        int blocks = 0;
+        while (reader.next(buffer, data, size)) {
+            joined.append(data, size);
+            if (joined.size() < text.size()) TEST_ASSERT_EQUAL('\n', data[size - 1]);
+            reader.release(data, size);
+            blocks++;
+        }
+        TEST_ASSERT_TRUE(text == joined);
+        TEST_ASSERT_TRUE(blocks > 100);
+    }
+}
+
+static void ignoreSignal(int) {
+}
+
+void test_signal_does_not_end_input() {
+    // A handler without SA_RESTART, so a blocked read() returns EINTR
+    struct sigaction action, previous;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = ignoreSignal;
+    sigaction(SIGUSR1, &action, &previous);
+
+    int fds[2];
+    TEST_ASSERT_EQUAL(0, pipe(fds));
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fds[0]);
+    CsvChunkReader reader(100);
+    TEST_ASSERT_TRUE(reader.open(path));
+    close(fds[0]);
+
+    // Interrupt the read the reader is blocked in, then send the input
+    pthread_t readerThread = pthread_self();
+    int writeEnd = fds[1];
+    std::thread writer([readerThread, writeEnd] {
+        usleep(50000);
+        pthread_kill(readerThread, SIGUSR1);
+        usleep(50000);
+        TEST_ASSERT_EQUAL(6, write(writeEnd, "a,1\nb\n", 6));
+        close(writeEnd);
+    });
+
+    std::string buffer, joined;
+    const char* data;
+    size_t size;
+    while (reader.next(buffer, data, size)) {
+        joined.append(data, size);
+    }
+    writer.join();
+    sigaction(SIGUSR1, &previous, nullptr);
+    TEST_ASSERT_EQUAL(0, reader.getError());
+    TEST_ASSERT_EQUAL_STRING("a,1\nb\n", joined.c_str());
+}
+
+void test_read_error_is_not_end_of_input() {
+    // A directory opens, but every read() of it fails
+    CsvChunkReader reader(100);
+    TEST_ASSERT_TRUE(reader.open("/tmp"));
+    std::string buffer;
+    const char* data;
+    size_t size;
+    TEST_ASSERT_FALSE(reader.next(buffer, data, size));
+    TEST_ASSERT_EQUAL(EISDIR, reader.getError());
+
+    int fd = open(OUTPUT_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    BatchForecast batch(BatchForecast::defaults());
+    TEST_ASSERT_FALSE(batch.run("/tmp", fd));
+    close(fd);
+    TEST_ASSERT_EQUAL(EISDIR, batch.getStats().readError);
+    TEST_ASSERT_EQUAL(0, batch.getStats().rows);
+}
+
+void test_parse_row() {
+    BatchRow row;
+    const char* line = "hre-20,-17.83,31.05,1490,20,0,CAT-2\r";
+    TEST_ASSERT_TRUE(BatchForecast::parseRow(line, strlen(line), row));
+    TEST_ASSERT_EQUAL_STRING("hre-20", row.id);
+    TEST_ASSERT_EQUAL_FLOAT(-17.83f, row.latitude);
+    TEST_ASSERT_EQUAL_FLOAT(20, row.tilt);
+    TEST_ASSERT_EQUAL_STRING("CAT-2", row.timezone);
+
+    // Zone optional, and it keeps its commas
+    line = "ber,52.52,13.40,34,35,180";
+    TEST_ASSERT_TRUE(BatchForecast::parseRow(line, strlen(line), row));
+    TEST_ASSERT_EQUAL_STRING("", row.timezone);
+    line = "ber,52.52,13.40,34,35,180,CET-1CEST,M3.5.0,M10.5.0/3";
+    TEST_ASSERT_TRUE(BatchForecast::parseRow(line, strlen(line), row));
+    TEST_ASSERT_EQUAL_STRING("CET-1CEST,M3.5.0,M10.5.0/3", row.timezone);
+
+    // Only the given length is read
+    line = "ber,52.52,13.40,34,35,180,UTC0 and more";
+    TEST_ASSERT_TRUE(BatchForecast::parseRow(line, 30, row));
+    TEST_ASSERT_EQUAL_STRING("UTC0", row.timezone);
+
+    line = "bad,52.52,13.40,34";
+    TEST_ASSERT_FALSE(BatchForecast::parseRow(line, strlen(line), row));
+    line = "bad,52.52,north,34,35,180";
+    TEST_ASSERT_FALSE(BatchForecast::parseRow(line, strlen(line), row));
+    line = "bad,52.52,13.40,34,95,180";
+    TEST_ASSERT_FALSE(BatchForecast::parseRow(line, strlen(line), row));
+
+    // A zone that does not compile is rejected, not read as UTC
+    line = "bad,52.52,13.40,34,35,180,Berlin";
+    TEST_ASSERT_FALSE(BatchForecast::parseRow(line, strlen(line), row));
+    line = "bad,52.52,13.40,34,35,180,CET-1CEST,M3.5.0";
+    TEST_ASSERT_FALSE(BatchForecast::parseRow(line, strlen(line), row));
+}
+
+void test_annual_matches_solar_calc() {
+    std::string csv = makeSites(3, 3);
+    csv += "# comment\n\nnot,a,row\n";
+    csv += "last,-17.83,31.05,1490,20,0,CAT-2";
+    writeFile(INPUT_PATH, csv);
+
+    // Tiny blocks over three threads, so rows finish out of order
+    BatchOptions options = BatchForecast::defaults();
+    options.year = 2024;
+    options.threads = 3;
+    options.chunkBytes = 64;
+    BatchStats stats = runBatch(options);
+    TEST_ASSERT_EQUAL(10, stats.rows);
+    TEST_ASSERT_EQUAL(1, stats.rejected);
+
+    // Each site's sun is computed once per day, whatever the tilts
+    TEST_ASSERT_TRUE(stats.blocks > 3);
+    TEST_ASSERT_TRUE(stats.skyRuns < stats.transpositions);
+
+    std::string output = readFile(OUTPUT_PATH);
+    std::vector<std::string> lines;
+    for (size_t start = 0, end; (end = output.find('\n', start)) != std::string::npos; start = end + 1) {
+        lines.push_back(output.substr(start, end - start));
+    }
+    TEST_ASSERT_EQUAL(11, lines.size());
+    TEST_ASSERT_EQUAL_STRING("id,latitude,longitude,tilt,azimuth,annual_kwh_m2", lines[0].c_str());
+    TEST_ASSERT_EQUAL(0, lines[1].find("s0-t0,"));
+    TEST_ASSERT_EQUAL(0, lines[9].find("s2-t10,"));
+    TEST_ASSERT_EQUAL(0, lines[10].find("last,"));
+
+    float expected = annualFromSolarCalc(-40.0f, -170.0f, 0, 5, 0, "CET-1CEST,M3.5.0,M10.5.0/3", 2024);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, expected, strtof(lines[2].c_str() + lines[2].rfind(',') + 1, nullptr));
+    expected = annualFromSolarCalc(-33.0f, -157.0f, 100, 10, 0, "UTC0", 2024);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, expected, strtof(lines[6].c_str() + lines[6].rfind(',') + 1, nullptr));
+    expected = annualFromSolarCalc(-17.83f, 31.05f, 1490, 20, 0, "CAT-2", 2024);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, expected, strtof(lines[10].c_str() + lines[10].rfind(',') + 1, nullptr));
+}
+
+void test_binary_columns_match_csv() {
+    writeFile(INPUT_PATH, makeSites(4, 2));
+    BatchOptions options = BatchForecast::defaults();
+    options.year = 2023;
+    options.mode = BATCH_DAILY;
+    options.threads = 2;
+    options.chunkBytes = 128;
+    options.allowMap = false;
+
+    runBatch(options);
+    std::string csv = readFile(OUTPUT_PATH);
+    options.format = BATCH_BINARY;
+    runBatch(options);
+    std::string binary = readFile(OUTPUT_PATH);
+
+    // File header
+    TEST_ASSERT_EQUAL(0, binary.compare(0, 4, "SGFB"));
+    int16_t year;
+    uint16_t days;
+    memcpy(&year, &binary[8], 2);
+    memcpy(&days, &binary[10], 2);
+    TEST_ASSERT_EQUAL(2023, year);
+    TEST_ASSERT_EQUAL(365, days);
+
+    // Walk the record batches, checking every value against the CSV lines in order
+    size_t at = 16;
+    size_t csvAt = csv.find('\n') + 1;
+    int rows = 0;
+    while (at < binary.size()) {
+        uint32_t count, idBytes;
+        memcpy(&count, &binary[at], 4);
+        memcpy(&idBytes, &binary[at + 4], 4);
+        const char* idLengths = &binary[at + 8];
+        const char* ids = idLengths + count * 2;
+        const char* latitude = ids + idBytes;
+        const char* dayColumns = latitude + 5 * count * sizeof(float);
+
+        for (uint32_t i = 0; i < count; i++, rows++) {
+            std::string id(ids, valueAt<uint16_t>(idLengths, i));
+            ids += id.size();
+            TEST_ASSERT_EQUAL_FLOAT(-40.0f + (rows / 2 * 7 % 80), valueAt<float>(latitude, i));
+            for (uint16_t day = 0; day < days; day++) {
+                size_t lineEnd = csv.find('\n', csvAt);
+                std::string line = csv.substr(csvAt, lineEnd - csvAt);
+                csvAt = lineEnd + 1;
+                TEST_ASSERT_EQUAL(0, line.find(id + ","));
+                TEST_ASSERT_FLOAT_WITHIN(0.00006f, strtof(line.c_str() + line.rfind(',') + 1, nullptr),
+                                         valueAt<float>(dayColumns, (size_t)day * count + i));
+            }
+        }
+        at = dayColumns + (size_t)days * count * sizeof(float) - binary.data();
+    }
+    TEST_ASSERT_EQUAL(8, rows);
+    TEST_ASSERT_EQUAL(binary.size(), at);
+    TEST_ASSERT_EQUAL(csv.size(), csvAt);
+}
+
+void test_memory_does_not_grow_with_input() {
+    BatchOptions options = BatchForecast::defaults();
+    options.year = 2024;
+    options.threads = 2;
+    options.chunkBytes = 4096;
+
+    writeFile(INPUT_PATH, makeSites(40, 10));
+    BatchStats small = runBatch(options);
+    writeFile(INPUT_PATH, makeSites(400, 10));
+    BatchStats large = runBatch(options);
+
+    char report[128];
+    snprintf(report, sizeof(report), "Peak buffered: %zu bytes for %llu rows, %zu bytes for %llu rows",
+             small.peakBuffered, (unsigned long long)small.rows, large.peakBuffered,
+             (unsigned long long)large.rows);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_EQUAL(4000, large.rows);
+    TEST_ASSERT_TRUE(large.peakBuffered <= 4 * (4096 + 200 + 8192));
+}
+
+void test_rows_per_second_per_core() {
+    // 1000 rows: 100 sites with 10 tilts each, then the same rows with no two neighbours at one site
+    std::string grouped = makeSites(100, 10);
+    std::string shuffled = "id,latitude,longitude,elevation,tilt,azimuth,timezone\n";
+    std::vector<std::string> lines;
+    for (size_t start = grouped.find('\n') + 1, end; (end = grouped.find('\n', start)) != std::string::npos;
+         start = end + 1) {
+        lines.push_back(grouped.substr(start, end - start + 1));
+    }
+    for (int tilt = 0; tilt < 10; tilt++) {
+        for (int site = 0; site < 100; site++) {
+            shuffled += lines[site * 10 + tilt];
+        }
+    }
+
+    static const unsigned threadCounts[] = {1, 2, 4};
+    unsigned cores = std::thread::hardware_concurrency();
+    char report[160];
+    snprintf(report, sizeof(report), "%u cores, annual totals for 1000 rows", cores);
+    TEST_MESSAGE(report);
+    for (unsigned threads : threadCounts) {
+        BatchOptions options = BatchForecast::defaults();
+        options.year = 2024;
+        options.threads = threads;
+        options.chunkBytes = 16 * 1024;
+
+        writeFile(INPUT_PATH, grouped);
+        BatchStats sweep = runBatch(options);
+        writeFile(INPUT_PATH, shuffled);
+        BatchStats scattered = runBatch(options);
+        TEST_ASSERT_EQUAL(1000, sweep.rows);
+        TEST_ASSERT_EQUAL(1000, scattered.rows);
+
+        snprintf(report, sizeof(report),
+                 "%u threads: %6.0f rows/s (%5.0f per core) tilt sweeps, %6.0f rows/s scattered sites",
+                 threads, sweep.rowsPerSecond, sweep.rowsPerSecond / (threads < cores ? threads : cores),
+                 scattered.rowsPerSecond);
+        TEST_MESSAGE(report);
+    }
+}
+
+// Main test runner
+void runBatchForecastTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_reader_blocks_are_whole_lines);
+    RUN_TEST(test_signal_does_not_end_input);
+    RUN_TEST(test_read_error_is_not_end_of_input);
+    RUN_TEST(test_parse_row);
+    RUN_TEST(test_annual_matches_solar_calc);
+    RUN_TEST(test_binary_columns_match_csv);
+    RUN_TEST(test_memory_does_not_grow_with_input);
+    RUN_TEST(test_rows_per_second_per_core);
+
+    UNITY_END();
+}
+
+// Native only: BatchForecast is a host library
+#ifdef UNIT_TEST
+int main() {
+    runBatchForecastTests();
+    return 0;
+}
+#endif
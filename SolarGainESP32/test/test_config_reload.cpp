@@ -0,0 +1,267 @@
+#include <unity.h>
+#include <SPIFFS.h>
+#include "ConfigManager.h"
+#include "SolarCalc.h"
+
+// Subscribers wired the way the firmware wires them; recipients stand in
+// for WhatsAppClient::setRecipients()
+ConfigManager* config;
+SolarCalc* solar;
+std::vector<String> recipients;
+uint16_t lastChanges;
+int events;
+
+static void wire() {
+    config->subscribe(CONFIG_SITE, [](uint16_t) {
+        LocationConfig location = config->getLocationConfig();
+        solar->setSite(location.latitude, location.longitude, location.elevation);
+    });
+    config->subscribe(CONFIG_TIMEZONE, [](uint16_t) {
+        solar->setTimeZone(&config->getTimeZone());
+    });
+    config->subscribe(CONFIG_PANEL, [](uint16_t) {
+        PanelConfig panel = config->getPanelConfig();
+        solar->setPanel(panel.tilt, panel.azimuth);
+    });
+    config->subscribe(CONFIG_RECIPIENTS, [](uint16_t) {
+        recipients = config->getWhatsAppConfig().recipients;
+    });
+    config->subscribe(CONFIG_ALL, [](uint16_t changes) {
+        lastChanges = changes;
+        events++;
+    });
+}
+
+void setUp(void) {
+    config = new ConfigManager();
+    TEST_ASSERT_TRUE(config->begin());
+    config->factoryReset();
+
+    LocationConfig location = config->getLocationConfig();
+    PanelConfig panel = config->getPanelConfig();
+    solar = new SolarCalc(location.latitude, location.longitude, location.elevation, panel.tilt, panel.azimuth);
+    solar->setTimeZone(&config->getTimeZone());
+    recipients.clear();
+    wire();
+
+    // Warm: one full computation before any change
+    solar->calculateDailyForecast(2024, 6, 21);
+    lastChanges = 0;
+    events = 0;
+}
+
+void tearDown(void) {
+    delete solar;
+    delete config;
+}
+
+void test_tilt_change_retransposes_only() {
+    PanelConfig panel = config->getPanelConfig();
+    panel.tilt = 15;
+    config->setPanelConfig(panel);
+    TEST_ASSERT_EQUAL(CONFIG_PANEL, lastChanges);
+
+    DailyForecast forecast = solar->calculateDailyForecast(2024, 6, 21);
+    SolarCalcStats stats = solar->getStats();
+    TEST_ASSERT_EQUAL(1, stats.ephemerisRuns);
+    TEST_ASSERT_EQUAL(2, stats.transpositions);
+
+    // Same result as building from scratch at the new tilt
+    LocationConfig location = config->getLocationConfig();
+    SolarCalc fresh(location.latitude, location.longitude, location.elevation, 15, panel.azimuth);
+    fresh.setTimeZone(&config->getTimeZone());
+    DailyForecast expected = fresh.calculateDailyForecast(2024, 6, 21);
+    TEST_ASSERT_EQUAL_FLOAT(expected.totalIrradiance, forecast.totalIrradiance);
+    for (int hour = 0; hour < 24; hour++) {
+        TEST_ASSERT_EQUAL_FLOAT(expected.hourlyData[hour].irradiance, forecast.hourlyData[hour].irradiance);
+    }
+}
+
+void test_recipient_change_touches_no_math() {
+    WhatsAppConfig whatsapp = config->getWhatsAppConfig();
+    whatsapp.recipients.push_back("+263771234567");
+    whatsapp.recipients.push_back("+263772345678");
+    config->setWhatsAppConfig(whatsapp);
+
+    TEST_ASSERT_EQUAL(CONFIG_RECIPIENTS, lastChanges);
+    TEST_ASSERT_EQUAL(2, recipients.size());
+
+    solar->calculateDailyForecast(2024, 6, 21);
+    SolarCalcStats stats = solar->getStats();
+    TEST_ASSERT_EQUAL(1, stats.ephemerisRuns);
+    TEST_ASSERT_EQUAL(1, stats.transpositions);
+    TEST_ASSERT_EQUAL(1, stats.cacheHits);
+}
+
+void test_site_change_recomputes_sky() {
+    LocationConfig location = config->getLocationConfig();
+    location.latitude = -20.15f;    // Bulawayo
+    location.longitude = 28.58f;
+    config->setLocationConfig(location);
+    TEST_ASSERT_EQUAL(CONFIG_SITE, lastChanges);
+
+    solar->calculateDailyForecast(2024, 6, 21);
+    SolarCalcStats stats = solar->getStats();
+    TEST_ASSERT_EQUAL(2, stats.ephemerisRuns);
+    TEST_ASSERT_EQUAL(2, stats.transpositions);
+
+    // Renaming the site is not a site change
+    location.name = "Bulawayo";
+    config->setLocationConfig(location);
+    TEST_ASSERT_EQUAL(CONFIG_SITE_NAME, lastChanges);
+    solar->calculateDailyForecast(2024, 6, 21);
+    TEST_ASSERT_EQUAL(2, solar->getStats().ephemerisRuns);
+}
+
+void test_timezone_change_moves_hours() {
+    float before = solar->getSunriseTime(2024, 6, 21);
+    const TimeZone* old = &config->getTimeZone();
+    int32_t oldOffset = old->offsetAt(0);
+
+    LocationConfig location = config->getLocationConfig();
+    location.timezone = "<+0230>-2:30";
+    config->setLocationConfig(location);
+    TEST_ASSERT_EQUAL(CONFIG_TIMEZONE, lastChanges);
+    TEST_ASSERT_EQUAL(9000, config->getTimeZone().offsetAt(0));
+
+    // Compiled beside the old zone, which a reader on another task may still
+    // be using; the listener moved SolarCalc over
+    TEST_ASSERT_TRUE(old != &config->getTimeZone());
+    TEST_ASSERT_EQUAL(oldOffset, old->offsetAt(0));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, before + 0.5f, solar->getSunriseTime(2024, 6, 21));
+    solar->calculateDailyForecast(2024, 6, 21);
+    TEST_ASSERT_EQUAL(2, solar->getStats().ephemerisRuns);
+}
+
+void test_unchanged_values_publish_nothing() {
+    config->setPanelConfig(config->getPanelConfig());
+    config->setLocationConfig(config->getLocationConfig());
+    config->setWhatsAppConfig(config->getWhatsAppConfig());
+    config->setSleepConfig(config->getSleepConfig());
+    TEST_ASSERT_EQUAL(0, events);
+
+    // A reload that finds the same values is silent too
+    config->loadConfig();
+    TEST_ASSERT_EQUAL(0, events);
+
+    solar->calculateDailyForecast(2024, 6, 21);
+    TEST_ASSERT_EQUAL(1, solar->getStats().transpositions);
+}
+
+void test_file_endpoint_survives_reload() {
+    // A stand-in endpoint named only in config.json
+    File file = SPIFFS.open("/config.json", FILE_WRITE);
+    TEST_ASSERT_TRUE(file);
+    file.print("{\"whatsapp\":{\"phone_number_id\":\"1\",\"access_token\":\"t\",\"recipient_number\":\"+2637\","
+               "\"api_host\":\"127.0.0.1\",\"api_port\":8443,\"api_version\":\"v19.0\"}}");
+    file.close();
+
+    // The first load copies it to Preferences; the second reads it back from there
+    for (int load = 0; load < 2; load++) {
+        config->loadConfig();
+        WhatsAppConfig whatsapp = config->getWhatsAppConfig();
+        TEST_ASSERT_EQUAL_STRING("127.0.0.1", whatsapp.apiHost.c_str());
+        TEST_ASSERT_EQUAL(8443, whatsapp.apiPort);
+        TEST_ASSERT_EQUAL_STRING("v19.0", whatsapp.apiVersion.c_str());
+    }
+    SPIFFS.remove("/config.json");
+}
+
+void test_recomputations_per_change() {
+    // One of each change, then a forecast; counts are the work each one caused
+    struct Step {
+        const char* label;
+        void (*apply)();
+    };
+    static const Step steps[] = {
+        {"panel tilt", [] { PanelConfig p = config->getPanelConfig(); p.tilt += 5; config->setPanelConfig(p); }},
+        {"recipients", [] { WhatsAppConfig w = config->getWhatsAppConfig(); w.recipients.push_back("+263779999999"); config->setWhatsAppConfig(w); }},
+        {"site name", [] { LocationConfig l = config->getLocationConfig(); l.name = "Home"; config->setLocationConfig(l); }},
+        {"sleep", [] { SleepConfig s = config->getSleepConfig(); s.durationMinutes = 15; config->setSleepConfig(s); }},
+        {"latitude", [] { LocationConfig l = config->getLocationConfig(); l.latitude += 1; config->setLocationConfig(l); }},
+        {"timezone", [] { LocationConfig l = config->getLocationConfig(); l.timezone = "IST-5:30"; config->setLocationConfig(l); }},
+    };
+    static const uint32_t expectedSky[] = {0, 0, 0, 0, 1, 1};
+    static const uint32_t expectedTranspose[] = {1, 0, 0, 0, 1, 1};
+
+    for (uint8_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        SolarCalcStats before = solar->getStats();
+        steps[i].apply();
+        solar->calculateDailyForecast(2024, 6, 21);
+        SolarCalcStats after = solar->getStats();
+
+        uint32_t sky = after.ephemerisRuns - before.ephemerisRuns;
+        uint32_t transposed = after.transpositions - before.transpositions;
+        char report[96];
+        snprintf(report, sizeof(report), "%-10s: %lu sun-position passes, %lu transpositions",
+                 steps[i].label, (unsigned long)sky, (unsigned long)transposed);
+        TEST_MESSAGE(report);
+        TEST_ASSERT_EQUAL(expectedSky[i], sky);
+        TEST_ASSERT_EQUAL(expectedTranspose[i], transposed);
+    }
+}
+
+void test_forecast_cost_per_change() {
+    const int rounds = 200;
+    PanelConfig panel = config->getPanelConfig();
+    LocationConfig location = config->getLocationConfig();
+    volatile float sink = 0;
+
+    // A tilt change reuses the sky; a site change rebuilds it
+    uint32_t start = micros();
+    for (int i = 0; i < rounds; i++) {
+        panel.tilt = 10 + i % 20;
+        config->setPanelConfig(panel);
+        sink += solar->calculateDailyForecast(2024, 6, 21).totalIrradiance;
+    }
+    uint32_t tilt = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < rounds; i++) {
+        location.latitude = -17.0f - (i % 20) * 0.1f;
+        config->setLocationConfig(location);
+        sink += solar->calculateDailyForecast(2024, 6, 21).totalIrradiance;
+    }
+    uint32_t site = micros() - start;
+
+    char report[96];
+    snprintf(report, sizeof(report), "Forecast after a tilt change: %.1f us, after a site change: %.1f us",
+             (float)tilt / rounds, (float)site / rounds);
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runConfigReloadTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_tilt_change_retransposes_only);
+    RUN_TEST(test_recipient_change_touches_no_math);
+    RUN_TEST(test_site_change_recomputes_sky);
+    RUN_TEST(test_timezone_change_moves_hours);
+    RUN_TEST(test_unchanged_values_publish_nothing);
+    RUN_TEST(test_file_endpoint_survives_reload);
+    RUN_TEST(test_recomputations_per_change);
+    RUN_TEST(test_forecast_cost_per_change);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runConfigReloadTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runConfigReloadTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
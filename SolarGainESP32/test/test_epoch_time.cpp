@@ -0,0 +1,149 @@
+#include <unity.h>
+#include "EpochTime.h"
+
+// 2024-06-21 00:00:00 UTC
+static const time_t JUNE_21 = 1718928000;
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_known_instants() {
+    UtcFields f = EpochTime::split(0);
+    TEST_ASSERT_EQUAL(1970, f.year);
+    TEST_ASSERT_EQUAL(1, f.month);
+    TEST_ASSERT_EQUAL(1, f.day);
+    TEST_ASSERT_EQUAL(1, f.dayOfYear);
+
+    f = EpochTime::split(JUNE_21 + 3 * 3600 + 25 * 60 + 45);
+    TEST_ASSERT_EQUAL(2024, f.year);
+    TEST_ASSERT_EQUAL(6, f.month);
+    TEST_ASSERT_EQUAL(21, f.day);
+    TEST_ASSERT_EQUAL(173, f.dayOfYear);   // leap year
+    TEST_ASSERT_EQUAL(3, f.hour);
+    TEST_ASSERT_EQUAL(25, f.minute);
+    TEST_ASSERT_EQUAL(45, f.second);
+    TEST_ASSERT_EQUAL(12345, f.secondOfDay);
+
+    // Before the epoch
+    f = EpochTime::split(-1);
+    TEST_ASSERT_EQUAL(1969, f.year);
+    TEST_ASSERT_EQUAL(12, f.month);
+    TEST_ASSERT_EQUAL(31, f.day);
+    TEST_ASSERT_EQUAL(365, f.dayOfYear);
+    TEST_ASSERT_EQUAL(86399, f.secondOfDay);
+
+    TEST_ASSERT_EQUAL(JUNE_21, EpochTime::fromCivil(2024, 6, 21));
+    TEST_ASSERT_EQUAL(JUNE_21 + 86399, EpochTime::fromCivil(2024, 6, 21, 23, 59, 59));
+    TEST_ASSERT_EQUAL(JUNE_21, EpochTime::startOfDay(JUNE_21 + 86399));
+}
+
+void test_leap_years() {
+    TEST_ASSERT_TRUE(EpochTime::isLeapYear(2000));
+    TEST_ASSERT_FALSE(EpochTime::isLeapYear(1900));
+    TEST_ASSERT_FALSE(EpochTime::isLeapYear(2100));
+    TEST_ASSERT_TRUE(EpochTime::isLeapYear(2024));
+    TEST_ASSERT_EQUAL(366, EpochTime::dayOfYear(2024, 12, 31));
+    TEST_ASSERT_EQUAL(365, EpochTime::dayOfYear(2100, 12, 31));
+    TEST_ASSERT_EQUAL(60, EpochTime::dayOfYear(2000, 2, 29));
+}
+
+void test_every_day_round_trips() {
+    // Walk the calendar one day at a time from 1900 to 2200
+    static const int monthDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int64_t days = EpochTime::daysFromCivil(1900, 1, 1);
+    int doy = 1;
+    for (int year = 1900; year < 2200; year++) {
+        for (int month = 1; month <= 12; month++) {
+            int length = monthDays[month - 1] + (month == 2 && EpochTime::isLeapYear(year));
+            for (int day = 1; day <= length; day++) {
+                TEST_ASSERT_EQUAL(days, EpochTime::daysFromCivil(year, month, day));
+                int y, m, d;
+                EpochTime::civilFromDays(days, y, m, d);
+                if (y != year || m != month || d != day) {
+                    TEST_FAIL_MESSAGE("civilFromDays disagrees with the calendar walk");
+                }
+                TEST_ASSERT_EQUAL(doy, EpochTime::dayOfYear(year, month, day));
+                days++;
+                doy++;
+            }
+        }
+        doy = 1;
+    }
+}
+
+void test_matches_gmtime() {
+    uint32_t seed = 12345;
+    for (int i = 0; i < 100000; i++) {
+        seed = seed * 1664525 + 1013904223;
+        time_t t = (time_t)(seed % 4102444800ULL);   // 1970 to 2100
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        UtcFields f = EpochTime::split(t);
+        if (f.year != tm.tm_year + 1900 || f.month != tm.tm_mon + 1 || f.day != tm.tm_mday ||
+            f.dayOfYear != tm.tm_yday + 1 || f.hour != tm.tm_hour || f.minute != tm.tm_min ||
+            f.second != tm.tm_sec) {
+            TEST_FAIL_MESSAGE("split() disagrees with gmtime_r()");
+        }
+    }
+}
+
+void test_utc_hours_exact() {
+    TEST_ASSERT_EQUAL_FLOAT(12.0f, EpochTime::split(JUNE_21 + 12 * 3600).utcHours);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, EpochTime::split(JUNE_21).utcHours);
+
+    // One second is still resolved decades from the epoch
+    float last = EpochTime::split(JUNE_21 + 86399).utcHours;
+    float previous = EpochTime::split(JUNE_21 + 86398).utcHours;
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1 / 3600.0f, last - previous);
+}
+
+void test_split_throughput() {
+    const int calls = 200000;
+    volatile uint32_t sink = 0;
+    uint32_t start = micros();
+    for (int i = 0; i < calls; i++) {
+        sink += EpochTime::split(JUNE_21 + (time_t)i * 997).dayOfYear;
+    }
+    uint32_t elapsed = micros() - start;
+
+    char report[96];
+    snprintf(report, sizeof(report), "split(): %.1f ns per call", elapsed * 1000.0 / calls);
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runEpochTimeTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_known_instants);
+    RUN_TEST(test_leap_years);
+    RUN_TEST(test_every_day_round_trips);
+    RUN_TEST(test_matches_gmtime);
+    RUN_TEST(test_utc_hours_exact);
+    RUN_TEST(test_split_throughput);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runEpochTimeTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runEpochTimeTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
@@ -0,0 +1,300 @@
+#include <unity.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "FleetService.h"
+#include "FleetLoad.h"
+#include "SolarCalc.h"
+
+// Host only: fleetd's registry, cache and API, served on a Unix socket
+// under /tmp, and the load generator run against it.
+
+static const char* const SOCKET_PATH = "/tmp/test_fleet_service.sock";
+static const char* const ZONES[] = {"CAT-2", "CET-1CEST,M3.5.0,M10.5.0/3", "IST-5:30",
+                                    "EST5EDT,M3.2.0,M11.1.0", "AEST-10AEDT,M10.1.0,M4.1.0/3"};
+
+SiteRegistry* registry;
+FleetService* service;
+
+// Sites spread over both hemispheres
+static void addSites(SiteRegistry& sites, int count) {
+    for (int i = 0; i < count; i++) {
+        FleetSite site;
+        char id[16];
+        snprintf(id, sizeof(id), "site%04d", i);
+        site.id = id;
+        site.name = "Site " + std::to_string(i);
+        site.latitude = -45.0f + (i * 37 % 90);
+        site.longitude = -170.0f + (i * 53 % 340);
+        site.elevation = (float)(i % 7) * 200;
+        site.tilt = site.latitude < 0 ? -site.latitude : site.latitude;
+        site.azimuth = site.latitude < 0 ? 0 : 180;
+        site.timezone = ZONES[i % 5];
+        TEST_ASSERT_TRUE(sites.upsert(site));
+    }
+}
+
+// One request on a fresh connection; returns the status
+static int request(const char* target, std::string& body) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKET_PATH);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    std::string text = std::string("GET ") + target + " HTTP/1.1\r\nConnection: close\r\n\r\n";
+    send(fd, text.data(), text.size(), MSG_NOSIGNAL);
+    std::string response;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+        response.append(chunk, n);
+    }
+    close(fd);
+
+    size_t headEnd = response.find("\r\n\r\n");
+    if (response.compare(0, 9, "HTTP/1.1 ") != 0 || headEnd == std::string::npos) return -1;
+    body = response.substr(headEnd + 4);
+    return atoi(response.c_str() + 9);
+}
+
+void setUp(void) {
+    registry = new SiteRegistry();
+    service = new FleetService(*registry, 2, 4096, 8);
+}
+
+void tearDown(void) {
+    delete service;
+    delete registry;
+}
+
+void test_lru_evicts_least_recently_used() {
+    ForecastLru lru(4, 1);
+    CachedForecast value;
+    memset(&value, 0, sizeof(value));
+    for (int day = 0; day < 4; day++) {
+        value.total = (float)day;
+        lru.put({1, 1, day, 0, 0}, value);
+    }
+
+    // Touch day 0, so day 1 is the oldest when day 4 arrives
+    TEST_ASSERT_TRUE(lru.get({1, 1, 0, 0, 0}, value));
+    value.total = 4;
+    lru.put({1, 1, 4, 0, 0}, value);
+
+    TEST_ASSERT_FALSE(lru.get({1, 1, 1, 0, 0}, value));
+    TEST_ASSERT_TRUE(lru.get({1, 1, 0, 0, 0}, value));
+    TEST_ASSERT_EQUAL_FLOAT(0, value.total);
+    TEST_ASSERT_TRUE(lru.get({1, 1, 4, 0, 0}, value));
+    TEST_ASSERT_EQUAL_FLOAT(4, value.total);
+
+    ForecastLruStats stats = lru.getStats();
+    TEST_ASSERT_EQUAL(3, stats.hits);
+    TEST_ASSERT_EQUAL(1, stats.misses);
+    TEST_ASSERT_EQUAL(1, stats.evictions);
+    TEST_ASSERT_EQUAL(4, stats.entries);
+}
+
+void test_registry_parses_csv_lines() {
+    FleetSite site;
+    TEST_ASSERT_TRUE(SiteRegistry::parseLine("hre,Harare roof,-17.83,31.05,1490,20,0,CAT-2\r\n", site));
+    TEST_ASSERT_EQUAL_STRING("hre", site.id.c_str());
+    TEST_ASSERT_EQUAL_STRING("Harare roof", site.name.c_str());
+    TEST_ASSERT_EQUAL_FLOAT(-17.83f, site.latitude);
+    TEST_ASSERT_EQUAL_FLOAT(1490, site.elevation);
+    TEST_ASSERT_EQUAL_STRING("CAT-2", site.timezone.c_str());
+
+    // The zone takes the rest of the line, commas included
+    TEST_ASSERT_TRUE(SiteRegistry::parseLine("ber,Berlin,52.52,13.40,34,35,180,CET-1CEST,M3.5.0,M10.5.0/3", site));
+    TEST_ASSERT_EQUAL_STRING("CET-1CEST,M3.5.0,M10.5.0/3", site.timezone.c_str());
+
+    TEST_ASSERT_FALSE(SiteRegistry::parseLine("bad,Missing,-17.83,31.05", site));
+    TEST_ASSERT_FALSE(SiteRegistry::parseLine("bad,Text,north,31.05,0,0,0,UTC0", site));
+
+    // Out of range or an unreadable zone is refused by the registry
+    SiteRegistry::parseLine("far,Far,-97,31.05,0,20,0,CAT-2", site);
+    TEST_ASSERT_FALSE(registry->upsert(site));
+    SiteRegistry::parseLine("tz,Zone,-17.83,31.05,0,20,0,Not a zone", site);
+    TEST_ASSERT_FALSE(registry->upsert(site));
+    TEST_ASSERT_EQUAL(0, registry->size());
+}
+
+void test_revision_moves_with_location_only() {
+    addSites(*registry, 3);
+    FleetSite site;
+    TEST_ASSERT_TRUE(registry->find("site0001", site));
+    uint32_t revision = site.revision;
+    TEST_ASSERT_EQUAL(1, site.index);
+
+    site.name = "Renamed";
+    site.tilt = 5;
+    TEST_ASSERT_TRUE(registry->upsert(site));
+    registry->find("site0001", site);
+    TEST_ASSERT_EQUAL(revision, site.revision);
+    TEST_ASSERT_EQUAL_STRING("Renamed", site.name.c_str());
+
+    site.latitude += 1;
+    TEST_ASSERT_TRUE(registry->upsert(site));
+    registry->find("site0001", site);
+    TEST_ASSERT_NOT_EQUAL(revision, site.revision);
+    TEST_ASSERT_EQUAL(1, site.index);
+    TEST_ASSERT_EQUAL(3, registry->size());
+}
+
+void test_forecast_matches_solar_calc() {
+    addSites(*registry, 10);
+    for (int i = 0; i < 10; i++) {
+        FleetSite site;
+        registry->find(registry->ids()[i], site);
+
+        SolarCalc solar(site.latitude, site.longitude, site.elevation, site.tilt, site.azimuth);
+        solar.setTimeZone(&site.zone);
+        DailyForecast expected = solar.calculateDailyForecast(2024, 3, 31);
+
+        CachedForecast result;
+        TEST_ASSERT_EQUAL(FLEET_OK, service->forecast(site.id, 2024, 3, 31, result));
+        TEST_ASSERT_EQUAL_FLOAT(expected.totalIrradiance, result.total);
+        for (const HourlyIrradiance& hour : expected.hourlyData) {
+            TEST_ASSERT_EQUAL_FLOAT(hour.irradiance, result.hourly[hour.hour]);
+        }
+    }
+    TEST_ASSERT_EQUAL(10, service->getStats().computed);
+}
+
+void test_cache_key_includes_panel_and_revision() {
+    addSites(*registry, 1);
+    CachedForecast first, again;
+    service->forecast("site0000", 2024, 6, 21, first);
+    service->forecast("site0000", 2024, 6, 21, again);
+    TEST_ASSERT_EQUAL(1, service->getStats().computed);
+    TEST_ASSERT_EQUAL_FLOAT(first.total, again.total);
+
+    // Another panel is another entry
+    CachedForecast flat;
+    service->forecast("site0000", 2024, 6, 21, flat, 0, 0);
+    TEST_ASSERT_EQUAL(2, service->getStats().computed);
+
+    // So is the same panel after the site moves
+    FleetSite site;
+    registry->find("site0000", site);
+    site.latitude += 10;
+    registry->upsert(site);
+    service->forecast("site0000", 2024, 6, 21, again);
+    TEST_ASSERT_EQUAL(3, service->getStats().computed);
+    TEST_ASSERT_TRUE(first.total != again.total);
+
+    TEST_ASSERT_EQUAL(FLEET_UNKNOWN_SITE, service->forecast("nowhere", 2024, 6, 21, again));
+    TEST_ASSERT_EQUAL(FLEET_BAD_DATE, service->forecast("site0000", 2023, 2, 29, again));
+    TEST_ASSERT_EQUAL(FLEET_BAD_PANEL, service->forecast("site0000", 2024, 6, 21, again, 95, 0));
+}
+
+void test_http_api_over_unix_socket() {
+    addSites(*registry, 3);
+    TEST_ASSERT_TRUE(service->beginUnix(SOCKET_PATH));
+
+    std::string body;
+    TEST_ASSERT_EQUAL(200, request("/forecast?site=site0002&date=2024-06-21", body));
+    TEST_ASSERT_EQUAL(0, body.find("{\"site\":\"site0002\",\"date\":\"2024-06-21\",\"total\":"));
+    TEST_ASSERT_TRUE(body.find("\"hourly\":[") != std::string::npos);
+
+    TEST_ASSERT_EQUAL(200, request("/forecast?date=2024-06-21&site=site0002&tilt=10&azimuth=90", body));
+    TEST_ASSERT_EQUAL(404, request("/forecast?site=nowhere&date=2024-06-21", body));
+    TEST_ASSERT_EQUAL_STRING("{\"error\":\"unknown site\"}", body.c_str());
+    TEST_ASSERT_EQUAL(400, request("/forecast?site=site0002&date=2024-13-01", body));
+    TEST_ASSERT_EQUAL(400, request("/forecast?site=site0002&date=tomorrow", body));
+    TEST_ASSERT_EQUAL(404, request("/nothing", body));
+
+    TEST_ASSERT_EQUAL(200, request("/sites", body));
+    TEST_ASSERT_TRUE(body.find("\"id\":\"site0001\",\"name\":\"Site 1\"") != std::string::npos);
+
+    TEST_ASSERT_EQUAL(200, request("/stats", body));
+    TEST_ASSERT_TRUE(body.find("\"requests\":8,\"errors\":4,\"computed\":2") != std::string::npos);
+
+    service->stop();
+    TEST_ASSERT_EQUAL(-1, access(SOCKET_PATH, F_OK));
+}
+
+void test_load_keep_alive_and_concurrency() {
+    addSites(*registry, 20);
+    TEST_ASSERT_TRUE(service->beginUnix(SOCKET_PATH));
+
+    FleetLoadOptions options = FleetLoad::defaults();
+    options.socketPath = SOCKET_PATH;
+    options.clients = 4;
+    options.requests = 2000;
+    options.days = 30;
+    FleetLoad load(options, registry->ids());
+    FleetLoadReport report = load.run();
+
+    TEST_ASSERT_EQUAL(2000, report.requests);
+    TEST_ASSERT_EQUAL(0, report.errors);
+    FleetServiceStats stats = service->getStats();
+    TEST_ASSERT_EQUAL(4, stats.connections);
+    TEST_ASSERT_EQUAL(2000, stats.requests);
+    TEST_ASSERT_EQUAL(stats.cache.misses, stats.computed);
+    TEST_ASSERT_TRUE(stats.computed <= 20 * 30 + 4);
+    TEST_ASSERT_TRUE(report.p50Us <= report.p99Us);
+}
+
+void test_latency_and_throughput_scaling() {
+    static const int siteCounts[] = {10, 1000};
+    static const unsigned workerCounts[] = {1, 2, 4};
+    char line[160];
+    snprintf(line, sizeof(line), "%u cores; 8 keep-alive clients, 8000 requests over 365 days per run",
+             std::thread::hardware_concurrency());
+    TEST_MESSAGE(line);
+
+    for (int sites : siteCounts) {
+        for (unsigned workers : workerCounts) {
+            SiteRegistry fleet;
+            addSites(fleet, sites);
+            FleetService scaled(fleet, workers, 65536, 16);
+            TEST_ASSERT_TRUE(scaled.beginUnix(SOCKET_PATH));
+
+            FleetLoadOptions options = FleetLoad::defaults();
+            options.socketPath = SOCKET_PATH;
+            options.clients = 8;
+            options.requests = 8000;
+            FleetLoad load(options, fleet.ids());
+            FleetLoadReport report = load.run();
+            FleetServiceStats stats = scaled.getStats();
+            scaled.stop();
+
+            TEST_ASSERT_EQUAL(0, report.errors);
+            snprintf(line, sizeof(line),
+                     "%4d sites, %u workers: %7.0f req/s, p50 %6.1f us, p99 %7.1f us, cache hits %4.1f%%",
+                     sites, workers, report.requestsPerSecond, report.p50Us, report.p99Us,
+                     100.0f * stats.cache.hits / (stats.cache.hits + stats.cache.misses));
+            TEST_MESSAGE(line);
+        }
+    }
+}
+
+// Main test runner
+void runFleetServiceTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_lru_evicts_least_recently_used);
+    RUN_TEST(test_registry_parses_csv_lines);
+    RUN_TEST(test_revision_moves_with_location_only);
+    RUN_TEST(test_forecast_matches_solar_calc);
+    RUN_TEST(test_cache_key_includes_panel_and_revision);
+    RUN_TEST(test_http_api_over_unix_socket);
+    RUN_TEST(test_load_keep_alive_and_concurrency);
+    RUN_TEST(test_latency_and_throughput_scaling);
+
+    UNITY_END();
+}
+
+// Native only: FleetService is a host library
+#ifdef UNIT_TEST
+int main() {
+    runFleetServiceTests();
+    return 0;
+}
+#endif
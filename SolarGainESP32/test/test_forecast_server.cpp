@@ -0,0 +1,283 @@
+#include <unity.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "ForecastServer.h"
+#include "SolarCalc.h"
+
+#ifdef HOST_BUILD
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#else
+#include <lwip/sockets.h>
+#endif
+
+// Minimal keep-alive client: one request at a time, Content-Length bodies only
+struct TestClient {
+    int fd = -1;
+    int status = 0;
+    std::string headers;
+    std::string body;
+
+    bool open(uint16_t port) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+
+    ~TestClient() {
+        if (fd >= 0) close(fd);
+    }
+
+    std::string header(const char* name) {
+        size_t at = headers.find(std::string("\r\n") + name + ": ");
+        if (at == std::string::npos) return "";
+        at += strlen(name) + 4;
+        return headers.substr(at, headers.find("\r\n", at) - at);
+    }
+
+    // Send a raw request and read one response; false when the server closed
+    bool exchange(const std::string& request) {
+        if (send(fd, request.data(), request.size(), 0) != (ssize_t)request.size()) return false;
+
+        std::string data;
+        char buffer[1024];
+        size_t headEnd;
+        while ((headEnd = data.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return false;
+            data.append(buffer, n);
+        }
+        headers = data.substr(0, headEnd + 2);
+        status = atoi(headers.c_str() + 9);
+
+        std::string length = header("Content-Length");
+        size_t total = headEnd + 4 + (length.empty() || request.rfind("HEAD", 0) == 0 ? 0 : atoi(length.c_str()));
+        while (data.size() < total) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return false;
+            data.append(buffer, n);
+        }
+        body = data.substr(headEnd + 4, total - headEnd - 4);
+        return true;
+    }
+
+    bool get(const char* path, const std::string& extra = "") {
+        return exchange(std::string("GET ") + path + " HTTP/1.1\r\nHost: solargain\r\n" + extra + "\r\n");
+    }
+};
+
+ForecastCache* cache;
+ForecastServer* server;
+
+static void publishDay(int year, int month, int day, bool isToday) {
+    SolarCalc solar(-17.8292f, 31.0522f, 1490.0f, 20.0f, 0.0f);
+    DailyForecast forecast = solar.calculateDailyForecast(year, month, day);
+    cache->publish(year, month, day, forecast, solar.getSunriseTime(year, month, day),
+                   solar.getSunsetTime(year, month, day), isToday);
+}
+
+void setUp(void) {
+    cache = new ForecastCache();
+    cache->setLocation("Harare", -17.8292f, 31.0522f);
+    publishDay(2024, 6, 21, true);
+    publishDay(2024, 6, 22, false);
+
+    server = new ForecastServer(*cache, 0);
+    TEST_ASSERT_TRUE(server->begin());
+    TEST_ASSERT_TRUE(server->startTask());
+}
+
+void tearDown(void) {
+    delete server;
+    delete cache;
+}
+
+void test_forecast_with_etag() {
+    TestClient client;
+    TEST_ASSERT_TRUE(client.open(server->getPort()));
+    TEST_ASSERT_TRUE(client.get("/forecast"));
+
+    TEST_ASSERT_EQUAL(200, client.status);
+    TEST_ASSERT_EQUAL_STRING("application/json", client.header("Content-Type").c_str());
+    TEST_ASSERT_TRUE(client.body.find("\"date\":\"2024-06-21\"") != std::string::npos);
+    TEST_ASSERT_TRUE(client.body.find("\"location\":\"Harare\"") != std::string::npos);
+    TEST_ASSERT_TRUE(client.body == cache->getToday()->json.c_str());
+
+    std::string etag = client.header("ETag");
+    TEST_ASSERT_EQUAL(10, etag.size());
+
+    // Revalidation on the same connection
+    TEST_ASSERT_TRUE(client.get("/forecast", "If-None-Match: " + etag + "\r\n"));
+    TEST_ASSERT_EQUAL(304, client.status);
+    TEST_ASSERT_EQUAL(0, client.body.size());
+
+    // A new forecast changes the tag
+    publishDay(2024, 6, 23, true);
+    TEST_ASSERT_TRUE(client.get("/forecast", "If-None-Match: " + etag + "\r\n"));
+    TEST_ASSERT_EQUAL(200, client.status);
+    TEST_ASSERT_TRUE(client.header("ETag") != etag);
+
+    TEST_ASSERT_EQUAL(1, server->getStats().connections);
+    TEST_ASSERT_EQUAL(1, server->getStats().notModified);
+}
+
+void test_forecast_by_date() {
+    TestClient client;
+    TEST_ASSERT_TRUE(client.open(server->getPort()));
+
+    TEST_ASSERT_TRUE(client.get("/forecast?date=2024-6-22"));
+    TEST_ASSERT_EQUAL(200, client.status);
+    TEST_ASSERT_TRUE(client.body.find("\"date\":\"2024-06-22\"") != std::string::npos);
+
+    TEST_ASSERT_TRUE(client.get("/forecast?date=2024-07-01"));
+    TEST_ASSERT_EQUAL(404, client.status);
+
+    TEST_ASSERT_TRUE(client.get("/forecast?date=tomorrow"));
+    TEST_ASSERT_EQUAL(400, client.status);
+}
+
+void test_health_and_metrics() {
+    TestClient client;
+    TEST_ASSERT_TRUE(client.open(server->getPort()));
+
+    TEST_ASSERT_TRUE(client.get("/health"));
+    TEST_ASSERT_EQUAL(200, client.status);
+    TEST_ASSERT_TRUE(client.body.find("\"status\":\"ok\"") != std::string::npos);
+
+    TEST_ASSERT_TRUE(client.get("/forecast"));
+    TEST_ASSERT_TRUE(client.get("/metrics"));
+    TEST_ASSERT_EQUAL(200, client.status);
+    // The /metrics request itself is counted once it is answered
+    TEST_ASSERT_TRUE(client.body.find("solargain_http_requests_total 2\n") != std::string::npos);
+    TEST_ASSERT_TRUE(client.body.find("solargain_http_request_duration_seconds_count 2\n") != std::string::npos);
+    TEST_ASSERT_TRUE(client.body.find("solargain_forecast_kwh_m2 ") != std::string::npos);
+}
+
+void test_errors_and_close() {
+    TestClient client;
+    TEST_ASSERT_TRUE(client.open(server->getPort()));
+
+    TEST_ASSERT_TRUE(client.get("/nowhere"));
+    TEST_ASSERT_EQUAL(404, client.status);
+
+    TEST_ASSERT_TRUE(client.exchange("POST /forecast HTTP/1.1\r\nContent-Length: 0\r\n\r\n"));
+    TEST_ASSERT_EQUAL(405, client.status);
+    TEST_ASSERT_EQUAL_STRING("GET, HEAD", client.header("Allow").c_str());
+
+    TEST_ASSERT_TRUE(client.exchange("HEAD /forecast HTTP/1.1\r\n\r\n"));
+    TEST_ASSERT_EQUAL(200, client.status);
+    TEST_ASSERT_EQUAL(0, client.body.size());
+
+    TEST_ASSERT_TRUE(client.get("/forecast", "Connection: close\r\n"));
+    TEST_ASSERT_EQUAL(200, client.status);
+    TEST_ASSERT_FALSE(client.get("/forecast"));
+
+    // Oversized headers
+    TestClient big;
+    TEST_ASSERT_TRUE(big.open(server->getPort()));
+    TEST_ASSERT_TRUE(big.get("/forecast", "X-Padding: " + std::string(600, 'x') + "\r\n"));
+    TEST_ASSERT_EQUAL(431, big.status);
+}
+
+void test_polling_load() {
+    const int clients = 4;
+    const int requestsEach = 2500;
+    uint32_t generation = cache->getGeneration();
+
+    TestClient probe;
+    TEST_ASSERT_TRUE(probe.open(server->getPort()));
+    TEST_ASSERT_TRUE(probe.get("/forecast"));
+    std::string revalidate = "If-None-Match: " + probe.header("ETag") + "\r\n";
+
+    std::vector<std::vector<uint32_t>> latencies(clients);
+    std::vector<int> failures(clients, 0);
+    std::vector<std::thread> threads;
+
+    uint32_t start = micros();
+    for (int t = 0; t < clients; t++) {
+        threads.emplace_back([&, t]() {
+            TestClient client;
+            if (!client.open(server->getPort())) {
+                failures[t] = requestsEach;
+                return;
+            }
+            latencies[t].reserve(requestsEach);
+            for (int i = 0; i < requestsEach; i++) {
+                // Dashboards mostly revalidate; every fourth poll is a full fetch
+                uint32_t sent = micros();
+                bool ok = client.get("/forecast", i % 4 ? revalidate : "");
+                latencies[t].push_back(micros() - sent);
+                if (!ok || client.status != (i % 4 ? 304 : 200)) failures[t]++;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    uint32_t elapsedUs = micros() - start;
+
+    std::vector<uint32_t> all;
+    for (const std::vector<uint32_t>& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    int failed = 0;
+    for (int f : failures) failed += f;
+
+    TEST_ASSERT_EQUAL(0, failed);
+    TEST_ASSERT_EQUAL(clients * requestsEach, all.size());
+    // Serving never recomputed or re-serialized the forecast
+    TEST_ASSERT_EQUAL(generation, cache->getGeneration());
+
+    char report[160];
+    snprintf(report, sizeof(report),
+             "%d clients x %d requests: %.0f req/s, latency p50 %lu us, p99 %lu us, max %lu us",
+             clients, requestsEach, all.size() * 1e6 / elapsedUs,
+             (unsigned long)all[all.size() / 2], (unsigned long)all[all.size() * 99 / 100],
+             (unsigned long)all.back());
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runForecastServerTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_forecast_with_etag);
+    RUN_TEST(test_forecast_by_date);
+    RUN_TEST(test_health_and_metrics);
+    RUN_TEST(test_errors_and_close);
+    RUN_TEST(test_polling_load);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runForecastServerTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runForecastServerTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
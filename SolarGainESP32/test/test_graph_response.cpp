@@ -0,0 +1,198 @@
+#include <unity.h>
+#include <string>
+#include "GraphResponse.h"
+#include "HttpSession.h"
+
+// A response body held in memory, read the way HttpBodyStream hands it over
+class BodyStream : public Stream {
+private:
+    std::string data;
+    size_t position;
+
+public:
+    BodyStream(const std::string& text) : data(text), position(0) {}
+    int available() override { return data.size() - position; }
+    int read() override { return position < data.size() ? (uint8_t)data[position++] : -1; }
+    int peek() override { return position < data.size() ? (uint8_t)data[position] : -1; }
+    size_t write(uint8_t) override { return 0; }
+};
+
+static GraphResponse parse(int status, const std::string& body) {
+    BodyStream stream(body);
+    GraphResponse response;
+    response.parse(stream, status);
+    return response;
+}
+
+static std::string errorBody(long code) {
+    return "{\"error\":{\"message\":\"(#" + std::to_string(code) + ") Failure\",\"type\":\"OAuthException\","
+           "\"code\":" + std::to_string(code) + ",\"error_subcode\":2494010,\"fbtrace_id\":\"AbCdEf\"}}";
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_parses_sent_message() {
+    GraphResponse r = parse(200, "{\"messaging_product\":\"whatsapp\",\"contacts\":[{\"input\":\"+263771234567\","
+                                 "\"wa_id\":\"263771234567\"}],\"messages\":[{\"id\":\"wamid.HBgMMjYzNzcxMjM0NTY3\"}]}");
+    TEST_ASSERT_TRUE(r.parsed);
+    TEST_ASSERT_TRUE(r.ok());
+    TEST_ASSERT_EQUAL(200, r.httpCode);
+    TEST_ASSERT_EQUAL(0, r.errorCode);
+    TEST_ASSERT_EQUAL_STRING("wamid.HBgMMjYzNzcxMjM0NTY3", r.messageId);
+    TEST_ASSERT_EQUAL_STRING("ok", r.errorName());
+}
+
+void test_parses_phone_number() {
+    GraphResponse r = parse(200, "{\"verified_name\":\"SolarGain\",\"display_phone_number\":\"+1 555-0100\","
+                                 "\"quality_rating\":\"GREEN\",\"id\":\"1098765432\"}");
+    TEST_ASSERT_TRUE(r.ok());
+    TEST_ASSERT_EQUAL_STRING("+1 555-0100", r.displayPhoneNumber);
+    TEST_ASSERT_EQUAL_STRING("", r.messageId);
+}
+
+void test_parses_error_codes() {
+    struct Case {
+        int status;
+        long code;
+        GraphError expected;
+    };
+    const Case cases[] = {
+        {400, 4, GRAPH_RATE_LIMITED},       // application request limit, under a 400
+        {400, 80007, GRAPH_RATE_LIMITED},
+        {429, 130429, GRAPH_RATE_LIMITED},
+        {500, 131000, GRAPH_UNAVAILABLE},
+        {503, 131016, GRAPH_UNAVAILABLE},
+        {401, 190, GRAPH_AUTH},
+        {400, 190, GRAPH_AUTH},             // the code wins over the status
+        {400, 131047, GRAPH_RECIPIENT},
+        {400, 100, GRAPH_REQUEST},
+    };
+    for (const Case& c : cases) {
+        GraphResponse r = parse(c.status, errorBody(c.code));
+        TEST_ASSERT_TRUE(r.parsed);
+        TEST_ASSERT_EQUAL(c.status, r.httpCode);
+        TEST_ASSERT_EQUAL(c.code, r.errorCode);
+        TEST_ASSERT_EQUAL(c.expected, r.error);
+        TEST_ASSERT_FALSE(r.ok());
+    }
+}
+
+void test_status_without_error_code() {
+    TEST_ASSERT_EQUAL(GRAPH_RATE_LIMITED, parse(429, "{}").error);
+    TEST_ASSERT_EQUAL(GRAPH_UNAVAILABLE, parse(502, "{}").error);
+    TEST_ASSERT_EQUAL(GRAPH_AUTH, parse(403, "{}").error);
+    TEST_ASSERT_EQUAL(GRAPH_REQUEST, parse(404, "{}").error);
+
+    // Empty body, as a proxy's 504 may have
+    GraphResponse r = parse(504, "");
+    TEST_ASSERT_FALSE(r.parsed);
+    TEST_ASSERT_EQUAL(GRAPH_UNAVAILABLE, r.error);
+    TEST_ASSERT_TRUE(r.retryable());
+}
+
+void test_malformed_and_truncated_bodies() {
+    // An HTML error page from a load balancer
+    GraphResponse r = parse(502, "<html><body>Bad Gateway</body></html>");
+    TEST_ASSERT_FALSE(r.parsed);
+    TEST_ASSERT_EQUAL(0, r.errorCode);
+    TEST_ASSERT_EQUAL(GRAPH_UNAVAILABLE, r.error);
+
+    // Cut off inside the error object: the status still decides
+    r = parse(429, "{\"error\":{\"message\":\"(#130429) Rate limit hit\",\"co");
+    TEST_ASSERT_FALSE(r.parsed);
+    TEST_ASSERT_EQUAL(GRAPH_RATE_LIMITED, r.error);
+
+    r = parse(500, "{\"error\":{\"code\":131000,\"message\":\"Something went");
+    TEST_ASSERT_FALSE(r.parsed);
+    TEST_ASSERT_EQUAL(GRAPH_UNAVAILABLE, r.error);
+
+    // A 2xx is accepted even when its body is cut off; only the id is missing
+    r = parse(200, "{\"messaging_product\":\"whatsapp\",\"messages\":[{\"id\":\"wamid.HBgM");
+    TEST_ASSERT_FALSE(r.parsed);
+    TEST_ASSERT_TRUE(r.ok());
+
+    r = parse(400, "{\"error\":}");
+    TEST_ASSERT_FALSE(r.parsed);
+    TEST_ASSERT_EQUAL(GRAPH_REQUEST, r.error);
+}
+
+void test_large_error_document() {
+    // The filter keeps memory flat however long the message is
+    std::string message(20000, 'x');
+    GraphResponse r = parse(400, "{\"error\":{\"message\":\"" + message + "\",\"error_data\":{\"details\":\"" +
+                                     message + "\"},\"code\":131026}}");
+    TEST_ASSERT_TRUE(r.parsed);
+    TEST_ASSERT_EQUAL(131026, r.errorCode);
+    TEST_ASSERT_EQUAL(GRAPH_RECIPIENT, r.error);
+}
+
+void test_classify() {
+    TEST_ASSERT_EQUAL(GRAPH_OK, GraphResponse::classify(200, 0));
+    TEST_ASSERT_EQUAL(GRAPH_OK, GraphResponse::classify(204, 0));
+    TEST_ASSERT_EQUAL(GRAPH_TRANSPORT, GraphResponse::classify(HTTP_SESSION_ERROR_CONNECT, 0));
+    TEST_ASSERT_EQUAL(GRAPH_TRANSPORT, GraphResponse::classify(HTTP_SESSION_ERROR_TIMEOUT, 0));
+    TEST_ASSERT_EQUAL(GRAPH_TRANSPORT, GraphResponse::classify(408, 0));
+
+    TEST_ASSERT_EQUAL(GRAPH_RATE_LIMITED, GraphResponse::classify(400, 4));
+    TEST_ASSERT_EQUAL(GRAPH_RATE_LIMITED, GraphResponse::classify(400, 80007));
+    TEST_ASSERT_EQUAL(GRAPH_RATE_LIMITED, GraphResponse::classify(429, 130429));
+    TEST_ASSERT_EQUAL(GRAPH_RATE_LIMITED, GraphResponse::classify(429, 0));
+    TEST_ASSERT_EQUAL(GRAPH_UNAVAILABLE, GraphResponse::classify(500, 131000));
+    TEST_ASSERT_EQUAL(GRAPH_UNAVAILABLE, GraphResponse::classify(500, 0));
+    TEST_ASSERT_EQUAL(GRAPH_AUTH, GraphResponse::classify(401, 190));
+    TEST_ASSERT_EQUAL(GRAPH_AUTH, GraphResponse::classify(400, 250));   // 200-299 are permissions
+    TEST_ASSERT_EQUAL(GRAPH_RECIPIENT, GraphResponse::classify(400, 131026));
+    TEST_ASSERT_EQUAL(GRAPH_REQUEST, GraphResponse::classify(400, 100));
+
+    // A Graph error code under a 2xx is still an error
+    TEST_ASSERT_EQUAL(GRAPH_UNAVAILABLE, GraphResponse::classify(200, 131000));
+}
+
+void test_reset_for_transport_errors() {
+    GraphResponse r;
+    r.reset(HTTP_SESSION_ERROR_LOST);
+    TEST_ASSERT_EQUAL(GRAPH_TRANSPORT, r.error);
+    TEST_ASSERT_TRUE(r.retryable());
+    TEST_ASSERT_FALSE(r.parsed);
+    TEST_ASSERT_EQUAL_STRING("transport", r.errorName());
+}
+
+// Main test runner
+void runGraphResponseTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parses_sent_message);
+    RUN_TEST(test_parses_phone_number);
+    RUN_TEST(test_parses_error_codes);
+    RUN_TEST(test_status_without_error_code);
+    RUN_TEST(test_malformed_and_truncated_bodies);
+    RUN_TEST(test_large_error_document);
+    RUN_TEST(test_classify);
+    RUN_TEST(test_reset_for_transport_errors);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runGraphResponseTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runGraphResponseTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
@@ -0,0 +1,331 @@
+#include <unity.h>
+#include <math.h>
+#include <string>
+#include "IrradianceMeter.h"
+#include "IrradianceSource.h"
+#include "EpochTime.h"
+
+#ifdef HOST_BUILD
+const uint32_t TEST_REPLAY_SAMPLES = 400000;
+#else
+const uint32_t TEST_REPLAY_SAMPLES = 5000;     // the log is held in RAM
+#endif
+
+// A CSV log held in memory
+class MemoryStream : public Stream {
+private:
+    std::string data;
+    size_t position;
+
+public:
+    MemoryStream(const std::string& text) : data(text), position(0) {}
+    int available() override { return data.size() - position; }
+    int read() override { return position < data.size() ? (uint8_t)data[position++] : -1; }
+    int peek() override { return position < data.size() ? (uint8_t)data[position] : -1; }
+    size_t readBytes(char* buffer, size_t length) override {
+        size_t count = min(length, data.size() - position);
+        memcpy(buffer, data.data() + position, count);
+        position += count;
+        return count;
+    }
+    size_t write(uint8_t) override { return 0; }
+};
+
+TimeZone harare;
+IrradianceMeter* meter;
+
+// A clear morning with some cloud: a ramp with a dip every few minutes
+static float sampleAt(time_t utc) {
+    float ramp = (utc % 86400) / 10.0f - 1800;
+    return (utc / 60) % 7 == 3 ? ramp * 0.4f : ramp;
+}
+
+static std::string replayLog(time_t from, time_t to, int step) {
+    std::string text = "utc,irradiance\n";
+    char line[48];
+    for (time_t t = from; t < to; t += step) {
+        snprintf(line, sizeof(line), "%ld,%.2f\n", (long)t, sampleAt(t));
+        text += line;
+    }
+    return text;
+}
+
+// Run a source to its end by hand, the way the two tasks would
+static void replay(IrradianceSource& source) {
+    meter->setSource(&source);
+    while (!meter->sourceFinished()) {
+        meter->pump();
+        meter->process();
+    }
+    meter->process();
+}
+
+void setUp(void) {
+    harare.begin("CAT-2");
+    meter = new IrradianceMeter();
+    meter->setTimeZone(&harare);
+}
+
+void tearDown(void) {
+    delete meter;
+}
+
+void test_running_stats_match_two_pass() {
+    float values[1000];
+    RunningStats all, first, second;
+    all.clear();
+    first.clear();
+    second.clear();
+    double sum = 0;
+    for (int i = 0; i < 1000; i++) {
+        values[i] = 800 + 150 * sinf(i * 0.37f) + (i % 13);
+        sum += values[i];
+        all.add(values[i]);
+        (i < 300 ? first : second).add(values[i]);
+    }
+    double mean = sum / 1000, squares = 0;
+    for (int i = 0; i < 1000; i++) squares += (values[i] - mean) * (values[i] - mean);
+
+    TEST_ASSERT_EQUAL(1000, all.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, mean, all.mean);
+    TEST_ASSERT_FLOAT_WITHIN(squares / 999 * 1e-4, squares / 999, all.variance());
+
+    // Two halves merged are the whole
+    first.merge(second);
+    TEST_ASSERT_EQUAL(1000, first.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, all.mean, first.mean);
+    TEST_ASSERT_FLOAT_WITHIN(all.variance() * 1e-4f, all.variance(), first.variance());
+    TEST_ASSERT_EQUAL_FLOAT(all.min, first.min);
+    TEST_ASSERT_EQUAL_FLOAT(all.max, first.max);
+}
+
+void test_ring_drops_when_full() {
+    SampleRing& ring = meter->getRing();
+    IrradianceSample sample = {0, 0};
+    for (uint32_t i = 0; i < IRRADIANCE_RING_SIZE + 10; i++) {
+        sample.utc = i;
+        ring.push(sample);
+    }
+    TEST_ASSERT_EQUAL(10, ring.getDropped());
+    TEST_ASSERT_EQUAL(0, ring.space());
+    TEST_ASSERT_EQUAL(IRRADIANCE_RING_SIZE, ring.getPeak());
+
+    // Oldest first, and the indices wrap
+    IrradianceSample out[IRRADIANCE_BATCH];
+    TEST_ASSERT_EQUAL(IRRADIANCE_BATCH, ring.pop(out, IRRADIANCE_BATCH));
+    TEST_ASSERT_EQUAL(0, out[0].utc);
+    TEST_ASSERT_EQUAL(IRRADIANCE_BATCH - 1, out[IRRADIANCE_BATCH - 1].utc);
+    sample.utc = 5000;
+    TEST_ASSERT_TRUE(ring.push(sample));
+    TEST_ASSERT_EQUAL(IRRADIANCE_RING_SIZE + 1, meter->process() + IRRADIANCE_BATCH);
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+void test_replay_by_minute_and_hour() {
+    // 05:50 to 07:10 UTC is 07:50 to 09:10 on the Harare clock, a sample every 5 s
+    time_t from = EpochTime::fromCivil(2025, 6, 21, 5, 50), to = EpochTime::fromCivil(2025, 6, 21, 7, 10);
+    std::string log = replayLog(from, to, 5);
+    log += "not,a,sample\n\n2025-06-21T07:10:00Z,1000\n";
+    MemoryStream input(log);
+    CsvReplaySource source(input);
+    replay(source);
+
+    // Header and the bad line
+    TEST_ASSERT_EQUAL(2, source.getRejected());
+    IrradianceMeterStats stats = meter->getStats();
+    TEST_ASSERT_EQUAL(80 * 12 + 1, stats.consumed);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+
+    // The ISO line opened 07:10; the minute before it against a two-pass reference
+    MinuteStats open = meter->getOpenMinute();
+    TEST_ASSERT_EQUAL(to, open.start);
+    TEST_ASSERT_EQUAL_FLOAT(1000, open.stats.mean);
+
+    MinuteStats minute;
+    TEST_ASSERT_TRUE(meter->getMinute(0, minute));
+    TEST_ASSERT_EQUAL(to - 60, minute.start);
+    for (int ago = 0; ago < 10; ago++) {
+        TEST_ASSERT_TRUE(meter->getMinute(ago, minute));
+        double sum = 0, squares = 0, low = 1e9, high = -1e9;
+        for (time_t t = minute.start; t < minute.start + 60; t += 5) sum += sampleAt(t);
+        double mean = sum / 12;
+        for (time_t t = minute.start; t < minute.start + 60; t += 5) {
+            squares += (sampleAt(t) - mean) * (sampleAt(t) - mean);
+            low = min(low, (double)sampleAt(t));
+            high = max(high, (double)sampleAt(t));
+        }
+        TEST_ASSERT_EQUAL(12, minute.stats.count);
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, mean, minute.stats.mean);
+        TEST_ASSERT_FLOAT_WITHIN(0.01f + squares / 11 * 1e-4, squares / 11, minute.stats.variance());
+        TEST_ASSERT_EQUAL_FLOAT(low, minute.stats.min);
+        TEST_ASSERT_EQUAL_FLOAT(high, minute.stats.max);
+    }
+    TEST_ASSERT_TRUE(meter->getMinute(IRRADIANCE_MINUTE_HISTORY - 1, minute));
+    TEST_ASSERT_FALSE(meter->getMinute(IRRADIANCE_MINUTE_HISTORY, minute));
+
+    // Local hours 7, 8 and 9, as the forecast's buckets
+    MeasuredDay day = meter->getToday();
+    TEST_ASSERT_EQUAL(2025, day.year);
+    TEST_ASSERT_EQUAL(21, day.day);
+    TEST_ASSERT_EQUAL(10, day.minutes[7]);
+    TEST_ASSERT_EQUAL(60, day.minutes[8]);
+    TEST_ASSERT_EQUAL(11, day.minutes[9]);
+    TEST_ASSERT_EQUAL(0, day.minutes[10]);
+    TEST_ASSERT_EQUAL(720, day.hour[8].count);
+    double sum = 0;
+    for (time_t t = from + 600; t < from + 4200; t += 5) sum += sampleAt(t);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, sum / 720, day.hour[8].mean);
+
+    DailyForecast measured = IrradianceMeter::toForecast(day);
+    TEST_ASSERT_EQUAL(24, measured.hourlyData.size());
+    TEST_ASSERT_EQUAL_STRING("2025-6-21", measured.date.c_str());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sum / 720 / 1000, measured.hourlyData[8].irradiance);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, day.hour[7].mean * 10 / 60 / 1000, measured.hourlyData[7].irradiance);
+    TEST_ASSERT_EQUAL_FLOAT(0, measured.hourlyData[12].irradiance);
+}
+
+void test_day_rollover_and_late_samples() {
+    // Across midnight on the Harare clock, 22:00 UTC
+    time_t midnight = EpochTime::fromCivil(2025, 3, 1, 22, 0);
+    std::string log = replayLog(midnight - 120, midnight + 120, 10);
+    log += std::to_string((long)midnight - 3600) + ",5\n";
+    MemoryStream input(log);
+    CsvReplaySource source(input);
+    replay(source);
+    meter->flush();
+
+    MeasuredDay today = meter->getToday(), yesterday = meter->getYesterday();
+    TEST_ASSERT_EQUAL(3, today.month);
+    TEST_ASSERT_EQUAL(2, today.day);
+    TEST_ASSERT_EQUAL(2, today.minutes[0]);
+    TEST_ASSERT_EQUAL(1, yesterday.day);
+    TEST_ASSERT_EQUAL(2, yesterday.minutes[23]);
+    TEST_ASSERT_EQUAL(12, yesterday.hour[23].count);
+    TEST_ASSERT_EQUAL(1, meter->getStats().late);
+}
+
+void test_paced_replay_past_micros_wrap() {
+    // A sample every 30 minutes for three hours, at real speed; the last ones
+    // fall due after micros() would have wrapped (71.6 minutes)
+    time_t from = EpochTime::fromCivil(2025, 6, 21, 6, 0);
+    std::string log = replayLog(from, from + 3 * 3600 + 1, 1800);
+    MemoryStream input(log);
+    CsvReplaySource source(input, 1.0f);
+    int64_t nowUs = 0xFFFFFF00LL;   // odd start, near a 32-bit boundary
+    source.setClock([&nowUs]() { return nowUs; });
+    meter->setSource(&source);
+
+    for (int sample = 0; sample < 7; sample++) {
+        int64_t dueUs = 0xFFFFFF00LL + sample * 1800 * 1000000LL;
+        if (sample > 0) {
+            nowUs = dueUs - 1;
+            TEST_ASSERT_EQUAL(0, meter->pump());
+        }
+        nowUs = dueUs;
+        TEST_ASSERT_EQUAL(1, meter->pump());
+    }
+    meter->pump();
+    TEST_ASSERT_TRUE(meter->sourceFinished());
+    TEST_ASSERT_EQUAL(7, meter->process());
+
+    // Sped up 60 times, the three hours take three minutes
+    MemoryStream fast(log);
+    CsvReplaySource quick(fast, 60.0f);
+    nowUs = 0;
+    quick.setClock([&nowUs]() { return nowUs; });
+    SampleRing ring;
+    TEST_ASSERT_EQUAL(1, quick.fill(ring));
+    nowUs = 30 * 1000000LL - 1;
+    TEST_ASSERT_EQUAL(0, quick.fill(ring));
+    nowUs = 180 * 1000000LL;
+    TEST_ASSERT_EQUAL(6, quick.fill(ring));
+}
+
+void test_adc_source_keeps_its_period() {
+    // 2 kHz for a third of a second through both tasks
+    AdcIrradianceSource adc(4, 2.0f, 500);
+    meter->setSource(&adc);
+    TEST_ASSERT_TRUE(meter->startTasks());
+    delay(333);
+    meter->stopTasks();
+    meter->process();
+
+    IrradianceMeterStats stats = meter->getStats();
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(stats.pushed, stats.consumed);
+    TEST_ASSERT_INT_WITHIN(60, 666, stats.pushed);
+}
+
+void test_replay_throughput() {
+    time_t from = EpochTime::fromCivil(2025, 1, 1);
+    std::string log = replayLog(from, from + TEST_REPLAY_SAMPLES, 1);
+    MemoryStream input(log);
+    CsvReplaySource source(input);
+    meter->setSource(&source);
+
+    uint32_t start = micros();
+    TEST_ASSERT_TRUE(meter->startTasks());
+    while (!meter->sourceFinished() || meter->getStats().consumed < TEST_REPLAY_SAMPLES) {
+        delay(1);
+    }
+    uint32_t elapsed = micros() - start;
+    meter->stopTasks();
+
+    IrradianceMeterStats stats = meter->getStats();
+    TEST_ASSERT_EQUAL(TEST_REPLAY_SAMPLES, stats.consumed);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+
+    // Parsing and aggregation alone, without the tasks
+    IrradianceMeter bare;
+    MemoryStream again(log);
+    CsvReplaySource manual(again);
+    bare.setSource(&manual);
+    uint32_t manualStart = micros();
+    while (!bare.sourceFinished()) {
+        bare.pump();
+        bare.process();
+    }
+    uint32_t manualElapsed = micros() - manualStart;
+
+    char report[160];
+    snprintf(report, sizeof(report),
+             "%u samples: %.0f samples/s through the tasks (peak %u of %u in the ring, 0 dropped), %.0f by hand",
+             (unsigned)TEST_REPLAY_SAMPLES, TEST_REPLAY_SAMPLES * 1e6 / elapsed, (unsigned)stats.peakDepth,
+             (unsigned)IRRADIANCE_RING_SIZE, TEST_REPLAY_SAMPLES * 1e6 / manualElapsed);
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runIrradianceMeterTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_running_stats_match_two_pass);
+    RUN_TEST(test_ring_drops_when_full);
+    RUN_TEST(test_replay_by_minute_and_hour);
+    RUN_TEST(test_day_rollover_and_late_samples);
+    RUN_TEST(test_paced_replay_past_micros_wrap);
+    RUN_TEST(test_adc_source_keeps_its_period);
+    RUN_TEST(test_replay_throughput);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runIrradianceMeterTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runIrradianceMeterTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
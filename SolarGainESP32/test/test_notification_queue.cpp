@@ -0,0 +1,332 @@
+#include <unity.h>
+#include <SPIFFS.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "NotificationQueue.h"
+
+// Mock WhatsApp endpoint: replays a script of HTTP results and, like Graph,
+// keeps every message it accepts; a resend is a second copy. The callback
+// keys only let the test count the copies.
+struct MockEndpoint {
+    std::vector<int> script;          // result per attempt; 200 once exhausted
+    size_t attempt = 0;
+    uint32_t lostAckEvery = 0;        // accept but report a timeout every N attempts
+    std::set<std::string> accepted;   // distinct callback keys
+    std::vector<std::string> order;   // texts in acceptance order, copies included
+    std::vector<uint32_t> sequences;  // sequence numbers in acceptance order
+    uint32_t duplicates = 0;          // copies of a message accepted before
+
+    NotificationResult handle(const Notification& n) {
+        attempt++;
+        int code = attempt <= script.size() ? script[attempt - 1] : 200;
+        bool lostAck = lostAckEvery && attempt % lostAckEvery == 0;
+
+        if (code == 200 || lostAck) {
+            if (!accepted.insert(n.callbackKey).second) duplicates++;
+            order.push_back(std::string(n.text, n.length));
+            sequences.push_back(n.sequence);
+        }
+        if (lostAck) code = -11; // read timeout after the server committed
+        return NotificationQueue::classifyHttpStatus(code);
+    }
+};
+
+NotificationQueue* queue;
+MockEndpoint* endpoint;
+
+void setUp(void) {
+    SPIFFS.begin(true);
+    SPIFFS.format();
+    endpoint = new MockEndpoint();
+    queue = new NotificationQueue();
+    queue->begin("test", true);
+    queue->setRetryPolicy({5, 80, 0});
+    queue->setSender([](const Notification& n) { return endpoint->handle(n); });
+}
+
+void tearDown(void) {
+    delete queue;
+    delete endpoint;
+}
+
+// Run the queue until it is empty, sleeping through backoff like the task does
+static void drain(NotificationQueue& q, uint32_t timeoutMs = 10000) {
+    uint32_t start = millis();
+    while (q.pending() > 0 && millis() - start < timeoutMs) {
+        uint32_t wait = q.process();
+        if (wait != NOTIFICATION_IDLE) delay(wait);
+    }
+}
+
+void test_delivers_in_order() {
+    TEST_ASSERT_TRUE(queue->enqueue("first"));
+    TEST_ASSERT_TRUE(queue->enqueue("second"));
+    TEST_ASSERT_TRUE(queue->enqueue([](Print& out) { out.print("third "); out.print(3); }));
+    drain(*queue);
+
+    TEST_ASSERT_EQUAL(3, endpoint->order.size());
+    TEST_ASSERT_EQUAL_STRING("first", endpoint->order[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("second", endpoint->order[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("third 3", endpoint->order[2].c_str());
+    TEST_ASSERT_EQUAL(3, queue->getStats().delivered);
+    TEST_ASSERT_EQUAL(0, queue->pending());
+}
+
+void test_retries_transient_failures() {
+    endpoint->script = {503, 429, -1, 200};
+    queue->enqueue("retry me");
+
+    uint32_t wait = queue->process();
+    // First backoff is jittered within [base/2, base]
+    TEST_ASSERT_GREATER_OR_EQUAL(2, wait);
+    TEST_ASSERT_LESS_OR_EQUAL(5, wait);
+
+    drain(*queue);
+    TEST_ASSERT_EQUAL(4, endpoint->attempt);
+    TEST_ASSERT_EQUAL(1, endpoint->accepted.size());
+    TEST_ASSERT_EQUAL(3, queue->getStats().retries);
+}
+
+void test_rejects_permanent_failures() {
+    endpoint->script = {400};
+    queue->enqueue("bad request");
+    queue->enqueue("good request");
+    drain(*queue);
+
+    NotificationStats stats = queue->getStats();
+    TEST_ASSERT_EQUAL(1, stats.rejected);
+    TEST_ASSERT_EQUAL(1, stats.delivered);
+    TEST_ASSERT_EQUAL_STRING("good request", endpoint->order[0].c_str());
+}
+
+void test_gives_up_after_max_attempts() {
+    queue->setRetryPolicy({1, 4, 3});
+    endpoint->script = {500, 500, 500, 500};
+    queue->enqueue("doomed");
+    drain(*queue);
+
+    TEST_ASSERT_EQUAL(3, endpoint->attempt);
+    TEST_ASSERT_EQUAL(1, queue->getStats().rejected);
+}
+
+void test_recovers_after_reboot() {
+    queue->enqueue("survives");
+    queue->enqueue("also survives");
+    endpoint->script = {503};
+    queue->process(); // persists both, first attempt fails
+
+    // Simulate a reset: a fresh queue over the same flash
+    delete queue;
+    queue = new NotificationQueue();
+    queue->begin("test", true);
+    queue->setRetryPolicy({5, 80, 0});
+    queue->setSender([](const Notification& n) { return endpoint->handle(n); });
+
+    TEST_ASSERT_EQUAL(2, queue->getStats().recovered);
+    drain(*queue);
+    TEST_ASSERT_EQUAL(2, endpoint->order.size());
+    TEST_ASSERT_EQUAL_STRING("survives", endpoint->order[0].c_str());
+
+    // New messages never reuse a sequence number, even with an empty outbox
+    queue->enqueue("after reboot");
+    drain(*queue);
+    TEST_ASSERT_EQUAL(3, endpoint->accepted.size());
+}
+
+void test_lost_ack_sends_a_copy() {
+    endpoint->lostAckEvery = 2;
+    for (int i = 0; i < 4; i++) {
+        queue->enqueue(String("message ") + String(i));
+    }
+    drain(*queue);
+
+    // Attempts 2, 4 and 6 were accepted but looked failed: each is resent under the same key
+    TEST_ASSERT_EQUAL(4, endpoint->accepted.size());
+    TEST_ASSERT_EQUAL(3, endpoint->duplicates);
+    TEST_ASSERT_EQUAL(7, endpoint->order.size());
+    TEST_ASSERT_EQUAL_STRING("message 1", endpoint->order[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("message 1", endpoint->order[2].c_str());
+    TEST_ASSERT_EQUAL(4, queue->getStats().delivered);
+}
+
+// Copy a record on flash under another sequence number (the header is
+// magic, sequence, length), to build a backlog bigger than the RAM slots
+static void cloneRecord(uint32_t from, uint32_t to) {
+    char path[32];
+    snprintf(path, sizeof(path), NOTIFICATION_OUTBOX_DIR "/%08lx.msg", (unsigned long)from);
+    File in = SPIFFS.open(path, FILE_READ);
+    TEST_ASSERT_TRUE((bool)in);
+    std::vector<uint8_t> bytes(in.size());
+    in.read(bytes.data(), bytes.size());
+    in.close();
+
+    memcpy(&bytes[4], &to, sizeof(to));
+    snprintf(path, sizeof(path), NOTIFICATION_OUTBOX_DIR "/%08lx.msg", (unsigned long)to);
+    File out = SPIFFS.open(path, FILE_WRITE);
+    out.write(bytes.data(), bytes.size());
+    out.close();
+}
+
+void test_backlog_keeps_order() {
+    // Two slots' worth on flash: persisted but never sent, then a reset
+    queue->setSender(NotificationSender());
+    for (int i = 0; i < NOTIFICATION_QUEUE_SLOTS; i++) {
+        queue->enqueue(String("backlog ") + i);
+    }
+    queue->process();
+    std::vector<uint32_t> persisted;
+    File dir = SPIFFS.open(NOTIFICATION_OUTBOX_DIR);
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        const char* name = strrchr(file.name(), '/');
+        persisted.push_back((uint32_t)strtoul(name ? name + 1 : file.name(), nullptr, 16));
+    }
+    TEST_ASSERT_EQUAL(NOTIFICATION_QUEUE_SLOTS, persisted.size());
+    for (uint32_t sequence : persisted) {
+        cloneRecord(sequence, sequence + NOTIFICATION_QUEUE_SLOTS);
+    }
+    delete queue;
+    queue = new NotificationQueue();
+    queue->begin("test", true);
+    queue->setRetryPolicy({5, 80, 0});
+    queue->setSender([](const Notification& n) { return endpoint->handle(n); });
+    TEST_ASSERT_EQUAL(NOTIFICATION_QUEUE_SLOTS, queue->pending());
+
+    // New messages queue up behind the backlog, not ahead of it
+    TEST_ASSERT_TRUE(queue->enqueue("after the backlog"));
+    TEST_ASSERT_TRUE(queue->enqueue([](Print& out) { out.print("rendered after it"); }));
+    TEST_ASSERT_EQUAL(NOTIFICATION_QUEUE_SLOTS, queue->pending());
+    drain(*queue);
+
+    TEST_ASSERT_EQUAL(NOTIFICATION_QUEUE_SLOTS * 2 + 2, endpoint->sequences.size());
+    TEST_ASSERT_EQUAL(0, endpoint->duplicates);
+    for (size_t i = 1; i < endpoint->sequences.size(); i++) {
+        TEST_ASSERT_GREATER_THAN(endpoint->sequences[i - 1], endpoint->sequences[i]);
+    }
+    TEST_ASSERT_EQUAL_STRING("rendered after it", endpoint->order.back().c_str());
+
+    // Once the backlog has drained, messages go through RAM again
+    queue->enqueue("through RAM");
+    queue->process();
+    TEST_ASSERT_EQUAL_STRING("through RAM", endpoint->order.back().c_str());
+}
+
+void test_task_delivers_while_producing() {
+    // Some attempts fail or lose their answer while the producer keeps going
+    endpoint->script = {503, 200, 200, 429, 200, -1};
+    endpoint->lostAckEvery = 7;
+    TEST_ASSERT_TRUE(queue->startTask());
+
+    const int messages = 24;
+    for (int i = 0; i < messages; i++) {
+        // A full queue refuses; the producer waits for the task to free a slot
+        uint32_t start = millis();
+        while (!queue->enqueue(String("task ") + String(i))) {
+            TEST_ASSERT_LESS_THAN(5000, millis() - start);
+            delay(1);
+        }
+    }
+    uint32_t start = millis();
+    while (queue->pending() > 0 && millis() - start < 5000) {
+        delay(1);
+    }
+    queue->stopTask();
+
+    NotificationStats stats = queue->getStats();
+    TEST_ASSERT_EQUAL(messages, stats.delivered);
+    TEST_ASSERT_EQUAL(messages, endpoint->accepted.size());
+    TEST_ASSERT_EQUAL(endpoint->order.size(), messages + endpoint->duplicates);
+    TEST_ASSERT_GREATER_THAN(0, endpoint->duplicates);
+
+    // In order; a copy only ever follows its original
+    for (size_t i = 1; i < endpoint->sequences.size(); i++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(endpoint->sequences[i - 1], endpoint->sequences[i]);
+    }
+    TEST_ASSERT_EQUAL_STRING("task 23", endpoint->order.back().c_str());
+}
+
+void test_overflow_is_refused() {
+    for (int i = 0; i < NOTIFICATION_QUEUE_SLOTS; i++) {
+        TEST_ASSERT_TRUE(queue->enqueue("fill"));
+    }
+    TEST_ASSERT_FALSE(queue->enqueue("one too many"));
+    TEST_ASSERT_EQUAL(1, queue->getStats().overflowed);
+
+    char tooLong[NOTIFICATION_MAX_PAYLOAD + 1];
+    memset(tooLong, 'x', sizeof(tooLong));
+    drain(*queue);
+    TEST_ASSERT_FALSE(queue->enqueue(tooLong, sizeof(tooLong)));
+}
+
+void test_delivery_latency_under_failures() {
+    // Roughly one attempt in three fails, in bursts, mixing throttling and outages
+    const int messages = 48;
+    for (int i = 0; i < messages * 2; i++) {
+        int r = (i * 7919) % 13;
+        endpoint->script.push_back(r < 2 ? 429 : r < 4 ? 503 : r < 5 ? -1 : 200);
+    }
+
+    uint32_t enqueueUs = 0;
+    int sent = 0;
+    while (sent < messages) {
+        // Producer bursts of up to half the queue, then let the sender catch up
+        for (int b = 0; b < NOTIFICATION_QUEUE_SLOTS / 2 && sent < messages; b++, sent++) {
+            uint32_t start = micros();
+            TEST_ASSERT_TRUE(queue->enqueue(String("forecast ") + sent));
+            enqueueUs += micros() - start;
+        }
+        drain(*queue);
+    }
+
+    NotificationStats stats = queue->getStats();
+    TEST_ASSERT_EQUAL(messages, stats.delivered);
+    TEST_ASSERT_EQUAL(messages, endpoint->accepted.size());
+    TEST_ASSERT_LESS_OR_EQUAL(stats.latencyP90Ms, stats.latencyP50Ms);
+    TEST_ASSERT_LESS_OR_EQUAL(stats.latencyP99Ms, stats.latencyP90Ms);
+
+    char report[160];
+    snprintf(report, sizeof(report),
+             "enqueue avg %lu us; latency p50 %lu ms, p90 %lu ms, p99 %lu ms; %lu retries",
+             (unsigned long)(enqueueUs / messages), (unsigned long)stats.latencyP50Ms,
+             (unsigned long)stats.latencyP90Ms, (unsigned long)stats.latencyP99Ms,
+             (unsigned long)stats.retries);
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runNotificationQueueTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_delivers_in_order);
+    RUN_TEST(test_retries_transient_failures);
+    RUN_TEST(test_rejects_permanent_failures);
+    RUN_TEST(test_gives_up_after_max_attempts);
+    RUN_TEST(test_recovers_after_reboot);
+    RUN_TEST(test_lost_ack_sends_a_copy);
+    RUN_TEST(test_backlog_keeps_order);
+    RUN_TEST(test_task_delivers_while_producing);
+    RUN_TEST(test_overflow_is_refused);
+    RUN_TEST(test_delivery_latency_under_failures);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runNotificationQueueTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runNotificationQueueTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
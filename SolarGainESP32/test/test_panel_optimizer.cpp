@@ -0,0 +1,217 @@
+#include <unity.h>
+#include "PanelOptimizer.h"
+#include "SolarCalc.h"
+#include "EpochTime.h"
+
+// Harare, on the Harare clock
+const float TEST_LATITUDE = -17.7831;
+const float TEST_LONGITUDE = 31.0909;
+const float TEST_ELEVATION = 1490;
+const int TEST_YEAR = 2025;
+
+TimeZone harare;
+PanelOptimizer* optimizer;
+
+// Degrees east (+) or west (-) of north, for a panel in the south
+static float fromNorth(float azimuth) {
+    return azimuth > 180 ? azimuth - 360 : azimuth;
+}
+
+static RoofPlane plane(float share, float tiltMin, float tiltMax, float azimuthMin, float azimuthMax, int mirrorOf) {
+    RoofPlane roof = {share, tiltMin, tiltMax, azimuthMin, azimuthMax, mirrorOf};
+    return roof;
+}
+
+void setUp(void) {
+    harare.begin("CAT-2");
+    optimizer = new PanelOptimizer();
+}
+
+void tearDown(void) {
+    delete optimizer;
+}
+
+void test_yield_matches_solar_calc() {
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+
+    // The same sampled days through SolarCalc's own forecast
+    static const float panels[][2] = {{0, 180}, {20, 0}, {35, 45}, {60, 270}, {90, 180}};
+    SolarCalc solar(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, 0, 0);
+    solar.setTimeZone(&harare);
+    int days = EpochTime::daysInYear(TEST_YEAR);
+    int64_t firstDay = EpochTime::daysFromCivil(TEST_YEAR, 1, 1);
+    for (const auto& panel : panels) {
+        solar.setPanel(panel[0], panel[1]);
+        float expected = 0;
+        for (int offset = 0; offset < days; offset += OPTIMIZER_DAY_STEP) {
+            int year, month, day;
+            EpochTime::civilFromDays(firstDay + offset, year, month, day);
+            int span = offset + OPTIMIZER_DAY_STEP <= days ? OPTIMIZER_DAY_STEP : days - offset;
+            expected += span * solar.calculateDailyForecast(year, month, day).totalIrradiance;
+        }
+        TEST_ASSERT_FLOAT_WITHIN(expected * 0.001f, expected, optimizer->yield(panel[0], panel[1]));
+    }
+}
+
+void test_optimum_beats_every_grid_point() {
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+    OptimizerResult best = optimizer->optimize();
+    TEST_ASSERT_EQUAL(1, best.planes.size());
+
+    // Facing north at about the latitude
+    TEST_ASSERT_FLOAT_WITHIN(5, 0, fromNorth(best.planes[0].azimuth));
+    TEST_ASSERT_FLOAT_WITHIN(8, 17, best.planes[0].tilt);
+
+    for (float tilt = 0; tilt <= 90; tilt += 2) {
+        for (float azimuth = 0; azimuth < 360; azimuth += 4) {
+            TEST_ASSERT_TRUE(optimizer->yield(tilt, azimuth) <= best.yield * 1.0001f);
+        }
+    }
+}
+
+void test_horizon_and_time_of_use_shift_the_optimum() {
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+    OptimizerResult annual = optimizer->optimize();
+
+    // A ridge to the east, 25 degrees high from 30 to 150: turn west
+    HorizonMask ridge;
+    for (int sector = 0; sector < HORIZON_SECTORS; sector++) {
+        ridge.elevation[sector] = sector >= 3 && sector <= 15 ? 25 : 0;
+    }
+    optimizer->setHorizon(&ridge);
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+    OptimizerResult masked = optimizer->optimize();
+    TEST_ASSERT_TRUE(masked.yield < annual.yield);
+    TEST_ASSERT_TRUE(fromNorth(masked.planes[0].azimuth) < fromNorth(annual.planes[0].azimuth) - 5);
+
+    // Evening peak tariff: also west
+    optimizer->setHorizon(nullptr);
+    YieldWeights tariff = PanelOptimizer::flatWeights();
+    for (int hour = 15; hour < 20; hour++) tariff.hour[hour] = 3;
+    optimizer->setWeights(tariff);
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+    OptimizerResult evening = optimizer->optimize();
+    TEST_ASSERT_TRUE(fromNorth(evening.planes[0].azimuth) < fromNorth(annual.planes[0].azimuth) - 5);
+
+    // Winter only: steeper
+    YieldWeights winter = PanelOptimizer::flatWeights();
+    for (int month = 0; month < 12; month++) winter.month[month] = month >= 4 && month <= 7 ? 1 : 0;
+    optimizer->setWeights(winter);
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+    OptimizerResult season = optimizer->optimize();
+    TEST_ASSERT_TRUE(season.planes[0].tilt > annual.planes[0].tilt + 10);
+}
+
+void test_roof_planes() {
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+
+    // East-west gable: the ridge fixes the azimuths, the tilt is shared
+    std::vector<RoofPlane> gable;
+    gable.push_back(plane(0.5f, 0, 60, 90, 90, -1));
+    gable.push_back(plane(0.5f, 0, 0, 0, 0, 0));
+    OptimizerResult roof = optimizer->optimize(gable);
+    TEST_ASSERT_EQUAL(2, roof.planes.size());
+    TEST_ASSERT_EQUAL_FLOAT(90, roof.planes[0].azimuth);
+    TEST_ASSERT_EQUAL_FLOAT(270, roof.planes[1].azimuth);
+    TEST_ASSERT_EQUAL_FLOAT(roof.planes[0].tilt, roof.planes[1].tilt);
+    TEST_ASSERT_TRUE(roof.planes[0].tilt < 15);
+    TEST_ASSERT_EQUAL_FLOAT(roof.yield, optimizer->yield(roof.planes, gable));
+
+    // A range short of north settles on its nearest edge; one through north finds it
+    std::vector<RoofPlane> east;
+    east.push_back(plane(1, 10, 40, 30, 120, -1));
+    OptimizerResult bounded = optimizer->optimize(east);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 30, bounded.planes[0].azimuth);
+
+    std::vector<RoofPlane> wrapped;
+    wrapped.push_back(plane(1, 0, 90, 300, 20, -1));
+    OptimizerResult north = optimizer->optimize(wrapped);
+    TEST_ASSERT_FLOAT_WITHIN(5, 0, fromNorth(north.planes[0].azimuth));
+
+    // A mirror of a later plane, or of a mirror, is refused
+    std::vector<RoofPlane> invalid;
+    invalid.push_back(plane(0.5f, 0, 60, 0, 360, 1));
+    invalid.push_back(plane(0.5f, 0, 60, 0, 360, -1));
+    TEST_ASSERT_EQUAL(0, optimizer->optimize(invalid).planes.size());
+}
+
+void test_inverter_limit_is_shared() {
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+    OptimizerResult single = optimizer->optimize();
+
+    // Two free halves behind an inverter sized for 60% of the clear-sky peak
+    std::vector<RoofPlane> halves;
+    halves.push_back(plane(0.5f, 0, 90, 0, 360, -1));
+    halves.push_back(plane(0.5f, 0, 90, 0, 360, -1));
+    optimizer->setInverterLimit(600);
+    std::vector<PlaneAngles> together(2, single.planes[0]);
+    float clipped = optimizer->yield(together, halves);
+    TEST_ASSERT_TRUE(clipped < single.yield);
+
+    // No east-west split the search missed
+    OptimizerResult split = optimizer->optimize(halves);
+    TEST_ASSERT_TRUE(split.yield >= clipped);
+    for (float spread = 10; spread <= 90; spread += 10) {
+        for (float tilt = 10; tilt <= 40; tilt += 5) {
+            std::vector<PlaneAngles> spreadAngles = {{tilt, spread}, {tilt, 360 - spread}};
+            TEST_ASSERT_TRUE(optimizer->yield(spreadAngles, halves) <= split.yield * 1.0001f);
+        }
+    }
+
+    char report[128];
+    snprintf(report, sizeof(report), "Limit 600 W/m2: %.1f kWh/m2 at %.0f/%.0f and %.0f/%.0f, %.1f without it",
+             split.yield, split.planes[0].tilt, split.planes[0].azimuth, split.planes[1].tilt,
+             split.planes[1].azimuth, single.yield);
+    TEST_MESSAGE(report);
+}
+
+void test_search_time() {
+    unsigned long start = micros();
+    optimizer->load(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_YEAR, &harare);
+    unsigned long loaded = micros();
+    OptimizerResult best = optimizer->optimize();
+    unsigned long searched = micros();
+
+    char report[128];
+    snprintf(report, sizeof(report), "%u sun hours in %lu ms, %u yields searched in %lu ms",
+             (unsigned)optimizer->getSampleCount(), (loaded - start) / 1000, (unsigned)best.evaluations,
+             (searched - loaded) / 1000);
+    TEST_MESSAGE(report);
+#ifdef HOST_BUILD
+    TEST_ASSERT_TRUE(searched - start < 1000000UL);
+#endif
+}
+
+// Main test runner
+void runPanelOptimizerTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_yield_matches_solar_calc);
+    RUN_TEST(test_optimum_beats_every_grid_point);
+    RUN_TEST(test_horizon_and_time_of_use_shift_the_optimum);
+    RUN_TEST(test_roof_planes);
+    RUN_TEST(test_inverter_limit_is_shared);
+    RUN_TEST(test_search_time);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runPanelOptimizerTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runPanelOptimizerTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
@@ -0,0 +1,318 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "Scheduler.h"
+#include "SolarCalc.h"
+
+// 2024-06-21 00:00:00 UTC; Harare is UTC+2
+static const time_t JUNE_21 = 1718928000;
+static const int32_t HARARE_OFFSET = 2 * 3600;
+static const time_t HOUR = 3600;
+static const time_t DAY = 86400;
+
+Scheduler* scheduler;
+std::vector<std::string> runs;
+
+static JobAction record() {
+    return [](const JobRun& run) {
+        char line[64];
+        snprintf(line, sizeof(line), "%s@%ld+%u", run.name, (long)(run.scheduledAt - JUNE_21),
+                 (unsigned)run.coalesced);
+        runs.push_back(line);
+    };
+}
+
+void setUp(void) {
+    runs.clear();
+    scheduler = new Scheduler();
+    TEST_ASSERT_TRUE(scheduler->begin("test_sched"));
+    scheduler->clearHistory();
+    scheduler->setUtcOffset(HARARE_OFFSET);
+}
+
+void tearDown(void) {
+    delete scheduler;
+}
+
+void test_daily_job_fires_at_exact_instant() {
+    int8_t id = scheduler->addDaily("notify", 7, 0, record());
+    scheduler->start(JUNE_21 + 4 * HOUR + 50 * 60);   // 06:50 local
+
+    // 07:00 local is 05:00 UTC
+    TEST_ASSERT_EQUAL(JUNE_21 + 5 * HOUR, scheduler->nextFireTime());
+    TEST_ASSERT_EQUAL(600, scheduler->secondsUntilNext(JUNE_21 + 4 * HOUR + 50 * 60));
+    TEST_ASSERT_EQUAL(id, scheduler->nextJob());
+
+    TEST_ASSERT_EQUAL(0, scheduler->runDue(JUNE_21 + 5 * HOUR - 1));
+    TEST_ASSERT_EQUAL(1, scheduler->runDue(JUNE_21 + 5 * HOUR));
+    TEST_ASSERT_EQUAL(0, scheduler->runDue(JUNE_21 + 5 * HOUR + 30));
+    TEST_ASSERT_EQUAL(JUNE_21 + DAY + 5 * HOUR, scheduler->nextFireTime());
+    TEST_ASSERT_EQUAL_STRING("notify@18000+0", runs[0].c_str());
+}
+
+void test_interval_job_aligned_to_local_midnight() {
+    scheduler->addInterval("display", HOUR, record());
+    scheduler->start(JUNE_21 + 7 * 60);
+
+    // On the local hour; the offset is whole hours, so also on the UTC hour
+    TEST_ASSERT_EQUAL(JUNE_21 + HOUR, scheduler->nextFireTime());
+
+    // Half-hour zones shift the grid with the offset
+    scheduler->setUtcOffset(5 * HOUR + 30 * 60);
+    TEST_ASSERT_EQUAL(JUNE_21 + 30 * 60, scheduler->nextFireTime());
+}
+
+void test_daily_job_keeps_wall_clock_across_dst() {
+    TimeZone berlin;
+    TEST_ASSERT_TRUE(berlin.begin("CET-1CEST,M3.5.0,M10.5.0/3", 2024));
+    scheduler->setTimeZone(berlin);
+    scheduler->addDaily("notify", 7, 0, record());
+
+    // 07:00 CET is 06:00 UTC; after the change on 2024-03-31, 07:00 CEST is 05:00 UTC
+    time_t saturday = EpochTime::fromCivil(2024, 3, 30);
+    scheduler->start(saturday);
+    TEST_ASSERT_EQUAL(saturday + 6 * HOUR, scheduler->nextFireTime());
+    scheduler->runDue(saturday + 6 * HOUR);
+    TEST_ASSERT_EQUAL(saturday + DAY + 5 * HOUR, scheduler->nextFireTime());
+
+    // 02:30 on the day of the change never happens; it runs at 03:30 CEST
+    scheduler->addDaily("meter", 2, 30, record());
+    TEST_ASSERT_EQUAL(saturday + DAY + HOUR + 30 * 60, scheduler->getNextFire(1));
+}
+
+void test_same_instant_runs_in_registration_order() {
+    scheduler->addDaily("reforecast", 0, 0, record());
+    scheduler->addInterval("display", HOUR, record());
+    scheduler->addOnce("ntp", JUNE_21 - HARARE_OFFSET + DAY, record());
+    scheduler->start(JUNE_21 - HARARE_OFFSET + DAY - 60);
+
+    // Local midnight on the 22nd
+    TEST_ASSERT_EQUAL(3, scheduler->runDue(JUNE_21 - HARARE_OFFSET + DAY));
+    TEST_ASSERT_EQUAL(3, runs.size());
+    TEST_ASSERT_EQUAL_STRING("reforecast@79200+0", runs[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("display@79200+0", runs[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("ntp@79200+0", runs[2].c_str());
+}
+
+void test_heap_orders_many_jobs() {
+    // Pseudo-random instants, popped in order as each job removes itself
+    uint32_t seed = 12345;
+    for (int i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+        seed = seed * 1103515245 + 12345;
+        char name[8];
+        snprintf(name, sizeof(name), "j%d", i);
+        scheduler->addOnce(name, JUNE_21 + (seed >> 16) % 10000, record());
+    }
+    TEST_ASSERT_EQUAL(-1, scheduler->addOnce("extra", JUNE_21, record()));
+    scheduler->start(JUNE_21);
+
+    time_t previous = 0;
+    while (scheduler->nextFireTime() != SCHEDULER_NEVER) {
+        time_t next = scheduler->nextFireTime();
+        TEST_ASSERT_TRUE(next >= previous);
+        scheduler->runDue(next);
+        previous = next;
+    }
+    TEST_ASSERT_EQUAL(SCHEDULER_MAX_JOBS, runs.size());
+}
+
+void test_catch_up_after_reboot() {
+    CatchUpPolicy notifyPolicy = {3 * HOUR, true, true};
+    scheduler->addDaily("notify", 7, 0, record(), notifyPolicy);
+    scheduler->addDaily("reforecast", 0, 0, record());
+    scheduler->addInterval("display", 15 * 60, record());
+    scheduler->start(JUNE_21);
+    scheduler->runDue(JUNE_21 + 6 * HOUR);
+    scheduler->runDue(JUNE_21 + 23 * HOUR);
+    TEST_ASSERT_EQUAL(1, scheduler->getStats(0).runs);
+    TEST_ASSERT_EQUAL(1, scheduler->getStats(1).runs);
+
+    // Powered off until 08:30 local two days later
+    delete scheduler;
+    runs.clear();
+    scheduler = new Scheduler();
+    scheduler->begin("test_sched");
+    scheduler->setUtcOffset(HARARE_OFFSET);
+    scheduler->addDaily("notify", 7, 0, record(), notifyPolicy);
+    scheduler->addDaily("reforecast", 0, 0, record());
+    scheduler->addInterval("display", 15 * 60, record());
+    time_t boot = JUNE_21 + 2 * DAY + 6 * HOUR + 30 * 60;
+    scheduler->start(boot);
+    TEST_ASSERT_EQUAL(0, scheduler->secondsUntilNext(boot));
+
+    // Missed occurrences fold into one run for the latest, and runs follow
+    // those instants; the display job is not persisted and starts from now
+    TEST_ASSERT_EQUAL(3, scheduler->runDue(boot));
+    TEST_ASSERT_EQUAL_STRING("reforecast@165600+0", runs[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("notify@190800+1", runs[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("display@196200+0", runs[2].c_str());
+    TEST_ASSERT_EQUAL(boot + 15 * 60, scheduler->nextFireTime());
+
+    // Off again until 11:00 local the next day: past the notification's grace
+    delete scheduler;
+    runs.clear();
+    scheduler = new Scheduler();
+    scheduler->begin("test_sched");
+    scheduler->setUtcOffset(HARARE_OFFSET);
+    int8_t notify = scheduler->addDaily("notify", 7, 0, record(), notifyPolicy);
+    boot = JUNE_21 + 3 * DAY + 9 * HOUR;
+    scheduler->start(boot);
+    scheduler->runDue(boot);
+    TEST_ASSERT_EQUAL(0, runs.size());
+    TEST_ASSERT_EQUAL(1, scheduler->getStats(notify).skipped);
+    TEST_ASSERT_EQUAL(JUNE_21 + 4 * DAY + 5 * HOUR, scheduler->getNextFire(notify));
+}
+
+void test_catch_up_every_occurrence() {
+    scheduler->addInterval("meter", HOUR, record(), {0, false, true});
+    scheduler->start(JUNE_21);
+    scheduler->runDue(JUNE_21 + HOUR);
+
+    delete scheduler;
+    runs.clear();
+    scheduler = new Scheduler();
+    scheduler->begin("test_sched");
+    scheduler->setUtcOffset(HARARE_OFFSET);
+    scheduler->addInterval("meter", HOUR, record(), {0, false, true});
+    scheduler->start(JUNE_21 + 5 * HOUR + 20 * 60);
+
+    // Hours 2..5, each run on its own, in order
+    TEST_ASSERT_EQUAL(4, scheduler->runDue(JUNE_21 + 5 * HOUR + 20 * 60));
+    TEST_ASSERT_EQUAL_STRING("meter@7200+0", runs[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("meter@18000+0", runs[3].c_str());
+    TEST_ASSERT_EQUAL(JUNE_21 + 6 * HOUR, scheduler->nextFireTime());
+}
+
+void test_solar_relative_jobs() {
+    SolarCalc solar(-17.8292f, 31.0522f, 1490.0f, 20.0f, 0.0f);
+    scheduler->setSolarSource([&solar](int year, int month, int day, SolarEvent event) {
+        return event == SOLAR_SUNRISE ? solar.getSunriseAt(year, month, day)
+                                      : solar.getSunsetAt(year, month, day);
+    });
+    int8_t wake = scheduler->addSolar("wake", SOLAR_SUNRISE, -15 * 60, record());
+    int8_t dim = scheduler->addSolar("dim", SOLAR_SUNSET, 30 * 60, record());
+    scheduler->start(JUNE_21);
+
+    time_t sunrise = solar.getSunriseAt(2024, 6, 21);
+    time_t sunset = solar.getSunsetAt(2024, 6, 21);
+    TEST_ASSERT_EQUAL(sunrise - 15 * 60, scheduler->getNextFire(wake));
+    TEST_ASSERT_EQUAL(sunset + 30 * 60, scheduler->getNextFire(dim));
+
+    // After it fires, the next one follows tomorrow's sunrise
+    scheduler->runDue(sunrise);
+    time_t tomorrow = solar.getSunriseAt(2024, 6, 22);
+    TEST_ASSERT_EQUAL(tomorrow - 15 * 60, scheduler->getNextFire(wake));
+}
+
+void test_solar_job_through_polar_night() {
+    // No sunrise until the 25th
+    scheduler->setSolarSource([](int year, int month, int day, SolarEvent) {
+        return (month == 6 && day < 25) ? SCHEDULER_NEVER : EpochTime::fromCivil(year, month, day, 9, 30);
+    });
+    int8_t wake = scheduler->addSolar("wake", SOLAR_SUNRISE, 0, record());
+    scheduler->start(JUNE_21);
+    TEST_ASSERT_EQUAL(JUNE_21 + 4 * DAY + 9 * HOUR + 30 * 60, scheduler->getNextFire(wake));
+}
+
+void test_rescheduled_once_job() {
+    // NTP resync re-arms itself from the clock's own interval
+    int8_t ntp = -1;
+    ntp = scheduler->addOnce("ntp", JUNE_21 + HOUR, [&ntp](const JobRun& run) {
+        runs.push_back("ntp");
+        scheduler->reschedule(ntp, run.firedAt + 4 * HOUR);
+    });
+    scheduler->start(JUNE_21);
+
+    scheduler->runDue(JUNE_21 + HOUR + 5);
+    TEST_ASSERT_EQUAL(JUNE_21 + 5 * HOUR + 5, scheduler->getNextFire(ntp));
+
+    TEST_ASSERT_TRUE(scheduler->setEnabled(ntp, false));
+    TEST_ASSERT_EQUAL(SCHEDULER_NEVER, scheduler->nextFireTime());
+    TEST_ASSERT_TRUE(scheduler->setEnabled(ntp, true));
+    TEST_ASSERT_EQUAL(JUNE_21 + 5 * HOUR + 5, scheduler->nextFireTime());
+}
+
+void test_sleep_until_next_event() {
+    SolarCalc solar(-17.8292f, 31.0522f, 1490.0f, 20.0f, 0.0f);
+    scheduler->setSolarSource([&solar](int year, int month, int day, SolarEvent event) {
+        return event == SOLAR_SUNRISE ? solar.getSunriseAt(year, month, day)
+                                      : solar.getSunsetAt(year, month, day);
+    });
+    int8_t notify = scheduler->addDaily("notify", 7, 0, nullptr);
+    int8_t reforecast = scheduler->addDaily("reforecast", 0, 0, nullptr);
+    int8_t display = scheduler->addInterval("display", 15 * 60, nullptr);
+    int8_t wake = scheduler->addSolar("wake", SOLAR_SUNRISE, -15 * 60, nullptr);
+    int8_t dim = scheduler->addSolar("dim", SOLAR_SUNSET, 0, nullptr);
+    int8_t ntp = scheduler->addOnce("ntp", JUNE_21 + HOUR, [&ntp](const JobRun& run) {
+        scheduler->reschedule(ntp, run.firedAt + 6 * HOUR);
+    });
+
+    // A week of waking only for the next event
+    time_t now = JUNE_21 - HARARE_OFFSET;
+    time_t end = now + 7 * DAY;
+    scheduler->start(now);
+    uint32_t wakeups = 0;
+    uint32_t start = micros();
+    while (true) {
+        scheduler->runDue(now);
+        time_t next = scheduler->nextFireTime();
+        if (next >= end) break;
+        now = next;
+        wakeups++;
+    }
+    uint32_t elapsed = micros() - start;
+
+    TEST_ASSERT_EQUAL(7, scheduler->getStats(notify).runs);
+    TEST_ASSERT_EQUAL(7, scheduler->getStats(reforecast).runs);
+    TEST_ASSERT_EQUAL(7 * 24 * 4, scheduler->getStats(display).runs);
+    TEST_ASSERT_EQUAL(7, scheduler->getStats(wake).runs);
+    TEST_ASSERT_EQUAL(7, scheduler->getStats(dim).runs);
+    TEST_ASSERT_EQUAL(28, scheduler->getStats(ntp).runs);
+    // Jobs sharing an instant share a wake-up
+    TEST_ASSERT_LESS_THAN(7 * 24 * 4 + 7 * 2 + 28, wakeups);
+
+    char report[160];
+    snprintf(report, sizeof(report),
+             "7 days, 6 jobs: %lu wake-ups instead of %d minute polls, %.2f us per wake-up",
+             (unsigned long)wakeups, 7 * 1440, (double)elapsed / max(wakeups, (uint32_t)1));
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runSchedulerTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_daily_job_fires_at_exact_instant);
+    RUN_TEST(test_interval_job_aligned_to_local_midnight);
+    RUN_TEST(test_daily_job_keeps_wall_clock_across_dst);
+    RUN_TEST(test_same_instant_runs_in_registration_order);
+    RUN_TEST(test_heap_orders_many_jobs);
+    RUN_TEST(test_catch_up_after_reboot);
+    RUN_TEST(test_catch_up_every_occurrence);
+    RUN_TEST(test_solar_relative_jobs);
+    RUN_TEST(test_solar_job_through_polar_night);
+    RUN_TEST(test_rescheduled_once_job);
+    RUN_TEST(test_sleep_until_next_event);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runSchedulerTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runSchedulerTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
@@ -0,0 +1,189 @@
+#include <unity.h>
+#include "SleepPlanner.h"
+#include "SolarCalc.h"
+
+// 2024-06-21 00:00:00 UTC; Harare is UTC+2
+static const time_t JUNE_21 = 1718928000;
+static const int32_t HARARE_OFFSET = 2 * 3600;
+static const time_t HOUR = 3600;
+static const time_t DAY = 86400;
+
+SolarCalc solar(-17.8292f, 31.0522f, 1490.0f, 20.0f, 0.0f);
+SleepPlanner* planner;
+time_t sunrise;
+time_t sunset;
+
+static SleepConfig defaultConfig() {
+    SleepConfig config = {30, 10, 45, 12, 80, 240};
+    return config;
+}
+
+static time_t solarEvent(int year, int month, int day, SolarEvent event) {
+    return event == SOLAR_SUNRISE ? solar.getSunriseAt(year, month, day) : solar.getSunsetAt(year, month, day);
+}
+
+void setUp(void) {
+    planner = new SleepPlanner();
+    planner->setConfig(defaultConfig());
+    planner->setSolarSource(solarEvent);
+    sunrise = solar.getSunriseAt(2024, 6, 21);
+    sunset = solar.getSunsetAt(2024, 6, 21);
+}
+
+void tearDown(void) {
+    delete planner;
+}
+
+void test_night_is_one_sleep() {
+    // An hour after sunset: sleep straight through to the morning twilight window
+    time_t now = sunset + HOUR;
+    time_t morning = solar.getSunriseAt(2024, 6, 22);
+    SleepPlan plan = planner->plan(now, SCHEDULER_NEVER);
+
+    TEST_ASSERT_EQUAL(PHASE_NIGHT, plan.phase);
+    TEST_ASSERT_EQUAL(WAKE_PHASE, plan.reason);
+    TEST_ASSERT_EQUAL(morning - 45 * 60, plan.wakeAt);
+    TEST_ASSERT_EQUAL((uint32_t)(plan.wakeAt - now), plan.sleepS);
+    TEST_ASSERT_GREATER_THAN(11 * HOUR, plan.sleepS);
+}
+
+void test_cadence_tightens_around_sunrise() {
+    SleepPlan plan = planner->plan(sunrise - 20 * 60, SCHEDULER_NEVER);
+    TEST_ASSERT_EQUAL(PHASE_TWILIGHT, plan.phase);
+    TEST_ASSERT_EQUAL(WAKE_CADENCE, plan.reason);
+    TEST_ASSERT_TRUE(plan.wakeAt - (sunrise - 20 * 60) <= 10 * 60);
+    TEST_ASSERT_EQUAL(0, plan.wakeAt % (10 * 60));
+
+    // Midday uses the configured duration
+    plan = planner->plan(JUNE_21 + 10 * HOUR + 60, SCHEDULER_NEVER);
+    TEST_ASSERT_EQUAL(PHASE_DAY, plan.phase);
+    TEST_ASSERT_EQUAL(JUNE_21 + 10 * HOUR + 30 * 60, plan.wakeAt);
+
+    // The last daytime sleep stops where the evening window opens
+    time_t late = sunset - 45 * 60 - 5 * 60;
+    plan = planner->plan(late, SCHEDULER_NEVER);
+    TEST_ASSERT_TRUE(plan.wakeAt <= sunset - 45 * 60);
+}
+
+void test_scheduled_job_cuts_sleep_short() {
+    // A job at 02:00 local; the timer is short by the RTC guard
+    time_t job = JUNE_21 + 2 * HOUR - HARARE_OFFSET + DAY;
+    time_t now = sunset + 2 * HOUR;
+    SleepPlan plan = planner->plan(now, job);
+    TEST_ASSERT_EQUAL(WAKE_JOB, plan.reason);
+    TEST_ASSERT_EQUAL(job, plan.wakeAt);
+    uint32_t span = (uint32_t)(job - now);
+    TEST_ASSERT_EQUAL(span - span / 50, plan.sleepS);
+
+    // Woken early, the rest is a short corrective sleep
+    plan = planner->plan(now + plan.sleepS, job);
+    TEST_ASSERT_EQUAL(job, plan.wakeAt);
+    TEST_ASSERT_UINT32_WITHIN(span / 50, span / 50, plan.sleepS);
+}
+
+void test_short_and_long_limits() {
+    // Too short to be worth a deep sleep
+    SleepPlan plan = planner->plan(JUNE_21 + 10 * HOUR + 30 * 60 - 10, SCHEDULER_NEVER);
+    TEST_ASSERT_EQUAL(0, plan.sleepS);
+    TEST_ASSERT_EQUAL(JUNE_21 + 10 * HOUR + 30 * 60, plan.wakeAt);
+
+    // maxSleepHours caps the night
+    SleepConfig config = defaultConfig();
+    config.maxSleepHours = 4;
+    planner->setConfig(config);
+    plan = planner->plan(sunset + HOUR, SCHEDULER_NEVER);
+    TEST_ASSERT_EQUAL(WAKE_LIMIT, plan.reason);
+    TEST_ASSERT_EQUAL(4 * HOUR, plan.sleepS);
+}
+
+void test_polar_day_keeps_cadence() {
+    planner->setSolarSource([](int, int, int, SolarEvent) { return SCHEDULER_NEVER; });
+    SleepPlan plan = planner->plan(JUNE_21 + 60, SCHEDULER_NEVER);
+    TEST_ASSERT_EQUAL(PHASE_DAY, plan.phase);
+    TEST_ASSERT_EQUAL(JUNE_21 + 30 * 60, plan.wakeAt);
+}
+
+void test_cpu_frequency_scaling() {
+    planner->enterIdle();
+    TEST_ASSERT_EQUAL(80, getCpuFrequencyMhz());
+    planner->enterActive();
+    TEST_ASSERT_EQUAL(240, getCpuFrequencyMhz());
+
+    // Rounded down to a frequency the chip supports
+    SleepConfig config = defaultConfig();
+    config.idleCpuMhz = 100;
+    planner->setConfig(config);
+    planner->enterIdle();
+    TEST_ASSERT_EQUAL(80, getCpuFrequencyMhz());
+    planner->enterActive();
+}
+
+static void compareDay(const char* label, time_t day) {
+    EnergyModel model = SleepPlanner::defaultModel();
+
+    // Daily notification, midnight re-forecast and a 6-hourly NTP resync
+    Scheduler scheduler;
+    scheduler.setUtcOffset(HARARE_OFFSET);
+    scheduler.addDaily("notify", 7, 0, nullptr);
+    scheduler.addDaily("reforecast", 0, 0, nullptr);
+    scheduler.addInterval("ntp", 6 * HOUR, nullptr);
+    scheduler.start(day - HARARE_OFFSET);
+
+    EnergyReport planned = planner->simulate(day - HARARE_OFFSET, day - HARARE_OFFSET + DAY, &scheduler, model);
+    EnergyReport fixed = SleepPlanner::simulateFixed(day - HARARE_OFFSET, day - HARARE_OFFSET + DAY, 30 * 60, model);
+
+    // More wakes around sunrise and sunset, none through the night
+    TEST_ASSERT_TRUE(planned.mAh < fixed.mAh);
+    TEST_ASSERT_GREATER_THAN(4 * HOUR, planned.longestSleepS);
+    TEST_ASSERT_EQUAL(2, scheduler.getStats(0).runs + scheduler.getStats(1).runs);
+    TEST_ASSERT_EQUAL(4, scheduler.getStats(2).runs);
+
+    char report[200];
+    snprintf(report, sizeof(report),
+             "%s: planned %lu wakes (%lu idle), longest sleep %.1f h, %.2f mAh/day; "
+             "fixed 30 min %lu wakes, %.2f mAh/day; %.1fx battery life",
+             label, (unsigned long)planned.wakes, (unsigned long)planned.idleWakes,
+             planned.longestSleepS / 3600.0f, planned.mAh, (unsigned long)fixed.wakes, fixed.mAh,
+             fixed.mAh / planned.mAh);
+    TEST_MESSAGE(report);
+}
+
+void test_energy_against_fixed_interval() {
+    compareDay("June 21", JUNE_21);
+    compareDay("December 21", JUNE_21 + 183 * DAY);
+}
+
+// Main test runner
+void runSleepPlannerTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_night_is_one_sleep);
+    RUN_TEST(test_cadence_tightens_around_sunrise);
+    RUN_TEST(test_scheduled_job_cuts_sleep_short);
+    RUN_TEST(test_short_and_long_limits);
+    RUN_TEST(test_polar_day_keeps_cadence);
+    RUN_TEST(test_cpu_frequency_scaling);
+    RUN_TEST(test_energy_against_fixed_interval);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runSleepPlannerTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runSleepPlannerTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
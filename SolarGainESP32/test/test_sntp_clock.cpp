@@ -0,0 +1,348 @@
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "SntpClock.h"
+#include <esp_timer.h>
+
+#ifdef HOST_BUILD
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#else
+#include <lwip/sockets.h>
+#endif
+
+// 2024-06-21 00:00:00 UTC
+static const int64_t SOLSTICE_US = 1718928000LL * 1000000;
+
+// Local SNTP server whose clock is esp_timer_get_time() + SOLSTICE_US
+struct TestNtpServer {
+    int fd = -1;
+    uint16_t port = 0;
+    std::atomic<bool> running{false};
+    std::atomic<bool> silent{false};       // drop every request
+    std::atomic<bool> kissOfDeath{false};  // answer with stratum 0
+    std::atomic<int> requests{0};
+    std::thread thread;
+
+    bool begin() {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            getsockname(fd, (struct sockaddr*)&addr, &length) < 0) {
+            return false;
+        }
+        port = ntohs(addr.sin_port);
+        running = true;
+        thread = std::thread([this]() { serve(); });
+        return true;
+    }
+
+    ~TestNtpServer() {
+        running = false;
+        shutdown(fd, SHUT_RDWR);
+        close(fd);
+        if (thread.joinable()) thread.join();
+    }
+
+    static void stamp(uint8_t* p, int64_t us) {
+        uint32_t seconds = (uint32_t)(us / 1000000 + 2208988800LL);
+        uint32_t fraction = (uint32_t)(((uint64_t)(us % 1000000) << 32) / 1000000);
+        for (int i = 0; i < 4; i++) {
+            p[i] = seconds >> (24 - 8 * i);
+            p[4 + i] = fraction >> (24 - 8 * i);
+        }
+    }
+
+    void serve() {
+        uint8_t packet[48];
+        struct sockaddr_in from;
+        socklen_t length = sizeof(from);
+        while (running) {
+            length = sizeof(from);
+            if (recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr*)&from, &length) != 48) continue;
+            int64_t received = esp_timer_get_time() + SOLSTICE_US;
+            requests++;
+            if (silent) continue;
+
+            memcpy(packet + 24, packet + 40, 8);            // originate = client transmit
+            packet[0] = (0 << 6) | (4 << 3) | 4;            // version 4, server
+            packet[1] = kissOfDeath ? 0 : 2;
+            stamp(packet + 32, received);
+            delayMicroseconds(200);                         // server processing time
+            stamp(packet + 40, esp_timer_get_time() + SOLSTICE_US);
+            sendto(fd, packet, sizeof(packet), 0, (struct sockaddr*)&from, length);
+        }
+    }
+};
+
+TestNtpServer* ntp;
+SntpClock* sntp;
+
+void setUp(void) {
+    ntp = new TestNtpServer();
+    TEST_ASSERT_TRUE(ntp->begin());
+    sntp = new SntpClock();
+    TEST_ASSERT_TRUE(sntp->begin("127.0.0.1", ntp->port));
+}
+
+void tearDown(void) {
+    delete sntp;
+    delete ntp;
+}
+
+// Poll without blocking until the burst ends; returns the slowest poll() in us
+static uint32_t runBurst() {
+    uint32_t slowest = 0;
+    uint32_t start = millis();
+    do {
+        uint32_t before = micros();
+        sntp->poll(0);
+        slowest = max(slowest, (uint32_t)(micros() - before));
+        delayMicroseconds(100);
+    } while (sntp->secondsUntilSync() == 0 && millis() - start < 10000);
+    return slowest;
+}
+
+void test_first_sync_sets_clock() {
+    TEST_ASSERT_FALSE(sntp->isSynchronized());
+    TEST_ASSERT_EQUAL(0, sntp->now());
+
+    runBurst();
+    TEST_ASSERT_TRUE(sntp->isSynchronized());
+
+    int64_t error = sntp->now() - (esp_timer_get_time() + SOLSTICE_US);
+    TEST_ASSERT_INT_WITHIN(2000, 0, (int32_t)error);
+    TEST_ASSERT_EQUAL(1718928000L, (long)(sntp->nowSeconds() / 86400 * 86400));
+
+    SntpStats stats = sntp->getStats();
+    TEST_ASSERT_EQUAL(1, stats.syncs);
+    TEST_ASSERT_EQUAL(SNTP_BURST, stats.requests);
+    TEST_ASSERT_EQUAL(SNTP_BURST, stats.replies);
+    TEST_ASSERT_EQUAL(0, sntp->getClockStats().steps);
+
+    // The next sync waits for the minimum interval
+    TEST_ASSERT_UINT32_WITHIN(2, CLOCK_MIN_INTERVAL_S, sntp->secondsUntilSync());
+    TEST_ASSERT_EQUAL(SNTP_BURST, ntp->requests.load());
+}
+
+void test_poll_never_blocks() {
+    ntp->silent = true;
+    uint32_t slowest = runBurst();
+
+    // Every request timed out, but no poll() waited for one
+    TEST_ASSERT_LESS_THAN(5000, slowest);
+    SntpStats stats = sntp->getStats();
+    TEST_ASSERT_EQUAL(SNTP_BURST, stats.timeouts);
+    TEST_ASSERT_EQUAL(1, stats.failures);
+    TEST_ASSERT_FALSE(sntp->isSynchronized());
+    TEST_ASSERT_UINT32_WITHIN(1, SNTP_RETRY_MS / 1000, sntp->secondsUntilSync());
+
+    // A forced sync after the server recovers
+    ntp->silent = false;
+    sntp->syncNow();
+    runBurst();
+    TEST_ASSERT_TRUE(sntp->isSynchronized());
+}
+
+void test_kiss_of_death_ends_burst() {
+    ntp->kissOfDeath = true;
+    runBurst();
+
+    SntpStats stats = sntp->getStats();
+    TEST_ASSERT_EQUAL(1, stats.requests);
+    TEST_ASSERT_EQUAL(1, stats.rejected);
+    TEST_ASSERT_EQUAL(1, stats.failures);
+    TEST_ASSERT_FALSE(sntp->isSynchronized());
+}
+
+void test_background_task() {
+    TEST_ASSERT_TRUE(sntp->startTask());
+    uint32_t start = millis();
+    while (!sntp->isSynchronized() && millis() - start < 5000) {
+        delay(5);
+    }
+    TEST_ASSERT_TRUE(sntp->isSynchronized());
+    sntp->stop();
+}
+
+void test_slews_small_offsets() {
+    ClockDiscipline clock;
+    TEST_ASSERT_TRUE(clock.addSample(0, SOLSTICE_US, 1000));
+
+    // 40 ms behind after an hour: slewed, not stepped
+    int64_t hour = 3600LL * 1000000;
+    TEST_ASSERT_FALSE(clock.addSample(hour, SOLSTICE_US + hour + 40000, 1000));
+    ClockStats stats = clock.getStats(hour);
+    TEST_ASSERT_EQUAL(40000, stats.offsetUs);
+    TEST_ASSERT_EQUAL(40000, stats.slewRemainingUs);
+    TEST_ASSERT_EQUAL(0, stats.steps);
+
+    // Time keeps moving forward while the offset is worked off
+    int64_t previous = clock.now(hour);
+    for (int64_t local = hour; local <= hour + 120LL * 1000000; local += 10000) {
+        int64_t reading = clock.now(local);
+        TEST_ASSERT_TRUE(reading > previous || local == hour);
+        previous = reading;
+    }
+
+    // Worked off at CLOCK_MAX_SLEW_PPM: 40 ms in 80 s. The two samples also
+    // fit an 11.1 ppm rate, which adds 1.1 ms over the 100 s
+    TEST_ASSERT_EQUAL(0, clock.getStats(hour + 81LL * 1000000).slewRemainingUs);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -11.11f, clock.getStats(hour).driftPpm);
+    int64_t later = hour + 100LL * 1000000;
+    TEST_ASSERT_INT_WITHIN(5, 1111, (int32_t)(clock.now(later) - (SOLSTICE_US + later + 40000)));
+}
+
+void test_steps_large_offsets() {
+    ClockDiscipline clock;
+    clock.addSample(0, SOLSTICE_US, 1000);
+    TEST_ASSERT_TRUE(clock.addSample(60000000, SOLSTICE_US + 62000000, 1000));
+    TEST_ASSERT_EQUAL(1, clock.getStats(60000000).steps);
+    TEST_ASSERT_EQUAL(SOLSTICE_US + 62000000, clock.now(60000000));
+}
+
+// True UTC for a local timer running driftPpm fast, plus deterministic noise
+struct Oscillator {
+    double driftPpm;
+    int64_t utcAtZero;
+    int64_t localAtZero;
+    uint32_t seed;
+
+    int64_t utc(int64_t local) const {
+        return utcAtZero + (int64_t)((local - localAtZero) / (1.0 + driftPpm * 1e-6));
+    }
+
+    // Shift the rate from this instant on, keeping time continuous
+    void setDrift(int64_t local, double ppm) {
+        utcAtZero = utc(local);
+        localAtZero = local;
+        driftPpm = ppm;
+    }
+
+    int32_t noise(int32_t amplitudeUs) {
+        seed = seed * 1664525 + 1013904223;
+        return (int32_t)(seed >> 8) % (amplitudeUs + 1) - amplitudeUs / 2;
+    }
+};
+
+struct RunResult {
+    uint32_t syncs;
+    int64_t maxErrorUs;      // worst clock error seen just before a sync, after settling
+    int64_t local;
+};
+
+// Sync whenever the discipline asks, for the given number of days
+static RunResult simulate(ClockDiscipline& clock, Oscillator& osc, int64_t startLocal, int days, int settle) {
+    RunResult result = {0, 0, startLocal};
+    int64_t end = startLocal + days * 86400LL * 1000000;
+    while (result.local < end) {
+        int64_t error = clock.now(result.local) - osc.utc(result.local);
+        if (result.syncs >= (uint32_t)settle) result.maxErrorUs = max(result.maxErrorUs, error < 0 ? -error : error);
+
+        clock.addSample(result.local, osc.utc(result.local) + osc.noise(4000), 8000 + osc.noise(4000));
+        result.syncs++;
+        result.local += (int64_t)clock.getInterval() * 1000000;
+    }
+    return result;
+}
+
+void test_drift_estimation_and_adaptive_interval() {
+    ClockDiscipline clock;
+    Oscillator osc = {35.0, SOLSTICE_US, 0, 7};
+
+    RunResult run = simulate(clock, osc, 0, 60, 4);
+    ClockStats stats = clock.getStats(run.local);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 35.0f, stats.driftPpm);
+    TEST_ASSERT_LESS_THAN(0.2f, stats.driftErrorPpm);
+    TEST_ASSERT_EQUAL(CLOCK_MAX_INTERVAL_S, stats.intervalS);
+    TEST_ASSERT_EQUAL(0, stats.steps);
+    TEST_ASSERT_LESS_THAN(CLOCK_TARGET_ERROR_US, run.maxErrorUs);
+
+    // Uncorrected, the same oscillator is 3 s off after a day
+    char report[200];
+    snprintf(report, sizeof(report),
+             "60 days at +35 ppm: %lu syncs (a 60 s poll makes 86400), drift %.3f +- %.3f ppm, "
+             "jitter %lu us, worst error %ld us, interval %lu s",
+             (unsigned long)run.syncs, stats.driftPpm, stats.driftErrorPpm, (unsigned long)stats.jitterUs,
+             (long)run.maxErrorUs, (unsigned long)stats.intervalS);
+    TEST_MESSAGE(report);
+}
+
+void test_interval_shrinks_when_drift_changes() {
+    ClockDiscipline clock;
+    Oscillator osc = {-12.0, SOLSTICE_US, 0, 11};
+    RunResult run = simulate(clock, osc, 0, 30, 4);
+    TEST_ASSERT_EQUAL(CLOCK_MAX_INTERVAL_S, clock.getInterval());
+
+    // A warmer enclosure moves the crystal by 2 ppm: 0.7 s over a 4-day interval
+    osc.setDrift(run.local - (int64_t)CLOCK_MAX_INTERVAL_S * 1000000, -10.0);
+    clock.addSample(run.local, osc.utc(run.local), 8000);
+    TEST_ASSERT_TRUE(clock.getInterval() < CLOCK_MAX_INTERVAL_S);
+
+    // It settles on the new rate and stretches the interval again
+    run = simulate(clock, osc, run.local + (int64_t)clock.getInterval() * 1000000, 30, 6);
+    ClockStats stats = clock.getStats(run.local);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, -10.0f, stats.driftPpm);
+    TEST_ASSERT_EQUAL(CLOCK_MAX_INTERVAL_S, stats.intervalS);
+}
+
+void test_clock_read_cost() {
+    const int reads = 100000;
+    int64_t sum = 0;
+    runBurst();
+
+    uint32_t start = micros();
+    for (int i = 0; i < reads; i++) {
+        sum += sntp->now() & 1;
+    }
+    uint32_t elapsed = micros() - start;
+    TEST_ASSERT_TRUE(sum >= 0);
+
+    char report[96];
+    snprintf(report, sizeof(report), "now(): %.0f ns per read", elapsed * 1000.0 / reads);
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runSntpClockTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_first_sync_sets_clock);
+    RUN_TEST(test_poll_never_blocks);
+    RUN_TEST(test_kiss_of_death_ends_burst);
+    RUN_TEST(test_background_task);
+    RUN_TEST(test_slews_small_offsets);
+    RUN_TEST(test_steps_large_offsets);
+    RUN_TEST(test_drift_estimation_and_adaptive_interval);
+    RUN_TEST(test_interval_shrinks_when_drift_changes);
+    RUN_TEST(test_clock_read_cost);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runSntpClockTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runSntpClockTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
@@ -1,18 +1,23 @@
 #include <unity.h>
 #include "SolarCalc.h"
+#include "EpochTime.h"
 
 // Test location: Harare
 const float TEST_LATITUDE = -17.7831;
 const float TEST_LONGITUDE = 31.0909;
 const float TEST_ELEVATION = 650;
 const float TEST_PANEL_TILT = 30;
-const float TEST_PANEL_AZIMUTH = 180;
+const float TEST_PANEL_AZIMUTH = 0;     // north-facing, towards the sun south of the equator
 
 SolarCalc* solarCalc;
+TimeZone harare;
 
 void setUp(void) {
     solarCalc = new SolarCalc(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, 
                              TEST_PANEL_TILT, TEST_PANEL_AZIMUTH);
+    // Forecast hours and sunrise/sunset are read on the Harare clock
+    harare.begin("CAT-2");
+    solarCalc->setTimeZone(&harare);
 }
 
 void tearDown(void) {
@@ -43,9 +48,12 @@ void test_solar_position_noon() {
 void test_solar_position_summer() {
     // Test solar position on December 21 (summer solstice)
     DailyForecast forecast = solarCalc->calculateDailyForecast(2024, 12, 21);
+    DailyForecast winter = solarCalc->calculateDailyForecast(2024, 6, 21);
     
-    // Summer should have higher total irradiance than winter
-    TEST_ASSERT_GREATER_THAN(4.0, forecast.totalIrradiance);
+    // Summer should have higher total irradiance than winter, even on a panel
+    // tilted towards the winter sun
+    TEST_ASSERT_TRUE(forecast.totalIrradiance > winter.totalIrradiance);
+    TEST_ASSERT_TRUE(forecast.totalIrradiance > 3.0);
     TEST_ASSERT_LESS_THAN(10.0, forecast.totalIrradiance);
     
     // Verify sunrise is earlier and sunset is later in summer
@@ -61,11 +69,17 @@ void test_solar_position_summer() {
         }
     }
     
-    // In summer, expect sunrise around 5-6 AM and sunset around 6-7 PM
-    TEST_ASSERT_GREATER_OR_EQUAL(4, sunriseHour);
-    TEST_ASSERT_LESS_OR_EQUAL(6, sunriseHour);
-    TEST_ASSERT_GREATER_OR_EQUAL(18, sunsetHour);
-    TEST_ASSERT_LESS_OR_EQUAL(19, sunsetHour);
+    // Hours are sampled at their midpoints, so the first and last lit hours
+    // fall inside the day, within an hour and a half of sunrise and sunset
+    // (about 5:20 and 18:30 in Harare at the December solstice)
+    float sunrise = solarCalc->getSunriseTime(2024, 12, 21);
+    float sunset = solarCalc->getSunsetTime(2024, 12, 21);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 5.3, sunrise);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 18.5, sunset);
+    TEST_ASSERT_TRUE(sunriseHour + 0.5f >= sunrise);
+    TEST_ASSERT_TRUE(sunriseHour + 0.5f < sunrise + 1.5f);
+    TEST_ASSERT_TRUE(sunsetHour + 0.5f <= sunset);
+    TEST_ASSERT_TRUE(sunsetHour + 0.5f > sunset - 1.5f);
 }
 
 void test_night_hours_zero_irradiance() {
@@ -80,7 +94,7 @@ void test_night_hours_zero_irradiance() {
 
 void test_panel_tilt_effect() {
     // Test with flat panel (0° tilt)
-    SolarCalc flatPanel(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, 0, 180);
+    SolarCalc flatPanel(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, 0, TEST_PANEL_AZIMUTH);
     DailyForecast flatForecast = flatPanel.calculateDailyForecast(2024, 6, 21);
     
     // Test with tilted panel (30° tilt)
@@ -114,6 +128,316 @@ void test_elevation_effect() {
     TEST_ASSERT_GREATER_THAN(seaLevelForecast.totalIrradiance, elevatedForecast.totalIrradiance);
 }
 
+void test_declination_follows_seasons() {
+    SolarPosition june = solarCalc->positionAt(EpochTime::fromCivil(2024, 6, 21, 12));
+    SolarPosition december = solarCalc->positionAt(EpochTime::fromCivil(2024, 12, 21, 12));
+    SolarPosition march = solarCalc->positionAt(EpochTime::fromCivil(2024, 3, 20, 3));
+    TEST_ASSERT_FLOAT_WITHIN(0.2, 23.44, june.declination);
+    TEST_ASSERT_FLOAT_WITHIN(0.2, -23.44, december.declination);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 0.0, march.declination);
+
+    // Equation of time extremes
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 16.4, solarCalc->positionAt(EpochTime::fromCivil(2024, 11, 3, 12)).equationOfTime);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, -14.2, solarCalc->positionAt(EpochTime::fromCivil(2024, 2, 11, 12)).equationOfTime);
+}
+
+void test_position_at_solar_noon() {
+    // Scan June 21 a minute at a time for the highest sun
+    time_t dayStart = EpochTime::fromCivil(2024, 6, 21);
+    SolarPosition best = solarCalc->positionAt(dayStart);
+    time_t bestAt = dayStart;
+    for (time_t t = dayStart; t < dayStart + 86400; t += 60) {
+        SolarPosition sun = solarCalc->positionAt(t);
+        if (sun.elevation > best.elevation) {
+            best = sun;
+            bestAt = t;
+        }
+    }
+
+    // 90 - (17.78 + 23.44) degrees, due north, at 12:00 solar time
+    TEST_ASSERT_FLOAT_WITHIN(0.3, 48.78, best.elevation);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, min(best.azimuth, 360.0f - best.azimuth));
+    float noon = 12.0 - TEST_LONGITUDE / 15.0 - best.equationOfTime / 60.0;
+    TEST_ASSERT_FLOAT_WITHIN(2.0 / 60.0, noon, (bestAt - dayStart) / 3600.0);
+
+    // Morning sun in the east, afternoon in the west
+    TEST_ASSERT_FLOAT_WITHIN(45, 60, solarCalc->positionAt(dayStart + 6 * 3600).azimuth);
+    TEST_ASSERT_FLOAT_WITHIN(45, 300, solarCalc->positionAt(dayStart + 14 * 3600).azimuth);
+}
+
+void test_position_continuous_across_midnight() {
+    time_t midnight = EpochTime::fromCivil(2024, 3, 1);
+    SolarPosition before = solarCalc->positionAt(midnight - 1);
+    SolarPosition after = solarCalc->positionAt(midnight);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, before.elevation, after.elevation);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, before.declination, after.declination);
+
+    // Cached terms give the same answer as a fresh calculator
+    for (time_t t = midnight; t < midnight + 86400; t += 977) {
+        SolarCalc fresh(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_PANEL_TILT, TEST_PANEL_AZIMUTH);
+        TEST_ASSERT_EQUAL_FLOAT(fresh.positionAt(t).elevation, solarCalc->positionAt(t).elevation);
+    }
+}
+
+void test_position_throughput() {
+    time_t dayStart = EpochTime::fromCivil(2024, 6, 21);
+    const int calls = 86400;
+    volatile float sink = 0;
+
+    // Tracking: one call a second through the day
+    uint32_t start = micros();
+    for (int i = 0; i < calls; i++) {
+        sink += solarCalc->positionAt(dayStart + i).elevation;
+    }
+    uint32_t tracking = micros() - start;
+
+    // Worst case: a new day every call
+    start = micros();
+    for (int i = 0; i < calls; i++) {
+        sink += solarCalc->positionAt(dayStart + (time_t)i * 86400).elevation;
+    }
+    uint32_t newDay = micros() - start;
+
+    char report[128];
+    snprintf(report, sizeof(report), "positionAt(): %.0f ns per call on the same day, %.0f ns on a new day",
+             tracking * 1000.0 / calls, newDay * 1000.0 / calls);
+    TEST_MESSAGE(report);
+}
+
+// Reference for the integrator: the same model as getTiltedSurfaceIrradiance(),
+// sampled every second (or every step seconds) by the trapezoid rule
+static double bruteForceEnergy(SolarCalc& solar, float tilt, float azimuth, time_t from, time_t to, int step = 1) {
+    float tiltRad = tilt * PI / 180.0, azimuthRad = azimuth * PI / 180.0;
+    double energy = 0;
+    for (time_t t = from; t <= to; t += step) {
+        SolarPosition sun = solar.positionAt(t);
+        float elevation = sun.elevation * PI / 180.0;
+        if (elevation <= 0) continue;
+        float dni = solar.getClearSkyDni(elevation);
+        float dhi = 0.1f * dni;
+        float cosIncidence = sin(elevation) * cos(tiltRad) +
+                             cos(elevation) * sin(tiltRad) * cos(sun.azimuth * PI / 180.0 - azimuthRad);
+        float power = dni * max(0.0f, cosIncidence) + dhi * (1 + cos(tiltRad)) / 2 +
+                      0.2 * (dni * sin(elevation) + dhi) * (1 - cos(tiltRad)) / 2;
+        energy += (t == from || t == to ? 0.5 : 1.0) * step * power;
+    }
+    return energy / 3600.0 / 1000.0;
+}
+
+struct IntegrationCase {
+    float latitude;
+    float tilt;
+    float azimuth;
+    int month;
+    int day;
+};
+
+void test_integrated_day_against_brute_force() {
+    // Harare, facing away from the sun too; a vertical east wall; Tromso in
+    // polar day, with a low February sun and on a west wall
+    static const IntegrationCase cases[] = {
+        {TEST_LATITUDE, 30, 0, 6, 21}, {TEST_LATITUDE, 30, 180, 6, 21}, {TEST_LATITUDE, 90, 90, 3, 20},
+        {TEST_LATITUDE, 0, 0, 12, 21}, {69.65f, 45, 180, 6, 21}, {69.65f, 60, 180, 2, 15}, {69.65f, 90, 270, 4, 1}};
+    double worstIntegrated = 0, worstSampled = 0;
+    for (const IntegrationCase& c : cases) {
+        SolarCalc solar(c.latitude, TEST_LONGITUDE, TEST_ELEVATION, c.tilt, c.azimuth);
+        time_t dayStart = EpochTime::fromCivil(2024, c.month, c.day);
+        double reference = bruteForceEnergy(solar, c.tilt, c.azimuth, dayStart, dayStart + 86400);
+        float integrated = solar.integrateEnergy(dayStart, dayStart + 86400);
+        float sampled = solar.calculateDailyForecast(2024, c.month, c.day).totalIrradiance;
+        TEST_ASSERT_FLOAT_WITHIN(reference * 0.00001, reference, integrated);
+        TEST_ASSERT_FLOAT_WITHIN(0.0001, integrated, solar.integrateDailyForecast(2024, c.month, c.day).totalIrradiance);
+
+        double integratedError = fabs(integrated - reference) / reference;
+        double sampledError = fabs(sampled - reference) / reference;
+        if (integratedError > worstIntegrated) worstIntegrated = integratedError;
+        if (sampledError > worstSampled) worstSampled = sampledError;
+    }
+    TEST_ASSERT_TRUE(worstIntegrated * 100 < worstSampled);
+
+    char report[128];
+    snprintf(report, sizeof(report), "Worst daily error against 1 s sampling: integrated %.5f%%, 24 midpoints %.2f%%",
+             worstIntegrated * 100, worstSampled * 100);
+    TEST_MESSAGE(report);
+}
+
+void test_integrated_hours_and_spans() {
+    time_t dayStart = EpochTime::fromCivil(2024, 9, 1);
+    for (int hour = 0; hour < 24; hour++) {
+        time_t from = dayStart + hour * 3600;
+        double reference = bruteForceEnergy(*solarCalc, TEST_PANEL_TILT, TEST_PANEL_AZIMUTH, from, from + 3600);
+        TEST_ASSERT_FLOAT_WITHIN(reference * 0.0001 + 0.0000001, reference, solarCalc->integrateEnergy(from, from + 3600));
+    }
+
+    // Any span, across midnight included; energy adds up over a split
+    time_t from = dayStart + 10 * 3600 + 17 * 60 + 23, to = dayStart + 13 * 3600 + 42 * 60 + 5;
+    double reference = bruteForceEnergy(*solarCalc, TEST_PANEL_TILT, TEST_PANEL_AZIMUTH, from, to);
+    TEST_ASSERT_FLOAT_WITHIN(reference * 0.0001, reference, solarCalc->integrateEnergy(from, to));
+    TEST_ASSERT_FLOAT_WITHIN(0.00001, solarCalc->integrateEnergy(from, to),
+                             solarCalc->integrateEnergy(from, from + 777) + solarCalc->integrateEnergy(from + 777, to));
+    TEST_ASSERT_EQUAL_FLOAT(0, solarCalc->integrateEnergy(dayStart - 3600, dayStart + 3600));
+    TEST_ASSERT_EQUAL_FLOAT(0, solarCalc->integrateEnergy(from, from));
+
+    // A daylight-saving day keeps computeSky()'s hours: the skipped hour is 0
+    TimeZone berlin;
+    berlin.begin("CET-1CEST,M3.5.0,M10.5.0/3");
+    SolarCalc solar(52.52f, 13.40f, 34, 35, 180);
+    solar.setTimeZone(&berlin);
+    DailyForecast integrated = solar.integrateDailyForecast(2024, 3, 31);
+    DailyForecast sampled = solar.calculateDailyForecast(2024, 3, 31);
+    TEST_ASSERT_EQUAL_FLOAT(0, integrated.hourlyData[2].irradiance);
+    TEST_ASSERT_FLOAT_WITHIN(sampled.totalIrradiance * 0.01, sampled.totalIrradiance, integrated.totalIrradiance);
+}
+
+void test_integration_cost() {
+    const int days = 100;
+    volatile float sink = 0;
+    SolarCalc solar(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_PANEL_TILT, TEST_PANEL_AZIMUTH);
+    time_t first = EpochTime::fromCivil(2024, 1, 1);
+
+    uint32_t start = micros();
+    for (int d = 0; d < days; d++) {
+        sink += solar.integrateEnergy(first + d * 86400L, first + (d + 1) * 86400L);
+    }
+    uint32_t integrated = micros() - start;
+
+    start = micros();
+    for (int d = 0; d < days; d++) {
+        int year, month, day;
+        EpochTime::civilFromDays(EpochTime::floorDiv(first, 86400) + d, year, month, day);
+        sink += solar.calculateDailyForecast(year, month, day).totalIrradiance;
+    }
+    uint32_t sampled = micros() - start;
+
+    start = micros();
+    for (int d = 0; d < days; d++) {
+        time_t dayStart = first + d * 86400L;
+        sink += bruteForceEnergy(solar, TEST_PANEL_TILT, TEST_PANEL_AZIMUTH, dayStart, dayStart + 86400, 60);
+    }
+    uint32_t minutes = micros() - start;
+    (void)sink;
+
+    char report[128];
+    snprintf(report, sizeof(report), "Per day: integrated %lu us, 24 midpoints %lu us, 1-minute sampling %lu us",
+             (unsigned long)(integrated / days), (unsigned long)(sampled / days), (unsigned long)(minutes / days));
+    TEST_MESSAGE(report);
+}
+
+// Where the sun's centre first passes an elevation between two instants, by
+// a minute scan then bisection to the second
+static time_t scanForElevation(SolarCalc& solar, time_t from, time_t to, float target) {
+    bool below = solar.positionAt(from).elevation < target;
+    for (time_t t = from; t < to; t += 60) {
+        time_t next = t + 60 < to ? t + 60 : to;
+        if ((solar.positionAt(next).elevation < target) == below) continue;
+        time_t low = t, high = next;
+        while (high - low > 1) {
+            time_t middle = low + (high - low) / 2;
+            if ((solar.positionAt(middle).elevation < target) == below) low = middle; else high = middle;
+        }
+        return high;
+    }
+    return 0;
+}
+
+void test_sun_events_against_scan() {
+    static const int dates[][3] = {{2024, 1, 15}, {2024, 3, 21}, {2024, 6, 21}, {2024, 9, 30}, {2024, 12, 21}};
+    for (const auto& date : dates) {
+        SolarDay sun = solarCalc->getSolarDay(date[0], date[1], date[2]);
+        TEST_ASSERT_EQUAL(SUN_RISES_AND_SETS, sun.cycle);
+        TEST_ASSERT_FLOAT_WITHIN(0.02f, 0, solarCalc->positionAt(sun.solarNoon).hourAngle);
+
+        time_t before = sun.solarNoon - 12 * 3600, after = sun.solarNoon + 12 * 3600;
+        TEST_ASSERT_INT_WITHIN(2, scanForElevation(*solarCalc, before, sun.solarNoon, SOLAR_HORIZON), sun.sunrise);
+        TEST_ASSERT_INT_WITHIN(2, scanForElevation(*solarCalc, sun.solarNoon, after, SOLAR_HORIZON), sun.sunset);
+        TEST_ASSERT_INT_WITHIN(2, scanForElevation(*solarCalc, before, sun.solarNoon, -6), sun.civilDawn);
+        TEST_ASSERT_INT_WITHIN(2, scanForElevation(*solarCalc, sun.solarNoon, after, -6), sun.civilDusk);
+        TEST_ASSERT_INT_WITHIN(2, scanForElevation(*solarCalc, before, sun.solarNoon, -12), sun.nauticalDawn);
+        TEST_ASSERT_INT_WITHIN(2, scanForElevation(*solarCalc, sun.solarNoon, after, -12), sun.nauticalDusk);
+        TEST_ASSERT_TRUE(sun.nauticalDawn < sun.civilDawn && sun.civilDawn < sun.sunrise);
+        TEST_ASSERT_TRUE(sun.sunset < sun.civilDusk && sun.civilDusk < sun.nauticalDusk);
+
+        // Refraction: the limb shows before the geometric centre reaches the horizon
+        time_t geometric = scanForElevation(*solarCalc, before, sun.solarNoon, 0);
+        TEST_ASSERT_INT_WITHIN(120, geometric - 4 * 60, sun.sunrise);
+        TEST_ASSERT_TRUE(sun.maxElevation > solarCalc->positionAt(sun.solarNoon).elevation);
+    }
+
+    // The Harare clock reads the same events
+    const SolarDay& equinox = solarCalc->getSolarDay(2024, 3, 21);
+    TEST_ASSERT_EQUAL(harare.toLocal(equinox.sunrise) - EpochTime::fromCivil(2024, 3, 21),
+                      lroundf(solarCalc->getSunriseTime(2024, 3, 21) * 3600));
+}
+
+void test_polar_day_and_night() {
+    // Tromso, 69.65 N
+    SolarCalc tromso(69.65f, 18.96f, 0, 0, 0);
+
+    SolarDay midsummer = tromso.getSolarDay(2024, 6, 21);
+    TEST_ASSERT_EQUAL(SUN_POLAR_DAY, midsummer.cycle);
+    TEST_ASSERT_EQUAL(0, midsummer.sunrise);
+    TEST_ASSERT_EQUAL(0, midsummer.sunset);
+    TEST_ASSERT_EQUAL(0, midsummer.civilDawn);
+    TEST_ASSERT_TRUE(midsummer.solarNoon != 0);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 43.8f, midsummer.maxElevation);
+    TEST_ASSERT_EQUAL_FLOAT(-1, tromso.getSunriseTime(2024, 6, 21));
+    TEST_ASSERT_EQUAL(0, tromso.getSunsetAt(2024, 6, 21));
+
+    // Polar night, but twilight around noon
+    SolarDay midwinter = tromso.getSolarDay(2024, 12, 21);
+    TEST_ASSERT_EQUAL(SUN_POLAR_NIGHT, midwinter.cycle);
+    TEST_ASSERT_EQUAL(0, midwinter.sunrise);
+    TEST_ASSERT_EQUAL(0, midwinter.sunset);
+    TEST_ASSERT_TRUE(midwinter.civilDawn != 0 && midwinter.civilDawn < midwinter.solarNoon);
+    TEST_ASSERT_TRUE(midwinter.civilDusk > midwinter.solarNoon);
+    TEST_ASSERT_TRUE(midwinter.nauticalDawn < midwinter.civilDawn);
+    TEST_ASSERT_TRUE(midwinter.maxElevation < SOLAR_HORIZON);
+    TEST_ASSERT_EQUAL_FLOAT(-1, tromso.getSunsetTime(2024, 12, 21));
+
+    // A white night further south: sets, but never 12 degrees down
+    SolarCalc oslo(59.91f, 10.75f, 0, 0, 0);
+    SolarDay white = oslo.getSolarDay(2024, 6, 21);
+    TEST_ASSERT_EQUAL(SUN_RISES_AND_SETS, white.cycle);
+    TEST_ASSERT_TRUE(white.sunrise != 0 && white.sunset != 0);
+    TEST_ASSERT_EQUAL(0, white.nauticalDawn);
+    TEST_ASSERT_EQUAL(0, white.nauticalDusk);
+}
+
+void test_solar_year_is_cached() {
+    SolarCalc solar(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_PANEL_TILT, TEST_PANEL_AZIMUTH);
+    uint32_t start = micros();
+    solar.loadSolarYear(2024);
+    uint32_t elapsed = micros() - start;
+    TEST_ASSERT_EQUAL(366, solar.getStats().eventDays);
+
+    SolarCalc single(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_PANEL_TILT, TEST_PANEL_AZIMUTH);
+    int64_t first = EpochTime::daysFromCivil(2024, 1, 1);
+    for (int d = 0; d < 366; d += 5) {
+        int year, month, day;
+        EpochTime::civilFromDays(first + d, year, month, day);
+        SolarDay cached = solar.getSolarDay(year, month, day);
+        SolarDay solved = single.getSolarDay(year, month, day);
+        TEST_ASSERT_EQUAL(solved.sunrise, cached.sunrise);
+        TEST_ASSERT_EQUAL(solved.nauticalDusk, cached.nauticalDusk);
+        TEST_ASSERT_EQUAL_FLOAT(solved.maxElevation, cached.maxElevation);
+        TEST_ASSERT_EQUAL(solved.sunset, solar.getSunsetAt(year, month, day));
+    }
+    TEST_ASSERT_EQUAL(366, solar.getStats().eventDays);
+
+    // A forecast carries the day's events, and a new site drops the table
+    DailyForecast forecast = solar.calculateDailyForecast(2024, 3, 21);
+    TEST_ASSERT_EQUAL_FLOAT(solar.getSunriseTime(2024, 3, 21), forecast.sunrise);
+    TEST_ASSERT_EQUAL(366, solar.getStats().eventDays);
+    solar.setSite(TEST_LATITUDE + 1, TEST_LONGITUDE, TEST_ELEVATION);
+    solar.getSolarDay(2024, 3, 21);
+    TEST_ASSERT_EQUAL(367, solar.getStats().eventDays);
+
+    char report[96];
+    snprintf(report, sizeof(report), "366 days of sun events in %lu us, %lu us per day", (unsigned long)elapsed,
+             (unsigned long)(elapsed / 366));
+    TEST_MESSAGE(report);
+}
+
 // Main test runner
 void runSolarCalcTests() {
     UNITY_BEGIN();
@@ -124,6 +448,16 @@ void runSolarCalcTests() {
     RUN_TEST(test_panel_tilt_effect);
     RUN_TEST(test_sunrise_sunset_times);
     RUN_TEST(test_elevation_effect);
+    RUN_TEST(test_declination_follows_seasons);
+    RUN_TEST(test_position_at_solar_noon);
+    RUN_TEST(test_position_continuous_across_midnight);
+    RUN_TEST(test_position_throughput);
+    RUN_TEST(test_integrated_day_against_brute_force);
+    RUN_TEST(test_integrated_hours_and_spans);
+    RUN_TEST(test_integration_cost);
+    RUN_TEST(test_sun_events_against_scan);
+    RUN_TEST(test_polar_day_and_night);
+    RUN_TEST(test_solar_year_is_cached);
     
     UNITY_END();
 }
@@ -0,0 +1,145 @@
+#include <unity.h>
+#include <string.h>
+#include "SolarEnsemble.h"
+#include "SolarCalc.h"
+
+// Harare, on the Harare clock, panel facing north
+const float TEST_LATITUDE = -17.7831;
+const float TEST_LONGITUDE = 31.0909;
+const float TEST_ELEVATION = 1490;
+const float TEST_TILT = 20;
+const float TEST_AZIMUTH = 0;
+
+#ifdef HOST_BUILD
+const uint32_t TEST_MEMBERS = 10000;
+#else
+const uint32_t TEST_MEMBERS = 1000;
+#endif
+
+TimeZone harare;
+SolarEnsemble* ensemble;
+
+static EnsembleSpread noSpread() {
+    EnsembleSpread spread = {0, 0, SOLAR_ALBEDO, SOLAR_ALBEDO, 0, 0};
+    return spread;
+}
+
+void setUp(void) {
+    harare.begin("CAT-2");
+    ensemble = new SolarEnsemble(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_TILT, TEST_AZIMUTH);
+    ensemble->setTimeZone(&harare);
+}
+
+void tearDown(void) {
+    delete ensemble;
+}
+
+void test_no_spread_is_the_forecast() {
+    ensemble->setSpread(noSpread());
+    EnsembleForecast forecast;
+    TEST_ASSERT_TRUE(ensemble->run(2025, 6, 21, 100, 1, forecast));
+
+    SolarCalc solar(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_TILT, TEST_AZIMUTH);
+    solar.setTimeZone(&harare);
+    DailyForecast expected = solar.calculateDailyForecast(2025, 6, 21);
+    for (int hour = 0; hour < 24; hour++) {
+        float value = expected.hourlyData[hour].irradiance;
+        TEST_ASSERT_FLOAT_WITHIN(value * 0.0001f + 0.000001f, value, forecast.hour[hour].p50);
+        TEST_ASSERT_EQUAL_FLOAT(forecast.hour[hour].p90, forecast.hour[hour].p10);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(expected.totalIrradiance * 0.0001f, expected.totalIrradiance, forecast.day.mean);
+}
+
+void test_same_result_for_any_thread_count() {
+    EnsembleForecast single, other;
+    TEST_ASSERT_TRUE(ensemble->run(2025, 3, 1, 1000, 42, single, 1));
+    for (unsigned threads = 2; threads <= 5; threads++) {
+        TEST_ASSERT_TRUE(ensemble->run(2025, 3, 1, 1000, 42, other, threads));
+        TEST_ASSERT_EQUAL(0, memcmp(single.hour, other.hour, sizeof(single.hour)));
+        TEST_ASSERT_EQUAL(0, memcmp(&single.day, &other.day, sizeof(single.day)));
+    }
+
+    // Another seed is another ensemble
+    TEST_ASSERT_TRUE(ensemble->run(2025, 3, 1, 1000, 43, other, 1));
+    TEST_ASSERT_TRUE(single.day.p50 != other.day.p50);
+    TEST_ASSERT_FLOAT_WITHIN(single.day.p50 * 0.02f, single.day.p50, other.day.p50);
+
+    TEST_ASSERT_FALSE(ensemble->run(2025, 3, 1, 0, 42, other));
+    TEST_ASSERT_FALSE(ensemble->run(2025, 3, 1, ENSEMBLE_MAX_MEMBERS + 1, 42, other));
+}
+
+void test_quantiles_and_clouds() {
+    EnsembleForecast clear, cloudy;
+    TEST_ASSERT_TRUE(ensemble->run(2025, 9, 1, TEST_MEMBERS, 7, clear));
+    for (int hour = 0; hour < 24; hour++) {
+        TEST_ASSERT_TRUE(clear.hour[hour].p90 <= clear.hour[hour].p50);
+        TEST_ASSERT_TRUE(clear.hour[hour].p50 <= clear.hour[hour].p10);
+    }
+    TEST_ASSERT_TRUE(clear.day.p90 < clear.day.p50);
+    TEST_ASSERT_TRUE(clear.day.p50 < clear.day.p10);
+
+    // The deterministic forecast sits inside the spread
+    SolarCalc solar(TEST_LATITUDE, TEST_LONGITUDE, TEST_ELEVATION, TEST_TILT, TEST_AZIMUTH);
+    solar.setTimeZone(&harare);
+    float deterministic = solar.calculateDailyForecast(2025, 9, 1).totalIrradiance;
+    TEST_ASSERT_TRUE(clear.day.p90 < deterministic && deterministic < clear.day.p10);
+
+    // A cloudy afternoon takes energy off the afternoon and widens it
+    float cover[24];
+    for (int hour = 0; hour < 24; hour++) cover[hour] = hour >= 13 ? 0.7f : 0;
+    ensemble->setCloudCover(cover);
+    TEST_ASSERT_TRUE(ensemble->run(2025, 9, 1, TEST_MEMBERS, 7, cloudy));
+    TEST_ASSERT_TRUE(cloudy.day.p50 < clear.day.p50);
+    TEST_ASSERT_TRUE(cloudy.hour[14].p50 < clear.hour[14].p50 * 0.8f);
+    TEST_ASSERT_TRUE(cloudy.hour[14].p10 - cloudy.hour[14].p90 > clear.hour[14].p10 - clear.hour[14].p90);
+    TEST_ASSERT_FLOAT_WITHIN(clear.hour[9].p50 * 0.05f, clear.hour[9].p50, cloudy.hour[9].p50);
+
+    char report[128];
+    snprintf(report, sizeof(report), "Day P90/P50/P10: clear %.2f/%.2f/%.2f, cloudy afternoon %.2f/%.2f/%.2f kWh/m2",
+             clear.day.p90, clear.day.p50, clear.day.p10, cloudy.day.p90, cloudy.day.p50, cloudy.day.p10);
+    TEST_MESSAGE(report);
+}
+
+void test_member_rate() {
+    EnsembleForecast one, all;
+    TEST_ASSERT_TRUE(ensemble->run(2025, 12, 21, TEST_MEMBERS, 3, one, 1));
+    TEST_ASSERT_TRUE(ensemble->run(2025, 12, 21, TEST_MEMBERS, 3, all));
+
+    char report[128];
+    snprintf(report, sizeof(report), "%u members: %.0f members/s on 1 thread, %.0f on %u", (unsigned)TEST_MEMBERS,
+             one.membersPerSecond, all.membersPerSecond, all.threads);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_TRUE(one.membersPerSecond > 0);
+}
+
+// Main test runner
+void runSolarEnsembleTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_no_spread_is_the_forecast);
+    RUN_TEST(test_same_result_for_any_thread_count);
+    RUN_TEST(test_quantiles_and_clouds);
+    RUN_TEST(test_member_rate);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runSolarEnsembleTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runSolarEnsembleTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
@@ -0,0 +1,169 @@
+#include <unity.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include "SolarRaster.h"
+#include "SolarCalc.h"
+
+// Host only: the raster engine against SolarCalc run per cell
+
+static const char* const RASTER_PATH = "/tmp/test_solar_raster.sgrt";
+
+static float naiveCell(const RasterGrid& grid, const RasterPanel& panel, uint32_t row, uint32_t column,
+                       int year, int month, int day) {
+    SolarCalc solar(grid.north - (row + 0.5f) * grid.step, grid.west + (column + 0.5f) * grid.step,
+                    panel.elevation, panel.tilt, panel.azimuth);
+    return solar.calculateDailyForecast(year, month, day).totalIrradiance;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+    unlink(RASTER_PATH);
+}
+
+void test_cells_match_solar_calc() {
+    // The whole globe at 3 degrees, polar day and night included
+    RasterGrid grid = {90, -180, 3, 120, 60};
+    static const RasterPanel panels[] = {{0, 180, 0}, {30, 180, 0}, {30, 0, 1500}, {20, 90, 0}, {90, 270, 0}};
+    static const int dates[][3] = {{2024, 3, 20}, {2024, 6, 21}, {2025, 12, 21}};
+
+    float worst = 0;
+    std::vector<float> row(grid.width);
+    for (const RasterPanel& panel : panels) {
+        SolarRaster raster(grid, panel);
+        for (const auto& date : dates) {
+            raster.setDate(date[0], date[1], date[2]);
+            for (uint32_t r = 0; r < grid.height; r += 3) {
+                raster.computeRow(r, row.data());
+                for (uint32_t column = 0; column < grid.width; column += 7) {
+                    float expected = naiveCell(grid, panel, r, column, date[0], date[1], date[2]);
+                    float error = fabsf(row[column] - expected);
+                    if (error > worst) worst = error;
+                    TEST_ASSERT_FLOAT_WITHIN(0.002f + expected * 0.001f, expected, row[column]);
+                }
+            }
+        }
+    }
+
+    char report[96];
+    snprintf(report, sizeof(report), "Largest difference from SolarCalc: %.5f kWh/m2", worst);
+    TEST_MESSAGE(report);
+}
+
+void test_tiled_file_layout() {
+    // 100 x 70 cells in 32-cell tiles: 4 x 3 tiles, the last column and row padded
+    RasterGrid grid = {-10, 20, 0.1f, 100, 70};
+    RasterPanel panel = {25, 0, 300};
+    SolarRaster raster(grid, panel);
+    raster.setDate(2024, 9, 1);
+
+    int fd = open(RASTER_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    TEST_ASSERT_TRUE(raster.writeTiled(fd, 32, 3));
+    close(fd);
+
+    FILE* file = fopen(RASTER_PATH, "rb");
+    std::vector<uint8_t> data(64 + 12 * 32 * 32 * 4 + 1);
+    size_t size = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+    TEST_ASSERT_EQUAL(64 + 12 * 32 * 32 * 4, size);
+
+    TEST_ASSERT_EQUAL(0, memcmp(data.data(), "SGRT", 4));
+    uint16_t tileSize;
+    uint32_t width, height;
+    float step;
+    int16_t year;
+    memcpy(&tileSize, &data[6], 2);
+    memcpy(&width, &data[8], 4);
+    memcpy(&height, &data[12], 4);
+    memcpy(&step, &data[24], 4);
+    memcpy(&year, &data[28], 2);
+    TEST_ASSERT_EQUAL(32, tileSize);
+    TEST_ASSERT_EQUAL(100, width);
+    TEST_ASSERT_EQUAL(70, height);
+    TEST_ASSERT_EQUAL_FLOAT(0.1f, step);
+    TEST_ASSERT_EQUAL(2024, year);
+    TEST_ASSERT_EQUAL(9, data[30]);
+    TEST_ASSERT_EQUAL(1, data[31]);
+
+    // Every cell where the header says it is, NaN beyond the grid
+    std::vector<float> row(grid.width);
+    for (uint32_t r = 0; r < 96; r++) {
+        if (r < grid.height) raster.computeRow(r, row.data());
+        for (uint32_t column = 0; column < 128; column++) {
+            size_t tile = (r / 32) * 4 + column / 32;
+            size_t at = 64 + (tile * 32 * 32 + (r % 32) * 32 + column % 32) * 4;
+            float value;
+            memcpy(&value, &data[at], 4);
+            if (r < grid.height && column < grid.width) {
+                TEST_ASSERT_EQUAL_FLOAT(row[column], value);
+            } else {
+                TEST_ASSERT_TRUE(isnan(value));
+            }
+        }
+    }
+}
+
+void test_cells_per_second_against_solar_calc() {
+    // Southern Africa at 0.1 degrees, a panel facing north
+    RasterGrid grid = {-10, 10, 0.1f, 300, 250};
+    RasterPanel panel = {25, 0, 1000};
+    const uint32_t cells = grid.width * grid.height;
+    volatile float sink = 0;
+
+    // Naive: one SolarCalc forecast per cell, on a sample of rows
+    auto start = std::chrono::steady_clock::now();
+    uint32_t naiveCells = 0;
+    for (uint32_t r = 0; r < grid.height; r += 10) {
+        for (uint32_t column = 0; column < grid.width; column++) {
+            sink += naiveCell(grid, panel, r, column, 2024, 6, 21);
+            naiveCells++;
+        }
+    }
+    float naiveSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    // Raster: date terms once, then every row
+    start = std::chrono::steady_clock::now();
+    SolarRaster raster(grid, panel);
+    raster.setDate(2024, 6, 21);
+    std::vector<float> row(grid.width);
+    for (int pass = 0; pass < 4; pass++) {
+        for (uint32_t r = 0; r < grid.height; r++) {
+            raster.computeRow(r, row.data());
+            sink += row[r % grid.width];
+        }
+    }
+    float rasterSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    float naiveRate = naiveCells / naiveSeconds;
+    float rasterRate = 4.0f * cells / rasterSeconds;
+    char report[128];
+    snprintf(report, sizeof(report), "SolarCalc per cell: %.2f M cells/s, raster: %.2f M cells/s (%.0fx)",
+             naiveRate / 1e6f, rasterRate / 1e6f, rasterRate / naiveRate);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_TRUE(rasterRate > naiveRate * 5);
+}
+
+// Main test runner
+void runSolarRasterTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_cells_match_solar_calc);
+    RUN_TEST(test_tiled_file_layout);
+    RUN_TEST(test_cells_per_second_against_solar_calc);
+
+    UNITY_END();
+}
+
+// Native only: SolarRaster is a host library
+#ifdef UNIT_TEST
+int main() {
+    runSolarRasterTests();
+    return 0;
+}
+#endif
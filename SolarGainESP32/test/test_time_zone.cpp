@@ -0,0 +1,218 @@
+#include <unity.h>
+#include <stdlib.h>
+#include "TimeZone.h"
+
+// 2024-06-21 00:00:00 UTC
+static const time_t JUNE_21 = 1718928000;
+
+// Zones the sites run in: whole, half and three-quarter hour offsets, and
+// daylight saving both sides of the equator
+static const char* ZONES[] = {
+    "CAT-2",
+    "IST-5:30",
+    "<+0545>-5:45",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "CET-1CEST,M3.5.0,M10.5.0/3",
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",
+    "NZST-12NZDT,M9.5.0,M4.1.0/3",
+    "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+    "IST-1GMT0,M10.5.0,M3.5.0/1",
+};
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+// Seconds east of UTC as the C library sees a zone
+static int32_t libcOffset(const char* posixTz, time_t utc) {
+    setenv("TZ", posixTz, 1);
+    tzset();
+    struct tm local;
+    localtime_r(&utc, &local);
+    return (int32_t)local.tm_gmtoff;
+}
+
+void test_parse_fixed_offsets() {
+    TimeZone zone;
+    TEST_ASSERT_TRUE(zone.begin("CAT-2", 2024));
+    TEST_ASSERT_EQUAL(7200, zone.offsetAt(JUNE_21));
+    TEST_ASSERT_FALSE(zone.observesDst());
+    TEST_ASSERT_EQUAL_STRING("CAT", zone.abbreviation(JUNE_21));
+
+    TEST_ASSERT_TRUE(zone.begin("IST-5:30", 2024));
+    TEST_ASSERT_EQUAL(19800, zone.offsetAt(JUNE_21));
+
+    TEST_ASSERT_TRUE(zone.begin("<+0545>-5:45", 2024));
+    TEST_ASSERT_EQUAL(20700, zone.offsetAt(JUNE_21));
+    TEST_ASSERT_EQUAL_STRING("+0545", zone.abbreviation(JUNE_21));
+
+    TEST_ASSERT_TRUE(zone.begin("<-0330>3:30", 2024));
+    TEST_ASSERT_EQUAL(-12600, zone.offsetAt(JUNE_21));
+
+    // Fixed offsets the old integer-hour setting maps to
+    TEST_ASSERT_TRUE(zone.begin(TimeZone::posixForOffset(19800).c_str(), 2024));
+    TEST_ASSERT_EQUAL(19800, zone.offsetAt(JUNE_21));
+    TEST_ASSERT_TRUE(zone.begin(TimeZone::posixForOffset(-5 * 3600).c_str(), 2024));
+    TEST_ASSERT_EQUAL(-18000, zone.offsetAt(JUNE_21));
+}
+
+void test_rejects_bad_strings() {
+    TimeZone zone;
+    TEST_ASSERT_FALSE(zone.begin("", 2024));
+    TEST_ASSERT_FALSE(zone.begin("Europe/Berlin", 2024));
+    TEST_ASSERT_FALSE(zone.begin("CET", 2024));
+    TEST_ASSERT_FALSE(zone.begin("CET-1CEST,M3.5.0", 2024));
+    TEST_ASSERT_FALSE(zone.begin("CET-1CEST,M13.5.0,M10.5.0", 2024));
+    TEST_ASSERT_FALSE(zone.begin("CAT-2 ", 2024));
+
+    // A failed parse leaves UTC, not the previous zone
+    TEST_ASSERT_EQUAL(0, zone.offsetAt(JUNE_21));
+}
+
+void test_transition_table() {
+    TimeZone zone;
+    TEST_ASSERT_TRUE(zone.begin("CET-1CEST,M3.5.0,M10.5.0/3", 2024));
+    TEST_ASSERT_EQUAL(TZ_TABLE_YEARS * 2, zone.getTransitionCount());
+    TEST_ASSERT_EQUAL(EpochTime::fromCivil(2024, 1, 1), zone.getTableStart());
+    TEST_ASSERT_EQUAL(EpochTime::fromCivil(2024 + TZ_TABLE_YEARS, 1, 1), zone.getTableEnd());
+
+    // 2024-03-31 01:00 UTC and 2024-10-27 01:00 UTC
+    time_t spring = EpochTime::fromCivil(2024, 3, 31, 1);
+    time_t autumn = EpochTime::fromCivil(2024, 10, 27, 1);
+    TEST_ASSERT_EQUAL(3600, zone.offsetAt(spring - 1));
+    TEST_ASSERT_EQUAL(7200, zone.offsetAt(spring));
+    TEST_ASSERT_EQUAL(7200, zone.offsetAt(autumn - 1));
+    TEST_ASSERT_EQUAL(3600, zone.offsetAt(autumn));
+    TEST_ASSERT_TRUE(zone.isDst(JUNE_21));
+    TEST_ASSERT_EQUAL_STRING("CEST", zone.abbreviation(JUNE_21));
+}
+
+void test_matches_libc() {
+    // Inside the table and well outside it, where the rule is evaluated directly
+    uint32_t seed = 2024;
+    time_t from = EpochTime::fromCivil(1990, 1, 1);
+    time_t span = EpochTime::fromCivil(2060, 1, 1) - from;
+    for (uint8_t z = 0; z < sizeof(ZONES) / sizeof(ZONES[0]); z++) {
+        TimeZone zone;
+        TEST_ASSERT_TRUE_MESSAGE(zone.begin(ZONES[z], 2024), ZONES[z]);
+        for (int i = 0; i < 20000; i++) {
+            seed = seed * 1664525 + 1013904223;
+            time_t utc = from + (time_t)((uint64_t)seed * span >> 32);
+            if (zone.offsetAt(utc) != libcOffset(ZONES[z], utc)) {
+                char message[96];
+                snprintf(message, sizeof(message), "%s disagrees with localtime_r() at %lld",
+                         ZONES[z], (long long)utc);
+                TEST_FAIL_MESSAGE(message);
+            }
+        }
+
+        // Every half hour of the table, so no transition is missed
+        for (time_t year = 2024; year < 2024 + TZ_TABLE_YEARS; year++) {
+            for (time_t t = EpochTime::fromCivil(year, 1, 1); t < EpochTime::fromCivil(year + 1, 1, 1); t += 1800) {
+                if (zone.offsetAt(t) != libcOffset(ZONES[z], t)) {
+                    TEST_FAIL_MESSAGE(ZONES[z]);
+                }
+            }
+        }
+    }
+    unsetenv("TZ");
+    tzset();
+}
+
+void test_local_round_trip() {
+    TimeZone zone;
+    TEST_ASSERT_TRUE(zone.begin("EST5EDT,M3.2.0,M11.1.0", 2024));
+
+    // Every wall time that exists comes back unchanged, through both changes
+    for (time_t utc = JUNE_21; utc < JUNE_21 + 200 * SECONDS_PER_DAY; utc += 3599) {
+        time_t local = zone.toLocal(utc);
+        TEST_ASSERT_EQUAL(local, zone.toLocal(zone.toUtc(local)));
+    }
+
+    // 2024-03-10 02:30 local never happens: read as 02:30 EST, which is 03:30 EDT
+    time_t gap = EpochTime::fromCivil(2024, 3, 10, 2, 30);
+    TEST_ASSERT_EQUAL(EpochTime::fromCivil(2024, 3, 10, 7, 30), zone.toUtc(gap));
+
+    // 2024-11-03 01:30 local happens twice: the first is 05:30 UTC (EDT)
+    time_t repeated = EpochTime::fromCivil(2024, 11, 3, 1, 30);
+    TEST_ASSERT_EQUAL(EpochTime::fromCivil(2024, 11, 3, 5, 30), zone.toUtc(repeated));
+}
+
+void test_conversion_throughput() {
+    TimeZone zone;
+    zone.begin("CET-1CEST,M3.5.0,M10.5.0/3", 2024);
+    const int calls = 200000;
+    volatile int32_t sink = 0;
+    char report[128];
+
+    // A clock: each lookup lands in the interval of the one before
+    uint32_t start = micros();
+    for (int i = 0; i < calls; i++) {
+        sink += zone.offsetAt(JUNE_21 + (time_t)i * 61);
+    }
+    uint32_t sequential = micros() - start;
+
+    // Scattered across the table: the binary search every time
+    uint32_t seed = 7;
+    start = micros();
+    for (int i = 0; i < calls; i++) {
+        seed = seed * 1664525 + 1013904223;
+        sink += zone.offsetAt(zone.getTableStart() + (time_t)(seed % (uint32_t)(zone.getTableEnd() - zone.getTableStart())));
+    }
+    uint32_t random = micros() - start;
+
+    // Outside the table: the rule is evaluated for the year
+    start = micros();
+    for (int i = 0; i < calls / 10; i++) {
+        sink += zone.offsetAt(EpochTime::fromCivil(2050, 1, 1) + (time_t)i * 997);
+    }
+    uint32_t rule = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < calls; i++) {
+        sink += (int32_t)zone.toUtc(JUNE_21 + (time_t)i * 61);
+    }
+    uint32_t toUtc = micros() - start;
+
+    snprintf(report, sizeof(report), "offsetAt(): %.1f ns sequential, %.1f ns random, %.1f ns outside the table",
+             sequential * 1000.0 / calls, random * 1000.0 / calls, rule * 1000.0 / (calls / 10));
+    TEST_MESSAGE(report);
+    snprintf(report, sizeof(report), "toUtc(): %.1f ns per call", toUtc * 1000.0 / calls);
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runTimeZoneTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parse_fixed_offsets);
+    RUN_TEST(test_rejects_bad_strings);
+    RUN_TEST(test_transition_table);
+    RUN_TEST(test_matches_libc);
+    RUN_TEST(test_local_round_trip);
+    RUN_TEST(test_conversion_throughput);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runTimeZoneTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runTimeZoneTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
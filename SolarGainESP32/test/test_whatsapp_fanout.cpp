@@ -0,0 +1,275 @@
+#include <unity.h>
+#include <atomic>
+#include <string>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "HttpSession.h"
+#include "PayloadWriter.h"
+#include "TokenBucket.h"
+
+// Simulated Graph API link: every complete request is answered with a 200.
+// The timed fan-out runs the real client against GraphStandIn in
+// test_whatsapp_harness.
+class SimulatedLink : public Client {
+private:
+    bool open;
+    std::string request;
+    std::string response;
+    size_t readPos;
+
+    void checkRequest() {
+        size_t headEnd = request.find("\r\n\r\n");
+        if (headEnd == std::string::npos) return;
+        size_t lengthAt = request.find("Content-Length: ");
+        size_t length = lengthAt < headEnd ? strtoul(request.c_str() + lengthAt + 16, nullptr, 10) : 0;
+        size_t total = headEnd + 4 + length;
+        if (request.size() < total) return;
+
+        lastBody = request.substr(headEnd + 4, length);
+        request.erase(0, total);
+
+        const char* json = "{\"messages\":[{\"id\":\"wamid.TEST\"}]}";
+        response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                   std::to_string(strlen(json)) + "\r\n\r\n" + json;
+        readPos = 0;
+    }
+
+public:
+    std::string lastBody;
+
+    SimulatedLink() : open(false), readPos(0) {}
+
+    int connect(IPAddress, uint16_t) override { return connect("", 0); }
+    int connect(const char*, uint16_t) override {
+        open = true;
+        return 1;
+    }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (!open) return 0;
+        request.append((const char*)buffer, size);
+        checkRequest();
+        return size;
+    }
+    int available() override {
+        if (readPos >= response.size()) return 0;
+        return response.size() - readPos;
+    }
+    int read() override { return available() ? (uint8_t)response[readPos++] : -1; }
+    int read(uint8_t* buffer, size_t size) override {
+        size_t n = 0;
+        while (n < size && available()) buffer[n++] = response[readPos++];
+        return n;
+    }
+    int peek() override { return available() ? (uint8_t)response[readPos] : -1; }
+    void flush() override {}
+    void stop() override {
+        open = false;
+        request.clear();
+        response.clear();
+        readPos = 0;
+    }
+    uint8_t connected() override { return open; }
+    operator bool() override { return open; }
+};
+
+class StringPrint : public Print {
+public:
+    std::string text;
+    size_t write(uint8_t c) override { text += (char)c; return 1; }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        text.append((const char*)buffer, size);
+        return size;
+    }
+};
+
+static const char* const HEAD =
+    "{\"messaging_product\":\"whatsapp\",\"recipient_type\":\"individual\",\"to\":\"";
+
+// Roughly the work of writeDailyMessage: 24 formatted lines with UTF-8
+static void writeForecast(Print& out) {
+    char line[48];
+    out.print("🌞 *Solar Gain Forecast*\n📍 Harare\n📅 2024-06-21\n\n");
+    for (int h = 0; h < 24; h++) {
+        snprintf(line, sizeof(line), "%02d:00 → ▪▪▪ %.2f kWh/m²\n", h, h * 0.037f);
+        out.print(line);
+    }
+}
+
+static void writeTail(Print& out) {
+    JsonEscapePrint escaped(out);
+    out.print("\",\"type\":\"text\",\"text\":{\"preview_url\":false,\"body\":\"");
+    writeForecast(escaped);
+    out.print("\"}}");
+}
+
+// Full envelope for one recipient, rendered from scratch
+static void writeFull(Print& out, const String& to) {
+    out.print(HEAD);
+    JsonEscapePrint escaped(out);
+    escaped.print(to);
+    writeTail(out);
+}
+
+static String recipient(int i) {
+    char number[16];
+    snprintf(number, sizeof(number), "+2637712%05d", i);
+    return String(number);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_patched_payload_matches_full_render() {
+    PatchedPayload message;
+    TEST_ASSERT_TRUE(message.prepare(HEAD, writeTail));
+
+    for (int i = 0; i < 3; i++) {
+        String to = i == 2 ? String("+1\"quoted\"") : recipient(i);
+        StringPrint patched, full;
+        message.write(patched, to);
+        writeFull(full, to);
+        TEST_ASSERT_TRUE(patched.text == full.text);
+    }
+
+    // Same body on the wire
+    SimulatedLink link;
+    HttpSession http(link);
+    http.setHost("graph.local", 80);
+    String to = recipient(7);
+    PayloadWriter patched = [&message, &to](Print& out) { message.write(out, to); };
+    PayloadWriter full = [&to](Print& out) { writeFull(out, to); };
+
+    TEST_ASSERT_EQUAL(0, http.sendRequest("POST", "/v18.0/1/messages", "Bearer t", &patched));
+    TEST_ASSERT_EQUAL(200, http.readResponseHead());
+    http.finish();
+    std::string patchedBody = link.lastBody;
+    TEST_ASSERT_EQUAL(0, http.sendRequest("POST", "/v18.0/1/messages", "Bearer t", &full));
+    TEST_ASSERT_EQUAL(200, http.readResponseHead());
+    http.finish();
+    TEST_ASSERT_TRUE(patchedBody == link.lastBody);
+    TEST_ASSERT_TRUE(patchedBody.find(to.c_str()) != std::string::npos);
+}
+
+void test_token_bucket_limits_rate() {
+    uint32_t nowUs = 1000;
+    TokenBucket bucket(200, 5);
+    bucket.setClock([&nowUs]() { return nowUs; });
+
+    // The burst of 5 is free, then one token every 5 ms
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(bucket.tryAcquire());
+    }
+    TEST_ASSERT_FALSE(bucket.tryAcquire());
+    TEST_ASSERT_UINT32_WITHIN(2, 5000, bucket.waitTimeUs());
+
+    nowUs += 4900;
+    TEST_ASSERT_FALSE(bucket.tryAcquire());
+    nowUs += 100;
+    TEST_ASSERT_TRUE(bucket.tryAcquire());
+    TEST_ASSERT_FALSE(bucket.tryAcquire());
+
+    // 20 tokens' worth of time refills only up to the burst
+    nowUs += 100000;
+    int taken = 0;
+    while (bucket.tryAcquire()) taken++;
+    TEST_ASSERT_EQUAL(5, taken);
+
+    // Still right across the 32-bit wrap of the clock
+    nowUs = 0xFFFFF000UL;
+    bucket.setClock([&nowUs]() { return nowUs; });
+    taken = 0;
+    while (bucket.tryAcquire()) taken++;
+    nowUs += 10000;
+    while (bucket.tryAcquire()) taken++;
+    TEST_ASSERT_EQUAL(7, taken);
+}
+
+void test_token_bucket_pause() {
+    uint32_t nowUs = 0;
+    TokenBucket bucket(1000, 10);
+    bucket.setClock([&nowUs]() { return nowUs; });
+
+    TEST_ASSERT_TRUE(bucket.tryAcquire());
+    bucket.pause(50);
+    TEST_ASSERT_FALSE(bucket.tryAcquire());
+    TEST_ASSERT_EQUAL(50000, bucket.waitTimeUs());
+
+    nowUs += 49999;
+    TEST_ASSERT_FALSE(bucket.tryAcquire());
+
+    // Tokens do not pile up during the pause: one per ms after it ends
+    nowUs += 5001;
+    TEST_ASSERT_FALSE(bucket.tryAcquire());
+    nowUs += 3000;
+    int taken = 0;
+    while (bucket.tryAcquire()) taken++;
+    TEST_ASSERT_EQUAL(3, taken);
+}
+
+// One bucket drained from two tasks, as the queue's task and a broadcast share the client's
+struct SharedBucket {
+    TokenBucket* bucket;
+    std::atomic<int> taken;
+    std::atomic<int> running;
+};
+
+static void drainBucket(void* arg) {
+    SharedBucket* shared = static_cast<SharedBucket*>(arg);
+    for (int i = 0; i < 2000; i++) {
+        if (shared->bucket->tryAcquire()) shared->taken++;
+    }
+    shared->running--;
+    vTaskDelete(nullptr);
+}
+
+void test_token_bucket_shared_between_tasks() {
+    std::atomic<uint32_t> nowUs(0);
+    TokenBucket bucket(1000, 1000);
+    bucket.setClock([&nowUs]() { return nowUs.load(); });
+
+    // The clock stands still, so exactly the burst can be handed out
+    SharedBucket shared;
+    shared.bucket = &bucket;
+    shared.taken = 0;
+    shared.running = 2;
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(drainBucket, "drain0", 4096, &shared, 1, nullptr, 0));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(drainBucket, "drain1", 4096, &shared, 1, nullptr, 1));
+    while (shared.running > 0) {
+        vTaskDelay(1);
+    }
+    TEST_ASSERT_EQUAL(1000, shared.taken.load());
+    TEST_ASSERT_FALSE(bucket.tryAcquire());
+}
+
+// Main test runner
+void runFanOutTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_patched_payload_matches_full_render);
+    RUN_TEST(test_token_bucket_limits_rate);
+    RUN_TEST(test_token_bucket_pause);
+    RUN_TEST(test_token_bucket_shared_between_tasks);
+
+    UNITY_END();
+}
+
+// For native testing
+#ifdef UNIT_TEST
+int main() {
+    runFanOutTests();
+    return 0;
+}
+#endif
+
+// For ESP32 testing
+#ifndef UNIT_TEST
+void setup() {
+    delay(2000);
+    runFanOutTests();
+}
+
+void loop() {
+    // Nothing to do
+}
+#endif
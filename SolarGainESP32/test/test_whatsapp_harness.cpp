@@ -0,0 +1,303 @@
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+#include "GraphStandIn.h"
+#include "WhatsAppClient.h"
+#include "NotificationQueue.h"
+
+// Runs the real WhatsAppClient (HttpSession, GraphResponse, retries, rate
+// limiting) against the local Graph API stand-in. Host only: the plain TCP
+// TlsConnection in env:native talks to GraphStandIn on 127.0.0.1.
+
+static const char* const PHONE_ID = "1098765432";
+static const char* const TOKEN = "EAAstandin";
+
+GraphStandIn* graph;
+WhatsAppClient* client;
+
+void setUp(void) {
+    graph = new GraphStandIn(PHONE_ID, TOKEN);
+    TEST_ASSERT_TRUE(graph->begin());
+
+    client = new WhatsAppClient();
+    client->begin(PHONE_ID, TOKEN, "+263771234567");
+    client->setEndpoint("127.0.0.1", graph->getPort(), "v18.0");
+    // Short backoff so transport retries do not dominate the run time
+    client->setReconnectPolicy({3, 5, 50000, 3600000UL});
+    client->setRateLimit(1000, 50);
+}
+
+void tearDown(void) {
+    delete client;
+    delete graph;
+}
+
+static uint32_t percentile(std::vector<uint32_t>& samples, int pct) {
+    std::sort(samples.begin(), samples.end());
+    return samples.empty() ? 0 : samples[(samples.size() - 1) * pct / 100];
+}
+
+void test_connection_and_send() {
+    TEST_ASSERT_TRUE(client->testConnection());
+    TEST_ASSERT_TRUE(client->sendMessage("Hello \"stand-in\"\n"));
+
+    std::vector<GraphMessage> messages = graph->getMessages();
+    TEST_ASSERT_EQUAL(1, messages.size());
+    TEST_ASSERT_EQUAL_STRING("+263771234567", messages[0].to.c_str());
+    TEST_ASSERT_EQUAL_STRING("Hello \\\"stand-in\\\"\\n", messages[0].body.c_str());
+
+    // Both requests share one keep-alive connection
+    TEST_ASSERT_EQUAL(1, graph->getStats().connections);
+    TEST_ASSERT_TRUE(client->getLastTiming().reused);
+}
+
+void test_get_retries_server_errors_and_drops() {
+    graph->injectNext(GRAPH_FAULT_UNAVAILABLE);
+    graph->injectNext(GRAPH_FAULT_TLS);
+    TEST_ASSERT_TRUE(client->testConnection());
+
+    GraphStandInStats stats = graph->getStats();
+    TEST_ASSERT_EQUAL(3, stats.requests);
+    // The dropped connection was replaced
+    TEST_ASSERT_EQUAL(2, stats.connections);
+}
+
+void test_post_is_not_resent_after_server_error() {
+    // Graph may have taken the message before failing; the caller decides
+    graph->injectNext(GRAPH_FAULT_UNAVAILABLE);
+    GraphResponse response = client->sendQueued("maybe sent", 10, "test-0");
+    TEST_ASSERT_EQUAL(GRAPH_UNAVAILABLE, response.error);
+    TEST_ASSERT_TRUE(response.retryable());
+    TEST_ASSERT_EQUAL(1, graph->getStats().requests);
+}
+
+void test_post_resent_when_idle_connection_drops() {
+    TEST_ASSERT_TRUE(client->sendMessage("first"));
+
+    // The reused connection closes before any response byte: sent again on a new one
+    graph->injectNext(GRAPH_FAULT_TLS);
+    TEST_ASSERT_TRUE(client->sendMessage("second"));
+
+    GraphStandInStats stats = graph->getStats();
+    TEST_ASSERT_EQUAL(3, stats.requests);
+    TEST_ASSERT_EQUAL(2, stats.accepted);
+    TEST_ASSERT_EQUAL(2, stats.connections);
+}
+
+void test_lost_ack_is_not_resent() {
+    // Accepted, but the fresh connection drops before the answer: reported, not resent
+    graph->injectNext(GRAPH_FAULT_LOST_ACK);
+    GraphResponse response = client->sendQueued("once only", 9, "test-1");
+    TEST_ASSERT_EQUAL(GRAPH_TRANSPORT, response.error);
+    TEST_ASSERT_TRUE(response.retryable());
+
+    GraphStandInStats stats = graph->getStats();
+    TEST_ASSERT_EQUAL(1, stats.requests);
+    TEST_ASSERT_EQUAL(1, stats.accepted);
+    TEST_ASSERT_EQUAL(0, stats.duplicates);
+
+    // The queue sends it again later, and the copy is delivered
+    TEST_ASSERT_TRUE(client->sendQueued("once only", 9, "test-1").ok());
+    stats = graph->getStats();
+    TEST_ASSERT_EQUAL(2, stats.accepted);
+    TEST_ASSERT_EQUAL(1, stats.duplicates);
+    TEST_ASSERT_EQUAL(2, graph->getMessages().size());
+}
+
+void test_lost_ack_on_reused_connection_duplicates() {
+    TEST_ASSERT_TRUE(client->sendMessage("warm"));
+
+    // Accepted, then the reused connection drops without a byte back. The client
+    // cannot tell this from an idle close, resends, and the recipient gets two.
+    graph->injectNext(GRAPH_FAULT_LOST_ACK);
+    TEST_ASSERT_TRUE(client->sendQueued("twice", 5, "test-4").ok());
+
+    GraphStandInStats stats = graph->getStats();
+    TEST_ASSERT_EQUAL(3, stats.requests);
+    TEST_ASSERT_EQUAL(3, stats.accepted);
+    TEST_ASSERT_EQUAL(1, stats.duplicates);
+}
+
+void test_gives_up_after_max_attempts() {
+    graph->injectNext(GRAPH_FAULT_SERVER_ERROR, 3);
+    TEST_ASSERT_FALSE(client->testConnection());
+    TEST_ASSERT_EQUAL(3, graph->getStats().requests);
+}
+
+void test_rate_limit_and_auth_errors() {
+    // 429 is not retried by the request loop; the caller decides
+    graph->injectNext(GRAPH_FAULT_RATE_LIMIT);
+    GraphResponse response = client->sendQueued("throttled", 9, "test-2");
+    TEST_ASSERT_EQUAL(429, response.httpCode);
+    TEST_ASSERT_EQUAL(GRAPH_RATE_LIMITED, response.error);
+    TEST_ASSERT_EQUAL(130429, response.errorCode);
+
+    // Broadcast pauses on 429 and carries on
+    client->setRecipients({"+263771000001", "+263771000002", "+263771000003"});
+    graph->injectNext(GRAPH_FAULT_RATE_LIMIT);
+    PayloadWriter body = [](Print& out) { out.print("fan-out"); };
+    FanOutResult result = client->broadcast(body);
+    TEST_ASSERT_EQUAL(3, result.delivered);
+    TEST_ASSERT_EQUAL(1, result.throttled);
+
+    // A bad token stops the broadcast at the first recipient
+    client->begin(PHONE_ID, "EAAwrong", "+263771234567");
+    client->setRecipients({"+263771000001", "+263771000002", "+263771000003"});
+    result = client->broadcast(body);
+    TEST_ASSERT_EQUAL(0, result.delivered);
+    TEST_ASSERT_EQUAL(3, result.failed);
+    TEST_ASSERT_EQUAL(1, graph->getStats().authFailures);
+}
+
+void test_send_latency_and_throughput() {
+    const int messages = 200;
+    graph->setFaults({2, 4, 0, 0, 0, 0});
+
+    std::vector<uint32_t> latencies;
+    uint32_t start = millis();
+    for (int i = 0; i < messages; i++) {
+        uint32_t sent = micros();
+        TEST_ASSERT_TRUE(client->sendMessage(String("forecast ") + i));
+        latencies.push_back(micros() - sent);
+    }
+    uint32_t elapsedMs = millis() - start;
+
+    TEST_ASSERT_EQUAL(messages, graph->getStats().accepted);
+    TEST_ASSERT_EQUAL(1, graph->getStats().connections);
+
+    char report[160];
+    snprintf(report, sizeof(report),
+             "%d sends, 2-6 ms server latency: %.0f msg/s, p50 %lu us, p90 %lu us, p99 %lu us",
+             messages, messages * 1000.0f / max(elapsedMs, (uint32_t)1),
+             (unsigned long)percentile(latencies, 50), (unsigned long)percentile(latencies, 90),
+             (unsigned long)percentile(latencies, 99));
+    TEST_MESSAGE(report);
+}
+
+void test_fanout_benchmark() {
+    const int recipients = 20;
+    // Each new connection pays a handshake (scaled down 10x), each request a round trip
+    graph->setFaults({15, 0, 0, 0, 0, 40});
+
+    std::vector<String> numbers;
+    for (int i = 0; i < recipients; i++) {
+        char number[16];
+        snprintf(number, sizeof(number), "+2637712%05d", i);
+        numbers.push_back(number);
+    }
+    DailyForecast forecast;
+    forecast.date = "2024-06-21";
+    forecast.totalIrradiance = 0;
+    for (int hour = 0; hour < 24; hour++) {
+        HourlyIrradiance hourData;
+        hourData.hour = hour;
+        hourData.irradiance = hour * 0.037f;
+        forecast.hourlyData.push_back(hourData);
+        forecast.totalIrradiance += hourData.irradiance;
+    }
+
+    // N independent sends: a new connection and a fresh render for each recipient
+    client->setRateLimit(0, 1);
+    uint32_t start = millis();
+    for (const String& number : numbers) {
+        client->begin(PHONE_ID, TOKEN, number);
+        client->disconnect();
+        TEST_ASSERT_TRUE(client->sendDailyForecast(forecast, "Harare"));
+    }
+    uint32_t separateMs = millis() - start;
+    uint32_t separateConnections = graph->getStats().connections;
+
+    // broadcast(): one keep-alive connection, body rendered once, rate limited
+    client->setRateLimit(80, 20);
+    client->disconnect();
+    client->setRecipients(numbers);
+    start = millis();
+    FanOutResult result = client->broadcastDailyForecast(forecast, "Harare");
+    uint32_t fanOutMs = millis() - start;
+
+    TEST_ASSERT_EQUAL(recipients, result.delivered);
+    TEST_ASSERT_EQUAL(recipients, separateConnections);
+    TEST_ASSERT_EQUAL(recipients + 1, graph->getStats().connections);
+    TEST_ASSERT_EQUAL(recipients * 2, graph->getStats().accepted);
+    std::vector<GraphMessage> messages = graph->getMessages();
+    TEST_ASSERT_TRUE(messages[0].body == messages[recipients].body);
+    TEST_ASSERT_LESS_THAN(separateMs, fanOutMs);
+
+    char report[128];
+    snprintf(report, sizeof(report), "%d recipients: separate %lu ms, broadcast() %lu ms (%.1fx)",
+             recipients, (unsigned long)separateMs, (unsigned long)fanOutMs,
+             fanOutMs ? (float)separateMs / fanOutMs : 0.0f);
+    TEST_MESSAGE(report);
+}
+
+void test_queued_delivery_under_faults() {
+    const int messages = 100;
+    // 5% throttled, 8% 5xx, 4% dropped connections
+    graph->setFaults({1, 3, 5, 8, 4, 0});
+    graph->setSeed(42);
+
+    NotificationQueue queue;
+    queue.begin("harness", false);
+    queue.setRetryPolicy({5, 80, 0});
+    queue.setSender([](const Notification& n) {
+        GraphResponse r = client->sendQueued(n.text, n.length, n.callbackKey);
+        return r.ok() ? NOTIFY_DELIVERED : r.retryable() ? NOTIFY_RETRY : NOTIFY_REJECTED;
+    });
+
+    uint32_t start = millis();
+    int sent = 0;
+    while (sent < messages) {
+        for (int b = 0; b < NOTIFICATION_QUEUE_SLOTS && sent < messages; b++, sent++) {
+            TEST_ASSERT_TRUE(queue.enqueue(String("forecast ") + sent));
+        }
+        while (queue.pending() > 0) {
+            uint32_t wait = queue.process();
+            if (wait != NOTIFICATION_IDLE) delay(wait);
+        }
+    }
+    uint32_t elapsedMs = millis() - start;
+
+    NotificationStats q = queue.getStats();
+    GraphStandInStats g = graph->getStats();
+    TEST_ASSERT_EQUAL(messages, q.delivered);
+    // Every message arrived; copies from lost answers are counted, not dropped
+    TEST_ASSERT_EQUAL(messages, g.accepted - g.duplicates);
+    TEST_ASSERT_GREATER_THAN(0, g.rateLimited + g.serverErrors + g.tlsFailures);
+
+    char report[200];
+    snprintf(report, sizeof(report),
+             "%d queued: %.0f msg/s, %lu requests (%lu throttled, %lu 5xx, %lu dropped, %lu duplicates), "
+             "%lu queue retries, latency p50 %lu ms, p99 %lu ms",
+             messages, messages * 1000.0f / max(elapsedMs, (uint32_t)1), (unsigned long)g.requests,
+             (unsigned long)g.rateLimited, (unsigned long)g.serverErrors, (unsigned long)g.tlsFailures,
+             (unsigned long)g.duplicates, (unsigned long)q.retries, (unsigned long)q.latencyP50Ms,
+             (unsigned long)q.latencyP99Ms);
+    TEST_MESSAGE(report);
+}
+
+// Main test runner
+void runHarnessTests() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_connection_and_send);
+    RUN_TEST(test_get_retries_server_errors_and_drops);
+    RUN_TEST(test_post_is_not_resent_after_server_error);
+    RUN_TEST(test_post_resent_when_idle_connection_drops);
+    RUN_TEST(test_lost_ack_is_not_resent);
+    RUN_TEST(test_lost_ack_on_reused_connection_duplicates);
+    RUN_TEST(test_gives_up_after_max_attempts);
+    RUN_TEST(test_rate_limit_and_auth_errors);
+    RUN_TEST(test_send_latency_and_throughput);
+    RUN_TEST(test_fanout_benchmark);
+    RUN_TEST(test_queued_delivery_under_faults);
+
+    UNITY_END();
+}
+
+// Native only: GraphStandIn is a host library
+#ifdef UNIT_TEST
+int main() {
+    runHarnessTests();
+    return 0;
+}
+#endif